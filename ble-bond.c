@@ -0,0 +1,70 @@
+/**
+ * @file ble-bond.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Bond usage table - LRU order and the attribute database each client last saw
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "ble-bond.h"
+
+#include <string.h>
+
+ble_bond_entry_t *ble_bond_find(ble_bond_entry_t *table, size_t count, const uint8_t *bda)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    if (table[i].last_used != 0 && memcmp(table[i].bda, bda, BLE_BOND_ADDR_LEN) == 0)
+      return &table[i];
+  }
+  return NULL;
+}
+
+uint32_t ble_bond_clock(const ble_bond_entry_t *table, size_t count)
+{
+  uint32_t clock = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    if (table[i].last_used > clock)
+      clock = table[i].last_used;
+  }
+  return clock;
+}
+
+bool ble_bond_touch(ble_bond_entry_t *table, size_t count, uint32_t *clock, const uint8_t *bda, uint32_t db_hash)
+{
+  bool db_changed = false;
+  ble_bond_entry_t *entry = ble_bond_find(table, count, bda);
+  if (entry != NULL)
+  {
+    db_changed = (entry->db_hash != db_hash);
+  }
+  else
+  {
+    // Reuse a free slot, or the least recently used one
+    entry = &table[0];
+    for (size_t i = 1; i < count && entry->last_used != 0; i++)
+    {
+      if (table[i].last_used < entry->last_used)
+        entry = &table[i];
+    }
+    memcpy(entry->bda, bda, BLE_BOND_ADDR_LEN);
+  }
+
+  entry->last_used = ++*clock;
+  entry->db_hash = db_hash;  // A new client discovers the current database
+  return db_changed;
+}
+
+bool ble_bond_remove(ble_bond_entry_t *table, size_t count, const uint8_t *bda)
+{
+  ble_bond_entry_t *entry = ble_bond_find(table, count, bda);
+  if (entry == NULL)
+    return false;
+
+  memset(entry, 0, sizeof(*entry));
+  return true;
+}
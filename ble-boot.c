@@ -0,0 +1,191 @@
+/**
+ * @file ble-boot.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Bring-up profiling - stage timestamps and ready signalling
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "ble-boot.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <string.h>
+
+#define BOOT_TAG "BLE_BOOT"
+
+#define BOOT_BIT(stage) (1u << (stage))
+
+// The server is connectable once these stages are reached, in any order
+#define BOOT_READY_BITS                                                            \
+  (BOOT_BIT(BLE_BOOT_STAGE_SERVICE_STARTED) | BOOT_BIT(BLE_BOOT_STAGE_CHARS_ADDED) | \
+   BOOT_BIT(BLE_BOOT_STAGE_ADV_STARTED))
+
+static const char *s_stage_names[BLE_BOOT_STAGE_COUNT] = {
+  [BLE_BOOT_STAGE_INIT_CALLED] = "init called",
+  [BLE_BOOT_STAGE_CONTROLLER_ENABLED] = "controller enabled",
+  [BLE_BOOT_STAGE_BLUEDROID_ENABLED] = "bluedroid enabled",
+  [BLE_BOOT_STAGE_APP_REGISTERED] = "app registered",
+  [BLE_BOOT_STAGE_SERVICE_CREATED] = "service created",
+  [BLE_BOOT_STAGE_SERVICE_STARTED] = "service started",
+  [BLE_BOOT_STAGE_CHARS_ADDED] = "characteristics added",
+  [BLE_BOOT_STAGE_ADV_STARTED] = "advertising started",
+};
+
+static portMUX_TYPE s_boot_lock = portMUX_INITIALIZER_UNLOCKED;
+static ble_boot_profile_t s_profile = {0};
+static ble_ready_cb_t s_on_ready = NULL;
+
+static StaticEventGroup_t s_ready_group_buf;
+static EventGroupHandle_t s_ready_group = NULL;
+
+/**
+ * @brief Log the stage deltas and the stage that took the longest
+ */
+static void boot_log_profile(const ble_boot_profile_t *profile)
+{
+  int64_t origin = profile->stage_us[BLE_BOOT_STAGE_INIT_CALLED];
+  ble_boot_stage_t order[BLE_BOOT_STAGE_COUNT];
+  size_t count = 0;
+
+  // Stages after Bluedroid complete asynchronously: sort the reached ones by time (insertion sort,
+  // a handful of entries) so every delta is measured from the stage that really came before
+  for (int stage = BLE_BOOT_STAGE_CONTROLLER_ENABLED; stage < BLE_BOOT_STAGE_COUNT; stage++)
+  {
+    int64_t at = profile->stage_us[stage];
+    if (at == 0)
+      continue;  // Never reached
+
+    size_t pos = count++;
+    while (pos > 0 && profile->stage_us[order[pos - 1]] > at)
+    {
+      order[pos] = order[pos - 1];
+      pos--;
+    }
+    order[pos] = (ble_boot_stage_t)stage;
+  }
+
+  int64_t prev = origin;
+  int64_t longest = 0;
+  ble_boot_stage_t longest_stage = BLE_BOOT_STAGE_INIT_CALLED;
+  for (size_t i = 0; i < count; i++)
+  {
+    int64_t at = profile->stage_us[order[i]];
+    int64_t delta = at - prev;
+    ESP_LOGI(BOOT_TAG, "  %-22s +%7lld us (at %lld us)", s_stage_names[order[i]], delta, at - origin);
+
+    if (delta > longest)
+    {
+      longest = delta;
+      longest_stage = order[i];
+    }
+    prev = at;
+  }
+
+  ESP_LOGI(BOOT_TAG,
+           "Server connectable %lld us after init, longest stage: %s (%lld us)",
+           prev - origin,
+           s_stage_names[longest_stage],
+           longest);
+}
+
+void ble_boot_start(ble_ready_cb_t on_ready)
+{
+  if (s_ready_group == NULL)
+    s_ready_group = xEventGroupCreateStatic(&s_ready_group_buf);
+
+  xEventGroupClearBits(s_ready_group, BOOT_READY_BITS);
+
+  taskENTER_CRITICAL(&s_boot_lock);
+  memset(&s_profile, 0, sizeof(s_profile));
+  s_on_ready = on_ready;
+  taskEXIT_CRITICAL(&s_boot_lock);
+
+  ble_boot_mark(BLE_BOOT_STAGE_INIT_CALLED);
+}
+
+void ble_boot_mark(ble_boot_stage_t stage)
+{
+  int64_t now_us = esp_timer_get_time();
+  bool became_ready = false;
+
+  taskENTER_CRITICAL(&s_boot_lock);
+  if (s_profile.stage_us[stage] == 0)
+  {
+    s_profile.stage_us[stage] = now_us;
+
+    bool all_reached = true;
+    for (int s = 0; s < BLE_BOOT_STAGE_COUNT; s++)
+    {
+      if ((BOOT_READY_BITS & BOOT_BIT(s)) && s_profile.stage_us[s] == 0)
+        all_reached = false;
+    }
+
+    if (all_reached && !s_profile.ready)
+    {
+      s_profile.ready = true;
+      became_ready = true;
+    }
+  }
+  taskEXIT_CRITICAL(&s_boot_lock);
+
+  if (s_ready_group != NULL && (BOOT_READY_BITS & BOOT_BIT(stage)))
+    xEventGroupSetBits(s_ready_group, BOOT_BIT(stage));
+
+  if (!became_ready)
+    return;
+
+  ble_boot_profile_t profile;
+  ble_boot_get_profile(&profile);
+  boot_log_profile(&profile);
+
+  if (s_on_ready != NULL)
+    s_on_ready();
+}
+
+void ble_boot_mark_char(size_t index)
+{
+  if (index >= BLE_MAX_CHARACTERISTICS)
+    return;
+
+  int64_t now_us = esp_timer_get_time();
+
+  taskENTER_CRITICAL(&s_boot_lock);
+  if (s_profile.char_added_us[index] == 0)
+    s_profile.char_added_us[index] = now_us;
+  if (index + 1 > s_profile.char_count)
+    s_profile.char_count = index + 1;
+  taskEXIT_CRITICAL(&s_boot_lock);
+}
+
+void ble_boot_reset(void)
+{
+  if (s_ready_group != NULL)
+    xEventGroupClearBits(s_ready_group, BOOT_READY_BITS);
+
+  taskENTER_CRITICAL(&s_boot_lock);
+  memset(&s_profile, 0, sizeof(s_profile));
+  s_on_ready = NULL;
+  taskEXIT_CRITICAL(&s_boot_lock);
+}
+
+bool ble_boot_wait_ready(uint32_t timeout_ms)
+{
+  if (s_ready_group == NULL)
+    return false;
+
+  EventBits_t bits = xEventGroupWaitBits(s_ready_group, BOOT_READY_BITS, pdFALSE, pdTRUE, pdMS_TO_TICKS(timeout_ms));
+  return (bits & BOOT_READY_BITS) == BOOT_READY_BITS;
+}
+
+void ble_boot_get_profile(ble_boot_profile_t *out)
+{
+  taskENTER_CRITICAL(&s_boot_lock);
+  *out = s_profile;
+  taskEXIT_CRITICAL(&s_boot_lock);
+}
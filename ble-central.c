@@ -0,0 +1,870 @@
+/**
+ * @file ble-central.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Central role - peripheral connections, handle cache and poll scheduler
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * While a configured peer is not connected the device scans, and connects to
+ * the first one it sees. Scanning (owned by ble-gap.c, shared with the
+ * observer) pauses during a connection attempt, since only one can be pending
+ * at a time. A new peer's service discovery resolves the handles of its
+ * points, which are kept in flash so later connections go straight to polling. A read answered with an invalid handle
+ * drops the cache and forces a new discovery.
+ *
+ * ATT allows one outstanding request per link, so the aggregate sample rate
+ * comes from keeping every link busy at once: a scheduler tick issues, for each
+ * peer without a read in flight, the most overdue poll. All peer links ask for
+ * the same connection interval so the controller lays their connection events
+ * side by side. Subscribed points only cost the notifications themselves.
+ *
+ * While the server is suspended the peer links are closed, the scheduler is
+ * stopped and nothing is scanned or opened; the resume searches again.
+ */
+
+#include "ble-central.h"
+
+#include <esp_gatt_defs.h>
+#include <esp_gattc_api.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ble-gap.h"
+#include "ble-store.h"
+
+#define CENTRAL_TAG             "BLE_CENTRAL"
+#define CENTRAL_APP_ID          1        // The GATT server registers app 0
+#define CENTRAL_TICK_US         5000     // Scheduler period
+#define CENTRAL_READ_TIMEOUT_US 2000000  // A read unanswered this long counts as an error
+#define CENTRAL_CONN_INTERVAL   0x0C     // 15 ms (1.25 ms units) on every peer link
+#define CENTRAL_CONN_TIMEOUT    400      // Supervision timeout, 4 s (10 ms units)
+#define CENTRAL_NONE            -1
+
+typedef struct
+{
+  uint16_t handle;     // Value handle (0 = not found on the peer)
+  uint16_t cccd;       // BLE_CENTRAL_SUBSCRIBE: configuration descriptor handle
+  uint16_t svc_start;  // Range of the point's service during a discovery
+  uint16_t svc_end;
+  int64_t due_us;      // BLE_CENTRAL_POLL: time of the next read
+  int64_t updated_us;  // Arrival of the latest value (0 = none yet)
+  uint16_t len;
+  uint8_t value[BLE_CENTRAL_MAX_VALUE];
+} central_point_t;
+
+typedef struct
+{
+  const ble_central_peer_t *cfg;
+  ble_central_peer_state_t state;
+  uint16_t conn_id;
+  bool cached;        // Point handles are known, from flash or a discovery
+  int in_flight;      // Point being read (CENTRAL_NONE = link idle)
+  int64_t sent_us;    // Time the read in flight was issued
+  uint64_t latency_total_us;
+  central_point_t points[BLE_CENTRAL_MAX_POINTS];
+  ble_central_peer_stats_t stats;
+} central_peer_t;
+
+// Point handles of one peer as stored in flash
+typedef struct
+{
+  uint32_t tag;  // Hash of the peer address and points, a changed configuration invalidates the entry
+  uint16_t handle[BLE_CENTRAL_MAX_POINTS];
+  uint16_t cccd[BLE_CENTRAL_MAX_POINTS];
+} central_cache_t;
+
+static const ble_central_config_t *s_config = NULL;
+static central_peer_t *s_peers = NULL;
+static esp_gatt_if_t s_gattc_if = ESP_GATT_IF_NONE;
+static esp_timer_handle_t s_tick_timer = NULL;
+static size_t s_first_peer = 0;  // Peer the next tick serves first, so no link is always last
+static portMUX_TYPE s_central_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool s_suspended = false;  // No link is opened or kept and nothing is polled
+
+//* Connect state, only touched by the Bluetooth task
+static int s_connecting = CENTRAL_NONE;  // Peer being connected
+static bool s_open_issued = false;
+static esp_ble_addr_type_t s_connect_addr_type = BLE_ADDR_TYPE_PUBLIC;
+
+/**
+ * @brief FNV-1a over a buffer, continuing from hash
+ */
+static uint32_t fnv1a(uint32_t hash, const void *data, size_t len)
+{
+  const uint8_t *bytes = data;
+  for (size_t i = 0; i < len; i++)
+  {
+    hash ^= bytes[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static uint32_t cache_tag(const ble_central_peer_t *cfg)
+{
+  uint32_t hash = fnv1a(2166136261u, cfg->address, sizeof(cfg->address));
+  for (size_t p = 0; p < cfg->point_count; p++)
+  {
+    hash = fnv1a(hash, &cfg->points[p].service_uuid, sizeof(cfg->points[p].service_uuid));
+    hash = fnv1a(hash, &cfg->points[p].uuid, sizeof(cfg->points[p].uuid));
+    hash = fnv1a(hash, &cfg->points[p].mode, sizeof(cfg->points[p].mode));
+  }
+  return hash;
+}
+
+static void cache_key(size_t index, char *key, size_t size)
+{
+  snprintf(key, size, "central_%u", (unsigned)index);
+}
+
+static void cache_load(size_t index)
+{
+  central_peer_t *peer = &s_peers[index];
+  central_cache_t cache;
+  size_t len = sizeof(cache);
+  char key[16];
+
+  cache_key(index, key, sizeof(key));
+  if (ble_store_get(key, &cache, &len) != ESP_OK || len != sizeof(cache) || cache.tag != cache_tag(peer->cfg))
+    return;
+
+  for (size_t p = 0; p < peer->cfg->point_count; p++)
+  {
+    peer->points[p].handle = cache.handle[p];
+    peer->points[p].cccd = cache.cccd[p];
+  }
+  peer->cached = true;
+}
+
+static void cache_save(size_t index)
+{
+  central_peer_t *peer = &s_peers[index];
+  central_cache_t cache = {.tag = cache_tag(peer->cfg)};
+  char key[16];
+
+  for (size_t p = 0; p < peer->cfg->point_count; p++)
+  {
+    cache.handle[p] = peer->points[p].handle;
+    cache.cccd[p] = peer->points[p].cccd;
+  }
+
+  cache_key(index, key, sizeof(key));
+  if (ble_store_set(key, &cache, sizeof(cache)) == ESP_OK)
+    ble_store_commit();
+}
+
+static void cache_drop(size_t index)
+{
+  char key[16];
+
+  s_peers[index].cached = false;
+  cache_key(index, key, sizeof(key));
+  if (ble_store_erase(key) == ESP_OK)
+    ble_store_commit();
+}
+
+static int find_peer_by_bda(const uint8_t *bda)
+{
+  for (size_t i = 0; s_config != NULL && i < s_config->peer_count; i++)
+  {
+    if (memcmp(s_peers[i].cfg->address, bda, ESP_BD_ADDR_LEN) == 0)
+      return i;
+  }
+  return CENTRAL_NONE;
+}
+
+static int find_peer_by_conn(uint16_t conn_id)
+{
+  for (size_t i = 0; s_config != NULL && i < s_config->peer_count; i++)
+  {
+    if (s_peers[i].state >= BLE_CENTRAL_PEER_DISCOVERING && s_peers[i].conn_id == conn_id)
+      return i;
+  }
+  return CENTRAL_NONE;
+}
+
+static int find_point(const central_peer_t *peer, uint16_t handle)
+{
+  for (size_t p = 0; p < peer->cfg->point_count; p++)
+  {
+    if (peer->points[p].handle == handle && handle != 0)
+      return p;
+  }
+  return CENTRAL_NONE;
+}
+
+/**
+ * @brief Tell the scanner what the peers need and open the pending connection once it stopped. Bluetooth task.
+ *
+ * SCAN_STOP_COMPLETE calls this again when the connection waits for the scan to stop.
+ */
+static void central_reconcile(void)
+{
+  if (s_gattc_if == ESP_GATT_IF_NONE)
+    return;
+
+  // Suspended: a connection not opened yet is given up and the scan is released
+  if (s_suspended && s_connecting != CENTRAL_NONE && !s_open_issued)
+  {
+    taskENTER_CRITICAL(&s_central_lock);
+    s_peers[s_connecting].state = BLE_CENTRAL_PEER_SEARCHING;
+    taskEXIT_CRITICAL(&s_central_lock);
+    s_connecting = CENTRAL_NONE;
+  }
+
+  bool searching = false;
+  for (size_t i = 0; i < s_config->peer_count && !s_suspended; i++)
+    searching |= s_peers[i].state == BLE_CENTRAL_PEER_SEARCHING;
+
+  bool connecting = s_connecting != CENTRAL_NONE;
+  bool scan_stopped = ble_gap_set_central_scan(searching, connecting);
+  if (!connecting || s_open_issued || !scan_stopped)
+    return;
+
+  central_peer_t *peer = &s_peers[s_connecting];
+  esp_bd_addr_t bda;
+  memcpy(bda, peer->cfg->address, ESP_BD_ADDR_LEN);
+  esp_ble_gap_set_prefer_conn_params(bda, CENTRAL_CONN_INTERVAL, CENTRAL_CONN_INTERVAL, 0, CENTRAL_CONN_TIMEOUT);
+
+  if (esp_ble_gattc_open(s_gattc_if, bda, s_connect_addr_type, true) == ESP_OK)
+  {
+    s_open_issued = true;
+    return;
+  }
+
+  ESP_LOGW(CENTRAL_TAG, "Connecting to '%s' failed", peer->cfg->name);
+  taskENTER_CRITICAL(&s_central_lock);
+  peer->state = BLE_CENTRAL_PEER_SEARCHING;
+  taskEXIT_CRITICAL(&s_central_lock);
+  s_connecting = CENTRAL_NONE;
+  ble_gap_set_central_scan(true, false);
+}
+
+/**
+ * @brief Handles are known: subscribe, spread the first polls over one period and hand the link to the scheduler
+ */
+static void central_ready(size_t index)
+{
+  central_peer_t *peer = &s_peers[index];
+  const ble_central_peer_t *cfg = peer->cfg;
+
+  if (s_suspended)
+  {
+    esp_ble_gattc_close(s_gattc_if, peer->conn_id);  // Discovery ended after the suspend closed the links
+    return;
+  }
+  int64_t now_us = esp_timer_get_time();
+  esp_bd_addr_t bda;
+  memcpy(bda, cfg->address, ESP_BD_ADDR_LEN);
+
+  for (size_t p = 0; p < cfg->point_count; p++)
+  {
+    central_point_t *point = &peer->points[p];
+    if (point->handle == 0)
+      continue;
+
+    if (cfg->points[p].mode == BLE_CENTRAL_SUBSCRIBE)
+    {
+      uint8_t enable[2] = {0x01, 0x00};
+      esp_ble_gattc_register_for_notify(s_gattc_if, bda, point->handle);
+      if (point->cccd != 0)
+        esp_ble_gattc_write_char_descr(s_gattc_if, peer->conn_id, point->cccd, sizeof(enable), enable,
+                                       ESP_GATT_WRITE_TYPE_RSP, ESP_GATT_AUTH_REQ_NONE);
+    }
+    else
+    {
+      point->due_us = now_us + (int64_t)cfg->points[p].period_ms * 1000 * p / cfg->point_count;
+    }
+  }
+
+  taskENTER_CRITICAL(&s_central_lock);
+  peer->state = BLE_CENTRAL_PEER_READY;
+  peer->in_flight = CENTRAL_NONE;
+  taskEXIT_CRITICAL(&s_central_lock);
+
+  if (!esp_timer_is_active(s_tick_timer))
+    esp_timer_start_periodic(s_tick_timer, CENTRAL_TICK_US);
+
+  ESP_LOGI(CENTRAL_TAG, "'%s' ready (conn_id %d)", cfg->name, peer->conn_id);
+}
+
+/**
+ * @brief Resolve the handles of every point from the discovered services
+ */
+static void central_discovered(size_t index)
+{
+  central_peer_t *peer = &s_peers[index];
+  const ble_central_peer_t *cfg = peer->cfg;
+
+  for (size_t p = 0; p < cfg->point_count; p++)
+  {
+    central_point_t *point = &peer->points[p];
+    esp_gattc_char_elem_t ch;
+    esp_gattc_descr_elem_t descr;
+    uint16_t count = 1;
+
+    point->handle = 0;
+    point->cccd = 0;
+    esp_bt_uuid_t uuid = {.len = ESP_UUID_LEN_16, .uuid.uuid16 = cfg->points[p].uuid};
+    if (point->svc_start != 0 && esp_ble_gattc_get_char_by_uuid(s_gattc_if, peer->conn_id, point->svc_start,
+                                                                point->svc_end, uuid, &ch, &count) == ESP_OK &&
+        count > 0)
+      point->handle = ch.char_handle;
+
+    if (point->handle == 0)
+    {
+      ESP_LOGW(CENTRAL_TAG, "'%s' has no characteristic 0x%04X", cfg->name, cfg->points[p].uuid);
+      continue;
+    }
+
+    count = 1;
+    esp_bt_uuid_t cccd_uuid = {.len = ESP_UUID_LEN_16, .uuid.uuid16 = ESP_GATT_UUID_CHAR_CLIENT_CONFIG};
+    if (cfg->points[p].mode == BLE_CENTRAL_SUBSCRIBE &&
+        esp_ble_gattc_get_descr_by_char_handle(s_gattc_if, peer->conn_id, point->handle, cccd_uuid, &descr, &count) ==
+          ESP_OK &&
+        count > 0)
+      point->cccd = descr.handle;
+  }
+
+  peer->cached = true;
+  peer->stats.discoveries++;
+  cache_save(index);
+  central_ready(index);
+}
+
+/**
+ * @brief Keep the latest value of a point and pass it to the application
+ */
+static void central_store(size_t index, size_t point, const uint8_t *value, size_t len)
+{
+  central_point_t *pt = &s_peers[index].points[point];
+
+  taskENTER_CRITICAL(&s_central_lock);
+  pt->len = (len < sizeof(pt->value)) ? len : sizeof(pt->value);
+  memcpy(pt->value, value, pt->len);
+  pt->updated_us = esp_timer_get_time();
+  taskEXIT_CRITICAL(&s_central_lock);
+
+  if (s_config->on_data != NULL)
+    s_config->on_data(index, point, value, len);
+}
+
+static void central_read_done(size_t index, const esp_ble_gattc_cb_param_t *param)
+{
+  central_peer_t *peer = &s_peers[index];
+  int64_t now_us = esp_timer_get_time();
+  int point = find_point(peer, param->read.handle);
+
+  taskENTER_CRITICAL(&s_central_lock);
+  if (peer->in_flight != CENTRAL_NONE && peer->in_flight == point)
+  {
+    uint32_t latency_us = (uint32_t)(now_us - peer->sent_us);
+    peer->in_flight = CENTRAL_NONE;
+    peer->stats.last_latency_us = latency_us;
+    if (latency_us > peer->stats.max_latency_us)
+      peer->stats.max_latency_us = latency_us;
+    if (param->read.status == ESP_GATT_OK)
+    {
+      peer->stats.polls++;
+      peer->latency_total_us += latency_us;
+    }
+  }
+  if (param->read.status != ESP_GATT_OK)
+    peer->stats.errors++;
+  taskEXIT_CRITICAL(&s_central_lock);
+
+  if (param->read.status == ESP_GATT_INVALID_HANDLE)
+  {
+    // The peer's database changed under the cache: reconnect and discover again
+    ESP_LOGW(CENTRAL_TAG, "'%s' handles are stale, rediscovering", peer->cfg->name);
+    cache_drop(index);
+    esp_ble_gattc_close(s_gattc_if, peer->conn_id);
+  }
+  else if (param->read.status == ESP_GATT_OK && point != CENTRAL_NONE)
+  {
+    central_store(index, point, param->read.value, param->read.value_len);
+  }
+}
+
+/**
+ * @brief Issue the most overdue poll on every idle link. Runs in the esp_timer task.
+ */
+static void central_tick(void *arg)
+{
+  if (s_suspended)
+  {
+    esp_timer_stop(s_tick_timer);
+    return;
+  }
+
+  int64_t now_us = esp_timer_get_time();
+  size_t peer_count = s_config->peer_count;
+  size_t ready = 0;
+
+  for (size_t n = 0; n < peer_count; n++)
+  {
+    size_t index = (s_first_peer + n) % peer_count;
+    central_peer_t *peer = &s_peers[index];
+    int next = CENTRAL_NONE;
+    uint16_t conn_id = 0, handle = 0;
+
+    taskENTER_CRITICAL(&s_central_lock);
+    if (peer->state == BLE_CENTRAL_PEER_READY)
+    {
+      ready++;
+      if (peer->in_flight != CENTRAL_NONE && now_us - peer->sent_us > CENTRAL_READ_TIMEOUT_US)
+      {
+        peer->in_flight = CENTRAL_NONE;
+        peer->stats.errors++;
+      }
+
+      for (size_t p = 0; p < peer->cfg->point_count && peer->in_flight == CENTRAL_NONE; p++)
+      {
+        const central_point_t *point = &peer->points[p];
+        if (peer->cfg->points[p].mode == BLE_CENTRAL_POLL && point->handle != 0 && point->due_us <= now_us &&
+            (next == CENTRAL_NONE || point->due_us < peer->points[next].due_us))
+          next = p;
+      }
+
+      if (next != CENTRAL_NONE)
+      {
+        central_point_t *point = &peer->points[next];
+        int64_t period_us = (int64_t)peer->cfg->points[next].period_ms * 1000;
+        int64_t lag_us = now_us - point->due_us;
+        int64_t skipped = lag_us / period_us;
+
+        // Periods that went by while the link was busy are counted, not made up for
+        peer->stats.missed_polls += skipped;
+        if (lag_us > peer->stats.max_lag_us)
+          peer->stats.max_lag_us = lag_us;
+        point->due_us += (skipped + 1) * period_us;
+        peer->in_flight = next;
+        peer->sent_us = now_us;
+        conn_id = peer->conn_id;
+        handle = point->handle;
+      }
+    }
+    taskEXIT_CRITICAL(&s_central_lock);
+
+    if (next == CENTRAL_NONE)
+      continue;
+
+    if (esp_ble_gattc_read_char(s_gattc_if, conn_id, handle, ESP_GATT_AUTH_REQ_NONE) != ESP_OK)
+    {
+      taskENTER_CRITICAL(&s_central_lock);
+      if (peer->in_flight == next)
+        peer->in_flight = CENTRAL_NONE;
+      peer->stats.errors++;
+      taskEXIT_CRITICAL(&s_central_lock);
+    }
+  }
+
+  s_first_peer = (s_first_peer + 1) % peer_count;
+  if (ready == 0)
+    esp_timer_stop(s_tick_timer);
+}
+
+static void central_disconnected(size_t index)
+{
+  central_peer_t *peer = &s_peers[index];
+
+  taskENTER_CRITICAL(&s_central_lock);
+  peer->state = BLE_CENTRAL_PEER_SEARCHING;
+  peer->in_flight = CENTRAL_NONE;
+  peer->stats.disconnects++;
+  taskEXIT_CRITICAL(&s_central_lock);
+
+  ESP_LOGI(CENTRAL_TAG, "'%s' disconnected", peer->cfg->name);
+  central_reconcile();
+}
+
+static void gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t *param)
+{
+  if (event == ESP_GATTC_REG_EVT)
+  {
+    if (param->reg.app_id != CENTRAL_APP_ID)
+      return;
+    if (param->reg.status != ESP_GATT_OK)
+    {
+      ESP_LOGE(CENTRAL_TAG, "GATT client registration failed, status %d", param->reg.status);
+      return;
+    }
+
+    s_gattc_if = gattc_if;
+    central_reconcile();
+    return;
+  }
+
+  if (s_config == NULL || gattc_if != s_gattc_if)
+    return;
+
+  switch (event)
+  {
+    case ESP_GATTC_OPEN_EVT:
+    {
+      int index = find_peer_by_bda(param->open.remote_bda);
+      if (index == CENTRAL_NONE || s_peers[index].state != BLE_CENTRAL_PEER_CONNECTING)
+        break;
+
+      central_peer_t *peer = &s_peers[index];
+      if (s_connecting == index)
+      {
+        s_connecting = CENTRAL_NONE;
+        s_open_issued = false;
+      }
+
+      if (param->open.status != ESP_GATT_OK)
+      {
+        ESP_LOGW(CENTRAL_TAG, "Connection to '%s' failed, status %d", peer->cfg->name, param->open.status);
+        taskENTER_CRITICAL(&s_central_lock);
+        peer->state = BLE_CENTRAL_PEER_SEARCHING;
+        taskEXIT_CRITICAL(&s_central_lock);
+        central_reconcile();
+        break;
+      }
+
+      taskENTER_CRITICAL(&s_central_lock);
+      peer->conn_id = param->open.conn_id;
+      peer->state = BLE_CENTRAL_PEER_DISCOVERING;
+      peer->stats.connects++;
+      taskEXIT_CRITICAL(&s_central_lock);
+
+      ESP_LOGI(CENTRAL_TAG, "Connected to '%s' (conn_id %d)", peer->cfg->name, peer->conn_id);
+      if (s_suspended)
+      {
+        esp_ble_gattc_close(gattc_if, peer->conn_id);  // Opened before the suspend, the disconnect frees the peer
+        break;
+      }
+      esp_ble_gattc_send_mtu_req(gattc_if, peer->conn_id);
+
+      if (peer->cached)
+      {
+        central_ready(index);
+      }
+      else
+      {
+        for (size_t p = 0; p < peer->cfg->point_count; p++)
+          peer->points[p].svc_start = peer->points[p].svc_end = 0;
+        esp_ble_gattc_search_service(gattc_if, peer->conn_id, NULL);
+      }
+
+      // Scanning resumes for the peers still missing
+      central_reconcile();
+      break;
+    }
+
+    case ESP_GATTC_SEARCH_RES_EVT:
+    {
+      int index = find_peer_by_conn(param->search_res.conn_id);
+      if (index == CENTRAL_NONE || param->search_res.srvc_id.uuid.len != ESP_UUID_LEN_16)
+        break;
+
+      central_peer_t *peer = &s_peers[index];
+      for (size_t p = 0; p < peer->cfg->point_count; p++)
+      {
+        if (peer->cfg->points[p].service_uuid == param->search_res.srvc_id.uuid.uuid.uuid16)
+        {
+          peer->points[p].svc_start = param->search_res.start_handle;
+          peer->points[p].svc_end = param->search_res.end_handle;
+        }
+      }
+      break;
+    }
+
+    case ESP_GATTC_SEARCH_CMPL_EVT:
+    {
+      int index = find_peer_by_conn(param->search_cmpl.conn_id);
+      if (index == CENTRAL_NONE || s_peers[index].state != BLE_CENTRAL_PEER_DISCOVERING)
+        break;
+
+      if (param->search_cmpl.status != ESP_GATT_OK)
+      {
+        ESP_LOGW(CENTRAL_TAG, "Discovery of '%s' failed, status %d", s_peers[index].cfg->name,
+                 param->search_cmpl.status);
+        esp_ble_gattc_close(gattc_if, s_peers[index].conn_id);
+        break;
+      }
+
+      central_discovered(index);
+      break;
+    }
+
+    case ESP_GATTC_READ_CHAR_EVT:
+    {
+      int index = find_peer_by_conn(param->read.conn_id);
+      if (index != CENTRAL_NONE)
+        central_read_done(index, param);
+      break;
+    }
+
+    case ESP_GATTC_NOTIFY_EVT:
+    {
+      int index = find_peer_by_conn(param->notify.conn_id);
+      int point = (index != CENTRAL_NONE) ? find_point(&s_peers[index], param->notify.handle) : CENTRAL_NONE;
+      if (point == CENTRAL_NONE)
+        break;
+
+      taskENTER_CRITICAL(&s_central_lock);
+      s_peers[index].stats.notifications++;
+      taskEXIT_CRITICAL(&s_central_lock);
+
+      central_store(index, point, param->notify.value, param->notify.value_len);
+      break;
+    }
+
+    case ESP_GATTC_WRITE_DESCR_EVT:
+    {
+      if (param->write.status != ESP_GATT_OK)
+        ESP_LOGW(CENTRAL_TAG, "Subscribing failed, handle %d, status %d", param->write.handle, param->write.status);
+      break;
+    }
+
+    case ESP_GATTC_CFG_MTU_EVT:
+    {
+      ESP_LOGD(CENTRAL_TAG, "Peer MTU %d (conn_id %d)", param->cfg_mtu.mtu, param->cfg_mtu.conn_id);
+      break;
+    }
+
+    case ESP_GATTC_DISCONNECT_EVT:
+    {
+      int index = find_peer_by_bda(param->disconnect.remote_bda);
+      if (index != CENTRAL_NONE && s_peers[index].state >= BLE_CENTRAL_PEER_DISCOVERING &&
+          s_peers[index].conn_id == param->disconnect.conn_id)
+        central_disconnected(index);
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+void ble_central_handle_gap_event(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
+{
+  // Peers are read without pairing; keys and the client's bond table stay out of their links
+  if (event == ESP_GAP_BLE_SEC_REQ_EVT)
+  {
+    ESP_LOGW(CENTRAL_TAG,
+             "Pairing requested by " ESP_BD_ADDR_STR " on a central link, refused",
+             ESP_BD_ADDR_HEX(param->ble_security.ble_req.bd_addr));
+    esp_ble_gap_security_rsp(param->ble_security.ble_req.bd_addr, false);
+    return;
+  }
+  if (event == ESP_GAP_BLE_AUTH_CMPL_EVT)
+  {
+    ESP_LOGD(CENTRAL_TAG,
+             "Authentication with " ESP_BD_ADDR_STR " ignored, not the client",
+             ESP_BD_ADDR_HEX(param->ble_security.auth_cmpl.bd_addr));
+    return;
+  }
+
+  if (s_config == NULL)
+    return;
+
+  switch (event)
+  {
+    case ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT:
+    {
+      central_reconcile();
+      break;
+    }
+    case ESP_GAP_BLE_SCAN_RESULT_EVT:
+    {
+      if (s_connecting != CENTRAL_NONE)
+        break;
+
+      int index = find_peer_by_bda(param->scan_rst.bda);
+      if (index == CENTRAL_NONE || s_peers[index].state != BLE_CENTRAL_PEER_SEARCHING)
+        break;
+
+      taskENTER_CRITICAL(&s_central_lock);
+      s_peers[index].state = BLE_CENTRAL_PEER_CONNECTING;
+      taskEXIT_CRITICAL(&s_central_lock);
+
+      s_connecting = index;
+      s_open_issued = false;
+      s_connect_addr_type = param->scan_rst.ble_addr_type;
+      ESP_LOGI(CENTRAL_TAG, "Found '%s' (RSSI %d), connecting", s_peers[index].cfg->name, param->scan_rst.rssi);
+      central_reconcile();
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+esp_err_t ble_central_init(const ble_central_config_t *config)
+{
+  if (config->peers == NULL || config->peer_count == 0 || config->peer_count > BLE_CENTRAL_MAX_PEERS)
+  {
+    ESP_LOGE(CENTRAL_TAG, "Between 1 and %d peers are supported", BLE_CENTRAL_MAX_PEERS);
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (size_t i = 0; i < config->peer_count; i++)
+  {
+    const ble_central_peer_t *cfg = &config->peers[i];
+    if (cfg->points == NULL || cfg->point_count == 0 || cfg->point_count > BLE_CENTRAL_MAX_POINTS)
+    {
+      ESP_LOGE(CENTRAL_TAG, "Peer '%s' needs between 1 and %d points", cfg->name, BLE_CENTRAL_MAX_POINTS);
+      return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t p = 0; p < cfg->point_count; p++)
+    {
+      if (cfg->points[p].mode == BLE_CENTRAL_POLL && cfg->points[p].period_ms == 0)
+      {
+        ESP_LOGE(CENTRAL_TAG, "Point 0x%04X of '%s' has no poll period", cfg->points[p].uuid, cfg->name);
+        return ESP_ERR_INVALID_ARG;
+      }
+    }
+  }
+
+  s_peers = (central_peer_t *)calloc(config->peer_count, sizeof(central_peer_t));
+  if (s_peers == NULL)
+    return ESP_ERR_NO_MEM;
+
+  s_config = config;
+  for (size_t i = 0; i < config->peer_count; i++)
+  {
+    s_peers[i].cfg = &config->peers[i];
+    s_peers[i].state = BLE_CENTRAL_PEER_SEARCHING;
+    s_peers[i].in_flight = CENTRAL_NONE;
+    cache_load(i);
+  }
+
+  const esp_timer_create_args_t timer_args = {
+    .callback = central_tick,
+    .name = "ble_central",
+  };
+  esp_err_t ret = esp_timer_create(&timer_args, &s_tick_timer);
+  if (ret == ESP_OK)
+    ret = esp_ble_gattc_register_callback(gattc_event_handler);
+  if (ret == ESP_OK)
+    ret = esp_ble_gattc_app_register(CENTRAL_APP_ID);
+  if (ret != ESP_OK)
+  {
+    ESP_LOGE(CENTRAL_TAG, "GATT client init failed: %s", esp_err_to_name(ret));
+    ble_central_deinit();
+    return ret;
+  }
+
+  ESP_LOGI(CENTRAL_TAG, "Central role with %d peers", config->peer_count);
+  return ESP_OK;
+}
+
+void ble_central_deinit(void)
+{
+  if (s_tick_timer != NULL)
+  {
+    esp_timer_stop(s_tick_timer);
+    esp_timer_delete(s_tick_timer);
+    s_tick_timer = NULL;
+  }
+
+  // ble_server_stop() disables Bluedroid first, which drops the peer links and stops the scan;
+  // the unregister only matters when init failed with the stack still up
+  if (s_gattc_if != ESP_GATT_IF_NONE)
+    esp_ble_gattc_app_unregister(s_gattc_if);
+
+  s_config = NULL;
+  s_gattc_if = ESP_GATT_IF_NONE;
+  s_suspended = false;
+  s_connecting = CENTRAL_NONE;
+  s_open_issued = false;
+  free(s_peers);
+  s_peers = NULL;
+}
+
+void ble_central_suspend(void)
+{
+  if (s_config == NULL)
+    return;
+
+  s_suspended = true;
+  esp_timer_stop(s_tick_timer);
+
+  // The disconnect events put the peers back to searching, which waits for the resume
+  for (size_t i = 0; i < s_config->peer_count; i++)
+  {
+    taskENTER_CRITICAL(&s_central_lock);
+    bool linked = s_peers[i].state >= BLE_CENTRAL_PEER_DISCOVERING;
+    uint16_t conn_id = s_peers[i].conn_id;
+    taskEXIT_CRITICAL(&s_central_lock);
+
+    if (linked && s_gattc_if != ESP_GATT_IF_NONE)
+      esp_ble_gattc_close(s_gattc_if, conn_id);
+  }
+  ESP_LOGI(CENTRAL_TAG, "Central role suspended");
+}
+
+void ble_central_resume(void)
+{
+  if (s_config == NULL || !s_suspended)
+    return;
+
+  s_suspended = false;
+
+  bool searching = false;
+  taskENTER_CRITICAL(&s_central_lock);
+  for (size_t i = 0; i < s_config->peer_count; i++)
+    searching |= s_peers[i].state == BLE_CENTRAL_PEER_SEARCHING;
+  taskEXIT_CRITICAL(&s_central_lock);
+
+  // Scan results drive the connections from here, in the Bluetooth task
+  ble_gap_set_central_scan(searching, false);
+  ESP_LOGI(CENTRAL_TAG, "Central role resumed");
+}
+
+bool ble_central_is_peer(const uint8_t *bda)
+{
+  return find_peer_by_bda(bda) != CENTRAL_NONE;
+}
+
+ble_return_code_t ble_central_get_stats(size_t peer, ble_central_peer_stats_t *out)
+{
+  if (s_config == NULL)
+    return BLE_NOT_INITIALIZED;
+  if (peer >= s_config->peer_count)
+    return BLE_INVALID_CONFIG;
+
+  taskENTER_CRITICAL(&s_central_lock);
+  *out = s_peers[peer].stats;
+  out->state = s_peers[peer].state;
+  if (out->polls > 0)
+    out->avg_latency_us = (uint32_t)(s_peers[peer].latency_total_us / out->polls);
+  taskEXIT_CRITICAL(&s_central_lock);
+
+  return BLE_SUCCESS;
+}
+
+ble_return_code_t ble_central_get_value(size_t peer, size_t point, void *out, size_t max_len, size_t *out_len,
+                                        uint32_t *age_ms)
+{
+  if (out == NULL || out_len == NULL)
+    return BLE_INVALID_CONFIG;
+  if (s_config == NULL)
+    return BLE_NOT_INITIALIZED;
+  if (peer >= s_config->peer_count || point >= s_config->peers[peer].point_count)
+    return BLE_INVALID_CONFIG;
+
+  const central_point_t *pt = &s_peers[peer].points[point];
+  int64_t now_us = esp_timer_get_time();
+  int64_t updated_us;
+
+  taskENTER_CRITICAL(&s_central_lock);
+  updated_us = pt->updated_us;
+  *out_len = (pt->len < max_len) ? pt->len : max_len;
+  memcpy(out, pt->value, *out_len);
+  taskEXIT_CRITICAL(&s_central_lock);
+
+  if (updated_us == 0)
+    return BLE_NOT_INITIALIZED;
+  if (age_ms != NULL)
+    *age_ms = (uint32_t)((now_us - updated_us) / 1000);
+  return BLE_SUCCESS;
+}
@@ -0,0 +1,408 @@
+/**
+ * @file ble-channel.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Credit-based data channel with segmentation and reassembly
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * Modelled on an LE credit-based L2CAP channel, carried by one characteristic
+ * (client writes without response, server notifies). Every PDU starts with a
+ * type byte:
+ *
+ *   0x00 FIRST  SDU length u16, payload    first segment of an SDU
+ *   0x01 CONT   payload                    further segments
+ *   0x02 CREDIT credits u16, MPS u16       the sender may send that many more segments
+ *                                          of at most MPS payload bytes
+ *
+ * The client opens the channel with a CREDIT; the server answers with credits
+ * for its whole receive pool. Received segments go straight into fixed pool
+ * blocks and are reassembled by ble_channel_read() in the application task,
+ * which returns the credits as blocks are freed. Since the client never holds
+ * more credits than free blocks, the Bluetooth task never waits or allocates.
+ */
+
+#include "ble-channel.h"
+
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ble-gatts.h"
+
+#define CHANNEL_TAG        "BLE_CHANNEL"
+#define CHANNEL_POOL       16   // Receive blocks, also the credits granted to the client
+#define CHANNEL_MPS        244  // Payload bytes per block (one LE data packet with ATT and L2CAP headers)
+#define CHANNEL_MAX_CREDIT 0xFFFF
+
+#define CHANNEL_FIRST  0x00
+#define CHANNEL_CONT   0x01
+#define CHANNEL_CREDIT 0x02
+
+#define CHANNEL_FIRST_HEADER 3  // Type + SDU length
+#define CHANNEL_CONT_HEADER  1
+
+// One received segment
+typedef struct
+{
+  uint16_t len;
+  uint16_t sdu_len;  // Non-zero on the first segment of an SDU
+} ble_channel_block_t;
+
+static size_t s_index = 0;
+static uint8_t *s_pool = NULL;  // CHANNEL_POOL blocks of CHANNEL_MPS bytes
+static ble_channel_block_t s_blocks[CHANNEL_POOL];
+static uint32_t s_free_mask = 0;   // Bit set = block free
+static QueueHandle_t s_rx = NULL;  // Indexes of filled blocks, in arrival order
+static SemaphoreHandle_t s_tx_credits = NULL;
+static SemaphoreHandle_t s_tx_lock = NULL;  // One writer at a time keeps SDU segments together
+static uint16_t s_tx_mps = 0;               // Segment payload the client accepts
+static bool s_open = false;                 // Client sent its first CREDIT
+static uint16_t s_returned = 0;             // Credits freed by the reader, not yet sent to the client
+
+static portMUX_TYPE s_channel_lock = portMUX_INITIALIZER_UNLOCKED;
+static ble_channel_stats_t s_stats = {0};
+
+static void put_u16(uint8_t *out, uint16_t value)
+{
+  out[0] = (uint8_t)(value & 0xFF);
+  out[1] = (uint8_t)(value >> 8);
+}
+
+static uint16_t get_u16(const uint8_t *in)
+{
+  return in[0] | ((uint16_t)in[1] << 8);
+}
+
+/**
+ * @brief Give credits to the client
+ */
+static bool channel_grant(uint16_t credits)
+{
+  uint16_t mps = ble_gatts_get_mtu() - BLE_ATT_NOTIFY_HEADER - CHANNEL_FIRST_HEADER;
+  if (mps > CHANNEL_MPS)
+    mps = CHANNEL_MPS;
+
+  uint8_t msg[5] = {CHANNEL_CREDIT};
+  put_u16(&msg[1], credits);
+  put_u16(&msg[3], mps);
+  return ble_gatts_notify(s_index, msg, sizeof(msg)) == ESP_OK;
+}
+
+static void channel_free_block(uint8_t block)
+{
+  taskENTER_CRITICAL(&s_channel_lock);
+  s_free_mask |= (1u << block);
+  s_returned++;
+  taskEXIT_CRITICAL(&s_channel_lock);
+}
+
+/**
+ * @brief Send the freed credits once half the pool is back, so grants stay rare
+ */
+static void channel_return_credits(void)
+{
+  uint16_t credits;
+
+  taskENTER_CRITICAL(&s_channel_lock);
+  credits = (s_returned >= CHANNEL_POOL / 2) ? s_returned : 0;
+  taskEXIT_CRITICAL(&s_channel_lock);
+
+  if (credits == 0 || !s_open || !channel_grant(credits))
+    return;  // Link busy: the next read tries again
+
+  taskENTER_CRITICAL(&s_channel_lock);
+  s_returned -= credits;
+  taskEXIT_CRITICAL(&s_channel_lock);
+}
+
+/**
+ * @brief Store one received segment into a pool block. Bluetooth task.
+ */
+static void channel_receive(const uint8_t *payload, size_t len, uint16_t sdu_len)
+{
+  int block = -1;
+
+  taskENTER_CRITICAL(&s_channel_lock);
+  if (s_free_mask != 0 && len <= CHANNEL_MPS)
+  {
+    block = __builtin_ctz(s_free_mask);
+    s_free_mask &= ~(1u << block);
+  }
+  if (block < 0)
+    s_stats.overruns++;  // The client sent without a credit
+  else
+    s_stats.segments_received++;
+  taskEXIT_CRITICAL(&s_channel_lock);
+
+  if (block < 0)
+    return;
+
+  memcpy(&s_pool[block * CHANNEL_MPS], payload, len);
+  s_blocks[block].len = len;
+  s_blocks[block].sdu_len = sdu_len;
+
+  uint8_t index = block;
+  xQueueSend(s_rx, &index, 0);  // Cannot fail, the queue holds the whole pool
+}
+
+static ble_char_error_t channel_write(const uint8_t *data, size_t len)
+{
+  if (len < 1)
+    return BLE_CHAR_ERR_SIZE;
+
+  switch (data[0])
+  {
+    case CHANNEL_CREDIT:
+    {
+      if (len < 5)
+        return BLE_CHAR_ERR_SIZE;
+
+      uint16_t credits = get_u16(&data[1]);
+      s_tx_mps = get_u16(&data[3]);
+      for (uint16_t i = 0; i < credits; i++)
+        xSemaphoreGive(s_tx_credits);
+
+      // The first CREDIT opens the channel: answer with the whole receive pool
+      if (!s_open)
+      {
+        s_open = true;
+        uint16_t pool = __builtin_popcount(s_free_mask);
+        if (!channel_grant(pool))
+        {
+          taskENTER_CRITICAL(&s_channel_lock);
+          s_returned += pool;
+          taskEXIT_CRITICAL(&s_channel_lock);
+        }
+        ESP_LOGI(CHANNEL_TAG, "Channel open, %d credits each way", credits);
+      }
+      return BLE_CHAR_OK;
+    }
+
+    case CHANNEL_FIRST:
+      if (len < CHANNEL_FIRST_HEADER)
+        return BLE_CHAR_ERR_SIZE;
+      channel_receive(&data[CHANNEL_FIRST_HEADER], len - CHANNEL_FIRST_HEADER, get_u16(&data[1]));
+      return BLE_CHAR_OK;
+
+    case CHANNEL_CONT:
+      channel_receive(&data[CHANNEL_CONT_HEADER], len - CHANNEL_CONT_HEADER, 0);
+      return BLE_CHAR_OK;
+
+    default:
+      return BLE_CHAR_ERR_VALUE;
+  }
+}
+
+esp_err_t ble_channel_init(const ble_channel_config_t *config, ble_characteristic_t *out, size_t index)
+{
+  s_index = index;
+  s_open = false;
+  s_returned = 0;
+  s_free_mask = (CHANNEL_POOL >= 32) ? UINT32_MAX : (1u << CHANNEL_POOL) - 1;
+
+  s_pool = (uint8_t *)malloc(CHANNEL_POOL * CHANNEL_MPS);
+  s_rx = xQueueCreate(CHANNEL_POOL, sizeof(uint8_t));
+  s_tx_credits = xSemaphoreCreateCounting(CHANNEL_MAX_CREDIT, 0);
+  s_tx_lock = xSemaphoreCreateMutex();
+  if (s_pool == NULL || s_rx == NULL || s_tx_credits == NULL || s_tx_lock == NULL)
+  {
+    ESP_LOGE(CHANNEL_TAG, "Failed to allocate the channel");
+    ble_channel_deinit();
+    return ESP_ERR_NO_MEM;
+  }
+
+  *out = (ble_characteristic_t){
+    .uuid = config->uuid,
+    .name = "Data channel",
+    .description = "Data channel",
+    .size = UINT8_MAX,
+    .write = channel_write,
+    .flags = BLE_CHAR_FLAG_NOTIFY_DIRECT | BLE_CHAR_FLAG_WRITE_NO_RSP,
+  };
+  return ESP_OK;
+}
+
+void ble_channel_deinit(void)
+{
+  free(s_pool);
+  s_pool = NULL;
+
+  if (s_rx != NULL)
+  {
+    vQueueDelete(s_rx);
+    s_rx = NULL;
+  }
+  if (s_tx_credits != NULL)
+  {
+    vSemaphoreDelete(s_tx_credits);
+    s_tx_credits = NULL;
+  }
+  if (s_tx_lock != NULL)
+  {
+    vSemaphoreDelete(s_tx_lock);
+    s_tx_lock = NULL;
+  }
+}
+
+void ble_channel_reset(void)
+{
+  if (s_pool == NULL)
+    return;
+
+  s_open = false;
+  xQueueReset(s_rx);
+  while (xSemaphoreTake(s_tx_credits, 0) == pdTRUE)
+    ;
+
+  taskENTER_CRITICAL(&s_channel_lock);
+  s_free_mask = (CHANNEL_POOL >= 32) ? UINT32_MAX : (1u << CHANNEL_POOL) - 1;
+  s_returned = 0;
+  taskEXIT_CRITICAL(&s_channel_lock);
+}
+
+ble_return_code_t ble_channel_write(const void *data, size_t len, uint32_t timeout_ms)
+{
+  if (data == NULL || len == 0 || len > UINT16_MAX)
+    return BLE_INVALID_CONFIG;
+  if (s_pool == NULL)
+    return BLE_NOT_INITIALIZED;
+
+  TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(timeout_ms);
+  if (xSemaphoreTake(s_tx_lock, pdMS_TO_TICKS(timeout_ms)) != pdTRUE)
+    return BLE_TIMEOUT;
+
+  const uint8_t *bytes = data;
+  uint8_t pdu[CHANNEL_FIRST_HEADER + CHANNEL_MPS];
+  size_t sent = 0;
+  ble_return_code_t ret = BLE_SUCCESS;
+
+  while (sent < len)
+  {
+    TickType_t now = xTaskGetTickCount();
+    TickType_t wait = (deadline > now) ? deadline - now : 0;
+
+    if (uxSemaphoreGetCount(s_tx_credits) == 0)
+    {
+      taskENTER_CRITICAL(&s_channel_lock);
+      s_stats.credit_waits++;
+      taskEXIT_CRITICAL(&s_channel_lock);
+    }
+    if (xSemaphoreTake(s_tx_credits, wait) != pdTRUE)
+    {
+      // The client drops an unfinished SDU when the next one starts
+      ret = BLE_TIMEOUT;
+      break;
+    }
+
+    size_t header = (sent == 0) ? CHANNEL_FIRST_HEADER : CHANNEL_CONT_HEADER;
+    size_t mps = ble_gatts_get_mtu() - BLE_ATT_NOTIFY_HEADER - header;
+    if (s_tx_mps > 0 && mps > s_tx_mps)
+      mps = s_tx_mps;
+    if (mps > CHANNEL_MPS)
+      mps = CHANNEL_MPS;
+
+    size_t chunk = (len - sent < mps) ? len - sent : mps;
+    pdu[0] = (sent == 0) ? CHANNEL_FIRST : CHANNEL_CONT;
+    if (sent == 0)
+      put_u16(&pdu[1], (uint16_t)len);
+    memcpy(&pdu[header], &bytes[sent], chunk);
+
+    // Congested: wait for the controller to drain, the credit stays taken for this segment
+    while (ble_gatts_notify(s_index, pdu, header + chunk) != ESP_OK)
+    {
+      if (!ble_gatts_is_connected() || xTaskGetTickCount() >= deadline)
+      {
+        ret = ble_gatts_is_connected() ? BLE_TIMEOUT : BLE_NOT_INITIALIZED;
+        break;
+      }
+      vTaskDelay(1);
+    }
+    if (ret != BLE_SUCCESS)
+      break;
+
+    sent += chunk;
+    taskENTER_CRITICAL(&s_channel_lock);
+    s_stats.segments_sent++;
+    taskEXIT_CRITICAL(&s_channel_lock);
+  }
+
+  if (ret == BLE_SUCCESS)
+  {
+    taskENTER_CRITICAL(&s_channel_lock);
+    s_stats.sdus_sent++;
+    taskEXIT_CRITICAL(&s_channel_lock);
+  }
+
+  xSemaphoreGive(s_tx_lock);
+  return ret;
+}
+
+ble_return_code_t ble_channel_read(void *out, size_t max_len, size_t *out_len, uint32_t timeout_ms)
+{
+  if (out == NULL || out_len == NULL)
+    return BLE_INVALID_CONFIG;
+  if (s_pool == NULL)
+    return BLE_NOT_INITIALIZED;
+
+  TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(timeout_ms);
+  uint8_t *bytes = out;
+  size_t sdu_len = 0, received = 0;
+  uint8_t block;
+
+  for (;;)
+  {
+    TickType_t now = xTaskGetTickCount();
+    if (xQueueReceive(s_rx, &block, (deadline > now) ? deadline - now : 0) != pdTRUE)
+      return BLE_TIMEOUT;
+
+    const ble_channel_block_t *seg = &s_blocks[block];
+    const uint8_t *payload = &s_pool[block * CHANNEL_MPS];
+
+    if (seg->sdu_len != 0)
+    {
+      // A new SDU: anything collected so far belonged to one the client abandoned
+      sdu_len = seg->sdu_len;
+      received = 0;
+    }
+
+    if (sdu_len != 0)
+    {
+      if (received < max_len)
+        memcpy(&bytes[received], payload, (seg->len < max_len - received) ? seg->len : max_len - received);
+      received += seg->len;
+    }
+
+    channel_free_block(block);
+    channel_return_credits();
+
+    if (sdu_len != 0 && received >= sdu_len)
+      break;
+  }
+
+  // The caller only sees what was copied; the rest of a long message is gone
+  *out_len = (sdu_len < max_len) ? sdu_len : max_len;
+
+  taskENTER_CRITICAL(&s_channel_lock);
+  s_stats.sdus_received++;
+  taskEXIT_CRITICAL(&s_channel_lock);
+
+  if (sdu_len > max_len)
+  {
+    ESP_LOGW(CHANNEL_TAG, "Message of %d bytes truncated to %d", sdu_len, max_len);
+    return BLE_TRUNCATED;
+  }
+  return BLE_SUCCESS;
+}
+
+void ble_channel_get_stats(ble_channel_stats_t *out)
+{
+  taskENTER_CRITICAL(&s_channel_lock);
+  *out = s_stats;
+  taskEXIT_CRITICAL(&s_channel_lock);
+}
@@ -0,0 +1,166 @@
+/**
+ * @file ble-char.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Characteristic value access - handlers or bound memory with a sequence lock
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * Bound memory is guarded by a sequence lock: writers make the sequence odd, update
+ * the memory and make it even again; readers copy the memory and retry if the
+ * sequence was odd or moved meanwhile. Readers never block writers. Writers (the
+ * application and client writes from the Bluetooth task) exclude each other by
+ * claiming the odd sequence with a compare-and-swap.
+ */
+
+#include "ble-char.h"
+
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <sched.h>  // Host builds of the benchmarks
+#endif
+
+#define SEQ_SPIN_LIMIT 64  // Retries before yielding so a preempted writer can finish
+
+/**
+ * @brief Back off after repeated retries
+ *
+ * A spinning task could starve a lower priority writer on the same core.
+ */
+static void seq_backoff(uint32_t *spins)
+{
+  if (++(*spins) < SEQ_SPIN_LIMIT)
+    return;
+
+  *spins = 0;
+#ifdef ESP_PLATFORM
+  vTaskDelay(1);
+#else
+  sched_yield();
+#endif
+}
+
+void ble_binding_write_begin(ble_char_binding_t *binding)
+{
+  uint32_t spins = 0;
+
+  for (;;)
+  {
+    uint32_t seq = __atomic_load_n(&binding->seq, __ATOMIC_RELAXED);
+    if (!(seq & 1) &&
+        __atomic_compare_exchange_n(&binding->seq, &seq, seq + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+      break;
+    seq_backoff(&spins);
+  }
+
+  // The odd sequence must be visible before any data store
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void ble_binding_write_end(ble_char_binding_t *binding)
+{
+  __atomic_fetch_add(&binding->seq, 1, __ATOMIC_RELEASE);
+}
+
+void ble_binding_write(ble_char_binding_t *binding, const void *data, size_t len)
+{
+  if (len > binding->len)
+    len = binding->len;
+
+  ble_binding_write_begin(binding);
+  memcpy(binding->data, data, len);
+  ble_binding_write_end(binding);
+}
+
+size_t ble_binding_read(const ble_char_binding_t *binding, void *out, size_t max_len)
+{
+  size_t len = (binding->len < max_len) ? binding->len : max_len;
+  uint32_t spins = 0;
+
+  for (;;)
+  {
+    uint32_t before = __atomic_load_n(&binding->seq, __ATOMIC_ACQUIRE);
+    if (!(before & 1))
+    {
+      memcpy(out, binding->data, len);
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&binding->seq, __ATOMIC_RELAXED) == before)
+        return len;
+    }
+    seq_backoff(&spins);
+  }
+}
+
+bool ble_char_is_readable(const ble_characteristic_t *ch)
+{
+  return ch->binding != NULL || ch->read != NULL;
+}
+
+bool ble_char_is_writable(const ble_characteristic_t *ch)
+{
+  if (ch->binding != NULL)
+    return ch->binding->writable;
+
+  return ch->write != NULL;
+}
+
+bool ble_char_is_notifiable(const ble_characteristic_t *ch)
+{
+  return ch->notify != NULL || (ch->flags & BLE_CHAR_FLAG_NOTIFY_DIRECT);
+}
+
+int ble_char_read_value(const ble_characteristic_t *ch, uint8_t *out, size_t max_len)
+{
+  if (ch->binding != NULL)
+    return (int)ble_binding_read(ch->binding, out, max_len);
+
+  if (ch->read == NULL)
+    return -1;
+
+  return ch->read(out, max_len);
+}
+
+ble_char_error_t ble_char_validate_value(const ble_characteristic_t *ch, const uint8_t *data, size_t len)
+{
+  ble_char_binding_t *binding = ch->binding;
+  if (binding == NULL)
+  {
+    if (ch->write == NULL)
+      return BLE_CHAR_ERR_READONLY;
+    if (len > ch->size)
+      return BLE_CHAR_ERR_SIZE;
+
+    // Handlers validate when called; only a coalescing policy can check ahead of time
+    if (ch->coalesce != NULL && ch->coalesce->validate != NULL)
+      return ch->coalesce->validate(data, len);
+    return BLE_CHAR_OK;
+  }
+
+  if (!binding->writable)
+    return BLE_CHAR_ERR_READONLY;
+
+  // Registers are written whole so readers never see half of an old value
+  if (len != binding->len)
+    return BLE_CHAR_ERR_SIZE;
+
+  return (binding->validate != NULL) ? binding->validate(data, len) : BLE_CHAR_OK;
+}
+
+ble_char_error_t ble_char_write_value(const ble_characteristic_t *ch, const uint8_t *data, size_t len)
+{
+  ble_char_binding_t *binding = ch->binding;
+  if (binding == NULL)
+    return (ch->write != NULL) ? ch->write(data, len) : BLE_CHAR_ERR_READONLY;
+
+  ble_char_error_t result = ble_char_validate_value(ch, data, len);
+  if (result != BLE_CHAR_OK)
+    return result;
+
+  ble_binding_write(binding, data, len);
+  return BLE_CHAR_OK;
+}
@@ -0,0 +1,188 @@
+/**
+ * @file ble-coalesce.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Last-writer-wins write coalescing for high-rate control characteristics
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * A client write is validated and acknowledged right away, but only stored as
+ * the pending value. A one-shot timer per characteristic applies the newest
+ * pending value, at most once per apply interval, so a burst of writes costs
+ * one handler call per interval no matter how fast the client writes. The first
+ * write after a quiet period is applied without delay.
+ */
+
+#include "ble-coalesce.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ble-char.h"
+
+#define COALESCE_TAG "BLE_COALESCE"
+
+// Pending state of one coalescing characteristic
+typedef struct
+{
+  uint8_t *value;            // Newest accepted value (NULL = characteristic does not coalesce)
+  uint8_t len;
+  bool pending;              // value has not been applied yet
+  int64_t last_apply_us;     // Time of the last apply
+  esp_timer_handle_t timer;  // Fires when the pending value may be applied
+  ble_write_stats_t stats;
+} ble_coalesce_slot_t;
+
+static const ble_characteristic_t *s_chars = NULL;
+static size_t s_count = 0;
+static ble_coalesce_slot_t s_slots[BLE_MAX_CHARACTERISTICS];
+static portMUX_TYPE s_coalesce_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Apply the pending value of a characteristic. Runs in the esp_timer task.
+ */
+static void coalesce_apply(void *arg)
+{
+  size_t index = (size_t)arg;
+  ble_coalesce_slot_t *slot = &s_slots[index];
+  const ble_characteristic_t *ch = &s_chars[index];
+  uint8_t value[UINT8_MAX];
+  uint8_t len;
+
+  taskENTER_CRITICAL(&s_coalesce_lock);
+  if (!slot->pending)
+  {
+    taskEXIT_CRITICAL(&s_coalesce_lock);
+    return;
+  }
+  len = slot->len;
+  memcpy(value, slot->value, len);
+  slot->pending = false;
+  // Taken before the handler runs so a write arriving meanwhile waits a full interval
+  slot->last_apply_us = esp_timer_get_time();
+  taskEXIT_CRITICAL(&s_coalesce_lock);
+
+  ble_char_error_t result = ble_char_write_value(ch, value, len);
+
+  taskENTER_CRITICAL(&s_coalesce_lock);
+  if (result == BLE_CHAR_OK)
+    slot->stats.applied++;
+  else
+    slot->stats.rejected++;
+  taskEXIT_CRITICAL(&s_coalesce_lock);
+
+  if (result != BLE_CHAR_OK)
+    ESP_LOGW(COALESCE_TAG, "Coalesced write to '%s' rejected by its handler (%d)", ch->name, result);
+}
+
+esp_err_t ble_coalesce_init(const ble_characteristic_t *chars, size_t count)
+{
+  s_chars = chars;
+  s_count = (count > BLE_MAX_CHARACTERISTICS) ? BLE_MAX_CHARACTERISTICS : count;
+  memset(s_slots, 0, sizeof(s_slots));
+
+  for (size_t i = 0; i < s_count; i++)
+  {
+    const ble_characteristic_t *ch = &chars[i];
+    if (ch->coalesce == NULL || ch->size == 0 || !ble_char_is_writable(ch))
+      continue;
+
+    s_slots[i].value = (uint8_t *)calloc(ch->size, sizeof(uint8_t));
+    if (s_slots[i].value == NULL)
+    {
+      ESP_LOGE(COALESCE_TAG, "Failed to allocate pending value for '%s'", ch->name);
+      ble_coalesce_deinit();
+      return ESP_ERR_NO_MEM;
+    }
+
+    const esp_timer_create_args_t timer_args = {
+      .callback = coalesce_apply,
+      .arg = (void *)i,
+      .name = "ble_coalesce",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &s_slots[i].timer);
+    if (ret != ESP_OK)
+    {
+      ESP_LOGE(COALESCE_TAG, "Apply timer creation failed: %s", esp_err_to_name(ret));
+      ble_coalesce_deinit();
+      return ret;
+    }
+  }
+
+  return ESP_OK;
+}
+
+void ble_coalesce_deinit(void)
+{
+  for (size_t i = 0; i < BLE_MAX_CHARACTERISTICS; i++)
+  {
+    ble_coalesce_slot_t *slot = &s_slots[i];
+    if (slot->timer != NULL)
+    {
+      esp_timer_stop(slot->timer);
+      esp_timer_delete(slot->timer);
+      slot->timer = NULL;
+    }
+
+    // The application still gets the last value a client wrote
+    if (slot->value != NULL)
+      coalesce_apply((void *)i);
+
+    free(slot->value);
+    slot->value = NULL;
+  }
+
+  s_chars = NULL;
+  s_count = 0;
+}
+
+ble_char_error_t ble_coalesce_write(size_t index, const uint8_t *data, size_t len)
+{
+  if (index >= s_count || s_slots[index].value == NULL)
+    return BLE_CHAR_ERR_READONLY;
+
+  const ble_characteristic_t *ch = &s_chars[index];
+  ble_coalesce_slot_t *slot = &s_slots[index];
+
+  if (len > ch->size)
+    return BLE_CHAR_ERR_SIZE;
+
+  ble_char_error_t result = ble_char_validate_value(ch, data, len);
+  if (result != BLE_CHAR_OK)
+    return result;
+
+  int64_t delay_us;
+
+  taskENTER_CRITICAL(&s_coalesce_lock);
+  memcpy(slot->value, data, len);
+  slot->len = len;
+  slot->pending = true;
+  slot->stats.received++;
+  delay_us = slot->last_apply_us + (int64_t)ch->coalesce->apply_interval_ms * 1000 - esp_timer_get_time();
+  taskEXIT_CRITICAL(&s_coalesce_lock);
+
+  // An armed timer picks up the newer value when it fires
+  if (!esp_timer_is_active(slot->timer))
+    esp_timer_start_once(slot->timer, (delay_us > 0) ? (uint64_t)delay_us : 0);
+
+  return BLE_CHAR_OK;
+}
+
+esp_err_t ble_coalesce_get_stats(uint16_t uuid, ble_write_stats_t *out)
+{
+  for (size_t i = 0; i < s_count; i++)
+  {
+    if (s_chars[i].uuid != uuid || s_slots[i].value == NULL)
+      continue;
+
+    taskENTER_CRITICAL(&s_coalesce_lock);
+    *out = s_slots[i].stats;
+    taskEXIT_CRITICAL(&s_coalesce_lock);
+    return ESP_OK;
+  }
+  return ESP_ERR_NOT_FOUND;
+}
@@ -0,0 +1,273 @@
+/**
+ * @file ble-compress.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Payload compression - value framing and capability negotiation
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * A capability characteristic tells the client which codecs the server has;
+ * values are only compressed after the client wrote back the ones it accepts,
+ * and only for the current connection.
+ *
+ *   Read:   codecs u8 (bit 0 = LZ), dictionary id u8 (0 = none), window u16
+ *   Write:  codecs u8, dictionary id u8 (required when the server has a dictionary)
+ *
+ * Values start with a format byte: the raw value or an LZ stream (see ble-lz.c).
+ * Flagged characteristics leave room for the format byte in one notification,
+ * and the client may only enable compression once the MTU exchange gave it, so
+ * a value is never cut to make room for the frame.
+ *
+ * The encoder keeps one window of history plus the input being encoded and a
+ * single-probe hash table, about 3 KB per context, and encodes input as it is
+ * committed, so a source is read straight into the window in pieces.
+ */
+
+#include "ble-compress.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ble-char.h"
+#include "ble-gatts.h"
+#include "ble-lz.h"
+
+#define COMPRESS_TAG        "BLE_COMPRESS"
+#define COMPRESS_CAPS_SIZE  4
+#define COMPRESS_CODEC_LZ   0x01
+
+typedef struct
+{
+  ble_lz_t lz;
+  int64_t start_us;
+} compress_ctx_t;
+
+static compress_ctx_t *s_ctx = NULL;  // BLE_COMPRESS_CTX_COUNT contexts
+static const uint8_t *s_dict = NULL;  // Last BLE_LZ_WINDOW bytes of the configured dictionary
+static size_t s_dict_len = 0;
+static uint8_t s_dict_id = 0;
+static size_t s_max_value = 0;  // Largest characteristic with BLE_CHAR_FLAG_COMPRESS
+static uint16_t s_dict_head[BLE_LZ_HASH_SIZE];  // Hash table primed with the dictionary
+static volatile bool s_enabled = false;
+static portMUX_TYPE s_compress_lock = portMUX_INITIALIZER_UNLOCKED;
+static ble_compress_stats_t s_stats = {0};
+
+static void compress_account(size_t in, size_t out, int64_t start_us, bool packed)
+{
+  uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - start_us);
+
+  taskENTER_CRITICAL(&s_compress_lock);
+  if (packed)
+    s_stats.values_compressed++;
+  else
+    s_stats.values_raw++;
+  s_stats.bytes_in += in;
+  s_stats.bytes_out += out;
+  s_stats.encode_us += elapsed_us;
+  taskEXIT_CRITICAL(&s_compress_lock);
+}
+
+/**
+ * @brief End a value encoded into out + 1 from window[start]; fall back to the raw bytes unless it shrank
+ * @return Bytes written to out, 0 if the raw value does not fit behind the format byte
+ */
+static size_t compress_pack(compress_ctx_t *c, size_t start, size_t len, uint8_t *out, size_t max)
+{
+  ble_lz_t *lz = &c->lz;
+
+  ble_lz_finish(lz);
+
+  bool packed = !lz->full && lz->encoded == len && lz->len < len;
+  if (packed)
+  {
+    out[0] = BLE_COMPRESS_FORMAT_LZ;
+  }
+  else
+  {
+    if (len > max - 1)
+      return 0;
+    lz->len = len;
+    out[0] = BLE_COMPRESS_FORMAT_RAW;
+    memcpy(&out[1], &lz->window[start], len);
+  }
+
+  compress_account(len, lz->len, c->start_us, packed);
+  return 1 + lz->len;
+}
+
+static int compress_caps_read(uint8_t *out_buffer, size_t max_len)
+{
+  if (max_len < COMPRESS_CAPS_SIZE)
+    return -1;
+
+  out_buffer[0] = COMPRESS_CODEC_LZ;
+  out_buffer[1] = s_dict_id;
+  out_buffer[2] = (uint8_t)(BLE_LZ_WINDOW & 0xFF);
+  out_buffer[3] = (uint8_t)(BLE_LZ_WINDOW >> 8);
+  return COMPRESS_CAPS_SIZE;
+}
+
+static ble_char_error_t compress_caps_write(const uint8_t *data, size_t len)
+{
+  if (len < 1)
+    return BLE_CHAR_ERR_SIZE;
+
+  bool enable = (data[0] & COMPRESS_CODEC_LZ) != 0;
+  // Every flagged value must fit one notification behind its format byte
+  if (enable && (size_t)(ble_gatts_get_mtu() - BLE_ATT_NOTIFY_HEADER) < s_max_value + 1)
+  {
+    ESP_LOGW(COMPRESS_TAG, "MTU %d too small to compress %d byte values", ble_gatts_get_mtu(), s_max_value);
+    return BLE_CHAR_ERR_SIZE;
+  }
+  // Streams are encoded against the dictionary, so a client without the same one could not decode them
+  if (enable && s_dict_len > 0 && (len < 2 || data[1] != s_dict_id))
+    return BLE_CHAR_ERR_VALUE;
+
+  s_enabled = enable;
+  ESP_LOGI(COMPRESS_TAG, "Compression %s by the client", enable ? "enabled" : "disabled");
+  return BLE_CHAR_OK;
+}
+
+esp_err_t ble_compress_init(const ble_compress_config_t *config, const ble_characteristic_t *chars, size_t count,
+                            ble_characteristic_t *out)
+{
+  if (config->dictionary_len > 0 && (config->dictionary == NULL || config->dictionary_id == 0))
+  {
+    ESP_LOGE(COMPRESS_TAG, "A dictionary needs its data and a non-zero id");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  // Values are at most 255 bytes, so the local MTU always has room for the format byte; the client's may not
+  s_max_value = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    if ((chars[i].flags & BLE_CHAR_FLAG_COMPRESS) && chars[i].size > s_max_value)
+      s_max_value = chars[i].size;
+  }
+
+  s_ctx = (compress_ctx_t *)calloc(BLE_COMPRESS_CTX_COUNT, sizeof(compress_ctx_t));
+  if (s_ctx == NULL)
+  {
+    ESP_LOGE(COMPRESS_TAG, "Failed to allocate the encoders");
+    return ESP_ERR_NO_MEM;
+  }
+
+  // Only the last window of the dictionary is reachable
+  s_dict_len = (config->dictionary_len > BLE_LZ_WINDOW) ? BLE_LZ_WINDOW : config->dictionary_len;
+  s_dict = (s_dict_len > 0) ? config->dictionary + config->dictionary_len - s_dict_len : NULL;
+  s_dict_id = (s_dict_len > 0) ? config->dictionary_id : 0;
+  s_enabled = false;
+  memset(&s_stats, 0, sizeof(s_stats));
+
+  ble_lz_prime(s_dict_head, s_dict, s_dict_len);
+
+  *out = (ble_characteristic_t){
+    .uuid = config->uuid,
+    .name = "Compression",
+    .description = "Compression",
+    .size = COMPRESS_CAPS_SIZE,
+    .read = compress_caps_read,
+    .write = compress_caps_write,
+  };
+
+  ESP_LOGI(COMPRESS_TAG, "LZ compression available, %d byte dictionary", s_dict_len);
+  return ESP_OK;
+}
+
+void ble_compress_deinit(void)
+{
+  s_enabled = false;
+  free(s_ctx);
+  s_ctx = NULL;
+}
+
+void ble_compress_reset(void)
+{
+  s_enabled = false;
+}
+
+bool ble_compress_is_enabled(void)
+{
+  return s_ctx != NULL && s_enabled;
+}
+
+void ble_compress_begin(ble_compress_ctx_t ctx, uint8_t *out, size_t cap)
+{
+  compress_ctx_t *c = &s_ctx[ctx];
+
+  ble_lz_begin(&c->lz, s_dict, s_dict_len, s_dict_head, out, cap);
+  c->start_us = esp_timer_get_time();
+}
+
+uint8_t *ble_compress_input(ble_compress_ctx_t ctx, size_t *room)
+{
+  return ble_lz_input(&s_ctx[ctx].lz, room);
+}
+
+void ble_compress_commit(ble_compress_ctx_t ctx, size_t len)
+{
+  ble_lz_commit(&s_ctx[ctx].lz, len);
+}
+
+size_t ble_compress_finish(ble_compress_ctx_t ctx, size_t *consumed)
+{
+  compress_ctx_t *c = &s_ctx[ctx];
+
+  size_t len = ble_lz_finish(&c->lz);
+  *consumed = c->lz.encoded;
+  compress_account(c->lz.encoded, len, c->start_us, true);
+  return len;
+}
+
+size_t ble_compress_value(ble_compress_ctx_t ctx, const uint8_t *in, size_t len, uint8_t *out, size_t max)
+{
+  if (max < 2)
+    return 0;
+
+  // Anything not shorter than the value is sent raw, so the stream may use one byte less
+  size_t cap = (len < max) ? len : max;
+  ble_compress_begin(ctx, &out[1], (cap > 0) ? cap - 1 : 0);
+
+  size_t start = s_ctx[ctx].lz.end;
+  size_t room;
+  uint8_t *window = ble_compress_input(ctx, &room);
+  if (len > room)
+    len = room;  // Values are at most one attribute long, far below one window
+  memcpy(window, in, len);
+  ble_compress_commit(ctx, len);
+
+  return compress_pack(&s_ctx[ctx], start, len, out, max);
+}
+
+int ble_compress_read(ble_compress_ctx_t ctx, const ble_characteristic_t *ch, uint8_t *out, size_t max)
+{
+  if (max < 2)
+    return -1;
+
+  ble_compress_begin(ctx, &out[1], max - 1);
+
+  size_t start = s_ctx[ctx].lz.end;
+  size_t room;
+  uint8_t *window = ble_compress_input(ctx, &room);
+  int len = ble_char_read_value(ch, window, room);
+  if (len < 0)
+    return len;
+
+  if ((size_t)len < max)
+    s_ctx[ctx].lz.cap = (len > 0) ? len - 1 : 0;
+  ble_compress_commit(ctx, len);
+
+  size_t out_len = compress_pack(&s_ctx[ctx], start, len, out, max);
+  return (out_len > 0) ? (int)out_len : -1;
+}
+
+void ble_compress_get_stats(ble_compress_stats_t *out)
+{
+  taskENTER_CRITICAL(&s_compress_lock);
+  *out = s_stats;
+  taskEXIT_CRITICAL(&s_compress_lock);
+}
@@ -0,0 +1,135 @@
+/**
+ * @file ble-frame.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Telemetry frame - a configured set of characteristics packed into one value
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * Frame layout (little endian):
+ *
+ *   0  uint8_t  version (BLE_FRAME_VERSION)
+ *   1  uint8_t  number of fields present
+ *   2  uint16_t sequence number, incremented on every frame
+ *   4  uint32_t timestamp in milliseconds since boot
+ *   8  fields, each at a fixed offset and padded to its characteristic size
+ *
+ * Fields that do not fit in the connection MTU are left out from the end, so a
+ * field's offset never changes. The frame is a regular characteristic served by
+ * a read handler; notifications go through the change-driven notification policy.
+ */
+
+#include "ble-frame.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <string.h>
+
+#include "ble-char.h"
+#include "ble-gatts.h"
+
+#define FRAME_TAG         "BLE_FRAME"
+#define FRAME_HEADER_SIZE 8
+
+static const ble_characteristic_t *s_fields[BLE_MAX_CHARACTERISTICS];
+static size_t s_field_count = 0;
+static volatile uint32_t s_sequence = 0;
+static ble_notify_policy_t s_policy;
+
+static int frame_read(uint8_t *out_buffer, size_t max_len)
+{
+  // Keep the frame within one notification so reads and notifications carry the same fields
+  size_t limit = ble_gatts_get_mtu() - BLE_ATT_NOTIFY_HEADER;
+  if (limit > max_len)
+    limit = max_len;
+  if (limit < FRAME_HEADER_SIZE)
+    return -1;
+
+  uint16_t seq = (uint16_t)__atomic_fetch_add(&s_sequence, 1, __ATOMIC_RELAXED);
+  uint32_t timestamp_ms = (uint32_t)(esp_timer_get_time() / 1000);
+
+  size_t offset = FRAME_HEADER_SIZE;
+  uint8_t present = 0;
+  for (size_t i = 0; i < s_field_count; i++)
+  {
+    const ble_characteristic_t *ch = s_fields[i];
+    if (offset + ch->size > limit)
+      break;
+
+    memset(&out_buffer[offset], 0, ch->size);
+    if (ble_char_read_value(ch, &out_buffer[offset], ch->size) < 0)
+      ESP_LOGD(FRAME_TAG, "Field '%s' unreadable, left zeroed", ch->name);
+
+    offset += ch->size;
+    present++;
+  }
+
+  out_buffer[0] = BLE_FRAME_VERSION;
+  out_buffer[1] = present;
+  out_buffer[2] = (uint8_t)(seq & 0xFF);
+  out_buffer[3] = (uint8_t)(seq >> 8);
+  out_buffer[4] = (uint8_t)(timestamp_ms & 0xFF);
+  out_buffer[5] = (uint8_t)((timestamp_ms >> 8) & 0xFF);
+  out_buffer[6] = (uint8_t)((timestamp_ms >> 16) & 0xFF);
+  out_buffer[7] = (uint8_t)(timestamp_ms >> 24);
+
+  return offset;
+}
+
+esp_err_t ble_frame_init(const ble_frame_config_t *config, const ble_characteristic_t *chars, size_t count,
+                         ble_characteristic_t *out)
+{
+  if (config->field_uuids == NULL || config->field_count == 0 || config->field_count > BLE_MAX_CHARACTERISTICS)
+  {
+    ESP_LOGE(FRAME_TAG, "Invalid frame fields");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  size_t frame_size = FRAME_HEADER_SIZE;
+  for (size_t i = 0; i < config->field_count; i++)
+  {
+    const ble_characteristic_t *found = NULL;
+    for (size_t c = 0; c < count && found == NULL; c++)
+    {
+      if (chars[c].uuid == config->field_uuids[i])
+        found = &chars[c];
+    }
+
+    if (found == NULL || !ble_char_is_readable(found))
+    {
+      ESP_LOGE(FRAME_TAG, "Frame field 0x%04X is not a readable characteristic", config->field_uuids[i]);
+      return ESP_ERR_INVALID_ARG;
+    }
+
+    s_fields[i] = found;
+    frame_size += found->size;
+  }
+
+  if (frame_size > BLE_FRAME_MAX_SIZE)
+  {
+    ESP_LOGE(FRAME_TAG, "Frame of %d bytes exceeds %d bytes", frame_size, BLE_FRAME_MAX_SIZE);
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  s_field_count = config->field_count;
+  s_sequence = 0;
+
+  // Every frame differs (sequence, timestamp), so the policy reduces to a fixed period
+  s_policy = (ble_notify_policy_t){
+    .type = BLE_VALUE_RAW,
+    .min_interval_ms = config->period_ms,
+  };
+
+  *out = (ble_characteristic_t){
+    .uuid = config->uuid,
+    .name = "Telemetry frame",
+    .description = config->description,
+    .size = frame_size,
+    .read = frame_read,
+    .notify = &s_policy,
+  };
+
+  ESP_LOGI(FRAME_TAG, "Telemetry frame with %d fields, %d bytes", s_field_count, frame_size);
+  return ESP_OK;
+}
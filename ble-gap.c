@@ -13,30 +13,456 @@
 
 #include <esp_gap_ble_api.h>  // Implements GATT Server configuration such as creating services and characteristics.
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "ble-boot.h"
+#include "ble-central.h"
+#include "ble-gatts.h"
+#include "ble-observe.h"
+#include "ble-sec.h"
+#include "ble-store.h"
+
 #define RAW_ADV_DATA_SERVICE_UUID      0xED58  // Example service UUID
 #define RAW_ADV_DATA_SIZE              31
 #define RAW_SCAN_RSP_DATA_SERVICE_UUID 0xAFBD  // Example scan response service UUID
 #define RAW_SCAN_RSP_DATA_SIZE         31
 #define ADV_CONFIG_FLAG                (1 << 0)
 #define SCAN_RSP_CONFIG_FLAG           (1 << 1)
+#define DIRECTED_ADV_TIMEOUT_MS        1000  // Under the controller's 1.28 s limit, whose timeout sends no stop event
+#define RECONNECT_PEER_KEY             "gap_peer"
+#define SCAN_DEFAULT_INTERVAL          0x50  // 50 ms (0.625 ms units)
+#define SCAN_DEFAULT_WINDOW            0x30  // 30 ms, leaves air time for advertising and the links
+#define SCAN_STOP_TIMEOUT_MS           1000
+#define OBSERVER_DEFAULT_DEDUP_MS      1000
+#define OBSERVER_DEFAULT_QUEUE         32
 
 static const char *TAG_GAP = "BLE_GAP";
 
 static uint8_t adv_config_done = 0;
 
 static uint8_t *s_raw_adv_data = NULL;
+static uint16_t s_raw_adv_len = 0;
 static esp_ble_adv_params_t *s_adv_params = NULL;
 static uint8_t *s_raw_scan_rsp_data = NULL;
+static uint16_t s_raw_scan_rsp_len = 0;
+
+//* Advertising state machine
+// Requests only update s_adv_requested; adv_reconcile() issues at most one start/stop
+// at a time and the completion events drive the next step, so requests coalesce.
+static portMUX_TYPE s_adv_lock = portMUX_INITIALIZER_UNLOCKED;
+static ble_adv_state_t s_adv_state = BLE_ADV_STATE_IDLE;
+static bool s_adv_requested = false;   // Desired state: advertising wanted
+static bool s_adv_op_pending = false;  // Start/stop issued, waiting for the completion event
+static int64_t s_state_entered_us[BLE_ADV_STATE_COUNT] = {0};
+static int64_t s_disconnect_us = 0;  // Disconnect timestamp of a pending restart (0 = none)
+static uint32_t s_restart_count = 0;
+static int64_t s_last_restart_latency_us = 0;
+static int64_t s_max_restart_latency_us = 0;
+static int64_t s_resume_us = 0;  // Resume timestamp until advertising is live (0 = none)
+static uint32_t s_resume_count = 0;
+static int64_t s_last_resume_latency_us = 0;
+static int64_t s_max_resume_latency_us = 0;
+
+//* Fast reconnection
+// Last client address as persisted in storage
+typedef struct
+{
+  uint8_t bda[ESP_BD_ADDR_LEN];
+  uint8_t addr_type;  // esp_ble_addr_type_t
+} ble_gap_peer_t;
+
+static ble_reconnect_config_t s_reconnect = {0};
+static ble_gap_peer_t s_peer = {0};
+static bool s_peer_valid = false;
+static ble_adv_mode_t s_adv_mode = BLE_ADV_MODE_UNDIRECTED;         // Requested advertising mode
+static ble_adv_mode_t s_adv_active_mode = BLE_ADV_MODE_UNDIRECTED;  // Mode of the advertising in flight or live
+static esp_ble_adv_params_t s_active_params;                        // Parameters of the advertising in flight or live
+static esp_timer_handle_t s_phase_timer = NULL;                     // Ends the directed / allowlist phases
+static int64_t s_reconnect_from_us = 0;                             // Disconnect timestamp until the next connection
+static uint32_t s_reconnect_count[BLE_ADV_MODE_COUNT] = {0};
+static ble_adv_mode_t s_last_reconnect_mode = BLE_ADV_MODE_UNDIRECTED;
+static int64_t s_last_reconnect_latency_us = 0;
+
+//* Scanning, shared by the observer and the central role
+// Same pattern as advertising: requests only update the wanted state and scan_reconcile()
+// issues one parameter/start/stop command at a time, driven by the completion events.
+static portMUX_TYPE s_scan_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_ble_scan_params_t s_scan_params;
+static bool s_scan_params_set = false;
+static bool s_scan_running = false;     // Scan running, or its start issued
+static bool s_scan_op_pending = false;  // Command issued, waiting for the completion event
+static bool s_central_searching = false;
+static bool s_central_connecting = false;
+static bool s_scan_suspended = false;            // Server suspended, scanning waits for the resume
+static bool s_scan_stopping = false;             // Server stopping, nothing may scan again
+static SemaphoreHandle_t s_scan_stopped = NULL;  // Given once stopping left the controller idle
+
+//* Observer
+// Filters and dedup table are used by the Bluetooth task only; the queue is shared under s_observer_lock
+static const ble_observer_config_t *s_observer = NULL;
+static ble_observe_t s_observe = {0};
+static SemaphoreHandle_t s_observer_ready = NULL;  // Counts queued reports, and the wake-ups of deinit
+static portMUX_TYPE s_observer_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_observer_open = false;       // Receivers may use the queue
+static uint32_t s_observer_receivers = 0;  // Tasks inside ble_observer_receive()
+static ble_observer_stats_t s_observer_stats = {0};
+static int64_t s_rate_start_us = 0;  // Start of the second being counted (Bluetooth task only)
+static uint32_t s_rate_count = 0;
+
+/**
+ * @brief ble_server_init() -> first advertising start of the current boot (0 = not reached)
+ */
+static int64_t ble_gap_cold_start_latency(void)
+{
+  ble_boot_profile_t profile;
+  ble_boot_get_profile(&profile);
+
+  if (profile.stage_us[BLE_BOOT_STAGE_ADV_STARTED] == 0)
+    return 0;
+  return profile.stage_us[BLE_BOOT_STAGE_ADV_STARTED] - profile.stage_us[BLE_BOOT_STAGE_INIT_CALLED];
+}
+
+static const char *s_adv_mode_names[BLE_ADV_MODE_COUNT] = {
+  [BLE_ADV_MODE_UNDIRECTED] = "undirected",
+  [BLE_ADV_MODE_DIRECTED] = "directed",
+  [BLE_ADV_MODE_ALLOWLIST] = "allowlist",
+};
+
+static const char *s_adv_state_names[BLE_ADV_STATE_COUNT] = {
+  [BLE_ADV_STATE_IDLE] = "IDLE",
+  [BLE_ADV_STATE_CONFIGURING] = "CONFIGURING",
+  [BLE_ADV_STATE_ADVERTISING] = "ADVERTISING",
+  [BLE_ADV_STATE_CONNECTED] = "CONNECTED",
+  [BLE_ADV_STATE_RESTARTING] = "RESTARTING",
+};
+
+typedef enum
+{
+  ADV_ACTION_NONE = 0,
+  ADV_ACTION_START,
+  ADV_ACTION_STOP,
+} adv_action_t;
+
+/**
+ * @brief Enter a new advertising state. Must be called with s_adv_lock held.
+ */
+static void adv_set_state_locked(ble_adv_state_t state)
+{
+  s_adv_state = state;
+  s_state_entered_us[state] = esp_timer_get_time();
+}
+
+/**
+ * @brief Mode a new advertising cycle starts in. Must be called with s_adv_lock held.
+ */
+static ble_adv_mode_t adv_first_mode_locked(void)
+{
+  return (s_reconnect.enabled && s_peer_valid) ? BLE_ADV_MODE_DIRECTED : BLE_ADV_MODE_UNDIRECTED;
+}
+
+/**
+ * @brief Build the parameters for the requested mode. Must be called with s_adv_lock held.
+ */
+static void adv_build_params_locked(ble_adv_mode_t mode)
+{
+  s_active_params = *s_adv_params;
+
+  switch (mode)
+  {
+    case BLE_ADV_MODE_DIRECTED:
+    {
+      // High duty cycle: interval is fixed by the controller (<= 3.75 ms) for at most 1.28 s
+      s_active_params.adv_type = ADV_TYPE_DIRECT_IND_HIGH;
+      memcpy(s_active_params.peer_addr, s_peer.bda, ESP_BD_ADDR_LEN);
+      s_active_params.peer_addr_type = (esp_ble_addr_type_t)s_peer.addr_type;
+      break;
+    }
+    case BLE_ADV_MODE_ALLOWLIST:
+    {
+      // Anyone may scan (the name stays visible), only the allowlisted client may connect
+      s_active_params.adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_WLST;
+      break;
+    }
+    default:
+      break;
+  }
+
+  s_adv_active_mode = mode;
+}
+
+/**
+ * @brief Move the controller towards the requested advertising state
+ *
+ * Issues at most one start or stop; the matching completion event calls this again.
+ * A mode change while advertising is applied as a stop followed by a start.
+ */
+static void adv_reconcile(void)
+{
+  adv_action_t action = ADV_ACTION_NONE;
+
+  taskENTER_CRITICAL(&s_adv_lock);
+  if (!s_adv_op_pending && adv_config_done == 0)
+  {
+    if (s_adv_requested && (s_adv_state == BLE_ADV_STATE_IDLE || s_adv_state == BLE_ADV_STATE_CONFIGURING))
+    {
+      action = ADV_ACTION_START;
+      s_adv_op_pending = true;
+      adv_build_params_locked(s_adv_mode);
+      if (s_adv_state == BLE_ADV_STATE_IDLE)
+        adv_set_state_locked(BLE_ADV_STATE_RESTARTING);
+    }
+    else if (s_adv_state == BLE_ADV_STATE_ADVERTISING && (!s_adv_requested || s_adv_active_mode != s_adv_mode))
+    {
+      action = ADV_ACTION_STOP;
+      s_adv_op_pending = true;
+    }
+    else if (!s_adv_requested && s_adv_state == BLE_ADV_STATE_CONFIGURING)
+    {
+      adv_set_state_locked(BLE_ADV_STATE_IDLE);
+    }
+  }
+  taskEXIT_CRITICAL(&s_adv_lock);
+
+  esp_err_t ret = ESP_OK;
+  if (action == ADV_ACTION_START)
+  {
+    ret = esp_ble_gap_start_advertising(&s_active_params);
+    if (ret != ESP_OK)
+      ESP_LOGE(TAG_GAP, "Starting advertising failed: %s", esp_err_to_name(ret));
+  }
+  else if (action == ADV_ACTION_STOP)
+  {
+    ret = esp_ble_gap_stop_advertising();
+    if (ret != ESP_OK)
+      ESP_LOGE(TAG_GAP, "Stop advertising failed: %s", esp_err_to_name(ret));
+  }
+
+  if (ret != ESP_OK)
+  {
+    // The completion event will never come; roll back so a later request can retry
+    taskENTER_CRITICAL(&s_adv_lock);
+    s_adv_op_pending = false;
+    if (action == ADV_ACTION_START)
+      adv_set_state_locked(BLE_ADV_STATE_IDLE);
+    taskEXIT_CRITICAL(&s_adv_lock);
+  }
+}
+
+/**
+ * @brief End of the directed burst or of the allowlist window: move to the next mode
+ *
+ * Runs in the esp_timer task. The restart itself goes through adv_reconcile().
+ */
+static void adv_phase_timeout(void *arg)
+{
+  ble_adv_mode_t next;
+
+  taskENTER_CRITICAL(&s_adv_lock);
+  if (s_adv_state != BLE_ADV_STATE_CONNECTED && s_adv_mode == BLE_ADV_MODE_DIRECTED)
+    s_adv_mode = BLE_ADV_MODE_ALLOWLIST;
+  else if (s_adv_state != BLE_ADV_STATE_CONNECTED && s_adv_mode == BLE_ADV_MODE_ALLOWLIST)
+    s_adv_mode = BLE_ADV_MODE_UNDIRECTED;
+  next = s_adv_mode;
+  taskEXIT_CRITICAL(&s_adv_lock);
+
+  ESP_LOGI(TAG_GAP, "Reconnect phase over, switching to %s advertising", s_adv_mode_names[next]);
+  adv_reconcile();
+}
+
+/**
+ * @brief Arm the phase timer for the advertising mode that just went live
+ */
+static void adv_arm_phase_timer(ble_adv_mode_t mode)
+{
+  if (s_phase_timer == NULL)
+    return;
+
+  uint32_t timeout_ms = 0;
+  if (mode == BLE_ADV_MODE_DIRECTED)
+    timeout_ms = DIRECTED_ADV_TIMEOUT_MS;
+  else if (mode == BLE_ADV_MODE_ALLOWLIST)
+    timeout_ms = s_reconnect.allowlist_window_ms;
 
-static bool s_is_adv_data_set = false;
+  esp_timer_stop(s_phase_timer);
+  if (timeout_ms > 0)
+    esp_timer_start_once(s_phase_timer, (uint64_t)timeout_ms * 1000);
+}
+
+/**
+ * @brief Put the remembered client in the controller allowlist
+ *
+ * Must not be called while advertising with an allowlist filter policy.
+ */
+static void ble_gap_allowlist_peer(void)
+{
+  esp_ble_wl_addr_type_t wl_type =
+    (s_peer.addr_type == BLE_ADDR_TYPE_PUBLIC) ? BLE_WL_ADDR_TYPE_PUBLIC : BLE_WL_ADDR_TYPE_RANDOM;
+
+  esp_ble_gap_clear_whitelist();
+  esp_err_t ret = esp_ble_gap_update_whitelist(true, s_peer.bda, wl_type);
+  if (ret != ESP_OK)
+    ESP_LOGW(TAG_GAP, "Allowlist update failed: %s", esp_err_to_name(ret));
+}
+
+/**
+ * @brief Remember the connected client, persisting it only when it changed
+ */
+static void ble_gap_remember_peer(const uint8_t *bda, uint8_t addr_type)
+{
+  if (s_peer_valid && s_peer.addr_type == addr_type && memcmp(s_peer.bda, bda, ESP_BD_ADDR_LEN) == 0)
+    return;
+
+  taskENTER_CRITICAL(&s_adv_lock);
+  memcpy(s_peer.bda, bda, ESP_BD_ADDR_LEN);
+  s_peer.addr_type = addr_type;
+  s_peer_valid = true;
+  taskEXIT_CRITICAL(&s_adv_lock);
+
+  // Advertising is stopped while connected, so the allowlist can be changed now
+  ble_gap_allowlist_peer();
+
+  if (ble_store_set(RECONNECT_PEER_KEY, &s_peer, sizeof(s_peer)) == ESP_OK)
+    ble_store_commit();
+
+  ESP_LOGI(TAG_GAP, "Remembering client " ESP_BD_ADDR_STR " for fast reconnection", ESP_BD_ADDR_HEX(bda));
+}
+
+typedef enum
+{
+  SCAN_ACTION_NONE = 0,
+  SCAN_ACTION_PARAMS,
+  SCAN_ACTION_START,
+  SCAN_ACTION_STOP,
+} scan_action_t;
+
+/**
+ * @brief Move the controller towards the wanted scan state
+ *
+ * Issues at most one command; the matching completion event calls this again.
+ */
+static void scan_reconcile(void)
+{
+  scan_action_t action = SCAN_ACTION_NONE;
+
+  taskENTER_CRITICAL(&s_scan_lock);
+  bool wanted = (s_observer != NULL || s_central_searching) && !s_central_connecting && !s_scan_suspended &&
+                !s_scan_stopping;
+  bool stopped = s_scan_stopping && !s_scan_running && !s_scan_op_pending;
+  if (!s_scan_op_pending)
+  {
+    if (wanted && !s_scan_params_set)
+      action = SCAN_ACTION_PARAMS;
+    else if (wanted && !s_scan_running)
+      action = SCAN_ACTION_START;
+    else if (!wanted && s_scan_running)
+      action = SCAN_ACTION_STOP;
+
+    s_scan_op_pending = action != SCAN_ACTION_NONE;
+    if (action == SCAN_ACTION_START)
+      s_scan_running = true;
+  }
+  taskEXIT_CRITICAL(&s_scan_lock);
+
+  if (stopped)
+    xSemaphoreGive(s_scan_stopped);
+
+  esp_err_t ret = ESP_OK;
+  if (action == SCAN_ACTION_PARAMS)
+    ret = esp_ble_gap_set_scan_params(&s_scan_params);
+  else if (action == SCAN_ACTION_START)
+    ret = esp_ble_gap_start_scanning(0);  // Until stopped
+  else if (action == SCAN_ACTION_STOP)
+    ret = esp_ble_gap_stop_scanning();
+
+  if (ret != ESP_OK)
+  {
+    // The completion event will never come; roll back so a later request can retry
+    ESP_LOGE(TAG_GAP, "Scan command %d failed: %s", action, esp_err_to_name(ret));
+    taskENTER_CRITICAL(&s_scan_lock);
+    s_scan_op_pending = false;
+    if (action == SCAN_ACTION_START)
+      s_scan_running = false;
+    taskEXIT_CRITICAL(&s_scan_lock);
+  }
+}
+
+/**
+ * @brief Filter, deduplicate and queue one advertising report. Bluetooth task.
+ */
+static void observer_ingest(const esp_ble_gap_cb_param_t *param)
+{
+  int64_t now_us = esp_timer_get_time();
+  uint32_t now_ms = (uint32_t)(now_us / 1000) | 1;  // 0 marks a free dedup slot
+  size_t len = param->scan_rst.adv_data_len + param->scan_rst.scan_rsp_len;
+  if (len > BLE_OBSERVER_MAX_DATA)
+    len = BLE_OBSERVER_MAX_DATA;
+
+  bool evicted;
+  ble_observe_verdict_t verdict = ble_observe_check(&s_observe, param->scan_rst.bda, param->scan_rst.ble_adv, len,
+                                                    now_ms, &evicted);
+  bool filtered = verdict == BLE_OBSERVE_FILTERED;
+  bool duplicate = verdict == BLE_OBSERVE_DUPLICATE;
+  bool dropped = false;
+
+  if (verdict == BLE_OBSERVE_NEW)
+  {
+    ble_observer_report_t report = {
+      .address_type = param->scan_rst.ble_addr_type,
+      .event_type = param->scan_rst.ble_evt_type,
+      .rssi = param->scan_rst.rssi,
+      .len = len,
+      .time_us = now_us,
+    };
+    memcpy(report.address, param->scan_rst.bda, ESP_BD_ADDR_LEN);
+    memcpy(report.data, param->scan_rst.ble_adv, len);
+
+    taskENTER_CRITICAL(&s_observer_lock);
+    dropped = !ble_observe_push(&s_observe, &report);
+    taskEXIT_CRITICAL(&s_observer_lock);
+    if (!dropped)
+      xSemaphoreGive(s_observer_ready);
+  }
+
+  // Rate over whole seconds, published when a second is complete
+  uint32_t rate = 0;
+  bool rate_done = false;
+  if (s_rate_start_us == 0)
+    s_rate_start_us = now_us;
+  s_rate_count++;
+  if (now_us - s_rate_start_us >= 1000000)
+  {
+    rate = (uint32_t)(s_rate_count * 1000000LL / (now_us - s_rate_start_us));
+    rate_done = true;
+    s_rate_start_us = now_us;
+    s_rate_count = 0;
+  }
+
+  taskENTER_CRITICAL(&s_observer_lock);
+  s_observer_stats.received++;
+  s_observer_stats.filtered += filtered;
+  s_observer_stats.duplicates += duplicate;
+  s_observer_stats.evictions += evicted;
+  s_observer_stats.queued += !filtered && !duplicate && !dropped;
+  s_observer_stats.dropped += dropped;
+  if (rate_done)
+  {
+    s_observer_stats.rate_per_s = rate;
+    if (rate > s_observer_stats.peak_rate_per_s)
+      s_observer_stats.peak_rate_per_s = rate;
+  }
+  taskEXIT_CRITICAL(&s_observer_lock);
+}
 
 static uint16_t ble_gap_config_adv(uint16_t service_uuid, const char *local_name, size_t size)
 {
   //* Advertise data
   if (s_raw_adv_data != NULL)
-    return 0;
+    return s_raw_adv_len;
 
   // Buffer temporário para montar os dados
   uint8_t adv_data[RAW_ADV_DATA_SIZE];
@@ -73,11 +499,17 @@ static uint16_t ble_gap_config_adv(uint16_t service_uuid, const char *local_name
 
   // Allocate and copy the advertising data
   s_raw_adv_data = (uint8_t *)calloc(idx, sizeof(uint8_t));
+  if (s_raw_adv_data == NULL)
+  {
+    ESP_LOGE(TAG_GAP, "Failed to allocate memory for advertising data");
+    return 0;
+  }
   memcpy(s_raw_adv_data, adv_data, idx);
+  s_raw_adv_len = idx;
 
   //* Advertise parameters
   if (s_adv_params != NULL)
-    return 0;
+    return idx;
 
   s_adv_params = (esp_ble_adv_params_t *)calloc(1, sizeof(esp_ble_adv_params_t));
   if (s_adv_params == NULL)
@@ -99,7 +531,7 @@ static uint16_t ble_gap_config_adv(uint16_t service_uuid, const char *local_name
 static uint16_t ble_gap_init_scan_rsp_data(uint16_t service_uuid, const char *local_name, size_t name_len)
 {
   if (s_raw_scan_rsp_data != NULL)
-    return 0;
+    return s_raw_scan_rsp_len;
 
   uint8_t scan_rsp_data[RAW_SCAN_RSP_DATA_SIZE];
   int idx = 0;
@@ -130,7 +562,13 @@ static uint16_t ble_gap_init_scan_rsp_data(uint16_t service_uuid, const char *lo
 
   // Allocate and copy the scan response data
   s_raw_scan_rsp_data = (uint8_t *)calloc(idx, sizeof(uint8_t));
+  if (s_raw_scan_rsp_data == NULL)
+  {
+    ESP_LOGE(TAG_GAP, "Failed to allocate memory for scan response data");
+    return 0;
+  }
   memcpy(s_raw_scan_rsp_data, scan_rsp_data, idx);
+  s_raw_scan_rsp_len = idx;
 
   return idx;
 }
@@ -142,6 +580,7 @@ static void ble_free_scan_rsp_data(void)
 
   free(s_raw_scan_rsp_data);
   s_raw_scan_rsp_data = NULL;
+  s_raw_scan_rsp_len = 0;
 }
 
 static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
@@ -153,39 +592,98 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
     {
       ESP_LOGI(TAG_GAP, "Advertising data set successfully");
 
+      taskENTER_CRITICAL(&s_adv_lock);
       adv_config_done &= ~ADV_CONFIG_FLAG;  // Clear the flag
-      ESP_LOGI(TAG_GAP, "adv_config_done: %d", adv_config_done);
-      // if (0 == adv_config_done)
-      ble_gap_start_adv();
+      taskEXIT_CRITICAL(&s_adv_lock);
 
+      // Advertising only starts once the scan response is configured as well
+      adv_reconcile();
       break;
     }
     case ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT:
     {
       ESP_LOGI(TAG_GAP, "Scan response data set successfully");
 
+      taskENTER_CRITICAL(&s_adv_lock);
       adv_config_done &= ~SCAN_RSP_CONFIG_FLAG;  // Clear the flag
-      if (0 == adv_config_done)
-        ble_gap_start_adv();
+      taskEXIT_CRITICAL(&s_adv_lock);
 
+      adv_reconcile();
       break;
     }
     case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
     {
-      if (param->adv_start_cmpl.status != ESP_BT_STATUS_SUCCESS)
-        ESP_LOGI(TAG_GAP, "Advertising start failed");
+      bool success = (param->adv_start_cmpl.status == ESP_BT_STATUS_SUCCESS);
+      int64_t restart_latency_us = 0;
+      int64_t resume_latency_us = 0;
+
+      taskENTER_CRITICAL(&s_adv_lock);
+      s_adv_op_pending = false;
+      if (s_adv_state != BLE_ADV_STATE_CONNECTED)
+        adv_set_state_locked(success ? BLE_ADV_STATE_ADVERTISING : BLE_ADV_STATE_IDLE);
+      if (success && s_disconnect_us != 0)
+      {
+        restart_latency_us = s_state_entered_us[BLE_ADV_STATE_ADVERTISING] - s_disconnect_us;
+        s_last_restart_latency_us = restart_latency_us;
+        if (restart_latency_us > s_max_restart_latency_us)
+          s_max_restart_latency_us = restart_latency_us;
+        s_restart_count++;
+        s_disconnect_us = 0;
+      }
+      if (success && s_resume_us != 0)
+      {
+        resume_latency_us = s_state_entered_us[BLE_ADV_STATE_ADVERTISING] - s_resume_us;
+        s_last_resume_latency_us = resume_latency_us;
+        if (resume_latency_us > s_max_resume_latency_us)
+          s_max_resume_latency_us = resume_latency_us;
+        s_resume_count++;
+      }
+      s_resume_us = 0;
+      if (!success)
+        s_adv_requested = false;  // Do not retry in a loop, wait for an explicit request
+      taskEXIT_CRITICAL(&s_adv_lock);
+
+      if (!success)
+        ESP_LOGE(TAG_GAP, "Advertising start failed, status %d", param->adv_start_cmpl.status);
+      else if (resume_latency_us != 0)
+        ESP_LOGI(TAG_GAP,
+                 "Advertising (%s) resumed in %lld us (cold init: %lld us)",
+                 s_adv_mode_names[s_adv_active_mode],
+                 resume_latency_us,
+                 ble_gap_cold_start_latency());
+      else if (restart_latency_us != 0)
+        ESP_LOGI(TAG_GAP,
+                 "Advertising (%s) restarted %lld us after disconnect",
+                 s_adv_mode_names[s_adv_active_mode],
+                 restart_latency_us);
       else
-        ESP_LOGI(TAG_GAP, "Advertising start successfully");
+        ESP_LOGI(TAG_GAP, "Advertising (%s) start successfully", s_adv_mode_names[s_adv_active_mode]);
 
+      if (success)
+      {
+        ble_boot_mark(BLE_BOOT_STAGE_ADV_STARTED);
+        adv_arm_phase_timer(s_adv_active_mode);
+      }
+
+      // A stop may have been requested while the start was in flight
+      adv_reconcile();
       break;
     }
     case ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT:
     {
+      taskENTER_CRITICAL(&s_adv_lock);
+      s_adv_op_pending = false;
+      if (s_adv_state == BLE_ADV_STATE_ADVERTISING)
+        adv_set_state_locked(BLE_ADV_STATE_IDLE);
+      taskEXIT_CRITICAL(&s_adv_lock);
+
       if (param->adv_stop_cmpl.status != ESP_BT_STATUS_SUCCESS)
         ESP_LOGI(TAG_GAP, "Advertising stop failed");
       else
         ESP_LOGI(TAG_GAP, "Stop adv successfully");
 
+      // A start may have been requested while the stop was in flight
+      adv_reconcile();
       break;
     }
     case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
@@ -211,6 +709,86 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
 
       break;
     }
+    case ESP_GAP_BLE_SEC_REQ_EVT:
+    case ESP_GAP_BLE_KEY_EVT:
+    case ESP_GAP_BLE_AUTH_CMPL_EVT:
+    {
+      // Only the client link pairs into the bond table; links opened as central belong to ble-central
+      const uint8_t *bda = (event == ESP_GAP_BLE_SEC_REQ_EVT) ? param->ble_security.ble_req.bd_addr
+                           : (event == ESP_GAP_BLE_KEY_EVT)   ? param->ble_security.ble_key.bd_addr
+                                                              : param->ble_security.auth_cmpl.bd_addr;
+      if (ble_gatts_is_client(bda))
+        ble_sec_handle_gap_event(event, param);
+      else
+        ble_central_handle_gap_event(event, param);
+      break;
+    }
+    case ESP_GAP_BLE_REMOVE_BOND_DEV_COMPLETE_EVT:
+    {
+      ble_sec_handle_gap_event(event, param);
+      break;
+    }
+    case ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT:
+    {
+      bool success = (param->scan_param_cmpl.status == ESP_BT_STATUS_SUCCESS);
+
+      taskENTER_CRITICAL(&s_scan_lock);
+      s_scan_op_pending = false;
+      s_scan_params_set = success;
+      taskEXIT_CRITICAL(&s_scan_lock);
+
+      // On failure wait for the next request rather than retrying in a loop
+      if (success)
+        scan_reconcile();
+      else
+        ESP_LOGE(TAG_GAP, "Setting scan parameters failed, status %d", param->scan_param_cmpl.status);
+      break;
+    }
+    case ESP_GAP_BLE_SCAN_START_COMPLETE_EVT:
+    {
+      bool success = (param->scan_start_cmpl.status == ESP_BT_STATUS_SUCCESS);
+
+      taskENTER_CRITICAL(&s_scan_lock);
+      s_scan_op_pending = false;
+      s_scan_running = success;
+      taskEXIT_CRITICAL(&s_scan_lock);
+
+      if (success)
+        scan_reconcile();  // A stop may have been requested while the start was in flight
+      else
+        ESP_LOGE(TAG_GAP, "Scan start failed, status %d", param->scan_start_cmpl.status);
+      break;
+    }
+    case ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT:
+    {
+      taskENTER_CRITICAL(&s_scan_lock);
+      s_scan_op_pending = false;
+      s_scan_running = false;
+      taskEXIT_CRITICAL(&s_scan_lock);
+
+      scan_reconcile();
+      ble_central_handle_gap_event(event, param);
+      break;
+    }
+    case ESP_GAP_BLE_SCAN_RESULT_EVT:
+    {
+      if (param->scan_rst.search_evt == ESP_GAP_SEARCH_INQ_CMPL_EVT)
+      {
+        // Scan duration elapsed (not expected, scans run until stopped)
+        taskENTER_CRITICAL(&s_scan_lock);
+        s_scan_running = false;
+        taskEXIT_CRITICAL(&s_scan_lock);
+        scan_reconcile();
+        break;
+      }
+      if (param->scan_rst.search_evt != ESP_GAP_SEARCH_INQ_RES_EVT)
+        break;
+
+      if (s_observer != NULL)
+        observer_ingest(param);
+      ble_central_handle_gap_event(event, param);
+      break;
+    }
     default:
     {
       ESP_LOGI(TAG_GAP, "Unhandled GAP event: %d", event);
@@ -219,10 +797,100 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
   }
 }
 
-esp_err_t ble_gap_init(const char *device_name)
+/**
+ * @brief Allocate the observer dedup table and report queue
+ */
+static esp_err_t observer_init(const ble_observer_config_t *observer)
+{
+  size_t queue_length = (observer->queue_length != 0) ? observer->queue_length : OBSERVER_DEFAULT_QUEUE;
+  uint32_t dedup_ms = (observer->dedup_ms != 0) ? observer->dedup_ms : OBSERVER_DEFAULT_DEDUP_MS;
+
+  s_observer_ready = xSemaphoreCreateCounting(queue_length, 0);
+  if (s_observer_ready == NULL || !ble_observe_alloc(&s_observe, observer, dedup_ms, queue_length))
+  {
+    ESP_LOGE(TAG_GAP, "Failed to allocate the observer table and queue");
+    return ESP_ERR_NO_MEM;
+  }
+
+  s_rate_start_us = 0;
+  s_rate_count = 0;
+  memset(&s_observer_stats, 0, sizeof(s_observer_stats));
+  s_observer = observer;
+
+  taskENTER_CRITICAL(&s_observer_lock);
+  s_observer_open = true;
+  taskEXIT_CRITICAL(&s_observer_lock);
+
+  ESP_LOGI(TAG_GAP, "Observer on, %d report queue, %lu ms dedup", queue_length, (unsigned long)dedup_ms);
+  return ESP_OK;
+}
+
+/**
+ * @brief Release the dedup table and report queue once no receiver is left on the queue
+ *
+ * The scan is already stopped (ble_gap_stop_scan()), so the Bluetooth task no longer ingests.
+ */
+static void observer_deinit(void)
+{
+  uint32_t receivers;
+
+  // From here on receivers return BLE_NOT_INITIALIZED
+  taskENTER_CRITICAL(&s_observer_lock);
+  s_observer_open = false;
+  receivers = s_observer_receivers;
+  taskEXIT_CRITICAL(&s_observer_lock);
+
+  s_observer = NULL;
+  if (s_observer_ready != NULL)
+  {
+    // Blocked receivers are woken without a report and see the observer closed
+    while (receivers > 0)
+    {
+      xSemaphoreGive(s_observer_ready);
+      vTaskDelay(1);
+
+      taskENTER_CRITICAL(&s_observer_lock);
+      receivers = s_observer_receivers;
+      taskEXIT_CRITICAL(&s_observer_lock);
+    }
+    vSemaphoreDelete(s_observer_ready);
+    s_observer_ready = NULL;
+  }
+  ble_observe_release(&s_observe);
+}
+
+esp_err_t ble_gap_init(const char *device_name, const ble_reconnect_config_t *reconnect,
+                       const ble_observer_config_t *observer)
 {
   esp_err_t ret;
 
+  s_reconnect = *reconnect;
+  s_peer_valid = false;
+  if (s_reconnect.enabled)
+  {
+    size_t len = sizeof(s_peer);
+    if (ble_store_get(RECONNECT_PEER_KEY, &s_peer, &len) == ESP_OK && len == sizeof(s_peer))
+    {
+      s_peer_valid = true;
+      ESP_LOGI(TAG_GAP, "Known client " ESP_BD_ADDR_STR ", reconnecting with directed advertising",
+               ESP_BD_ADDR_HEX(s_peer.bda));
+    }
+
+    if (s_phase_timer == NULL)
+    {
+      const esp_timer_create_args_t timer_args = {
+        .callback = adv_phase_timeout,
+        .name = "ble_adv_phase",
+      };
+      ret = esp_timer_create(&timer_args, &s_phase_timer);
+      if (ret != ESP_OK)
+      {
+        ESP_LOGE(TAG_GAP, "Phase timer creation failed: %s", esp_err_to_name(ret));
+        return ret;
+      }
+    }
+  }
+
   ret = esp_ble_gap_register_callback(gap_event_handler);
   if (ret)
   {
@@ -238,8 +906,31 @@ esp_err_t ble_gap_init(const char *device_name)
     return ret;
   }
 
+  // Payloads are built once and stay resident until ble_gap_deinit()
   uint16_t raw_adv_data_size = ble_gap_config_adv(RAW_ADV_DATA_SERVICE_UUID, device_name, strlen(device_name));
   ESP_LOGI(TAG_GAP, "Advertising data size: %d", raw_adv_data_size);
+
+  uint16_t scab_rsp_data_size =
+    ble_gap_init_scan_rsp_data(RAW_SCAN_RSP_DATA_SERVICE_UUID,
+                               device_name,
+                               strlen(device_name));  // Example service UUID and device name
+  ESP_LOGI(TAG_GAP, "Scan response data size: %d", scab_rsp_data_size);
+
+  if (raw_adv_data_size == 0 || scab_rsp_data_size == 0 || s_adv_params == NULL)
+    return ESP_ERR_NO_MEM;
+
+  if (s_peer_valid)
+    ble_gap_allowlist_peer();
+
+  // Flags must be set before the config calls: completion events arrive on the BTC task
+  taskENTER_CRITICAL(&s_adv_lock);
+  adv_config_done |= ADV_CONFIG_FLAG | SCAN_RSP_CONFIG_FLAG;
+  s_adv_requested = true;  // Start advertising as soon as both payloads are configured
+  s_adv_op_pending = false;
+  s_adv_mode = adv_first_mode_locked();
+  adv_set_state_locked(BLE_ADV_STATE_CONFIGURING);
+  taskEXIT_CRITICAL(&s_adv_lock);
+
   ret = esp_ble_gap_config_adv_data_raw(s_raw_adv_data, raw_adv_data_size);
   if (ret)
   {
@@ -247,11 +938,6 @@ esp_err_t ble_gap_init(const char *device_name)
     return ret;
   }
 
-  uint16_t scab_rsp_data_size =
-    ble_gap_init_scan_rsp_data(RAW_SCAN_RSP_DATA_SERVICE_UUID,
-                               device_name,
-                               strlen(device_name));  // Example service UUID and device name
-  ESP_LOGI(TAG_GAP, "Scan response data size: %d", scab_rsp_data_size);
   ret = esp_ble_gap_config_scan_rsp_data_raw(s_raw_scan_rsp_data, scab_rsp_data_size);
   if (ret)
   {
@@ -259,7 +945,44 @@ esp_err_t ble_gap_init(const char *device_name)
     return ret;
   }
 
-  adv_config_done |= ADV_CONFIG_FLAG | SCAN_RSP_CONFIG_FLAG;
+  if (s_scan_stopped == NULL)
+  {
+    s_scan_stopped = xSemaphoreCreateBinary();
+    if (s_scan_stopped == NULL)
+    {
+      ESP_LOGE(TAG_GAP, "Failed to create the scan stop semaphore");
+      return ESP_ERR_NO_MEM;
+    }
+  }
+
+  // The observer settings apply to the central role's scans as well
+  s_scan_params = (esp_ble_scan_params_t){
+    .scan_type = BLE_SCAN_TYPE_PASSIVE,
+    .own_addr_type = BLE_ADDR_TYPE_PUBLIC,
+    .scan_filter_policy = BLE_SCAN_FILTER_ALLOW_ALL,
+    .scan_interval = SCAN_DEFAULT_INTERVAL,
+    .scan_window = SCAN_DEFAULT_WINDOW,
+    .scan_duplicate = BLE_SCAN_DUPLICATE_DISABLE,  // Duplicates are filtered by the observer table
+  };
+  if (observer != NULL)
+  {
+    if (observer->active)
+      s_scan_params.scan_type = BLE_SCAN_TYPE_ACTIVE;
+    if (observer->scan_interval != 0)
+      s_scan_params.scan_interval = observer->scan_interval;
+    if (observer->scan_window != 0)
+      s_scan_params.scan_window = observer->scan_window;
+    if (s_scan_params.scan_window > s_scan_params.scan_interval)
+      s_scan_params.scan_window = s_scan_params.scan_interval;
+
+    ret = observer_init(observer);
+    if (ret != ESP_OK)
+    {
+      observer_deinit();
+      return ret;
+    }
+    scan_reconcile();
+  }
 
   ESP_LOGI(TAG_GAP, "GAP initialized successfully with device name: %s", device_name);
   return ESP_OK;
@@ -268,18 +991,60 @@ esp_err_t ble_gap_init(const char *device_name)
 static void ble_gap_free_adv_data()
 {
   // Free advertising data
-  if (s_raw_adv_data == NULL)
-    return;
-
-  free(s_raw_adv_data);
-  s_raw_adv_data = NULL;
+  if (s_raw_adv_data != NULL)
+  {
+    free(s_raw_adv_data);
+    s_raw_adv_data = NULL;
+    s_raw_adv_len = 0;
+  }
 
   // Free advertising parameters
-  if (s_adv_params == NULL)
-    return;
+  if (s_adv_params != NULL)
+  {
+    free(s_adv_params);
+    s_adv_params = NULL;
+  }
+}
+
+void ble_gap_deinit(void)
+{
+  taskENTER_CRITICAL(&s_adv_lock);
+  adv_config_done = 0;
+  s_adv_requested = false;
+  s_adv_op_pending = false;
+  s_disconnect_us = 0;
+  s_resume_us = 0;
+  s_reconnect_from_us = 0;
+  adv_set_state_locked(BLE_ADV_STATE_IDLE);
+  taskEXIT_CRITICAL(&s_adv_lock);
 
-  free(s_adv_params);
-  s_adv_params = NULL;
+  if (s_phase_timer != NULL)
+  {
+    esp_timer_stop(s_phase_timer);
+    esp_timer_delete(s_phase_timer);
+    s_phase_timer = NULL;
+  }
+
+  // Bluedroid is down, the scan was stopped before by ble_gap_stop_scan()
+  taskENTER_CRITICAL(&s_scan_lock);
+  s_scan_running = false;
+  s_scan_op_pending = false;
+  s_scan_params_set = false;
+  s_central_searching = false;
+  s_central_connecting = false;
+  s_scan_suspended = false;
+  s_scan_stopping = false;
+  taskEXIT_CRITICAL(&s_scan_lock);
+
+  observer_deinit();
+  if (s_scan_stopped != NULL)
+  {
+    vSemaphoreDelete(s_scan_stopped);
+    s_scan_stopped = NULL;
+  }
+
+  ble_gap_free_adv_data();
+  ble_free_scan_rsp_data();
 }
 
 esp_err_t ble_gap_start_adv()
@@ -290,13 +1055,29 @@ esp_err_t ble_gap_start_adv()
     return ESP_ERR_INVALID_STATE;
   }
 
-  esp_err_t ret = esp_ble_gap_start_advertising(s_adv_params);
-  if (ret)
+  taskENTER_CRITICAL(&s_adv_lock);
+  s_adv_requested = true;
+  taskEXIT_CRITICAL(&s_adv_lock);
+
+  adv_reconcile();
+  return ESP_OK;
+}
+
+esp_err_t ble_gap_resume_adv(void)
+{
+  if (s_raw_adv_data == NULL || s_adv_params == NULL)
   {
-    ESP_LOGE(TAG_GAP, "Starting advertising failed: %s", esp_err_to_name(ret));
-    return ret;
+    ESP_LOGE(TAG_GAP, "Advertising data or parameters not set");
+    return ESP_ERR_INVALID_STATE;
   }
 
+  taskENTER_CRITICAL(&s_adv_lock);
+  s_resume_us = esp_timer_get_time();
+  s_adv_requested = true;
+  s_adv_mode = adv_first_mode_locked();
+  taskEXIT_CRITICAL(&s_adv_lock);
+
+  adv_reconcile();
   return ESP_OK;
 }
 
@@ -324,16 +1105,186 @@ esp_err_t ble_gap_update_connection_params(uint8_t *bda, uint16_t min_interval,
 
 esp_err_t ble_gap_stop_adv(void)
 {
-  esp_err_t ret = esp_ble_gap_stop_advertising();
-  if (ret != ESP_OK)
+  taskENTER_CRITICAL(&s_adv_lock);
+  s_adv_requested = false;
+  s_disconnect_us = 0;
+  s_resume_us = 0;
+  taskEXIT_CRITICAL(&s_adv_lock);
+
+  // Payloads are kept so that a later ble_gap_start_adv() does not need a reconfiguration
+  adv_reconcile();
+  return ESP_OK;
+}
+
+esp_err_t ble_gap_stop_scan(void)
+{
+  if (s_scan_stopped == NULL)
+    return ESP_OK;
+
+  xSemaphoreTake(s_scan_stopped, 0);  // A give left over from an earlier stop
+
+  taskENTER_CRITICAL(&s_scan_lock);
+  s_scan_stopping = true;
+  taskEXIT_CRITICAL(&s_scan_lock);
+
+  // Stops a running scan, or gives the semaphore right away if the controller is idle
+  scan_reconcile();
+  if (xSemaphoreTake(s_scan_stopped, pdMS_TO_TICKS(SCAN_STOP_TIMEOUT_MS)) != pdTRUE)
   {
-    ESP_LOGE(TAG_GAP, "Stop advertising failed: %s", esp_err_to_name(ret));
-    return ret;
+    ESP_LOGW(TAG_GAP, "Scan stop not confirmed within %d ms", SCAN_STOP_TIMEOUT_MS);
+    return ESP_ERR_TIMEOUT;
   }
+  return ESP_OK;
+}
 
-  // Free allocated resources
-  ble_gap_free_adv_data();
-  ble_free_scan_rsp_data();
+void ble_gap_suspend_scan(bool suspended)
+{
+  taskENTER_CRITICAL(&s_scan_lock);
+  s_scan_suspended = suspended;
+  taskEXIT_CRITICAL(&s_scan_lock);
 
-  return ESP_OK;
+  // Stops or restarts the observer and central scan; the completion events finish the job
+  scan_reconcile();
+}
+
+void ble_gap_on_connect(const uint8_t *bda, uint8_t addr_type)
+{
+  int64_t now_us = esp_timer_get_time();
+  int64_t latency_us = 0;
+  ble_adv_mode_t mode;
+
+  taskENTER_CRITICAL(&s_adv_lock);
+  adv_set_state_locked(BLE_ADV_STATE_CONNECTED);
+  s_disconnect_us = 0;
+  mode = s_adv_active_mode;
+  if (s_reconnect_from_us != 0)
+  {
+    latency_us = now_us - s_reconnect_from_us;
+    s_reconnect_count[mode]++;
+    s_last_reconnect_mode = mode;
+    s_last_reconnect_latency_us = latency_us;
+    s_reconnect_from_us = 0;
+  }
+  taskEXIT_CRITICAL(&s_adv_lock);
+
+  if (s_phase_timer != NULL)
+    esp_timer_stop(s_phase_timer);
+
+  ESP_LOGD(TAG_GAP, "Advertising state: %s", s_adv_state_names[BLE_ADV_STATE_CONNECTED]);
+  if (latency_us != 0)
+    ESP_LOGI(TAG_GAP,
+             "Reconnected through %s advertising %lld us after disconnect",
+             s_adv_mode_names[mode],
+             latency_us);
+
+  if (s_reconnect.enabled)
+    ble_gap_remember_peer(bda, addr_type);
+}
+
+void ble_gap_on_disconnect(void)
+{
+  int64_t now_us = esp_timer_get_time();
+
+  taskENTER_CRITICAL(&s_adv_lock);
+  if (s_adv_state == BLE_ADV_STATE_CONNECTED)
+    adv_set_state_locked(BLE_ADV_STATE_IDLE);
+  if (s_adv_requested)
+    s_disconnect_us = now_us;
+  s_reconnect_from_us = now_us;
+  s_adv_mode = adv_first_mode_locked();
+  taskEXIT_CRITICAL(&s_adv_lock);
+
+  adv_reconcile();
+  ESP_LOGD(TAG_GAP, "Advertising state: %s", s_adv_state_names[s_adv_state]);
+}
+
+void ble_gap_get_adv_stats(ble_adv_stats_t *out)
+{
+  taskENTER_CRITICAL(&s_adv_lock);
+  out->state = s_adv_state;
+  memcpy(out->state_entered_us, s_state_entered_us, sizeof(out->state_entered_us));
+  out->restart_count = s_restart_count;
+  out->last_restart_latency_us = s_last_restart_latency_us;
+  out->max_restart_latency_us = s_max_restart_latency_us;
+  out->mode = s_adv_mode;
+  memcpy(out->reconnect_count, s_reconnect_count, sizeof(out->reconnect_count));
+  out->last_reconnect_mode = s_last_reconnect_mode;
+  out->last_reconnect_latency_us = s_last_reconnect_latency_us;
+  out->resume_count = s_resume_count;
+  out->last_resume_latency_us = s_last_resume_latency_us;
+  out->max_resume_latency_us = s_max_resume_latency_us;
+  taskEXIT_CRITICAL(&s_adv_lock);
+
+  out->cold_start_latency_us = ble_gap_cold_start_latency();
+}
+
+void ble_gap_forget_peer(void)
+{
+  taskENTER_CRITICAL(&s_adv_lock);
+  s_peer_valid = false;
+  s_adv_mode = BLE_ADV_MODE_UNDIRECTED;
+  taskEXIT_CRITICAL(&s_adv_lock);
+
+  if (s_phase_timer != NULL)
+    esp_timer_stop(s_phase_timer);
+
+  if (ble_store_erase(RECONNECT_PEER_KEY) == ESP_OK)
+    ble_store_commit();
+
+  // Restarts advertising in undirected mode if a reconnect phase was running
+  adv_reconcile();
+}
+
+bool ble_gap_set_central_scan(bool searching, bool connecting)
+{
+  bool stopped;
+
+  taskENTER_CRITICAL(&s_scan_lock);
+  s_central_searching = searching;
+  s_central_connecting = connecting;
+  taskEXIT_CRITICAL(&s_scan_lock);
+
+  scan_reconcile();
+
+  taskENTER_CRITICAL(&s_scan_lock);
+  stopped = !s_scan_running && !s_scan_op_pending;
+  taskEXIT_CRITICAL(&s_scan_lock);
+  return stopped;
+}
+
+void ble_gap_get_observer_stats(ble_observer_stats_t *out)
+{
+  taskENTER_CRITICAL(&s_observer_lock);
+  *out = s_observer_stats;
+  taskEXIT_CRITICAL(&s_observer_lock);
+}
+
+ble_return_code_t ble_observer_receive(ble_observer_report_t *out, uint32_t timeout_ms)
+{
+  if (out == NULL)
+    return BLE_INVALID_CONFIG;
+
+  // Registered as a receiver, so deinit wakes this task and waits for it before deleting the queue
+  taskENTER_CRITICAL(&s_observer_lock);
+  SemaphoreHandle_t ready = s_observer_open ? s_observer_ready : NULL;
+  if (ready != NULL)
+    s_observer_receivers++;
+  taskEXIT_CRITICAL(&s_observer_lock);
+
+  if (ready == NULL)
+    return BLE_NOT_INITIALIZED;
+
+  // Each give stands for one queued report, unless deinit closed the observer meanwhile
+  bool received = xSemaphoreTake(ready, pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+
+  taskENTER_CRITICAL(&s_observer_lock);
+  s_observer_receivers--;
+  bool open = s_observer_open;
+  if (open && received)
+    ble_observe_pop(&s_observe, out);
+  taskEXIT_CRITICAL(&s_observer_lock);
+
+  if (!open)
+    return BLE_NOT_INITIALIZED;
+  return received ? BLE_SUCCESS : BLE_TIMEOUT;
 }
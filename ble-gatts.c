@@ -17,18 +17,36 @@
 #include <esp_gatt_defs.h>
 #include <esp_gatts_api.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <string.h>
 
+#include "ble-boot.h"
+#include "ble-channel.h"
+#include "ble-char.h"
+#include "ble-coalesce.h"
+#include "ble-compress.h"
 #include "ble-gap.h"
+#include "ble-history.h"
+#include "ble-notify.h"
+#include "ble-persist.h"
+#include "ble-rpc.h"
+#include "ble-sec.h"
+#include "ble-serial.h"
+#include "ble-store.h"
+#include "ble-txn.h"
+#include "ble-xfer.h"
 
 #define GATTS_TAG "BLE_GATTS"
 
 // Constants
-#define MAX_CHARACTERISTICS  16
-#define HANDLES_PER_CHAR     3  // 1 for char declaration + 1 for char value + 1 for descriptor
+#define MAX_CHARACTERISTICS  BLE_MAX_CHARACTERISTICS
+#define HANDLES_PER_CHAR     4  // Declaration + value + user description + CCCD
 #define SERVICE_HANDLE_COUNT 1
 #define MAX_MTU_SIZE         500
+#define DEFAULT_MTU_SIZE     23
 #define GATTS_APP_ID         0
+#define HANDLE_MAP_KEY       "gatts_map"
+#define HANDLE_MAP_VERSION   2
 
 // Calculate handles: service + (characteristics * handles_per_char)
 #define CALC_NUM_HANDLES(char_count) (SERVICE_HANDLE_COUNT + ((char_count) * HANDLES_PER_CHAR))
@@ -50,18 +68,357 @@ static uint16_t s_service_handle = 0;
 static esp_gatt_if_t s_gatts_if = ESP_GATT_IF_NONE;
 static uint16_t s_conn_id = 0;
 static bool s_is_connected = false;
+static esp_bd_addr_t s_client_bda;       // Address the client connected with
+static esp_bd_addr_t s_client_identity;  // Its identity address, the same unless it is a bonded private address
+static bool s_suspended = false;  // Connections are refused while the server is suspended
+static int64_t s_connect_us = 0;  // Connection timestamp until the first ATT request (0 = measured)
+static uint16_t s_mtu = DEFAULT_MTU_SIZE;
+static bool s_congested = false;
+
+// Snapshot of the last value read, so the Read Blob requests of a long read are served
+// from the value seen by the first request instead of calling the handler again
+static struct
+{
+  uint16_t handle;  // 0 = empty
+  uint16_t len;
+  uint8_t value[ESP_GATT_MAX_ATTR_LEN];
+} s_read_snapshot;
 
 // Handle tracking
 static ble_char_handle_t s_char_handles[MAX_CHARACTERISTICS];
 static size_t s_registered_chars = 0;
-static size_t s_pending_descr_char = 0;  // Index of char waiting for descriptor registration
+static uint8_t s_pending_descrs = 0;  // DESCR_* still to add for the characteristic being registered
+
+// Descriptors of a characteristic
+#define DESCR_USER_DESCRIPTION (1 << 0)
+#define DESCR_CCCD             (1 << 1)
+
+//* Persisted handle map
+// Bluedroid assigns handles in registration order, so the same configuration normally
+// gets the same handles. The map from the last boot fills the dispatch table at init and
+// the registration events verify it. The attribute database hash bonded clients are
+// checked against covers the handles, so handles that moved (with an unchanged layout,
+// e.g. after a stack update) still send those clients a Service Changed.
+typedef struct
+{
+  uint8_t version;
+  uint8_t char_count;
+  uint16_t service_handle;
+  uint32_t config_hash;
+  struct
+  {
+    uint16_t char_handle;
+    uint16_t descr_handle;
+    uint16_t cccd_handle;
+  } chars[MAX_CHARACTERISTICS];
+} ble_gatts_handle_map_t;
+
+static uint32_t s_config_hash = 0;
+static bool s_map_preloaded = false;  // Dispatch table filled from storage
+static bool s_map_mismatch = false;   // A registered handle differed from the stored map
 
 // Forward declarations
 static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param);
 static void handle_char_read(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param);
 static void handle_char_write(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param);
+static void handle_exec_write(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param);
 static ble_char_handle_t *find_char_by_handle(uint16_t handle);
 static ble_char_handle_t *find_char_by_descr_handle(uint16_t handle);
+static ble_char_handle_t *find_char_by_cccd_handle(uint16_t handle);
+
+/**
+ * @brief Characteristic properties derived from the handlers
+ */
+static esp_gatt_char_prop_t char_properties(const ble_characteristic_t *ch)
+{
+  esp_gatt_char_prop_t props = 0;
+  if (ble_char_is_readable(ch))
+    props |= ESP_GATT_CHAR_PROP_BIT_READ;
+  if (ble_char_is_writable(ch))
+    props |= ESP_GATT_CHAR_PROP_BIT_WRITE;
+  // High-rate controls and data streams need no round trip per write
+  if (ble_char_is_writable(ch) && (ch->coalesce != NULL || (ch->flags & BLE_CHAR_FLAG_WRITE_NO_RSP)))
+    props |= ESP_GATT_CHAR_PROP_BIT_WRITE_NR;
+  if (ble_char_is_notifiable(ch))
+    props |= ESP_GATT_CHAR_PROP_BIT_NOTIFY;
+  return props;
+}
+
+/**
+ * @brief Descriptors (DESCR_*) a characteristic gets
+ */
+static uint8_t char_descriptors(const ble_characteristic_t *ch)
+{
+  uint8_t descrs = 0;
+  if (ch->description != NULL && ch->description[0] != '\0')
+    descrs |= DESCR_USER_DESCRIPTION;
+  if (ble_char_is_notifiable(ch))
+    descrs |= DESCR_CCCD;
+  return descrs;
+}
+
+/**
+ * @brief Read permission required by the security mode
+ */
+static esp_gatt_perm_t read_permission(void)
+{
+  if (ble_sec_requires_mitm())
+    return ESP_GATT_PERM_READ_ENC_MITM;
+  return ble_sec_is_enabled() ? ESP_GATT_PERM_READ_ENCRYPTED : ESP_GATT_PERM_READ;
+}
+
+/**
+ * @brief Write permission required by the security mode
+ */
+static esp_gatt_perm_t write_permission(void)
+{
+  if (ble_sec_requires_mitm())
+    return ESP_GATT_PERM_WRITE_ENC_MITM;
+  return ble_sec_is_enabled() ? ESP_GATT_PERM_WRITE_ENCRYPTED : ESP_GATT_PERM_WRITE;
+}
+
+/**
+ * @brief Characteristic permissions derived from the handlers and the security mode
+ */
+static esp_gatt_perm_t char_permissions(const ble_characteristic_t *ch)
+{
+  esp_gatt_perm_t perms = 0;
+  if (ble_char_is_readable(ch))
+    perms |= read_permission();
+  if (ble_char_is_writable(ch))
+    perms |= write_permission();
+  return perms;
+}
+
+/**
+ * @brief Register the characteristic at the given index (completes with ESP_GATTS_ADD_CHAR_EVT)
+ */
+static void add_characteristic(size_t index)
+{
+  ble_characteristic_t *ch = &s_characteristics[index];
+
+  esp_bt_uuid_t char_uuid = {
+    .len = ESP_UUID_LEN_16,
+    .uuid.uuid16 = ch->uuid,
+  };
+
+  esp_err_t ret =
+    esp_ble_gatts_add_char(s_service_handle, &char_uuid, char_permissions(ch), char_properties(ch), NULL, NULL);
+  if (ret != ESP_OK)
+    ESP_LOGE(GATTS_TAG, "Add char failed: %s", esp_err_to_name(ret));
+  else
+    ESP_LOGI(GATTS_TAG, "Adding characteristic '%s' (UUID: 0x%04X)", ch->name, ch->uuid);
+}
+
+/**
+ * @brief FNV-1a over a buffer, continuing from hash
+ */
+static uint32_t fnv1a(uint32_t hash, const void *data, size_t len)
+{
+  const uint8_t *bytes = data;
+  for (size_t i = 0; i < len; i++)
+  {
+    hash ^= bytes[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * @brief Hash everything that influences the attribute layout
+ */
+static uint32_t config_hash(void)
+{
+  uint32_t hash = 2166136261u;
+  uint8_t version = HANDLE_MAP_VERSION;
+  uint8_t handles_per_char = HANDLES_PER_CHAR;
+
+  hash = fnv1a(hash, &version, sizeof(version));
+  hash = fnv1a(hash, &handles_per_char, sizeof(handles_per_char));
+  hash = fnv1a(hash, &s_service_uuid, sizeof(s_service_uuid));
+  hash = fnv1a(hash, &s_char_count, sizeof(s_char_count));
+
+  for (size_t i = 0; i < s_char_count; i++)
+  {
+    const ble_characteristic_t *ch = &s_characteristics[i];
+    esp_gatt_char_prop_t props = char_properties(ch);
+    esp_gatt_perm_t perms = char_permissions(ch);
+    uint8_t descrs = char_descriptors(ch);
+
+    hash = fnv1a(hash, &ch->uuid, sizeof(ch->uuid));
+    hash = fnv1a(hash, &props, sizeof(props));
+    hash = fnv1a(hash, &perms, sizeof(perms));
+    hash = fnv1a(hash, &descrs, sizeof(descrs));
+  }
+
+  return hash;
+}
+
+/**
+ * @brief Hash of the layout and of the handles in the dispatch table, what a client's attribute cache depends on
+ */
+static uint32_t db_hash(void)
+{
+  uint32_t hash = fnv1a(s_config_hash, &s_service_handle, sizeof(s_service_handle));
+
+  for (size_t i = 0; i < s_char_count; i++)
+  {
+    hash = fnv1a(hash, &s_char_handles[i].char_handle, sizeof(s_char_handles[i].char_handle));
+    hash = fnv1a(hash, &s_char_handles[i].descr_handle, sizeof(s_char_handles[i].descr_handle));
+    hash = fnv1a(hash, &s_char_handles[i].cccd_handle, sizeof(s_char_handles[i].cccd_handle));
+  }
+  return hash;
+}
+
+/**
+ * @brief Fill the dispatch table from the stored handle map if it matches the configuration
+ */
+static void load_handle_map(void)
+{
+  ble_gatts_handle_map_t map;
+  size_t len = sizeof(map);
+
+  s_map_preloaded = false;
+  s_map_mismatch = false;
+
+  if (ble_store_get(HANDLE_MAP_KEY, &map, &len) != ESP_OK || len != sizeof(map))
+    return;
+
+  if (map.version != HANDLE_MAP_VERSION || map.config_hash != s_config_hash || map.char_count != s_char_count)
+  {
+    ESP_LOGI(GATTS_TAG, "Configuration changed, stored handle map ignored");
+    return;
+  }
+
+  for (size_t i = 0; i < s_char_count; i++)
+  {
+    s_char_handles[i].char_handle = map.chars[i].char_handle;
+    s_char_handles[i].descr_handle = map.chars[i].descr_handle;
+    s_char_handles[i].cccd_handle = map.chars[i].cccd_handle;
+    s_char_handles[i].def = &s_characteristics[i];
+  }
+  s_service_handle = map.service_handle;
+  s_map_preloaded = true;
+
+  ESP_LOGI(GATTS_TAG, "Handle map restored (service handle %d), verifying during registration", map.service_handle);
+}
+
+/**
+ * @brief Persist the handle map of the current registration
+ */
+static void save_handle_map(void)
+{
+  ble_gatts_handle_map_t map = {
+    .version = HANDLE_MAP_VERSION,
+    .char_count = s_char_count,
+    .service_handle = s_service_handle,
+    .config_hash = s_config_hash,
+  };
+
+  for (size_t i = 0; i < s_char_count; i++)
+  {
+    map.chars[i].char_handle = s_char_handles[i].char_handle;
+    map.chars[i].descr_handle = s_char_handles[i].descr_handle;
+    map.chars[i].cccd_handle = s_char_handles[i].cccd_handle;
+  }
+
+  if (ble_store_set(HANDLE_MAP_KEY, &map, sizeof(map)) == ESP_OK && ble_store_commit() == ESP_OK)
+    ESP_LOGI(GATTS_TAG, "Handle map saved");
+  else
+    ESP_LOGW(GATTS_TAG, "Handle map could not be saved");
+}
+
+/**
+ * @brief Store a handle reported by the stack, noting any difference from the restored map
+ */
+static void set_handle(uint16_t *slot, uint16_t handle)
+{
+  if (s_map_preloaded && *slot != handle)
+    s_map_mismatch = true;
+  *slot = handle;
+}
+
+/**
+ * @brief All characteristics are registered: verify or save the handle map
+ */
+static void on_chars_registered(void)
+{
+  ESP_LOGI(GATTS_TAG, "All %d characteristics registered", s_registered_chars);
+  ble_boot_mark(BLE_BOOT_STAGE_CHARS_ADDED);
+
+  // The handles are final now; bonded clients are checked against them from here on
+  ble_sec_set_db_hash(db_hash());
+
+  if (s_map_preloaded && !s_map_mismatch)
+  {
+    ESP_LOGI(GATTS_TAG, "Handle map verified");
+    return;
+  }
+
+  if (s_map_mismatch)
+    ESP_LOGW(GATTS_TAG, "Stack assigned different handles than the stored map, bonded clients will rediscover");
+
+  save_handle_map();
+}
+
+/**
+ * @brief Add the next pending descriptor of the current characteristic, or move to the next characteristic
+ *
+ * Each step completes with ESP_GATTS_ADD_CHAR_DESCR_EVT or ESP_GATTS_ADD_CHAR_EVT, which call this again.
+ */
+static void register_next(void)
+{
+  ble_characteristic_t *ch = &s_characteristics[s_registered_chars];
+
+  if (s_pending_descrs & DESCR_USER_DESCRIPTION)
+  {
+    s_pending_descrs &= ~DESCR_USER_DESCRIPTION;
+
+    esp_bt_uuid_t descr_uuid = {
+      .len = ESP_UUID_LEN_16,
+      .uuid.uuid16 = ESP_GATT_UUID_CHAR_DESCRIPTION,  // 0x2901 - Characteristic User Description
+    };
+
+    esp_attr_value_t descr_value = {
+      .attr_max_len = strlen(ch->description),
+      .attr_len = strlen(ch->description),
+      .attr_value = (uint8_t *)ch->description,
+    };
+
+    esp_err_t ret = esp_ble_gatts_add_char_descr(s_service_handle, &descr_uuid, ESP_GATT_PERM_READ, &descr_value, NULL);
+    if (ret != ESP_OK)
+      ESP_LOGE(GATTS_TAG, "Add char descr failed: %s", esp_err_to_name(ret));
+    else
+      ESP_LOGI(GATTS_TAG, "Adding descriptor for '%s': \"%s\"", ch->name, ch->description);
+    return;
+  }
+
+  if (s_pending_descrs & DESCR_CCCD)
+  {
+    s_pending_descrs &= ~DESCR_CCCD;
+
+    esp_bt_uuid_t descr_uuid = {
+      .len = ESP_UUID_LEN_16,
+      .uuid.uuid16 = ESP_GATT_UUID_CHAR_CLIENT_CONFIG,  // 0x2902 - Client Characteristic Configuration
+    };
+
+    // Subscriptions follow the value's security requirement
+    esp_gatt_perm_t perms = read_permission() | write_permission();
+
+    esp_err_t ret = esp_ble_gatts_add_char_descr(s_service_handle, &descr_uuid, perms, NULL, NULL);
+    if (ret != ESP_OK)
+      ESP_LOGE(GATTS_TAG, "Add CCCD failed: %s", esp_err_to_name(ret));
+    return;
+  }
+
+  s_registered_chars++;
+
+  // Add next characteristic if available
+  if (s_registered_chars < s_char_count)
+    add_characteristic(s_registered_chars);
+  else
+    on_chars_registered();
+}
 
 /**
  * @brief Initialize GATTS with user-defined characteristics
@@ -84,9 +441,16 @@ esp_err_t ble_gatts_init(ble_characteristic_t *chars, size_t count, uint16_t ser
   s_char_count = count;
   s_service_uuid = service_uuid;
   s_registered_chars = 0;
+  s_service_handle = 0;
 
   memset(s_char_handles, 0, sizeof(s_char_handles));
 
+  s_config_hash = config_hash();
+  load_handle_map();
+  // Until registration completes: the handles expected from the stored map, or (no usable map) the layout
+  // alone, which matches no stored client hash
+  ble_sec_set_db_hash(s_map_preloaded ? db_hash() : s_config_hash);
+
   esp_err_t ret = esp_ble_gatts_register_callback(gatts_event_handler);
   if (ret != ESP_OK)
   {
@@ -131,6 +495,18 @@ esp_err_t ble_gatts_deinit()
   return ESP_OK;
 }
 
+/**
+ * @brief Report the connect -> first ATT request latency once per connection
+ */
+static void record_first_request(void)
+{
+  if (s_connect_us == 0)
+    return;
+
+  ble_sec_record_first_request(esp_timer_get_time() - s_connect_us);
+  s_connect_us = 0;
+}
+
 /**
  * @brief Main GATTS event handler
  */
@@ -147,6 +523,7 @@ static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_
       }
 
       s_gatts_if = gatts_if;
+      ble_boot_mark(BLE_BOOT_STAGE_APP_REGISTERED);
       ESP_LOGI(GATTS_TAG, "App registered, gatts_if %d", gatts_if);
 
       // Create the primary service
@@ -176,7 +553,8 @@ static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_
         return;
       }
 
-      s_service_handle = param->create.service_handle;
+      set_handle(&s_service_handle, param->create.service_handle);
+      ble_boot_mark(BLE_BOOT_STAGE_SERVICE_CREATED);
       ESP_LOGI(GATTS_TAG, "Service created, handle %d", s_service_handle);
 
       // Start the service
@@ -184,34 +562,7 @@ static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_
 
       // Add first characteristic
       if (s_char_count > 0)
-      {
-        ble_characteristic_t *ch = &s_characteristics[0];
-
-        // Determine properties based on handlers
-        esp_gatt_char_prop_t props = 0;
-        if (ch->read != NULL)
-          props |= ESP_GATT_CHAR_PROP_BIT_READ;
-        if (ch->write != NULL)
-          props |= ESP_GATT_CHAR_PROP_BIT_WRITE;
-
-        // Determine permissions
-        esp_gatt_perm_t perms = 0;
-        if (ch->read != NULL)
-          perms |= ESP_GATT_PERM_READ;
-        if (ch->write != NULL)
-          perms |= ESP_GATT_PERM_WRITE;
-
-        esp_bt_uuid_t char_uuid = {
-          .len = ESP_UUID_LEN_16,
-          .uuid.uuid16 = ch->uuid,
-        };
-
-        esp_err_t ret = esp_ble_gatts_add_char(s_service_handle, &char_uuid, perms, props, NULL, NULL);
-        if (ret != ESP_OK)
-          ESP_LOGE(GATTS_TAG, "Add char failed: %s", esp_err_to_name(ret));
-        else
-          ESP_LOGI(GATTS_TAG, "Adding characteristic '%s' (UUID: 0x%04X)", ch->name, ch->uuid);
-      }
+        add_characteristic(0);
       break;
     }
 
@@ -226,77 +577,17 @@ static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_
       // Store handle for this characteristic
       if (s_registered_chars < s_char_count)
       {
-        s_char_handles[s_registered_chars].char_handle = param->add_char.attr_handle;
+        set_handle(&s_char_handles[s_registered_chars].char_handle, param->add_char.attr_handle);
         s_char_handles[s_registered_chars].def = &s_characteristics[s_registered_chars];
+        ble_boot_mark_char(s_registered_chars);
 
         ESP_LOGI(GATTS_TAG,
                  "Characteristic added: '%s' handle=%d",
                  s_characteristics[s_registered_chars].name,
                  param->add_char.attr_handle);
 
-        // Add User Description descriptor if description is provided
-        ble_characteristic_t *current_ch = &s_characteristics[s_registered_chars];
-        if (current_ch->description != NULL && current_ch->description[0] != '\0')
-        {
-          s_pending_descr_char = s_registered_chars;
-
-          esp_bt_uuid_t descr_uuid = {
-            .len = ESP_UUID_LEN_16,
-            .uuid.uuid16 = ESP_GATT_UUID_CHAR_DESCRIPTION,  // 0x2901 - Characteristic User Description
-          };
-
-          esp_attr_value_t descr_value = {
-            .attr_max_len = strlen(current_ch->description),
-            .attr_len = strlen(current_ch->description),
-            .attr_value = (uint8_t *)current_ch->description,
-          };
-
-          esp_err_t ret =
-            esp_ble_gatts_add_char_descr(s_service_handle, &descr_uuid, ESP_GATT_PERM_READ, &descr_value, NULL);
-          if (ret != ESP_OK)
-          {
-            ESP_LOGE(GATTS_TAG, "Add char descr failed: %s", esp_err_to_name(ret));
-          }
-          else
-          {
-            ESP_LOGI(GATTS_TAG, "Adding descriptor for '%s': \"%s\"", current_ch->name, current_ch->description);
-          }
-        }
-        else
-        {
-          // No descriptor, proceed to register characteristic and move to next
-          s_registered_chars++;
-
-          // Add next characteristic if available
-          if (s_registered_chars < s_char_count)
-          {
-            ble_characteristic_t *ch = &s_characteristics[s_registered_chars];
-
-            esp_gatt_char_prop_t props = 0;
-            if (ch->read != NULL)
-              props |= ESP_GATT_CHAR_PROP_BIT_READ;
-            if (ch->write != NULL)
-              props |= ESP_GATT_CHAR_PROP_BIT_WRITE;
-
-            esp_gatt_perm_t perms = 0;
-            if (ch->read != NULL)
-              perms |= ESP_GATT_PERM_READ;
-            if (ch->write != NULL)
-              perms |= ESP_GATT_PERM_WRITE;
-
-            esp_bt_uuid_t char_uuid = {
-              .len = ESP_UUID_LEN_16,
-              .uuid.uuid16 = ch->uuid,
-            };
-
-            esp_ble_gatts_add_char(s_service_handle, &char_uuid, perms, props, NULL, NULL);
-            ESP_LOGI(GATTS_TAG, "Adding characteristic '%s' (UUID: 0x%04X)", ch->name, ch->uuid);
-          }
-          else
-          {
-            ESP_LOGI(GATTS_TAG, "All %d characteristics registered", s_registered_chars);
-          }
-        }
+        s_pending_descrs = char_descriptors(&s_characteristics[s_registered_chars]);
+        register_next();
       }
       break;
     }
@@ -310,54 +601,50 @@ static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_
       }
 
       // Store descriptor handle
-      if (s_pending_descr_char < s_char_count)
+      if (s_registered_chars < s_char_count)
       {
-        s_char_handles[s_pending_descr_char].descr_handle = param->add_char_descr.attr_handle;
+        ble_char_handle_t *current = &s_char_handles[s_registered_chars];
+        if (param->add_char_descr.descr_uuid.uuid.uuid16 == ESP_GATT_UUID_CHAR_CLIENT_CONFIG)
+          set_handle(&current->cccd_handle, param->add_char_descr.attr_handle);
+        else
+          set_handle(&current->descr_handle, param->add_char_descr.attr_handle);
 
         ESP_LOGI(GATTS_TAG,
-                 "Descriptor added for '%s' handle=%d",
-                 s_characteristics[s_pending_descr_char].name,
+                 "Descriptor 0x%04X added for '%s' handle=%d",
+                 param->add_char_descr.descr_uuid.uuid.uuid16,
+                 s_characteristics[s_registered_chars].name,
                  param->add_char_descr.attr_handle);
 
-        s_registered_chars++;
-
-        // Add next characteristic if available
-        if (s_registered_chars < s_char_count)
-        {
-          ble_characteristic_t *ch = &s_characteristics[s_registered_chars];
-
-          esp_gatt_char_prop_t props = 0;
-          if (ch->read != NULL)
-            props |= ESP_GATT_CHAR_PROP_BIT_READ;
-          if (ch->write != NULL)
-            props |= ESP_GATT_CHAR_PROP_BIT_WRITE;
-
-          esp_gatt_perm_t perms = 0;
-          if (ch->read != NULL)
-            perms |= ESP_GATT_PERM_READ;
-          if (ch->write != NULL)
-            perms |= ESP_GATT_PERM_WRITE;
-
-          esp_bt_uuid_t char_uuid = {
-            .len = ESP_UUID_LEN_16,
-            .uuid.uuid16 = ch->uuid,
-          };
-
-          esp_ble_gatts_add_char(s_service_handle, &char_uuid, perms, props, NULL, NULL);
-          ESP_LOGI(GATTS_TAG, "Adding characteristic '%s' (UUID: 0x%04X)", ch->name, ch->uuid);
-        }
-        else
-        {
-          ESP_LOGI(GATTS_TAG, "All %d characteristics registered", s_registered_chars);
-        }
+        register_next();
       }
       break;
     }
 
     case ESP_GATTS_CONNECT_EVT:
     {
+      if (param->connect.link_role == 0)
+        break;  // Link we opened as central to a peer, owned by ble-central
+
+      if (s_suspended)
+      {
+        // Advertising was still live when the server was suspended
+        ESP_LOGI(GATTS_TAG, "Server suspended, dropping connection " ESP_BD_ADDR_STR,
+                 ESP_BD_ADDR_HEX(param->connect.remote_bda));
+        esp_ble_gatts_close(gatts_if, param->connect.conn_id);
+        break;
+      }
+
       s_conn_id = param->connect.conn_id;
       s_is_connected = true;
+      s_connect_us = esp_timer_get_time();
+
+      // Resolve the client to its identity so a private address is remembered correctly
+      uint8_t identity[ESP_BD_ADDR_LEN];
+      uint8_t identity_type;
+      ble_sec_on_connect(param->connect.remote_bda, param->connect.ble_addr_type, identity, &identity_type);
+      memcpy(s_client_bda, param->connect.remote_bda, ESP_BD_ADDR_LEN);
+      memcpy(s_client_identity, identity, ESP_BD_ADDR_LEN);
+      ble_gap_on_connect(identity, identity_type);
 
       ESP_LOGI(GATTS_TAG,
                "Client connected, conn_id=%d, remote=" ESP_BD_ADDR_STR,
@@ -371,36 +658,78 @@ static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_
 
     case ESP_GATTS_DISCONNECT_EVT:
     {
+      if (!s_is_connected || param->disconnect.conn_id != s_conn_id)
+        break;  // Connection refused while suspended (GAP never saw it), or a central peer link
+
       s_is_connected = false;
+      s_mtu = DEFAULT_MTU_SIZE;
+      s_read_snapshot.handle = 0;
+      s_congested = false;
+      ble_notify_reset();
+      ble_txn_cancel();
+      ble_xfer_reset();
+      ble_channel_reset();
+      ble_rpc_reset();
+      ble_serial_reset();
+      ble_history_reset();
+      ble_compress_reset();
 
       ESP_LOGI(GATTS_TAG, "Client disconnected, reason=0x%x", param->disconnect.reason);
 
-      // Restart advertising
-      ble_gap_start_adv();
+      // Restart advertising (payloads are resident, so this is a single controller command)
+      ble_gap_on_disconnect();
       break;
     }
 
     case ESP_GATTS_READ_EVT:
     {
+      record_first_request();
       handle_char_read(gatts_if, param);
       break;
     }
 
     case ESP_GATTS_WRITE_EVT:
     {
+      record_first_request();
       handle_char_write(gatts_if, param);
       break;
     }
 
+    case ESP_GATTS_EXEC_WRITE_EVT:
+    {
+      handle_exec_write(gatts_if, param);
+      break;
+    }
+
     case ESP_GATTS_MTU_EVT:
     {
+      if (!s_is_connected || param->mtu.conn_id != s_conn_id)
+        break;  // A central peer link, possibly reusing the conn_id of a client that left
       ESP_LOGI(GATTS_TAG, "MTU updated to %d", param->mtu.mtu);
+      s_mtu = param->mtu.mtu;
+      break;
+    }
+
+    case ESP_GATTS_CONGEST_EVT:
+    {
+      if (!s_is_connected || param->congest.conn_id != s_conn_id)
+        break;  // A central peer link, possibly reusing the conn_id of a client that left
+      s_congested = param->congest.congested;
+      ESP_LOGD(GATTS_TAG, "Link %s", s_congested ? "congested" : "uncongested");
+      break;
+    }
+
+    case ESP_GATTS_SEND_SERVICE_CHANGE_EVT:
+    {
+      ESP_LOGI(GATTS_TAG, "Service Changed indicated, status %d", param->service_change.status);
       break;
     }
 
     case ESP_GATTS_START_EVT:
     {
       ESP_LOGI(GATTS_TAG, "Service started, status %d", param->start.status);
+      if (param->start.status == ESP_GATT_OK)
+        ble_boot_mark(BLE_BOOT_STAGE_SERVICE_STARTED);
       break;
     }
 
@@ -417,6 +746,19 @@ static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_
  */
 static void handle_char_read(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
 {
+  // Client Characteristic Configuration: report the subscription
+  ble_char_handle_t *ch_cccd = find_char_by_cccd_handle(param->read.handle);
+  if (ch_cccd != NULL)
+  {
+    esp_gatt_rsp_t rsp = {0};
+    rsp.attr_value.handle = param->read.handle;
+    rsp.attr_value.len = 2;
+    rsp.attr_value.value[0] = ble_notify_is_subscribed(ch_cccd - s_char_handles) ? 0x01 : 0x00;
+
+    esp_ble_gatts_send_response(gatts_if, param->read.conn_id, param->read.trans_id, ESP_GATT_OK, &rsp);
+    return;
+  }
+
   // First check if this is a descriptor read
   ble_char_handle_t *ch_descr = find_char_by_descr_handle(param->read.handle);
   if (ch_descr != NULL)
@@ -474,12 +816,9 @@ static void handle_char_read(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *p
     return;
   }
 
-  ESP_LOGI(GATTS_TAG, "Read request for '%s'", ch->def->name);
-
-  esp_gatt_rsp_t rsp = {0};
-  rsp.attr_value.handle = param->read.handle;
+  ESP_LOGI(GATTS_TAG, "Read request for '%s' (offset=%d)", ch->def->name, param->read.offset);
 
-  if (ch->def->read == NULL)
+  if (!ble_char_is_readable(ch->def))
   {
     // Write-only characteristic
     ESP_LOGW(GATTS_TAG, "Characteristic '%s' is write-only", ch->def->name);
@@ -487,29 +826,112 @@ static void handle_char_read(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *p
     return;
   }
 
-  // Call user's read handler
-  int bytes_read = ch->def->read(rsp.attr_value.value, sizeof(rsp.attr_value.value));
+  uint16_t offset = param->read.offset;
+
+  // A fresh read takes a new snapshot; Read Blob continues from the existing one
+  if (offset == 0 || s_read_snapshot.handle != param->read.handle)
+  {
+    // Bound memory is copied straight into the snapshot, otherwise the user's read handler fills it.
+    // Compressed values are read into the encoder window and only the encoded stream lands here.
+    int bytes_read;
+    if ((ch->def->flags & BLE_CHAR_FLAG_COMPRESS) && ble_compress_is_enabled())
+      bytes_read =
+        ble_compress_read(BLE_COMPRESS_CTX_BT, ch->def, s_read_snapshot.value, sizeof(s_read_snapshot.value));
+    else
+      bytes_read = ble_char_read_value(ch->def, s_read_snapshot.value, sizeof(s_read_snapshot.value));
+    if (bytes_read < 0)
+    {
+      ESP_LOGE(GATTS_TAG, "Read handler error for '%s'", ch->def->name);
+      s_read_snapshot.handle = 0;
+      esp_ble_gatts_send_response(gatts_if, param->read.conn_id, param->read.trans_id, ESP_GATT_ERROR, NULL);
+      return;
+    }
+
+    s_read_snapshot.handle = param->read.handle;
+    s_read_snapshot.len = bytes_read;
+  }
 
-  if (bytes_read < 0)
+  if (offset > s_read_snapshot.len)
   {
-    ESP_LOGE(GATTS_TAG, "Read handler error for '%s'", ch->def->name);
-    esp_ble_gatts_send_response(gatts_if, param->read.conn_id, param->read.trans_id, ESP_GATT_ERROR, NULL);
+    esp_ble_gatts_send_response(gatts_if, param->read.conn_id, param->read.trans_id, ESP_GATT_INVALID_OFFSET, NULL);
     return;
   }
 
-  rsp.attr_value.len = bytes_read;
+  esp_gatt_rsp_t rsp = {0};
+  rsp.attr_value.handle = param->read.handle;
+  rsp.attr_value.offset = offset;
+  rsp.attr_value.len = s_read_snapshot.len - offset;
+  memcpy(rsp.attr_value.value, s_read_snapshot.value + offset, rsp.attr_value.len);
 
-  ESP_LOGI(GATTS_TAG, "Sending %d bytes for '%s'", bytes_read, ch->def->name);
-  ESP_LOG_BUFFER_HEX_LEVEL(GATTS_TAG, rsp.attr_value.value, bytes_read, ESP_LOG_DEBUG);
+  ESP_LOGI(GATTS_TAG, "Sending %d bytes for '%s'", rsp.attr_value.len, ch->def->name);
+  ESP_LOG_BUFFER_HEX_LEVEL(GATTS_TAG, rsp.attr_value.value, rsp.attr_value.len, ESP_LOG_DEBUG);
 
   esp_ble_gatts_send_response(gatts_if, param->read.conn_id, param->read.trans_id, ESP_GATT_OK, &rsp);
 }
 
+/**
+ * @brief Map a write result to its ATT status, logging refusals
+ */
+static esp_gatt_status_t write_status(const char *name, ble_char_error_t result)
+{
+  switch (result)
+  {
+    case BLE_CHAR_OK:
+      return ESP_GATT_OK;
+    case BLE_CHAR_ERR_SIZE:
+      ESP_LOGW(GATTS_TAG, "Write to '%s' failed: invalid size", name);
+      return ESP_GATT_INVALID_ATTR_LEN;
+    case BLE_CHAR_ERR_VALUE:
+      ESP_LOGW(GATTS_TAG, "Write to '%s' failed: value out of range", name);
+      return ESP_GATT_OUT_OF_RANGE;
+    case BLE_CHAR_ERR_READONLY:
+      ESP_LOGW(GATTS_TAG, "Write to '%s' failed: read-only", name);
+      return ESP_GATT_WRITE_NOT_PERMIT;
+    case BLE_CHAR_ERR_BUSY:
+      ESP_LOGW(GATTS_TAG, "Write to '%s' failed: busy", name);
+      return ESP_GATT_BUSY;
+    default:
+      ESP_LOGE(GATTS_TAG, "Write to '%s' failed: unknown error %d", name, result);
+      return ESP_GATT_ERROR;
+  }
+}
+
+/**
+ * @brief Apply a client value: validate and copy into bound memory, or call the user's write
+ * handler. Coalescing characteristics only validate here and apply the newest value later.
+ */
+static ble_char_error_t apply_write(size_t index, const uint8_t *value, size_t len)
+{
+  const ble_characteristic_t *def = &s_characteristics[index];
+
+  ble_char_error_t result =
+    (def->coalesce != NULL) ? ble_coalesce_write(index, value, len) : ble_char_write_value(def, value, len);
+
+  if (result == BLE_CHAR_OK && (def->flags & BLE_CHAR_FLAG_PERSISTENT))
+    ble_persist_store(index, value, len);
+  return result;
+}
+
 /**
  * @brief Handle characteristic write request
  */
 static void handle_char_write(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
 {
+  // Client Characteristic Configuration: bit 0 enables notifications
+  ble_char_handle_t *ch_cccd = find_char_by_cccd_handle(param->write.handle);
+  if (ch_cccd != NULL)
+  {
+    esp_gatt_status_t status = ESP_GATT_OK;
+    if (param->write.len != 2)
+      status = ESP_GATT_INVALID_ATTR_LEN;
+    else
+      ble_notify_set_subscribed(ch_cccd - s_char_handles, (param->write.value[0] & 0x01) != 0);
+
+    if (param->write.need_rsp)
+      esp_ble_gatts_send_response(gatts_if, param->write.conn_id, param->write.trans_id, status, NULL);
+    return;
+  }
+
   ble_char_handle_t *ch = find_char_by_handle(param->write.handle);
 
   if (ch == NULL)
@@ -519,10 +941,11 @@ static void handle_char_write(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *
     return;
   }
 
-  ESP_LOGI(GATTS_TAG, "Write request for '%s', len=%d", ch->def->name, param->write.len);
+  // Debug level: bulk data arrives as one write per block
+  ESP_LOGD(GATTS_TAG, "Write request for '%s', len=%d", ch->def->name, param->write.len);
   ESP_LOG_BUFFER_HEX_LEVEL(GATTS_TAG, param->write.value, param->write.len, ESP_LOG_DEBUG);
 
-  if (ch->def->write == NULL)
+  if (!ble_char_is_writable(ch->def))
   {
     // Read-only characteristic
     ESP_LOGW(GATTS_TAG, "Characteristic '%s' is read-only", ch->def->name);
@@ -530,39 +953,37 @@ static void handle_char_write(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *
     return;
   }
 
-  // Call user's write handler
-  ble_char_error_t result = ch->def->write(param->write.value, param->write.len);
+  size_t index = ch - s_char_handles;
+  ble_char_error_t result;
 
-  // Map error code to GATT status
-  esp_gatt_status_t status;
-  switch (result)
+  // Reliable write: only stage the fragment, the Execute Write commits the whole transaction
+  if (param->write.is_prep)
   {
-    case BLE_CHAR_OK:
-      status = ESP_GATT_OK;
-      ESP_LOGI(GATTS_TAG, "Write to '%s' successful", ch->def->name);
-      break;
-    case BLE_CHAR_ERR_SIZE:
-      status = ESP_GATT_INVALID_ATTR_LEN;
-      ESP_LOGW(GATTS_TAG, "Write to '%s' failed: invalid size", ch->def->name);
-      break;
-    case BLE_CHAR_ERR_VALUE:
-      status = ESP_GATT_OUT_OF_RANGE;
-      ESP_LOGW(GATTS_TAG, "Write to '%s' failed: value out of range", ch->def->name);
-      break;
-    case BLE_CHAR_ERR_READONLY:
-      status = ESP_GATT_WRITE_NOT_PERMIT;
-      ESP_LOGW(GATTS_TAG, "Write to '%s' failed: read-only", ch->def->name);
-      break;
-    case BLE_CHAR_ERR_BUSY:
-      status = ESP_GATT_BUSY;
-      ESP_LOGW(GATTS_TAG, "Write to '%s' failed: busy", ch->def->name);
-      break;
-    default:
-      status = ESP_GATT_ERROR;
-      ESP_LOGE(GATTS_TAG, "Write to '%s' failed: unknown error %d", ch->def->name, result);
-      break;
+    result = ble_txn_prepare(index, param->write.offset, param->write.value, param->write.len);
+
+    esp_gatt_status_t status;
+    if (result == BLE_CHAR_ERR_SIZE && param->write.offset > ch->def->size)
+      status = ESP_GATT_INVALID_OFFSET;
+    else
+      status = write_status(ch->def->name, result);
+
+    // The client checks the echoed fragment before executing
+    esp_gatt_rsp_t rsp = {0};
+    rsp.attr_value.handle = param->write.handle;
+    rsp.attr_value.offset = param->write.offset;
+    rsp.attr_value.len = param->write.len;
+    rsp.attr_value.auth_req = ESP_GATT_AUTH_REQ_NONE;
+    memcpy(rsp.attr_value.value, param->write.value, param->write.len);
+    esp_ble_gatts_send_response(gatts_if, param->write.conn_id, param->write.trans_id, status,
+                                (status == ESP_GATT_OK) ? &rsp : NULL);
+    return;
   }
 
+  result = apply_write(index, param->write.value, param->write.len);
+  esp_gatt_status_t status = write_status(ch->def->name, result);
+  if (result == BLE_CHAR_OK)
+    ESP_LOGD(GATTS_TAG, "Write to '%s' successful", ch->def->name);
+
   // Send response if needed
   if (param->write.need_rsp)
   {
@@ -570,6 +991,28 @@ static void handle_char_write(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *
   }
 }
 
+/**
+ * @brief Commit or discard the staged reliable write transaction
+ */
+static void handle_exec_write(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
+{
+  esp_gatt_status_t status = ESP_GATT_OK;
+
+  if (param->exec_write.exec_write_flag == ESP_GATT_PREP_WRITE_EXEC)
+  {
+    size_t failed_index;
+    ble_char_error_t result = ble_txn_execute(apply_write, &failed_index);
+    status = write_status((failed_index < s_char_count) ? s_characteristics[failed_index].name : "transaction", result);
+  }
+  else
+  {
+    ESP_LOGI(GATTS_TAG, "Reliable write cancelled by the client");
+    ble_txn_cancel();
+  }
+
+  esp_ble_gatts_send_response(gatts_if, param->exec_write.conn_id, param->exec_write.trans_id, status, NULL);
+}
+
 /**
  * @brief Find characteristic by attribute handle
  */
@@ -600,6 +1043,80 @@ static ble_char_handle_t *find_char_by_descr_handle(uint16_t handle)
   return NULL;
 }
 
+/**
+ * @brief Refuse new connections and drop the connected client, if any
+ */
+void ble_gatts_suspend(void)
+{
+  s_suspended = true;
+
+  if (s_is_connected && s_gatts_if != ESP_GATT_IF_NONE)
+  {
+    esp_err_t ret = esp_ble_gatts_close(s_gatts_if, s_conn_id);
+    if (ret != ESP_OK)
+      ESP_LOGW(GATTS_TAG, "Closing connection failed: %s", esp_err_to_name(ret));
+  }
+}
+
+/**
+ * @brief Accept connections again
+ */
+void ble_gatts_resume(void)
+{
+  s_suspended = false;
+}
+
+/**
+ * @brief Find characteristic by CCCD handle
+ */
+static ble_char_handle_t *find_char_by_cccd_handle(uint16_t handle)
+{
+  for (size_t i = 0; i < s_char_count; i++)
+  {
+    if (s_char_handles[i].cccd_handle != 0 && s_char_handles[i].cccd_handle == handle)
+    {
+      return &s_char_handles[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Current ATT MTU of the connection
+ */
+uint16_t ble_gatts_get_mtu(void)
+{
+  return s_mtu;
+}
+
+/**
+ * @brief Send a notification for a characteristic to the connected client
+ */
+esp_err_t ble_gatts_notify(size_t index, const uint8_t *value, size_t len)
+{
+  if (!s_is_connected || s_congested || index >= s_char_count || s_char_handles[index].char_handle == 0)
+    return ESP_ERR_INVALID_STATE;
+
+  if (len > (size_t)(s_mtu - BLE_ATT_NOTIFY_HEADER))
+    len = s_mtu - BLE_ATT_NOTIFY_HEADER;
+
+  return esp_ble_gatts_send_indicate(s_gatts_if, s_conn_id, s_char_handles[index].char_handle, len, (uint8_t *)value,
+                                     false);
+}
+
+/**
+ * @brief Indicate Service Changed (whole database) to a client
+ */
+void ble_gatts_send_service_changed(const uint8_t *bda)
+{
+  if (s_gatts_if == ESP_GATT_IF_NONE)
+    return;
+
+  esp_err_t ret = esp_ble_gatts_send_service_change_indication(s_gatts_if, (uint8_t *)bda);
+  if (ret != ESP_OK)
+    ESP_LOGW(GATTS_TAG, "Service Changed indication failed: %s", esp_err_to_name(ret));
+}
+
 /**
  * @brief Check if a BLE client is currently connected
  */
@@ -607,3 +1124,12 @@ bool ble_gatts_is_connected(void)
 {
   return s_is_connected;
 }
+
+/**
+ * @brief Check if an address is the connected client's, by its connection or identity address
+ */
+bool ble_gatts_is_client(const uint8_t *bda)
+{
+  return s_is_connected &&
+         (memcmp(bda, s_client_bda, ESP_BD_ADDR_LEN) == 0 || memcmp(bda, s_client_identity, ESP_BD_ADDR_LEN) == 0);
+}
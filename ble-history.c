@@ -0,0 +1,531 @@
+/**
+ * @file ble-history.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Sample history - a characteristic value sampled into a RAM ring, downloaded by time range
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * A periodic timer reads the source characteristic into a ring of fixed-width
+ * samples. Sample n was taken at first_ms + n * period_ms (uptime), so the ring
+ * stores no timestamps; a period whose read failed still takes its seq and is
+ * only marked missing. All integers are little endian.
+ *
+ *   Read:   period_ms u32, uptime_ms u32, oldest_ms u32, newest_ms u32, samples u32, type u8
+ *   Write:  0x01 RANGE from_ms u32, to_ms u32   download the samples taken in [from_ms, to_ms]
+ *           0x02 STOP
+ *
+ * A download is a series of notifications, each packing as many samples as
+ * the MTU allows:
+ *
+ *   seq u32 of the first sample, count u8, first value, count - 1 deltas
+ *
+ * Values and deltas are zigzag varints, so a slowly moving signal costs about
+ * one byte per sample. Every notification starts from an absolute value and
+ * can be decoded on its own. A notification with count 0 ends the download;
+ * its seq is one past the last sample sent. Missing samples and samples
+ * overwritten before they were sent are skipped, which the client sees as a
+ * gap in seq.
+ *
+ * Times on the wire are the low 32 bits of the uptime in ms. They are widened
+ * to the 64-bit uptime nearest to now, so requests keep working after the
+ * 32-bit value wraps (49.7 days).
+ *
+ * Sampling and the download pump are both esp_timer callbacks, so they never
+ * run at the same time and the ring needs no lock. Requests arrive on the
+ * Bluetooth task and are only posted under the lock; the pump adopts them
+ * between notifications, so the download cursor is only touched by the pump.
+ */
+
+#include "ble-history.h"
+
+#include <esp_gatt_defs.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ble-char.h"
+#include "ble-gatts.h"
+
+#define HISTORY_TAG     "BLE_HISTORY"
+#define HISTORY_PUMP_US 5000  // Send retry period while a download is open
+#define HISTORY_INFO    21
+#define HISTORY_HEADER  5     // seq + count
+#define HISTORY_VARINT  5     // Longest zigzag varint of a 32-bit value or of a delta of two
+
+#define HISTORY_OP_RANGE 0x01
+#define HISTORY_OP_STOP  0x02
+
+static const ble_history_config_t *s_config = NULL;
+static const ble_characteristic_t *s_source = NULL;
+static size_t s_index = 0;
+static size_t s_width = 0;
+static uint8_t *s_ring = NULL;
+static uint32_t *s_valid = NULL;       // One bit per ring slot, clear if the read of that period failed
+static volatile uint32_t s_taken = 0;  // Sample periods so far, also the seq of the next one
+static int64_t s_first_ms = 0;         // Uptime of sample 0
+static esp_timer_handle_t s_sample_timer = NULL;
+static esp_timer_handle_t s_pump_timer = NULL;
+static portMUX_TYPE s_history_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Request posted to the pump, under s_history_lock
+typedef enum
+{
+  HISTORY_REQ_NONE = 0,
+  HISTORY_REQ_RANGE,
+  HISTORY_REQ_STOP,
+} history_request_t;
+
+static history_request_t s_request = HISTORY_REQ_NONE;
+static uint32_t s_request_first = 0;
+static uint32_t s_request_end = 0;
+
+// Download in progress, pump only
+static bool s_active = false;
+static uint32_t s_cursor = 0;  // Next seq to send
+static uint32_t s_end = 0;     // One past the last seq requested
+static int64_t s_start_us = 0;
+static uint32_t s_download_bytes = 0;
+static uint8_t s_packet[ESP_GATT_MAX_ATTR_LEN];  // Pump only
+
+static ble_history_stats_t s_stats = {0};
+
+static void put_u32(uint8_t *out, uint32_t value)
+{
+  for (size_t i = 0; i < 4; i++)
+    out[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint32_t get_u32(const uint8_t *in)
+{
+  return in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static size_t type_width(ble_value_type_t type)
+{
+  switch (type)
+  {
+    case BLE_VALUE_U8:
+    case BLE_VALUE_I8:
+      return 1;
+    case BLE_VALUE_U16:
+    case BLE_VALUE_I16:
+      return 2;
+    case BLE_VALUE_U32:
+    case BLE_VALUE_I32:
+      return 4;
+    default:
+      return 0;  // Not a delta-encodable type
+  }
+}
+
+/**
+ * @brief Decode stored sample seq as a signed 64-bit value
+ */
+static int64_t sample_value(uint32_t seq)
+{
+  const uint8_t *in = &s_ring[(seq % s_config->capacity) * s_width];
+  uint32_t raw = 0;
+  for (size_t i = 0; i < s_width; i++)
+    raw |= (uint32_t)in[i] << (8 * i);
+
+  switch (s_config->type)
+  {
+    case BLE_VALUE_I8:
+      return (int8_t)raw;
+    case BLE_VALUE_I16:
+      return (int16_t)raw;
+    case BLE_VALUE_I32:
+      return (int32_t)raw;
+    default:
+      return raw;
+  }
+}
+
+/**
+ * @brief Append a zigzag varint
+ *
+ * @return Bytes written
+ */
+static size_t put_varint(uint8_t *out, int64_t value)
+{
+  uint64_t zz = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+  size_t len = 0;
+  do
+  {
+    out[len] = (uint8_t)(zz & 0x7F);
+    zz >>= 7;
+    if (zz != 0)
+      out[len] |= 0x80;
+    len++;
+  } while (zz != 0);
+  return len;
+}
+
+static uint32_t oldest_seq(void)
+{
+  return (s_taken > s_config->capacity) ? s_taken - s_config->capacity : 0;
+}
+
+static bool sample_valid(uint32_t seq)
+{
+  uint32_t slot = seq % s_config->capacity;
+  return (s_valid[slot / 32] >> (slot % 32)) & 1;
+}
+
+static void history_sample(void *arg)
+{
+  int64_t start_us = esp_timer_get_time();
+  uint8_t value[4] = {0};
+
+  if (s_taken == 0)
+    s_first_ms = start_us / 1000;
+
+  // A failed read still uses up its period, so later samples keep first_ms + n * period_ms
+  uint32_t slot = s_taken % s_config->capacity;
+  bool valid = ble_char_read_value(s_source, value, sizeof(value)) >= (int)s_width;
+  if (valid)
+  {
+    memcpy(&s_ring[slot * s_width], value, s_width);
+    s_valid[slot / 32] |= 1u << (slot % 32);
+  }
+  else
+  {
+    s_valid[slot / 32] &= ~(1u << (slot % 32));
+  }
+  __atomic_store_n(&s_taken, s_taken + 1, __ATOMIC_RELEASE);
+
+  if (!valid)
+  {
+    taskENTER_CRITICAL(&s_history_lock);
+    s_stats.read_errors++;
+    taskEXIT_CRITICAL(&s_history_lock);
+    return;
+  }
+
+  uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - start_us);
+  taskENTER_CRITICAL(&s_history_lock);
+  s_stats.samples++;
+  if (elapsed_us > s_stats.max_sample_us)
+    s_stats.max_sample_us = elapsed_us;
+  taskEXIT_CRITICAL(&s_history_lock);
+}
+
+static void history_finish(bool complete)
+{
+  int64_t elapsed_us = esp_timer_get_time() - s_start_us;
+
+  s_active = false;
+  taskENTER_CRITICAL(&s_history_lock);
+  if (complete)
+  {
+    s_stats.downloads++;
+    if (elapsed_us > 0)
+      s_stats.throughput_bytes_per_s = (uint32_t)((int64_t)s_download_bytes * 1000000 / elapsed_us);
+  }
+  taskEXIT_CRITICAL(&s_history_lock);
+}
+
+/**
+ * @brief Build the next notification from the cursor
+ *
+ * @return Length of the notification, samples covered in *count
+ */
+static size_t history_pack(uint32_t end, size_t room, uint8_t *count)
+{
+  size_t len = HISTORY_HEADER;
+  int64_t previous = 0;
+  uint8_t n = 0;
+
+  // A missing sample ends the notification, the next one starts after the gap
+  while (s_cursor + n < end && n < UINT8_MAX && sample_valid(s_cursor + n))
+  {
+    int64_t value = sample_value(s_cursor + n);
+    uint8_t coded[HISTORY_VARINT + 1];
+    size_t coded_len = put_varint(coded, (n == 0) ? value : value - previous);
+    if (len + coded_len > room)
+      break;
+
+    memcpy(&s_packet[len], coded, coded_len);
+    len += coded_len;
+    previous = value;
+    n++;
+  }
+
+  put_u32(s_packet, s_cursor);
+  s_packet[4] = n;
+  *count = n;
+  return len;
+}
+
+/**
+ * @brief Take over the request posted by the Bluetooth task, if any
+ */
+static void history_adopt(void)
+{
+  taskENTER_CRITICAL(&s_history_lock);
+  history_request_t request = s_request;
+  uint32_t first = s_request_first;
+  uint32_t end = s_request_end;
+  s_request = HISTORY_REQ_NONE;
+  taskEXIT_CRITICAL(&s_history_lock);
+
+  if (request == HISTORY_REQ_STOP && s_active)
+  {
+    history_finish(false);
+  }
+  else if (request == HISTORY_REQ_RANGE)
+  {
+    s_cursor = first;
+    s_end = end;
+    s_active = true;
+    s_start_us = esp_timer_get_time();
+    s_download_bytes = 0;
+  }
+}
+
+/**
+ * @brief Post a request and run the pump, which adopts it before its next notification
+ */
+static void history_post(history_request_t request, uint32_t first, uint32_t end)
+{
+  taskENTER_CRITICAL(&s_history_lock);
+  s_request = request;
+  s_request_first = first;
+  s_request_end = end;
+  taskEXIT_CRITICAL(&s_history_lock);
+
+  // Fails only while the pump is already armed, and then it picks the request up anyway
+  esp_timer_start_once(s_pump_timer, 0);
+}
+
+/**
+ * @brief One-shot pump tick; it re-arms itself while a download is open
+ */
+static void history_pump(void *arg)
+{
+  size_t room = ble_gatts_get_mtu() - BLE_ATT_NOTIFY_HEADER;
+  if (room > sizeof(s_packet))
+    room = sizeof(s_packet);
+
+  history_adopt();
+  while (s_active)
+  {
+    // Samples the ring overwrote since the request are gone
+    uint32_t oldest = oldest_seq();
+    if (s_cursor < oldest)
+    {
+      taskENTER_CRITICAL(&s_history_lock);
+      s_stats.skipped += oldest - s_cursor;
+      taskEXIT_CRITICAL(&s_history_lock);
+      s_cursor = oldest;
+    }
+    while (s_cursor < s_end && !sample_valid(s_cursor))
+      s_cursor++;
+
+    uint8_t count;
+    size_t len = history_pack(s_end, room, &count);
+    if (ble_gatts_notify(s_index, s_packet, len) != ESP_OK)
+    {
+      esp_timer_start_once(s_pump_timer, HISTORY_PUMP_US);  // Congested, the next tick retries
+      return;
+    }
+
+    s_download_bytes += len;
+    taskENTER_CRITICAL(&s_history_lock);
+    s_stats.samples_sent += count;
+    s_stats.bytes_sent += len;
+    taskEXIT_CRITICAL(&s_history_lock);
+
+    if (count == 0)
+    {
+      history_finish(true);  // End marker delivered
+      return;
+    }
+    s_cursor += count;
+
+    // A request posted meanwhile replaces this download before its next notification
+    history_adopt();
+  }
+}
+
+/**
+ * @brief Widen a 32-bit uptime from the wire to the 64-bit uptime within 24.8 days of now
+ */
+static int64_t uptime_from_wire(uint32_t ms)
+{
+  int64_t now_ms = esp_timer_get_time() / 1000;
+  return now_ms + (int32_t)(ms - (uint32_t)now_ms);
+}
+
+/**
+ * @brief Map an uptime to the seq of the first sample taken at or after it
+ */
+static uint32_t seq_at(int64_t ms)
+{
+  if (ms <= s_first_ms)
+    return 0;
+
+  int64_t seq = (ms - s_first_ms + s_config->period_ms - 1) / s_config->period_ms;
+  return (seq > UINT32_MAX) ? UINT32_MAX : (uint32_t)seq;
+}
+
+static ble_char_error_t history_write(const uint8_t *data, size_t len)
+{
+  if (len < 1)
+    return BLE_CHAR_ERR_SIZE;
+
+  if (data[0] == HISTORY_OP_STOP)
+  {
+    history_post(HISTORY_REQ_STOP, 0, 0);
+    return BLE_CHAR_OK;
+  }
+
+  if (data[0] != HISTORY_OP_RANGE)
+    return BLE_CHAR_ERR_VALUE;
+  if (len < 9)
+    return BLE_CHAR_ERR_SIZE;
+
+  bool to_now = get_u32(&data[5]) == UINT32_MAX;
+  int64_t from_ms = uptime_from_wire(get_u32(&data[1]));
+  int64_t to_ms = to_now ? esp_timer_get_time() / 1000 : uptime_from_wire(get_u32(&data[5]));
+  if (to_ms < from_ms)
+    return BLE_CHAR_ERR_VALUE;
+
+  // The range ends at what exists now; samples taken during the download are not waited for
+  uint32_t taken = __atomic_load_n(&s_taken, __ATOMIC_ACQUIRE);
+  uint32_t first = seq_at(from_ms);
+  uint32_t end = to_now ? taken : seq_at(to_ms + 1);
+  if (end > taken)
+    end = taken;
+  if (first > end)
+    first = end;
+
+  history_post(HISTORY_REQ_RANGE, first, end);
+
+  ESP_LOGD(HISTORY_TAG, "Download of samples %lu to %lu", (unsigned long)first, (unsigned long)end);
+  return BLE_CHAR_OK;
+}
+
+static int history_read(uint8_t *out_buffer, size_t max_len)
+{
+  if (max_len < HISTORY_INFO)
+    return -1;
+
+  uint32_t taken = __atomic_load_n(&s_taken, __ATOMIC_ACQUIRE);
+  uint32_t oldest = oldest_seq();
+  uint32_t stored = taken - oldest;
+
+  // Times go out as their low 32 bits
+  put_u32(&out_buffer[0], s_config->period_ms);
+  put_u32(&out_buffer[4], (uint32_t)(esp_timer_get_time() / 1000));
+  put_u32(&out_buffer[8], (uint32_t)(s_first_ms + (int64_t)oldest * s_config->period_ms));
+  put_u32(&out_buffer[12], (stored > 0) ? (uint32_t)(s_first_ms + (int64_t)(taken - 1) * s_config->period_ms) : 0);
+  put_u32(&out_buffer[16], stored);
+  out_buffer[20] = s_config->type;
+  return HISTORY_INFO;
+}
+
+esp_err_t ble_history_init(const ble_history_config_t *config, const ble_characteristic_t *chars, size_t count,
+                           ble_characteristic_t *out, size_t index)
+{
+  const ble_characteristic_t *source = NULL;
+  for (size_t i = 0; i < count && source == NULL; i++)
+  {
+    if (chars[i].uuid == config->source_uuid)
+      source = &chars[i];
+  }
+
+  size_t width = type_width(config->type);
+  if (source == NULL || !ble_char_is_readable(source) || width == 0 || width > source->size)
+  {
+    ESP_LOGE(HISTORY_TAG, "History source 0x%04X is not a readable integer characteristic", config->source_uuid);
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (config->period_ms == 0 || config->capacity == 0)
+  {
+    ESP_LOGE(HISTORY_TAG, "History needs a period and a capacity");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  s_config = config;
+  s_source = source;
+  s_index = index;
+  s_width = width;
+  s_taken = 0;
+  s_active = false;
+  s_request = HISTORY_REQ_NONE;
+  memset(&s_stats, 0, sizeof(s_stats));
+
+  const esp_timer_create_args_t sample_args = {
+    .callback = history_sample,
+    .name = "ble_history",
+  };
+  const esp_timer_create_args_t pump_args = {
+    .callback = history_pump,
+    .name = "ble_history_tx",
+  };
+
+  s_ring = (uint8_t *)malloc(config->capacity * width);
+  s_valid = (uint32_t *)calloc((config->capacity + 31) / 32, sizeof(uint32_t));
+  if (s_ring == NULL || s_valid == NULL || esp_timer_create(&sample_args, &s_sample_timer) != ESP_OK ||
+      esp_timer_create(&pump_args, &s_pump_timer) != ESP_OK ||
+      esp_timer_start_periodic(s_sample_timer, (uint64_t)config->period_ms * 1000) != ESP_OK)
+  {
+    ESP_LOGE(HISTORY_TAG, "Failed to start sampling");
+    ble_history_deinit();
+    return ESP_ERR_NO_MEM;
+  }
+
+  *out = (ble_characteristic_t){
+    .uuid = config->uuid,
+    .name = "History",
+    .description = config->description,
+    .size = HISTORY_INFO,
+    .read = history_read,
+    .write = history_write,
+    .flags = BLE_CHAR_FLAG_NOTIFY_DIRECT,
+  };
+
+  ESP_LOGI(HISTORY_TAG, "History of '%s': %lu samples every %lu ms (%lu bytes)", source->name,
+           (unsigned long)config->capacity, (unsigned long)config->period_ms,
+           (unsigned long)(config->capacity * width));
+  return ESP_OK;
+}
+
+void ble_history_deinit(void)
+{
+  esp_timer_handle_t *timers[] = {&s_sample_timer, &s_pump_timer};
+  for (size_t i = 0; i < 2; i++)
+  {
+    if (*timers[i] != NULL)
+    {
+      esp_timer_stop(*timers[i]);
+      esp_timer_delete(*timers[i]);
+      *timers[i] = NULL;
+    }
+  }
+
+  free(s_ring);
+  s_ring = NULL;
+  free(s_valid);
+  s_valid = NULL;
+  s_active = false;
+  s_config = NULL;
+}
+
+void ble_history_reset(void)
+{
+  if (s_pump_timer != NULL)
+    history_post(HISTORY_REQ_STOP, 0, 0);
+}
+
+void ble_history_get_stats(ble_history_stats_t *out)
+{
+  taskENTER_CRITICAL(&s_history_lock);
+  *out = s_stats;
+  taskEXIT_CRITICAL(&s_history_lock);
+}
@@ -0,0 +1,202 @@
+/**
+ * @file ble-lz.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief LZ codec - streaming encoder and the matching decoder
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * The stream is a sequence of groups: one flag byte, then up to eight items,
+ * bit 0 first. A clear bit is a literal byte; a set bit is a match u16 (little
+ * endian) copying (value >> 10) + 3 bytes from (value & 0x3FF) + 1 bytes back.
+ * Matches may overlap the bytes they produce and may reach into the
+ * dictionary, which virtually precedes every stream. The stream ends with the
+ * payload.
+ */
+
+#include "ble-lz.h"
+
+#include <string.h>
+
+static uint32_t lz_hash(const uint8_t *p)
+{
+  uint32_t v = p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+  return (v * 2654435761u) >> (32 - BLE_LZ_HASH_BITS);
+}
+
+/**
+ * @brief Append a literal or a match, opening a new group when needed
+ * @return false if the output is full
+ */
+static bool lz_item(ble_lz_t *lz, bool match, uint16_t value)
+{
+  size_t need = (match ? 2 : 1) + ((lz->bit == 8) ? 1 : 0);
+  if (lz->len + need > lz->cap)
+  {
+    lz->full = true;
+    return false;
+  }
+
+  if (lz->bit == 8)
+  {
+    lz->flags_at = lz->len;
+    lz->out[lz->len++] = 0;
+    lz->bit = 0;
+  }
+  if (match)
+  {
+    lz->out[lz->flags_at] |= (uint8_t)(1 << lz->bit);
+    lz->out[lz->len++] = (uint8_t)(value & 0xFF);
+    lz->out[lz->len++] = (uint8_t)(value >> 8);
+  }
+  else
+  {
+    lz->out[lz->len++] = (uint8_t)value;
+  }
+  lz->bit++;
+  return true;
+}
+
+/**
+ * @brief Encode the window input; without final, the last BLE_LZ_MAX_MATCH bytes wait for more input
+ */
+static void lz_run(ble_lz_t *lz, bool final)
+{
+  while (!lz->full)
+  {
+    size_t avail = lz->end - lz->pos;
+    if (avail == 0 || (!final && avail < BLE_LZ_MAX_MATCH))
+      break;
+
+    size_t match = 0, distance = 0;
+    if (avail >= BLE_LZ_MIN_MATCH)
+    {
+      uint32_t hash = lz_hash(&lz->window[lz->pos]);
+      uint16_t candidate = lz->head[hash];
+      lz->head[hash] = (uint16_t)lz->pos;
+
+      if (candidate != BLE_LZ_NONE && lz->pos - candidate <= BLE_LZ_WINDOW)
+      {
+        size_t longest = (avail < BLE_LZ_MAX_MATCH) ? avail : BLE_LZ_MAX_MATCH;
+        while (match < longest && lz->window[candidate + match] == lz->window[lz->pos + match])
+          match++;
+        distance = lz->pos - candidate;
+      }
+    }
+
+    if (match >= BLE_LZ_MIN_MATCH)
+    {
+      if (!lz_item(lz, true, (uint16_t)((distance - 1) | ((match - BLE_LZ_MIN_MATCH) << 10))))
+        break;
+      // Positions inside the match become candidates too, which matters for repetitive text
+      for (size_t p = lz->pos + 1; p < lz->pos + match && p + BLE_LZ_MIN_MATCH <= lz->end; p++)
+        lz->head[lz_hash(&lz->window[p])] = (uint16_t)p;
+    }
+    else
+    {
+      if (!lz_item(lz, false, lz->window[lz->pos]))
+        break;
+      match = 1;
+    }
+
+    lz->pos += match;
+    lz->encoded += match;
+  }
+}
+
+/**
+ * @brief Drop everything older than one window before pos to make room for input
+ */
+static void lz_slide(ble_lz_t *lz)
+{
+  size_t shift = lz->pos - BLE_LZ_WINDOW;
+
+  memmove(lz->window, &lz->window[shift], lz->end - shift);
+  lz->pos -= shift;
+  lz->end -= shift;
+  for (size_t i = 0; i < BLE_LZ_HASH_SIZE; i++)
+    lz->head[i] = (lz->head[i] == BLE_LZ_NONE || lz->head[i] < shift) ? BLE_LZ_NONE : lz->head[i] - shift;
+}
+
+void ble_lz_prime(uint16_t *head, const uint8_t *dict, size_t dict_len)
+{
+  for (size_t i = 0; i < BLE_LZ_HASH_SIZE; i++)
+    head[i] = BLE_LZ_NONE;
+  for (size_t p = 0; p + BLE_LZ_MIN_MATCH <= dict_len; p++)
+    head[lz_hash(&dict[p])] = (uint16_t)p;
+}
+
+void ble_lz_begin(ble_lz_t *lz, const uint8_t *dict, size_t dict_len, const uint16_t *dict_head, uint8_t *out,
+                  size_t cap)
+{
+  if (dict_len > 0)
+    memcpy(lz->window, dict, dict_len);
+  memcpy(lz->head, dict_head, sizeof(lz->head));
+  lz->pos = dict_len;
+  lz->end = dict_len;
+  lz->out = out;
+  lz->cap = cap;
+  lz->len = 0;
+  lz->bit = 8;
+  lz->full = false;
+  lz->encoded = 0;
+}
+
+uint8_t *ble_lz_input(ble_lz_t *lz, size_t *room)
+{
+  // Committed input is encoded down to BLE_LZ_MAX_MATCH bytes, so a full window always has history to drop
+  if (lz->end == BLE_LZ_BUF_SIZE && lz->pos > BLE_LZ_WINDOW)
+    lz_slide(lz);
+
+  *room = lz->full ? 0 : BLE_LZ_BUF_SIZE - lz->end;
+  return &lz->window[lz->end];
+}
+
+void ble_lz_commit(ble_lz_t *lz, size_t len)
+{
+  lz->end += len;
+  lz_run(lz, false);
+}
+
+size_t ble_lz_finish(ble_lz_t *lz)
+{
+  lz_run(lz, true);
+  return lz->len;
+}
+
+int ble_lz_decode(const uint8_t *dict, size_t dict_len, const uint8_t *in, size_t len, uint8_t *out, size_t max)
+{
+  size_t i = 0, o = 0;
+
+  while (i < len)
+  {
+    uint8_t flags = in[i++];
+    for (int bit = 0; bit < 8 && i < len; bit++)
+    {
+      if (!(flags & (1 << bit)))
+      {
+        if (o == max)
+          return -1;
+        out[o++] = in[i++];
+        continue;
+      }
+
+      if (i + 2 > len)
+        return -1;
+      uint16_t value = in[i] | (uint16_t)(in[i + 1] << 8);
+      i += 2;
+
+      size_t distance = (value & 0x3FF) + 1;
+      size_t count = (value >> 10) + BLE_LZ_MIN_MATCH;
+      if (distance > o + dict_len || count > max - o)
+        return -1;
+
+      // Byte by byte, since a match may overlap the bytes it produces
+      for (size_t k = 0; k < count; k++, o++)
+        out[o] = (distance > o) ? dict[dict_len - (distance - o)] : out[o - distance];
+    }
+  }
+
+  return (int)o;
+}
@@ -0,0 +1,334 @@
+/**
+ * @file ble-notify.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Change-driven notifications with deadband, rate limit and heartbeat
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * A periodic timer samples every subscribed characteristic that is due (its
+ * minimum interval elapsed) and compares the value with the last one sent. Only
+ * changes beyond the deadband, or an expired heartbeat, produce a notification.
+ * The timer only runs while at least one characteristic is subscribed.
+ */
+
+#include "ble-notify.h"
+
+#include <esp_gatt_defs.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ble-char.h"
+#include "ble-compress.h"
+#include "ble-gatts.h"
+
+#define NOTIFY_TAG       "BLE_NOTIFY"
+#define NOTIFY_SAMPLE_MS 20  // Sampling period, about one connection interval
+
+// Publishing state of one notifying characteristic
+typedef struct
+{
+  uint8_t *last;         // Last value sent (NULL = characteristic does not notify)
+  uint8_t last_len;
+  bool direct;           // Values are pushed by a built-in service, only the subscription is tracked
+  bool subscribed;       // Client enabled notifications in the CCCD
+  bool force;            // Send on the next sample regardless of the policy
+  int64_t last_sent_us;  // Time of the last notification
+} ble_notify_slot_t;
+
+static const ble_characteristic_t *s_chars = NULL;
+static size_t s_count = 0;
+static ble_notify_slot_t s_slots[BLE_MAX_CHARACTERISTICS];
+static size_t s_subscribed_count = 0;
+static esp_timer_handle_t s_sample_timer = NULL;
+
+static portMUX_TYPE s_notify_lock = portMUX_INITIALIZER_UNLOCKED;
+static ble_notify_stats_t s_stats = {0};
+static uint8_t s_packed[ESP_GATT_MAX_ATTR_LEN];  // Compressed value being sent, only touched by the sample timer
+
+/**
+ * @brief Decode a little endian numeric value
+ *
+ * @return false if the value is too short for the type
+ */
+static bool notify_decode(ble_value_type_t type, const uint8_t *data, size_t len, double *out)
+{
+  static const uint8_t sizes[] = {
+    [BLE_VALUE_RAW] = 0,
+    [BLE_VALUE_U8] = 1,
+    [BLE_VALUE_I8] = 1,
+    [BLE_VALUE_U16] = 2,
+    [BLE_VALUE_I16] = 2,
+    [BLE_VALUE_U32] = 4,
+    [BLE_VALUE_I32] = 4,
+    [BLE_VALUE_FLOAT] = 4,
+  };
+
+  if (type == BLE_VALUE_RAW || type > BLE_VALUE_FLOAT || len < sizes[type])
+    return false;
+
+  uint32_t raw = 0;
+  for (size_t i = 0; i < sizes[type]; i++)
+    raw |= (uint32_t)data[i] << (8 * i);
+
+  switch (type)
+  {
+    case BLE_VALUE_U8:
+    case BLE_VALUE_U16:
+    case BLE_VALUE_U32:
+      *out = raw;
+      break;
+    case BLE_VALUE_I8:
+      *out = (int8_t)raw;
+      break;
+    case BLE_VALUE_I16:
+      *out = (int16_t)raw;
+      break;
+    case BLE_VALUE_I32:
+      *out = (int32_t)raw;
+      break;
+    case BLE_VALUE_FLOAT:
+    {
+      float f;
+      memcpy(&f, &raw, sizeof(f));
+      *out = f;
+      break;
+    }
+    default:
+      return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Compare a sample with the last value sent
+ *
+ * @param moved Out: the bytes differ (possibly within the deadband)
+ * @return true if the change is beyond the deadband
+ */
+static bool notify_changed(const ble_notify_policy_t *policy, const ble_notify_slot_t *slot, const uint8_t *value,
+                           size_t len, bool *moved)
+{
+  *moved = (len != slot->last_len || memcmp(value, slot->last, len) != 0);
+  if (!*moved || len != slot->last_len || policy->deadband <= 0.0f)
+    return *moved;
+
+  double now_value, last_value;
+  if (!notify_decode(policy->type, value, len, &now_value) ||
+      !notify_decode(policy->type, slot->last, slot->last_len, &last_value))
+    return true;  // Opaque value: any difference counts
+
+  return fabs(now_value - last_value) > policy->deadband;
+}
+
+/**
+ * @brief Sample the subscribed characteristics that are due. Runs in the esp_timer task.
+ */
+static void notify_sample(void *arg)
+{
+  int64_t now_us = esp_timer_get_time();
+
+  for (size_t i = 0; i < s_count; i++)
+  {
+    ble_notify_slot_t *slot = &s_slots[i];
+    const ble_characteristic_t *ch = &s_chars[i];
+    const ble_notify_policy_t *policy = ch->notify;
+    bool subscribed, force;
+
+    taskENTER_CRITICAL(&s_notify_lock);
+    subscribed = slot->subscribed;
+    force = slot->force;
+    taskEXIT_CRITICAL(&s_notify_lock);
+
+    if (slot->last == NULL || !subscribed)
+      continue;
+
+    int64_t since_us = now_us - slot->last_sent_us;
+    if (!force && since_us < (int64_t)policy->min_interval_ms * 1000)
+      continue;
+
+    uint8_t value[UINT8_MAX];
+    int len = ble_char_read_value(ch, value, ch->size);
+    if (len < 0)
+      continue;
+
+    bool moved = false;
+    bool changed = force || notify_changed(policy, slot, value, len, &moved);
+    bool heartbeat = !changed && policy->heartbeat_ms > 0 && since_us >= (int64_t)policy->heartbeat_ms * 1000;
+
+    if (!changed && !heartbeat)
+    {
+      if (moved)
+      {
+        taskENTER_CRITICAL(&s_notify_lock);
+        s_stats.suppressed++;
+        taskEXIT_CRITICAL(&s_notify_lock);
+      }
+      continue;
+    }
+
+    const uint8_t *out = value;
+    size_t out_len = len;
+
+    // Only what is sent is compressed; the deadband keeps comparing raw values
+    if ((ch->flags & BLE_CHAR_FLAG_COMPRESS) && ble_compress_is_enabled())
+    {
+      size_t max = ble_gatts_get_mtu() - BLE_ATT_NOTIFY_HEADER;
+      if (max > sizeof(s_packed))
+        max = sizeof(s_packed);
+      out_len = ble_compress_value(BLE_COMPRESS_CTX_TIMER, value, len, s_packed, max);
+      out = s_packed;
+    }
+
+    if (out_len == 0 || ble_gatts_notify(i, out, out_len) != ESP_OK)
+    {
+      // Value is still pending, the next sample retries
+      taskENTER_CRITICAL(&s_notify_lock);
+      s_stats.dropped++;
+      taskEXIT_CRITICAL(&s_notify_lock);
+      continue;
+    }
+
+    memcpy(slot->last, value, len);
+    slot->last_len = len;
+    slot->last_sent_us = now_us;
+
+    taskENTER_CRITICAL(&s_notify_lock);
+    slot->force = false;
+    s_stats.sent++;
+    if (heartbeat)
+      s_stats.heartbeats++;
+    taskEXIT_CRITICAL(&s_notify_lock);
+  }
+}
+
+esp_err_t ble_notify_init(const ble_characteristic_t *chars, size_t count)
+{
+  s_chars = chars;
+  s_count = (count > BLE_MAX_CHARACTERISTICS) ? BLE_MAX_CHARACTERISTICS : count;
+  s_subscribed_count = 0;
+  memset(s_slots, 0, sizeof(s_slots));
+
+  size_t notifying = 0;
+  for (size_t i = 0; i < s_count; i++)
+  {
+    s_slots[i].direct = (chars[i].notify == NULL && (chars[i].flags & BLE_CHAR_FLAG_NOTIFY_DIRECT));
+    if (chars[i].notify == NULL || chars[i].size == 0)
+      continue;
+
+    s_slots[i].last = (uint8_t *)calloc(chars[i].size, sizeof(uint8_t));
+    if (s_slots[i].last == NULL)
+    {
+      ESP_LOGE(NOTIFY_TAG, "Failed to allocate notification buffer for '%s'", chars[i].name);
+      ble_notify_deinit();
+      return ESP_ERR_NO_MEM;
+    }
+    notifying++;
+  }
+
+  if (notifying == 0 || s_sample_timer != NULL)
+    return ESP_OK;
+
+  const esp_timer_create_args_t timer_args = {
+    .callback = notify_sample,
+    .name = "ble_notify",
+  };
+  esp_err_t ret = esp_timer_create(&timer_args, &s_sample_timer);
+  if (ret != ESP_OK)
+  {
+    ESP_LOGE(NOTIFY_TAG, "Sample timer creation failed: %s", esp_err_to_name(ret));
+    ble_notify_deinit();
+    return ret;
+  }
+
+  return ESP_OK;
+}
+
+void ble_notify_deinit(void)
+{
+  if (s_sample_timer != NULL)
+  {
+    esp_timer_stop(s_sample_timer);
+    esp_timer_delete(s_sample_timer);
+    s_sample_timer = NULL;
+  }
+
+  for (size_t i = 0; i < BLE_MAX_CHARACTERISTICS; i++)
+  {
+    free(s_slots[i].last);
+    s_slots[i].last = NULL;
+  }
+
+  s_chars = NULL;
+  s_count = 0;
+  s_subscribed_count = 0;
+}
+
+void ble_notify_set_subscribed(size_t index, bool subscribed)
+{
+  if (index >= s_count)
+    return;
+
+  if (s_slots[index].direct)
+  {
+    s_slots[index].subscribed = subscribed;
+    return;
+  }
+
+  if (s_slots[index].last == NULL)
+    return;
+
+  bool start = false, stop = false;
+
+  taskENTER_CRITICAL(&s_notify_lock);
+  if (s_slots[index].subscribed != subscribed)
+  {
+    s_slots[index].subscribed = subscribed;
+    s_slots[index].force = subscribed;  // A new subscriber gets the current value right away
+    s_subscribed_count += subscribed ? 1 : -1;
+    start = subscribed && s_subscribed_count == 1;
+    stop = !subscribed && s_subscribed_count == 0;
+  }
+  taskEXIT_CRITICAL(&s_notify_lock);
+
+  ESP_LOGI(NOTIFY_TAG, "Notifications for '%s' %s", s_chars[index].name, subscribed ? "enabled" : "disabled");
+
+  if (s_sample_timer == NULL)
+    return;
+  if (start)
+    esp_timer_start_periodic(s_sample_timer, (uint64_t)NOTIFY_SAMPLE_MS * 1000);
+  else if (stop)
+    esp_timer_stop(s_sample_timer);
+}
+
+bool ble_notify_is_subscribed(size_t index)
+{
+  return index < s_count && s_slots[index].subscribed;
+}
+
+void ble_notify_reset(void)
+{
+  taskENTER_CRITICAL(&s_notify_lock);
+  for (size_t i = 0; i < s_count; i++)
+  {
+    s_slots[i].subscribed = false;
+    s_slots[i].force = false;
+  }
+  s_subscribed_count = 0;
+  taskEXIT_CRITICAL(&s_notify_lock);
+
+  if (s_sample_timer != NULL)
+    esp_timer_stop(s_sample_timer);
+}
+
+void ble_notify_get_stats(ble_notify_stats_t *out)
+{
+  taskENTER_CRITICAL(&s_notify_lock);
+  *out = s_stats;
+  taskEXIT_CRITICAL(&s_notify_lock);
+}
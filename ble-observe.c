@@ -0,0 +1,188 @@
+/**
+ * @file ble-observe.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Observer report path - filters, dedup table and report queue
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "ble-observe.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// AD types the filters look at
+#define AD_TYPE_16SRV_PART   0x02
+#define AD_TYPE_16SRV_CMPL   0x03
+#define AD_TYPE_SERVICE_DATA 0x16
+#define AD_TYPE_MANUFACTURER 0xFF
+
+/**
+ * @brief FNV-1a over a buffer, continuing from hash
+ */
+static uint32_t observe_hash(uint32_t hash, const uint8_t *data, size_t len)
+{
+  for (size_t i = 0; i < len; i++)
+  {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static bool observe_listed(const uint16_t *list, size_t count, uint16_t value)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    if (list[i] == value)
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Apply the address, service UUID and company ID filters to one report
+ */
+static bool observe_accepts(const ble_observer_config_t *cfg, const uint8_t *bda, const uint8_t *data, size_t len)
+{
+  if (cfg->addresses != NULL)
+  {
+    size_t i = 0;
+    while (i < cfg->address_count && memcmp(cfg->addresses[i], bda, 6) != 0)
+      i++;
+    if (i == cfg->address_count)
+      return false;
+  }
+
+  bool uuid_ok = cfg->service_uuids == NULL;
+  bool company_ok = cfg->company_ids == NULL;
+  if (uuid_ok && company_ok)
+    return true;
+
+  // AD structures: length (type included), type, value
+  for (size_t pos = 0; pos + 1 < len && data[pos] != 0 && pos + 1 + data[pos] <= len; pos += 1 + data[pos])
+  {
+    uint8_t type = data[pos + 1];
+    const uint8_t *value = &data[pos + 2];
+    size_t value_len = data[pos] - 1;
+
+    if (type == AD_TYPE_16SRV_PART || type == AD_TYPE_16SRV_CMPL)
+    {
+      for (size_t i = 0; i + 1 < value_len; i += 2)
+        uuid_ok |= observe_listed(cfg->service_uuids, cfg->service_uuid_count, value[i] | (value[i + 1] << 8));
+    }
+    else if (type == AD_TYPE_SERVICE_DATA && value_len >= 2)
+    {
+      uuid_ok |= observe_listed(cfg->service_uuids, cfg->service_uuid_count, value[0] | (value[1] << 8));
+    }
+    else if (type == AD_TYPE_MANUFACTURER && value_len >= 2)
+    {
+      company_ok |= observe_listed(cfg->company_ids, cfg->company_id_count, value[0] | (value[1] << 8));
+    }
+  }
+
+  return uuid_ok && company_ok;
+}
+
+/**
+ * @brief Check a report against the dedup table, recording it when it is new
+ *
+ * Open addressing over BLE_OBSERVE_DEDUP_PROBE slots: an expired or free slot is
+ * reused first, otherwise the oldest entry is overwritten.
+ *
+ * @return true if the same address and payload was passed on less than dedup_ms ago
+ */
+static bool observe_is_duplicate(ble_observe_t *o, const uint8_t *bda, uint32_t payload_hash, uint32_t now_ms,
+                                 bool *evicted)
+{
+  uint32_t slot = observe_hash(payload_hash, bda, 6);
+  ble_observe_entry_t *victim = NULL;
+  bool victim_live = true;
+
+  for (size_t i = 0; i < BLE_OBSERVE_DEDUP_PROBE; i++)
+  {
+    ble_observe_entry_t *entry = &o->dedup[(slot + i) & (BLE_OBSERVE_DEDUP_SLOTS - 1)];
+    bool live = entry->seen_ms != 0 && now_ms - entry->seen_ms < o->dedup_ms;
+
+    if (entry->seen_ms != 0 && entry->payload_hash == payload_hash && memcmp(entry->bda, bda, 6) == 0)
+    {
+      if (live)
+        return true;
+      victim = entry;
+      victim_live = false;
+      break;
+    }
+    // Prefer a free or expired slot, then the oldest live one (times compare modulo 2^32)
+    if (victim == NULL || (victim_live && (!live || (int32_t)(entry->seen_ms - victim->seen_ms) < 0)))
+    {
+      victim = entry;
+      victim_live = live;
+    }
+  }
+
+  *evicted = victim_live;
+  memcpy(victim->bda, bda, 6);
+  victim->payload_hash = payload_hash;
+  victim->seen_ms = now_ms;
+  return false;
+}
+
+bool ble_observe_alloc(ble_observe_t *o, const ble_observer_config_t *cfg, uint32_t dedup_ms, size_t queue_length)
+{
+  o->dedup = (ble_observe_entry_t *)calloc(BLE_OBSERVE_DEDUP_SLOTS, sizeof(ble_observe_entry_t));
+  o->queue = (ble_observer_report_t *)malloc(queue_length * sizeof(ble_observer_report_t));
+  if (o->dedup == NULL || o->queue == NULL)
+  {
+    ble_observe_release(o);
+    return false;
+  }
+
+  o->cfg = cfg;
+  o->dedup_ms = dedup_ms;
+  o->queue_length = queue_length;
+  o->head = 0;
+  o->count = 0;
+  return true;
+}
+
+void ble_observe_release(ble_observe_t *o)
+{
+  free(o->dedup);
+  free(o->queue);
+  memset(o, 0, sizeof(*o));
+}
+
+ble_observe_verdict_t ble_observe_check(ble_observe_t *o, const uint8_t *bda, const uint8_t *data, size_t len,
+                                        uint32_t now_ms, bool *evicted)
+{
+  *evicted = false;
+  if (!observe_accepts(o->cfg, bda, data, len))
+    return BLE_OBSERVE_FILTERED;
+
+  uint32_t payload_hash = observe_hash(2166136261u, data, len);
+  return observe_is_duplicate(o, bda, payload_hash, now_ms, evicted) ? BLE_OBSERVE_DUPLICATE : BLE_OBSERVE_NEW;
+}
+
+bool ble_observe_push(ble_observe_t *o, const ble_observer_report_t *report)
+{
+  if (o->count == o->queue_length)
+    return false;
+
+  o->queue[(o->head + o->count) % o->queue_length] = *report;
+  o->count++;
+  return true;
+}
+
+bool ble_observe_pop(ble_observe_t *o, ble_observer_report_t *out)
+{
+  if (o->count == 0)
+    return false;
+
+  *out = o->queue[o->head];
+  o->head = (o->head + 1) % o->queue_length;
+  o->count--;
+  return true;
+}
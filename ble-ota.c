@@ -0,0 +1,566 @@
+/**
+ * @file ble-ota.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Streaming firmware update into the inactive OTA partition
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * The image travels as an upload of a reserved object of the transfer service,
+ * which already provides the window, CRC and rewind. This module is its sink.
+ *
+ * Blocks are copied into one of two sector-sized buffers in the Bluetooth task.
+ * A full buffer goes to a writer task that erases, writes and hashes it while
+ * the other buffer fills, so flash stalls never block radio reception. When
+ * both buffers are busy the block is refused with BLE_CHAR_ERR_BUSY and the
+ * client resends it, which paces the link to the flash.
+ *
+ * Control characteristic (write, read, notify), little endian:
+ *
+ *   0x01 BEGIN  size u32, SHA-256 of the image [32]  ->  0x81, status, resume offset u32
+ *   0x02 APPLY                                       ->  0x82, status, then reboot
+ *   0x03 ABORT                                       ->  0x83, status
+ *        Image received and checked                  ->  0x84, status
+ *   Read: state u8, bytes in flash u32, image size u32
+ *
+ * Progress is stored every OTA_PROGRESS_SECTORS sectors. After a disconnect or
+ * a reboot, BEGIN with the same size and hash returns the sector to continue
+ * from, and the hash of what is already in flash is recomputed from the partition.
+ *
+ * The server must run with passkey pairing: the characteristics then require an
+ * authenticated link, and the control point and the image object check it again.
+ */
+
+#include "ble-ota.h"
+
+#include <esp_log.h>
+#include <esp_ota_ops.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <mbedtls/sha256.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ble-gatts.h"
+#include "ble-sec.h"
+#include "ble-store.h"
+#include "ble-xfer.h"
+
+#define OTA_TAG              "BLE_OTA"
+#define OTA_SECTOR_SIZE      4096  // Flash erase unit, also the buffer size
+#define OTA_PROGRESS_SECTORS 16    // Sectors written between two progress saves
+#define OTA_PROGRESS_KEY     "ota_prog"
+#define OTA_DEFAULT_OBJECT   0xF0
+#define OTA_CONTROL_SIZE     37
+#define OTA_REBOOT_DELAY_MS  500   // Lets the APPLY response leave before the restart
+#define OTA_WRITER_STACK     4096
+#define OTA_WRITER_PRIORITY  5
+
+#define OTA_OP_BEGIN    0x01
+#define OTA_OP_APPLY    0x02
+#define OTA_OP_ABORT    0x03
+#define OTA_EVT_CHECKED 0x04
+#define OTA_RSP         0x80
+
+// Work for the writer task
+typedef enum
+{
+  OTA_JOB_WRITE = 0,  // Write one buffer
+  OTA_JOB_FINISH,     // Write the last buffer, then check the hash and select the partition
+  OTA_JOB_REHASH,     // Hash what is already in flash before resuming
+} ble_ota_job_type_t;
+
+typedef struct
+{
+  ble_ota_job_type_t type;
+  uint8_t buf;
+  uint32_t offset;
+  uint32_t len;
+} ble_ota_job_t;
+
+// Stored resume point
+typedef struct
+{
+  uint32_t size;
+  uint8_t sha256[32];
+  uint32_t committed;
+} ble_ota_progress_t;
+
+static const ble_ota_config_t *s_config = NULL;
+static ble_xfer_config_t s_sink;
+static size_t s_index = 0;
+static const esp_partition_t *s_partition = NULL;
+static TaskHandle_t s_writer = NULL;
+static QueueHandle_t s_jobs = NULL;
+static esp_timer_handle_t s_reboot_timer = NULL;
+static portMUX_TYPE s_ota_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint8_t *s_buf[2] = {NULL, NULL};
+static bool s_busy[2] = {false, false};  // Buffer handed to the writer
+static uint8_t s_fill = 0;               // Buffer being filled
+static uint32_t s_fill_offset = 0;       // Image offset of the buffer being filled
+static uint32_t s_fill_len = 0;
+
+static ble_ota_progress_t s_image;            // Image announced by BEGIN
+static mbedtls_sha256_context s_sha;          // Writer task only
+static uint32_t s_sectors_since_save = 0;     // Writer task only
+static ble_ota_status_t s_status = {0};
+
+static void put_u32(uint8_t *out, uint32_t value)
+{
+  for (size_t i = 0; i < 4; i++)
+    out[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint32_t get_u32(const uint8_t *in)
+{
+  return in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static void ota_set_state(ble_ota_state_t state)
+{
+  taskENTER_CRITICAL(&s_ota_lock);
+  s_status.state = state;
+  taskEXIT_CRITICAL(&s_ota_lock);
+}
+
+static void ota_notify(uint8_t opcode, ble_char_error_t status, uint32_t offset)
+{
+  uint8_t msg[6] = {opcode | OTA_RSP, status};
+  put_u32(&msg[2], offset);
+  ble_gatts_notify(s_index, msg, (opcode == OTA_OP_BEGIN) ? 6 : 2);
+}
+
+static void ota_save_progress(void)
+{
+  if (ble_store_set(OTA_PROGRESS_KEY, &s_image, sizeof(s_image)) == ESP_OK)
+    ble_store_commit();
+}
+
+/**
+ * @brief Erase, write and hash one buffer. Writer task.
+ */
+static bool ota_write_buffer(const ble_ota_job_t *job)
+{
+  int64_t start_us = esp_timer_get_time();
+
+  esp_err_t ret = esp_partition_erase_range(s_partition, job->offset, OTA_SECTOR_SIZE);
+  if (ret == ESP_OK)
+    ret = esp_partition_write(s_partition, job->offset, s_buf[job->buf], job->len);
+  if (ret != ESP_OK)
+  {
+    ESP_LOGE(OTA_TAG, "Flash write at 0x%lx failed: %s", (unsigned long)job->offset, esp_err_to_name(ret));
+    return false;
+  }
+
+  mbedtls_sha256_update(&s_sha, s_buf[job->buf], job->len);
+  uint32_t write_us = (uint32_t)(esp_timer_get_time() - start_us);
+
+  taskENTER_CRITICAL(&s_ota_lock);
+  s_busy[job->buf] = false;
+  s_image.committed = job->offset + job->len;
+  s_status.written = s_image.committed;
+  if (write_us > s_status.max_sector_write_us)
+    s_status.max_sector_write_us = write_us;
+  taskEXIT_CRITICAL(&s_ota_lock);
+
+  if (++s_sectors_since_save >= OTA_PROGRESS_SECTORS)
+  {
+    s_sectors_since_save = 0;
+    ota_save_progress();
+  }
+  return true;
+}
+
+/**
+ * @brief Check the hash of the complete image and make it the next boot partition. Writer task.
+ */
+static ble_char_error_t ota_check_image(void)
+{
+  uint8_t digest[32];
+  mbedtls_sha256_finish(&s_sha, digest);
+
+  if (memcmp(digest, s_image.sha256, sizeof(digest)) != 0)
+  {
+    ESP_LOGE(OTA_TAG, "Image hash mismatch");
+    return BLE_CHAR_ERR_VALUE;
+  }
+
+  // Also validates the image headers and, if enabled, its signature
+  esp_err_t ret = esp_ota_set_boot_partition(s_partition);
+  if (ret != ESP_OK)
+  {
+    ESP_LOGE(OTA_TAG, "Image rejected by the bootloader checks: %s", esp_err_to_name(ret));
+    return BLE_CHAR_ERR_VALUE;
+  }
+  return BLE_CHAR_OK;
+}
+
+/**
+ * @brief Recompute the hash of the part already in flash before resuming. Writer task.
+ */
+static void ota_rehash(uint32_t len)
+{
+  mbedtls_sha256_starts(&s_sha, 0);
+  for (uint32_t offset = 0; offset < len; offset += OTA_SECTOR_SIZE)
+  {
+    uint32_t chunk = (len - offset < OTA_SECTOR_SIZE) ? len - offset : OTA_SECTOR_SIZE;
+    esp_partition_read(s_partition, offset, s_buf[0], chunk);
+    mbedtls_sha256_update(&s_sha, s_buf[0], chunk);
+  }
+
+  taskENTER_CRITICAL(&s_ota_lock);
+  s_busy[0] = false;
+  s_busy[1] = false;
+  taskEXIT_CRITICAL(&s_ota_lock);
+
+  // Saved here rather than in BEGIN so the Bluetooth task never waits for flash
+  ota_save_progress();
+}
+
+static void ota_writer_task(void *arg)
+{
+  ble_ota_job_t job;
+
+  for (;;)
+  {
+    if (xQueueReceive(s_jobs, &job, portMAX_DELAY) != pdTRUE)
+      continue;
+
+    switch (job.type)
+    {
+      case OTA_JOB_REHASH:
+        ota_rehash(job.offset);
+        break;
+
+      case OTA_JOB_WRITE:
+        if (!ota_write_buffer(&job))
+          ota_set_state(BLE_OTA_FAILED);
+        break;
+
+      case OTA_JOB_FINISH:
+      {
+        ble_char_error_t result = BLE_CHAR_ERR_VALUE;
+        if ((job.len == 0 || ota_write_buffer(&job)) && s_image.committed == s_image.size)
+          result = ota_check_image();
+
+        ota_set_state((result == BLE_CHAR_OK) ? BLE_OTA_READY : BLE_OTA_FAILED);
+        ble_store_erase(OTA_PROGRESS_KEY);
+        ble_store_commit();
+        ota_notify(OTA_EVT_CHECKED, result, 0);
+        ESP_LOGI(OTA_TAG, "Image of %lu bytes %s", (unsigned long)s_image.size, result ? "rejected" : "verified");
+        break;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Hand the filling buffer to the writer and switch to the other one
+ */
+static void ota_submit(ble_ota_job_type_t type)
+{
+  ble_ota_job_t job = {
+    .type = type,
+    .buf = s_fill,
+    .offset = s_fill_offset,
+    .len = s_fill_len,
+  };
+
+  // An empty final buffer is not written, so it must not stay marked busy
+  if (s_fill_len > 0)
+  {
+    taskENTER_CRITICAL(&s_ota_lock);
+    s_busy[s_fill] = true;
+    taskEXIT_CRITICAL(&s_ota_lock);
+  }
+
+  xQueueSend(s_jobs, &job, portMAX_DELAY);
+
+  s_fill ^= 1;
+  s_fill_offset += s_fill_len;
+  s_fill_len = 0;
+}
+
+static ble_char_error_t ota_open(uint8_t object, ble_xfer_dir_t dir, uint32_t *size)
+{
+  if (!ble_sec_link_authenticated())
+    return BLE_CHAR_ERR_READONLY;
+  if (dir != BLE_XFER_UPLOAD || s_status.state != BLE_OTA_RECEIVING || *size != s_image.size)
+    return BLE_CHAR_ERR_VALUE;
+  return BLE_CHAR_OK;
+}
+
+static ble_char_error_t ota_write(uint32_t offset, const uint8_t *data, size_t len)
+{
+  if (s_status.state != BLE_OTA_RECEIVING || offset != s_fill_offset + s_fill_len)
+    return BLE_CHAR_ERR_VALUE;
+
+  bool other_busy;
+  taskENTER_CRITICAL(&s_ota_lock);
+  other_busy = s_busy[s_fill ^ 1];
+  bool fill_busy = s_busy[s_fill];
+  taskEXIT_CRITICAL(&s_ota_lock);
+
+  // Nothing is taken unless the whole block fits, so a refused block can simply come again
+  if (fill_busy || (s_fill_len + len > OTA_SECTOR_SIZE && other_busy))
+  {
+    taskENTER_CRITICAL(&s_ota_lock);
+    s_status.flash_waits++;
+    taskEXIT_CRITICAL(&s_ota_lock);
+    return BLE_CHAR_ERR_BUSY;
+  }
+
+  size_t first = (len < OTA_SECTOR_SIZE - s_fill_len) ? len : OTA_SECTOR_SIZE - s_fill_len;
+  memcpy(&s_buf[s_fill][s_fill_len], data, first);
+  s_fill_len += first;
+
+  if (s_fill_len == OTA_SECTOR_SIZE)
+    ota_submit(OTA_JOB_WRITE);
+
+  if (first < len)
+  {
+    memcpy(s_buf[s_fill], &data[first], len - first);
+    s_fill_len = len - first;
+  }
+  return BLE_CHAR_OK;
+}
+
+static void ota_close(bool complete)
+{
+  if (s_status.state != BLE_OTA_RECEIVING)
+    return;
+
+  if (complete)
+  {
+    ota_set_state(BLE_OTA_VERIFYING);
+    ota_submit(OTA_JOB_FINISH);
+    return;
+  }
+
+  // Interrupted: the partial sector is dropped, BEGIN resumes from the last full one
+  s_fill_len = 0;
+}
+
+/**
+ * @brief BEGIN: start a new image or resume the one in flash
+ */
+static ble_char_error_t ota_begin(const uint8_t *data, size_t len)
+{
+  if (len < OTA_CONTROL_SIZE)
+    return BLE_CHAR_ERR_SIZE;
+
+  bool busy;
+  taskENTER_CRITICAL(&s_ota_lock);
+  busy = s_busy[0] || s_busy[1] || s_status.state == BLE_OTA_VERIFYING;
+  taskEXIT_CRITICAL(&s_ota_lock);
+  if (busy)
+    return BLE_CHAR_ERR_BUSY;
+
+  uint32_t size = get_u32(&data[1]);
+  if (size == 0 || size > s_partition->size)
+    return BLE_CHAR_ERR_VALUE;
+
+  // Same image as the stored or interrupted one: continue after its last full sector
+  ble_ota_progress_t stored = s_image;
+  size_t stored_len = sizeof(stored);
+  if (s_status.state != BLE_OTA_RECEIVING &&
+      (ble_store_get(OTA_PROGRESS_KEY, &stored, &stored_len) != ESP_OK || stored_len != sizeof(stored)))
+    memset(&stored, 0, sizeof(stored));
+
+  bool resume = stored.size == size && memcmp(stored.sha256, &data[5], 32) == 0;
+  uint32_t committed = resume ? stored.committed : 0;
+
+  s_image.size = size;
+  memcpy(s_image.sha256, &data[5], 32);
+  s_image.committed = committed;
+  s_fill = 0;
+  s_fill_offset = committed;
+  s_fill_len = 0;
+  s_sectors_since_save = 0;
+
+  taskENTER_CRITICAL(&s_ota_lock);
+  s_status.state = BLE_OTA_RECEIVING;
+  s_status.size = size;
+  s_status.written = committed;
+  s_status.resumed_from = committed;
+  s_busy[0] = true;  // Released by the writer once the hash covers the resumed part
+  s_busy[1] = true;
+  taskEXIT_CRITICAL(&s_ota_lock);
+
+  ble_ota_job_t job = {.type = OTA_JOB_REHASH, .offset = committed};
+  xQueueSend(s_jobs, &job, portMAX_DELAY);
+
+  ESP_LOGI(OTA_TAG, "Receiving %lu byte image from offset %lu", (unsigned long)size, (unsigned long)committed);
+  ota_notify(OTA_OP_BEGIN, BLE_CHAR_OK, committed);
+  return BLE_CHAR_OK;
+}
+
+static void ota_reboot(void *arg)
+{
+  esp_restart();
+}
+
+static ble_char_error_t ota_control_write(const uint8_t *data, size_t len)
+{
+  // The attribute permissions already demand it; an image from an unauthenticated peer is never taken
+  if (!ble_sec_link_authenticated())
+  {
+    ESP_LOGW(OTA_TAG, "Control write refused, link not authenticated");
+    return BLE_CHAR_ERR_READONLY;
+  }
+  if (len < 1)
+    return BLE_CHAR_ERR_SIZE;
+
+  ble_char_error_t result;
+  switch (data[0])
+  {
+    case OTA_OP_BEGIN:
+      result = ota_begin(data, len);
+      if (result != BLE_CHAR_OK)
+        ota_notify(OTA_OP_BEGIN, result, 0);
+      return result;
+
+    case OTA_OP_APPLY:
+      result = (s_status.state == BLE_OTA_READY) ? BLE_CHAR_OK : BLE_CHAR_ERR_BUSY;
+      ota_notify(OTA_OP_APPLY, result, 0);
+      if (result == BLE_CHAR_OK)
+      {
+        ESP_LOGW(OTA_TAG, "Rebooting into the new image");
+        esp_timer_start_once(s_reboot_timer, (uint64_t)OTA_REBOOT_DELAY_MS * 1000);
+      }
+      return result;
+
+    case OTA_OP_ABORT:
+      ble_store_erase(OTA_PROGRESS_KEY);
+      ble_store_commit();
+      s_fill_len = 0;
+      ota_set_state(BLE_OTA_IDLE);
+      ota_notify(OTA_OP_ABORT, BLE_CHAR_OK, 0);
+      return BLE_CHAR_OK;
+
+    default:
+      return BLE_CHAR_ERR_VALUE;
+  }
+}
+
+static int ota_control_read(uint8_t *out, size_t max_len)
+{
+  if (max_len < 9)
+    return -1;
+
+  ble_ota_status_t status;
+  ble_ota_get_status(&status);
+
+  out[0] = status.state;
+  put_u32(&out[1], status.written);
+  put_u32(&out[5], status.size);
+  return 9;
+}
+
+esp_err_t ble_ota_init(const ble_ota_config_t *config, ble_security_mode_t security, ble_characteristic_t *out,
+                       size_t index)
+{
+  if (security != BLE_SECURITY_BOND_SC_MITM)
+  {
+    ESP_LOGE(OTA_TAG, "Firmware updates need an authenticated link (BLE_SECURITY_BOND_SC_MITM)");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  s_partition = esp_ota_get_next_update_partition(NULL);
+  if (s_partition == NULL)
+  {
+    ESP_LOGE(OTA_TAG, "No OTA partition to update");
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  s_config = config;
+  s_index = index;
+  memset(&s_status, 0, sizeof(s_status));
+  memset(&s_image, 0, sizeof(s_image));
+
+  for (size_t i = 0; i < 2; i++)
+  {
+    s_buf[i] = (uint8_t *)malloc(OTA_SECTOR_SIZE);
+    s_busy[i] = false;
+    if (s_buf[i] == NULL)
+    {
+      ESP_LOGE(OTA_TAG, "Failed to allocate flash buffers");
+      ble_ota_deinit();
+      return ESP_ERR_NO_MEM;
+    }
+  }
+
+  const esp_timer_create_args_t timer_args = {
+    .callback = ota_reboot,
+    .name = "ble_ota",
+  };
+  s_jobs = xQueueCreate(2, sizeof(ble_ota_job_t));
+  if (s_jobs == NULL || esp_timer_create(&timer_args, &s_reboot_timer) != ESP_OK ||
+      xTaskCreate(ota_writer_task, "ble_ota", OTA_WRITER_STACK, NULL, OTA_WRITER_PRIORITY, &s_writer) != pdPASS)
+  {
+    ESP_LOGE(OTA_TAG, "Failed to start the flash writer");
+    ble_ota_deinit();
+    return ESP_ERR_NO_MEM;
+  }
+  mbedtls_sha256_init(&s_sha);
+
+  s_sink = (ble_xfer_config_t){
+    .open = ota_open,
+    .write = ota_write,
+    .close = ota_close,
+  };
+  ble_xfer_set_object_handler((config->object != 0) ? config->object : OTA_DEFAULT_OBJECT, &s_sink);
+
+  *out = (ble_characteristic_t){
+    .uuid = config->control_uuid,
+    .name = "OTA control",
+    .description = "Firmware update",
+    .size = OTA_CONTROL_SIZE,
+    .read = ota_control_read,
+    .write = ota_control_write,
+    .flags = BLE_CHAR_FLAG_NOTIFY_DIRECT,
+  };
+
+  ESP_LOGI(OTA_TAG, "Updates go to partition '%s' (%lu bytes)", s_partition->label, (unsigned long)s_partition->size);
+  return ESP_OK;
+}
+
+void ble_ota_deinit(void)
+{
+  if (s_writer != NULL)
+  {
+    vTaskDelete(s_writer);
+    s_writer = NULL;
+    mbedtls_sha256_free(&s_sha);
+  }
+  if (s_jobs != NULL)
+  {
+    vQueueDelete(s_jobs);
+    s_jobs = NULL;
+  }
+  if (s_reboot_timer != NULL)
+  {
+    esp_timer_stop(s_reboot_timer);
+    esp_timer_delete(s_reboot_timer);
+    s_reboot_timer = NULL;
+  }
+
+  for (size_t i = 0; i < 2; i++)
+  {
+    free(s_buf[i]);
+    s_buf[i] = NULL;
+  }
+  s_config = NULL;
+}
+
+void ble_ota_get_status(ble_ota_status_t *out)
+{
+  taskENTER_CRITICAL(&s_ota_lock);
+  *out = s_status;
+  taskEXIT_CRITICAL(&s_ota_lock);
+}
@@ -0,0 +1,221 @@
+/**
+ * @file ble-persist.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Write-behind persistence of characteristic values
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * Accepted writes to persistent characteristics only update a RAM copy. A timer
+ * started by the first change writes every changed value and commits once, so
+ * a value adjusted many times in a row costs a single flash write.
+ */
+
+#include "ble-persist.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ble-char.h"
+#include "ble-store.h"
+
+#define PERSIST_TAG      "BLE_PERSIST"
+#define PERSIST_FLUSH_MS 2000  // Changes are written at most this long after the first one
+#define PERSIST_KEY_FMT  "cv_%04x"
+
+// RAM copy of one persistent characteristic
+typedef struct
+{
+  uint8_t *value;  // NULL = characteristic not persistent
+  uint8_t len;
+  bool dirty;
+} ble_persist_slot_t;
+
+static const ble_characteristic_t *s_chars = NULL;
+static size_t s_count = 0;
+static ble_persist_slot_t s_slots[BLE_MAX_CHARACTERISTICS];
+static portMUX_TYPE s_persist_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t s_flush_timer = NULL;
+
+static void persist_key(size_t index, char *key, size_t key_size)
+{
+  snprintf(key, key_size, PERSIST_KEY_FMT, s_chars[index].uuid);
+}
+
+static void persist_flush_timeout(void *arg)
+{
+  ble_persist_flush();
+}
+
+esp_err_t ble_persist_init(const ble_characteristic_t *chars, size_t count)
+{
+  s_chars = chars;
+  s_count = (count > BLE_MAX_CHARACTERISTICS) ? BLE_MAX_CHARACTERISTICS : count;
+  memset(s_slots, 0, sizeof(s_slots));
+
+  size_t restored = 0;
+  for (size_t i = 0; i < s_count; i++)
+  {
+    const ble_characteristic_t *ch = &chars[i];
+    if (!(ch->flags & BLE_CHAR_FLAG_PERSISTENT) || ch->size == 0)
+      continue;
+
+    // The storage key is the UUID, so two persistent characteristics must not share one
+    for (size_t j = 0; j < i; j++)
+    {
+      if (s_slots[j].value != NULL && chars[j].uuid == ch->uuid)
+      {
+        ESP_LOGE(PERSIST_TAG, "'%s' and '%s' share UUID 0x%04x", chars[j].name, ch->name, ch->uuid);
+        ble_persist_deinit();
+        return ESP_ERR_INVALID_ARG;
+      }
+    }
+
+    s_slots[i].value = (uint8_t *)calloc(ch->size, sizeof(uint8_t));
+    if (s_slots[i].value == NULL)
+    {
+      ESP_LOGE(PERSIST_TAG, "Failed to allocate value cache for '%s'", ch->name);
+      ble_persist_deinit();
+      return ESP_ERR_NO_MEM;
+    }
+
+    char key[16];
+    size_t len = ch->size;
+    persist_key(i, key, sizeof(key));
+    if (ble_store_get(key, s_slots[i].value, &len) != ESP_OK || len == 0 || len > ch->size)
+      continue;
+
+    s_slots[i].len = len;
+
+    // Hand the value to the application before any client can read it
+    if (ble_char_is_writable(ch) && ble_char_write_value(ch, s_slots[i].value, len) != BLE_CHAR_OK)
+    {
+      ESP_LOGW(PERSIST_TAG, "Stored value for '%s' rejected by its write handler", ch->name);
+      continue;
+    }
+    restored++;
+  }
+
+  if (s_flush_timer == NULL)
+  {
+    const esp_timer_create_args_t timer_args = {
+      .callback = persist_flush_timeout,
+      .name = "ble_persist",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &s_flush_timer);
+    if (ret != ESP_OK)
+    {
+      ESP_LOGE(PERSIST_TAG, "Flush timer creation failed: %s", esp_err_to_name(ret));
+      ble_persist_deinit();
+      return ret;
+    }
+  }
+
+  if (restored > 0)
+    ESP_LOGI(PERSIST_TAG, "Restored %d persistent values", restored);
+  return ESP_OK;
+}
+
+void ble_persist_deinit(void)
+{
+  if (s_flush_timer != NULL)
+  {
+    esp_timer_stop(s_flush_timer);
+    esp_timer_delete(s_flush_timer);
+    s_flush_timer = NULL;
+  }
+
+  ble_persist_flush();
+
+  for (size_t i = 0; i < BLE_MAX_CHARACTERISTICS; i++)
+  {
+    free(s_slots[i].value);
+    s_slots[i].value = NULL;
+  }
+
+  s_chars = NULL;
+  s_count = 0;
+}
+
+void ble_persist_store(size_t index, const uint8_t *value, size_t len)
+{
+  if (index >= s_count || s_slots[index].value == NULL)
+    return;
+
+  if (len > s_chars[index].size)
+    len = s_chars[index].size;
+
+  bool changed;
+
+  taskENTER_CRITICAL(&s_persist_lock);
+  changed = (len != s_slots[index].len || memcmp(s_slots[index].value, value, len) != 0);
+  if (changed)
+  {
+    memcpy(s_slots[index].value, value, len);
+    s_slots[index].len = len;
+    s_slots[index].dirty = true;
+  }
+  taskEXIT_CRITICAL(&s_persist_lock);
+
+  // Writing the same value again costs nothing; a pending flush keeps its deadline
+  if (changed && s_flush_timer != NULL && !esp_timer_is_active(s_flush_timer))
+    esp_timer_start_once(s_flush_timer, (uint64_t)PERSIST_FLUSH_MS * 1000);
+}
+
+void ble_persist_flush(void)
+{
+  size_t written = 0;
+  bool retry = false;
+
+  for (size_t i = 0; i < s_count; i++)
+  {
+    uint8_t value[UINT8_MAX];
+    uint8_t len = 0;
+    bool dirty;
+
+    taskENTER_CRITICAL(&s_persist_lock);
+    dirty = s_slots[i].dirty;
+    if (dirty)
+    {
+      len = s_slots[i].len;
+      memcpy(value, s_slots[i].value, len);
+      s_slots[i].dirty = false;
+    }
+    taskEXIT_CRITICAL(&s_persist_lock);
+
+    if (!dirty)
+      continue;
+
+    char key[16];
+    persist_key(i, key, sizeof(key));
+    if (ble_store_set(key, value, len) != ESP_OK)
+    {
+      ESP_LOGW(PERSIST_TAG, "Persisting '%s' failed, retrying later", s_chars[i].name);
+
+      // A store made meanwhile already marked the slot with a newer value
+      taskENTER_CRITICAL(&s_persist_lock);
+      s_slots[i].dirty = true;
+      taskEXIT_CRITICAL(&s_persist_lock);
+      retry = true;
+      continue;
+    }
+    written++;
+  }
+
+  if (retry && s_flush_timer != NULL && !esp_timer_is_active(s_flush_timer))
+    esp_timer_start_once(s_flush_timer, (uint64_t)PERSIST_FLUSH_MS * 1000);
+
+  if (written == 0)
+    return;
+
+  esp_err_t ret = ble_store_commit();
+  if (ret != ESP_OK)
+    ESP_LOGW(PERSIST_TAG, "Commit failed: %s", esp_err_to_name(ret));
+  else
+    ESP_LOGI(PERSIST_TAG, "Persisted %d values in one commit", written);
+}
@@ -0,0 +1,432 @@
+/**
+ * @file ble-prop.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Property store - typed application keys behind one batched characteristic
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * The client writes a batch of operations and receives all results in one
+ * notification (the last response can also be read). All integers are little
+ * endian; values take the width of their type.
+ *
+ *   Request:   txn u8, operations
+ *     0x01 GET   id u16
+ *     0x02 SET   id u16, value
+ *     0x03 LIST  first id u16, max count u8
+ *
+ *   Response:  txn u8, answered u8, results in request order
+ *     GET        id u16, status u8, value (status 0 only)
+ *     SET        id u16, status u8
+ *     LIST       count u8, count x (id u16, type u8 | 0x80 if read-only)
+ *
+ * Status bytes are ble_char_error_t values. The whole request is parsed
+ * before anything runs, so a malformed batch fails the write without side
+ * effects. Operations run in order until the next result would not fit the
+ * MTU; answered tells the client where to resend from.
+ *
+ * Keys are looked up by binary search in the application's sorted table, and
+ * results are built in a static buffer: a batch never allocates.
+ */
+
+#include "ble-prop.h"
+
+#include <esp_gatt_defs.h>
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ble-gatts.h"
+
+#define PROP_TAG "BLE_PROP"
+
+#define PROP_OP_GET  0x01
+#define PROP_OP_SET  0x02
+#define PROP_OP_LIST 0x03
+
+#define PROP_RSP_HEADER    2     // txn, answered
+#define PROP_LIST_READONLY 0x80  // Set in the type byte of read-only keys
+
+static const ble_prop_config_t *s_config = NULL;
+static size_t s_index = 0;
+static uint32_t *s_values = NULL;  // Raw value of each key, in table order
+static uint8_t s_response[ESP_GATT_MAX_ATTR_LEN];
+static size_t s_response_len = 0;
+static portMUX_TYPE s_prop_lock = portMUX_INITIALIZER_UNLOCKED;
+static ble_prop_stats_t s_stats = {0};
+
+static size_t type_width(ble_value_type_t type)
+{
+  switch (type)
+  {
+    case BLE_VALUE_U8:
+    case BLE_VALUE_I8:
+      return 1;
+    case BLE_VALUE_U16:
+    case BLE_VALUE_I16:
+      return 2;
+    case BLE_VALUE_U32:
+    case BLE_VALUE_I32:
+      return 4;
+    default:
+      return 0;  // Not a property type
+  }
+}
+
+static bool type_signed(ble_value_type_t type)
+{
+  return type == BLE_VALUE_I8 || type == BLE_VALUE_I16 || type == BLE_VALUE_I32;
+}
+
+static int64_t raw_to_value(ble_value_type_t type, uint32_t raw)
+{
+  size_t bits = type_width(type) * 8;
+  if (type_signed(type) && bits < 32 && (raw & (1u << (bits - 1))))
+    raw |= ~((1u << bits) - 1);  // Sign-extend to 32 bits
+  return type_signed(type) ? (int64_t)(int32_t)raw : (int64_t)raw;
+}
+
+// Raw values keep only the bytes of their type, so equal values compare equal
+static uint32_t value_to_raw(ble_value_type_t type, int64_t value)
+{
+  size_t bits = type_width(type) * 8;
+  return (bits < 32) ? (uint32_t)value & ((1u << bits) - 1) : (uint32_t)value;
+}
+
+static bool value_in_range(const ble_prop_def_t *def, int64_t value)
+{
+  if (def->min != 0 || def->max != 0)
+    return value >= def->min && value <= def->max;
+
+  size_t bits = type_width(def->type) * 8;
+  if (type_signed(def->type))
+    return value >= -((int64_t)1 << (bits - 1)) && value < ((int64_t)1 << (bits - 1));
+  return value >= 0 && value < ((int64_t)1 << bits);
+}
+
+static uint32_t get_le(const uint8_t *in, size_t width)
+{
+  uint32_t value = 0;
+  for (size_t i = 0; i < width; i++)
+    value |= (uint32_t)in[i] << (8 * i);
+  return value;
+}
+
+static void put_le(uint8_t *out, uint32_t value, size_t width)
+{
+  for (size_t i = 0; i < width; i++)
+    out[i] = (uint8_t)(value >> (8 * i));
+}
+
+/**
+ * @brief Binary search of the sorted key table
+ *
+ * @return Position of the key, or -1 if unknown
+ */
+static int prop_find(uint16_t id)
+{
+  size_t lo = 0, hi = s_config->prop_count;
+  while (lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    uint16_t key = s_config->props[mid].id;
+    if (key == id)
+      return (int)mid;
+    if (key < id)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return -1;
+}
+
+/**
+ * @brief First table position with an id not below the given one
+ */
+static size_t prop_lower_bound(uint16_t id)
+{
+  size_t lo = 0, hi = s_config->prop_count;
+  while (lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    if (s_config->props[mid].id < id)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/**
+ * @brief Validate and store a client SET
+ */
+static ble_char_error_t prop_set(size_t pos, const uint8_t *in)
+{
+  const ble_prop_def_t *def = &s_config->props[pos];
+  uint32_t raw = get_le(in, type_width(def->type));
+  int64_t value = raw_to_value(def->type, raw);
+
+  if (def->readonly)
+    return BLE_CHAR_ERR_READONLY;
+  if (!value_in_range(def, value))
+    return BLE_CHAR_ERR_VALUE;
+  if (s_config->validate != NULL)
+  {
+    ble_char_error_t result = s_config->validate(def->id, value);
+    if (result != BLE_CHAR_OK)
+      return result;
+  }
+
+  uint32_t old = __atomic_exchange_n(&s_values[pos], raw, __ATOMIC_RELAXED);
+  if (old != raw && s_config->on_change != NULL)
+    s_config->on_change(def->id, value);
+  return BLE_CHAR_OK;
+}
+
+/**
+ * @brief Check the framing of a whole batch
+ */
+static ble_char_error_t prop_parse(const uint8_t *data, size_t len, size_t *ops)
+{
+  size_t at = 1;  // After txn
+  *ops = 0;
+
+  while (at < len)
+  {
+    uint8_t op = data[at];
+    size_t need = (op == PROP_OP_LIST) ? 4 : 3;
+    if (op != PROP_OP_GET && op != PROP_OP_SET && op != PROP_OP_LIST)
+      return BLE_CHAR_ERR_VALUE;
+    if (at + need > len)
+      return BLE_CHAR_ERR_SIZE;
+
+    if (op == PROP_OP_SET)
+    {
+      // The key decides how many value bytes follow
+      int pos = prop_find(get_le(&data[at + 1], 2));
+      if (pos < 0)
+        return BLE_CHAR_ERR_VALUE;
+      need += type_width(s_config->props[pos].type);
+      if (at + need > len)
+        return BLE_CHAR_ERR_SIZE;
+    }
+
+    at += need;
+    (*ops)++;
+  }
+  return BLE_CHAR_OK;
+}
+
+static ble_char_error_t prop_write(const uint8_t *data, size_t len)
+{
+  size_t ops;
+
+  if (len < 1)
+    return BLE_CHAR_ERR_SIZE;
+
+  ble_char_error_t result = prop_parse(data, len, &ops);
+  if (result != BLE_CHAR_OK)
+  {
+    taskENTER_CRITICAL(&s_prop_lock);
+    s_stats.malformed++;
+    taskEXIT_CRITICAL(&s_prop_lock);
+    return result;
+  }
+
+  size_t limit = ble_gatts_get_mtu() - BLE_ATT_NOTIFY_HEADER;
+  if (limit > sizeof(s_response))
+    limit = sizeof(s_response);
+
+  size_t out = PROP_RSP_HEADER;
+  size_t at = 1;
+  uint8_t answered = 0;
+  uint32_t gets = 0, sets = 0, rejected = 0;
+
+  for (size_t n = 0; n < ops; n++)
+  {
+    uint8_t op = data[at];
+    uint16_t id = get_le(&data[at + 1], 2);
+    int pos = prop_find(id);
+    size_t width = (pos >= 0) ? type_width(s_config->props[pos].type) : 0;
+
+    if (op == PROP_OP_GET)
+    {
+      if (out + 3 + width > limit)
+        break;
+      put_le(&s_response[out], id, 2);
+      s_response[out + 2] = (pos >= 0) ? BLE_CHAR_OK : BLE_CHAR_ERR_VALUE;
+      out += 3;
+      if (pos >= 0)
+      {
+        put_le(&s_response[out], __atomic_load_n(&s_values[pos], __ATOMIC_RELAXED), width);
+        out += width;
+      }
+      gets++;
+      rejected += (pos < 0) ? 1 : 0;
+      at += 3;
+    }
+    else if (op == PROP_OP_SET)
+    {
+      if (out + 3 > limit)
+        break;
+      ble_char_error_t status = prop_set(pos, &data[at + 3]);
+      put_le(&s_response[out], id, 2);
+      s_response[out + 2] = status;
+      out += 3;
+      sets++;
+      rejected += (status != BLE_CHAR_OK) ? 1 : 0;
+      at += 3 + width;
+    }
+    else
+    {
+      size_t first = prop_lower_bound(id);
+      size_t count = data[at + 3];
+      if (out + 1 + 3 > limit)
+        break;
+      if (count > (limit - out - 1) / 3)
+        count = (limit - out - 1) / 3;
+      if (count > s_config->prop_count - first)
+        count = s_config->prop_count - first;
+
+      s_response[out++] = count;
+      for (size_t i = first; i < first + count; i++)
+      {
+        const ble_prop_def_t *def = &s_config->props[i];
+        put_le(&s_response[out], def->id, 2);
+        s_response[out + 2] = (uint8_t)def->type | (def->readonly ? PROP_LIST_READONLY : 0);
+        out += 3;
+      }
+      at += 4;
+    }
+    answered++;
+  }
+
+  s_response[0] = data[0];
+  s_response[1] = answered;
+  s_response_len = out;
+
+  taskENTER_CRITICAL(&s_prop_lock);
+  s_stats.batches++;
+  s_stats.gets += gets;
+  s_stats.sets += sets;
+  s_stats.rejected += rejected;
+  if (answered < ops)
+    s_stats.truncated++;
+  taskEXIT_CRITICAL(&s_prop_lock);
+
+  // A missed notification is recovered by reading the characteristic
+  ble_gatts_notify(s_index, s_response, s_response_len);
+  return BLE_CHAR_OK;
+}
+
+static int prop_read(uint8_t *out_buffer, size_t max_len)
+{
+  size_t len = (s_response_len < max_len) ? s_response_len : max_len;
+  memcpy(out_buffer, s_response, len);
+  return len;
+}
+
+esp_err_t ble_prop_init(const ble_prop_config_t *config, ble_characteristic_t *out, size_t index)
+{
+  if (config->props == NULL || config->prop_count == 0)
+  {
+    ESP_LOGE(PROP_TAG, "No properties");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  for (size_t i = 0; i < config->prop_count; i++)
+  {
+    const ble_prop_def_t *def = &config->props[i];
+    if (i > 0 && def->id <= config->props[i - 1].id)
+    {
+      ESP_LOGE(PROP_TAG, "Property 0x%04X out of order (table must be sorted by id)", def->id);
+      return ESP_ERR_INVALID_ARG;
+    }
+    if (type_width(def->type) == 0 || def->min > def->max)
+    {
+      ESP_LOGE(PROP_TAG, "Property 0x%04X has an invalid type or bounds", def->id);
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+
+  s_values = (uint32_t *)calloc(config->prop_count, sizeof(uint32_t));
+  if (s_values == NULL)
+  {
+    ESP_LOGE(PROP_TAG, "Failed to allocate the value table");
+    return ESP_ERR_NO_MEM;
+  }
+
+  s_config = config;
+  for (size_t i = 0; i < config->prop_count; i++)
+  {
+    if (!value_in_range(&config->props[i], config->props[i].def))
+    {
+      ESP_LOGE(PROP_TAG, "Default of property 0x%04X out of bounds", config->props[i].id);
+      ble_prop_deinit();
+      return ESP_ERR_INVALID_ARG;
+    }
+    s_values[i] = value_to_raw(config->props[i].type, config->props[i].def);
+  }
+
+  s_index = index;
+  s_response_len = 0;
+
+  *out = (ble_characteristic_t){
+    .uuid = config->uuid,
+    .name = "Property store",
+    .description = "Property store",
+    .size = UINT8_MAX,
+    .read = prop_read,
+    .write = prop_write,
+    .flags = BLE_CHAR_FLAG_NOTIFY_DIRECT,
+  };
+
+  ESP_LOGI(PROP_TAG, "Property store with %d keys", config->prop_count);
+  return ESP_OK;
+}
+
+void ble_prop_deinit(void)
+{
+  free(s_values);
+  s_values = NULL;
+  s_config = NULL;
+}
+
+ble_return_code_t ble_prop_get(uint16_t id, int64_t *value)
+{
+  if (value == NULL)
+    return BLE_INVALID_CONFIG;
+  if (s_values == NULL)
+    return BLE_NOT_INITIALIZED;
+
+  int pos = prop_find(id);
+  if (pos < 0)
+    return BLE_INVALID_CHARS;
+
+  *value = raw_to_value(s_config->props[pos].type, __atomic_load_n(&s_values[pos], __ATOMIC_RELAXED));
+  return BLE_SUCCESS;
+}
+
+ble_return_code_t ble_prop_set(uint16_t id, int64_t value)
+{
+  if (s_values == NULL)
+    return BLE_NOT_INITIALIZED;
+
+  int pos = prop_find(id);
+  if (pos < 0)
+    return BLE_INVALID_CHARS;
+  if (!value_in_range(&s_config->props[pos], value))
+    return BLE_INVALID_CONFIG;
+
+  __atomic_store_n(&s_values[pos], value_to_raw(s_config->props[pos].type, value), __ATOMIC_RELAXED);
+  return BLE_SUCCESS;
+}
+
+void ble_prop_get_stats(ble_prop_stats_t *out)
+{
+  taskENTER_CRITICAL(&s_prop_lock);
+  *out = s_stats;
+  taskEXIT_CRITICAL(&s_prop_lock);
+}
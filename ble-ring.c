@@ -0,0 +1,79 @@
+/**
+ * @file ble-ring.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Single-producer single-consumer byte ring
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "ble-ring.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool ble_ring_alloc(ble_ring_t *r, size_t size)
+{
+  size_t pow2 = 1;
+  while (pow2 < size)
+    pow2 <<= 1;
+
+  r->buf = (uint8_t *)malloc(pow2);
+  r->mask = pow2 - 1;
+  r->head = 0;
+  r->tail = 0;
+  return r->buf != NULL;
+}
+
+void ble_ring_release(ble_ring_t *r)
+{
+  free(r->buf);
+  memset(r, 0, sizeof(*r));
+}
+
+size_t ble_ring_used(const ble_ring_t *r)
+{
+  return __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+}
+
+size_t ble_ring_space(const ble_ring_t *r)
+{
+  return r->mask + 1 - ble_ring_used(r);
+}
+
+size_t ble_ring_put(ble_ring_t *r, const uint8_t *data, size_t len)
+{
+  uint32_t head = r->head;
+  size_t room = ble_ring_space(r);
+  if (len > room)
+    len = room;
+
+  size_t at = head & r->mask;
+  size_t first = (len < r->mask + 1 - at) ? len : r->mask + 1 - at;
+  memcpy(&r->buf[at], data, first);
+  memcpy(r->buf, &data[first], len - first);
+
+  __atomic_store_n(&r->head, head + len, __ATOMIC_RELEASE);
+  return len;
+}
+
+size_t ble_ring_peek(const ble_ring_t *r, uint8_t *out, size_t len)
+{
+  uint32_t tail = r->tail;
+  size_t used = ble_ring_used(r);
+  if (len > used)
+    len = used;
+
+  size_t at = tail & r->mask;
+  size_t first = (len < r->mask + 1 - at) ? len : r->mask + 1 - at;
+  memcpy(out, &r->buf[at], first);
+  memcpy(&out[first], r->buf, len - first);
+  return len;
+}
+
+void ble_ring_consume(ble_ring_t *r, size_t len)
+{
+  __atomic_store_n(&r->tail, r->tail + len, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,435 @@
+/**
+ * @file ble-rpc.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief RPC transport - pipelined method calls over a request/response characteristic pair
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * The client writes requests without response to the request characteristic
+ * and receives responses as notifications of the response characteristic.
+ * Messages longer than one PDU are segmented; the header tells them apart by
+ * the client-chosen call id. All integers are little endian.
+ *
+ *   Request segment:   id u8, seq u8, [seq 0: method u8, length u16], data
+ *   Response segment:  id u8, seq u8, [seq 0: status u8, flags u8, length u16], data
+ *
+ * seq counts the segments of one message from 0. A response with
+ * RPC_FLAG_MORE set is a streamed part; the call ends with the response
+ * without it. Status bytes are ble_char_error_t values.
+ *
+ * Requests are reassembled in the Bluetooth task into one of RPC_MAX_CALLS
+ * slots, so the client can pipeline that many calls without waiting. A task
+ * runs the handlers in arrival order, which keeps blocking handlers and
+ * response flow control out of the Bluetooth task.
+ */
+
+#include "ble-rpc.h"
+
+#include <esp_gatt_defs.h>
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ble-gatts.h"
+
+#define RPC_TAG             "BLE_RPC"
+#define RPC_MAX_CALLS       4     // Calls received but not answered yet
+#define RPC_SEND_TIMEOUT_MS 1000  // Longest wait for the link to take one response segment
+#define RPC_TASK_STACK      4096
+#define RPC_TASK_PRIORITY   5
+
+#define RPC_REQ_HEADER  5  // id, seq, method, length
+#define RPC_RSP_HEADER  6  // id, seq, status, flags, length
+#define RPC_CONT_HEADER 2  // id, seq
+#define RPC_FLAG_MORE   0x01
+
+typedef enum
+{
+  RPC_SLOT_FREE = 0,
+  RPC_SLOT_RECEIVING,  // Bluetooth task is reassembling the request
+  RPC_SLOT_QUEUED,     // Owned by the dispatch task
+} ble_rpc_slot_state_t;
+
+typedef struct
+{
+  ble_rpc_slot_state_t state;
+  uint8_t id;
+  uint8_t method;
+  uint8_t next_seq;
+  uint16_t len;
+  uint16_t received;
+  uint8_t args[BLE_RPC_MAX_MESSAGE];
+} ble_rpc_slot_t;
+
+static const ble_rpc_config_t *s_config = NULL;
+static size_t s_response_index = 0;
+static ble_rpc_slot_t *s_slots = NULL;
+static QueueHandle_t s_calls = NULL;  // Slot indexes of complete requests
+static TaskHandle_t s_task = NULL;
+static uint8_t s_result[BLE_RPC_MAX_MESSAGE];  // Dispatch task only
+static portMUX_TYPE s_rpc_lock = portMUX_INITIALIZER_UNLOCKED;
+static ble_rpc_stats_t s_stats = {0};
+
+static void put_u16(uint8_t *out, uint16_t value)
+{
+  out[0] = (uint8_t)(value & 0xFF);
+  out[1] = (uint8_t)(value >> 8);
+}
+
+static uint16_t get_u16(const uint8_t *in)
+{
+  return in[0] | ((uint16_t)in[1] << 8);
+}
+
+/**
+ * @brief Answer a request with a bare status from the Bluetooth task, without waiting for the link
+ */
+static void rpc_reject(uint8_t id, ble_char_error_t status)
+{
+  uint8_t pdu[RPC_RSP_HEADER] = {id, 0, status, 0, 0, 0};
+  bool sent = ble_gatts_notify(s_response_index, pdu, sizeof(pdu)) == ESP_OK;
+
+  taskENTER_CRITICAL(&s_rpc_lock);
+  s_stats.rejected++;
+  if (!sent)
+    s_stats.responses_dropped++;
+  taskEXIT_CRITICAL(&s_rpc_lock);
+}
+
+/**
+ * @brief Send one response message, segmented to the MTU. Dispatch task.
+ */
+static ble_return_code_t rpc_send(uint8_t id, ble_char_error_t status, uint8_t flags, const uint8_t *data, size_t len)
+{
+  uint8_t pdu[ESP_GATT_MAX_ATTR_LEN];
+  size_t sent = 0;
+  uint8_t seq = 0;
+
+  do
+  {
+    size_t header = (seq == 0) ? RPC_RSP_HEADER : RPC_CONT_HEADER;
+    size_t room = ble_gatts_get_mtu() - BLE_ATT_NOTIFY_HEADER - header;
+    size_t chunk = (len - sent < room) ? len - sent : room;
+
+    pdu[0] = id;
+    pdu[1] = seq;
+    if (seq == 0)
+    {
+      pdu[2] = status;
+      pdu[3] = flags;
+      put_u16(&pdu[4], (uint16_t)len);
+    }
+    memcpy(&pdu[header], &data[sent], chunk);
+
+    // Congested: the controller drains one connection event at a time
+    TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(RPC_SEND_TIMEOUT_MS);
+    while (ble_gatts_notify(s_response_index, pdu, header + chunk) != ESP_OK)
+    {
+      if (!ble_gatts_is_connected() || xTaskGetTickCount() >= deadline)
+      {
+        taskENTER_CRITICAL(&s_rpc_lock);
+        s_stats.responses_dropped++;
+        taskEXIT_CRITICAL(&s_rpc_lock);
+        return ble_gatts_is_connected() ? BLE_TIMEOUT : BLE_NOT_INITIALIZED;
+      }
+      vTaskDelay(1);
+    }
+
+    sent += chunk;
+    seq++;
+    taskENTER_CRITICAL(&s_rpc_lock);
+    s_stats.segments_sent++;
+    taskEXIT_CRITICAL(&s_rpc_lock);
+  } while (sent < len);
+
+  return BLE_SUCCESS;
+}
+
+static const ble_rpc_method_t *rpc_find(uint8_t method)
+{
+  for (size_t i = 0; i < s_config->method_count; i++)
+  {
+    if (s_config->methods[i].id == method)
+      return &s_config->methods[i];
+  }
+  return NULL;
+}
+
+static void rpc_dispatch(const ble_rpc_slot_t *slot)
+{
+  const ble_rpc_call_t call = {
+    .id = slot->id,
+    .method = slot->method,
+    .args = slot->args,
+    .len = slot->len,
+  };
+
+  const ble_rpc_method_t *method = rpc_find(call.method);
+  size_t result_len = sizeof(s_result);
+  ble_char_error_t status = BLE_CHAR_ERR_VALUE;
+
+  if (method != NULL)
+    status = method->handler(&call, s_result, &result_len);
+  if (status != BLE_CHAR_OK || result_len > sizeof(s_result))
+    result_len = 0;
+
+  rpc_send(call.id, status, 0, s_result, result_len);
+
+  taskENTER_CRITICAL(&s_rpc_lock);
+  s_stats.calls++;
+  if (status != BLE_CHAR_OK)
+    s_stats.failed++;
+  taskEXIT_CRITICAL(&s_rpc_lock);
+}
+
+static void rpc_task(void *arg)
+{
+  uint8_t index;
+
+  for (;;)
+  {
+    if (xQueueReceive(s_calls, &index, portMAX_DELAY) != pdTRUE)
+      continue;
+
+    rpc_dispatch(&s_slots[index]);
+
+    taskENTER_CRITICAL(&s_rpc_lock);
+    s_slots[index].state = RPC_SLOT_FREE;
+    taskEXIT_CRITICAL(&s_rpc_lock);
+  }
+}
+
+/**
+ * @brief Take the slot of a new request, restarting one the client abandoned under the same id
+ */
+static ble_rpc_slot_t *rpc_slot_open(uint8_t id)
+{
+  ble_rpc_slot_t *slot = NULL;
+  size_t in_flight = 0;
+
+  taskENTER_CRITICAL(&s_rpc_lock);
+  for (size_t i = 0; i < RPC_MAX_CALLS; i++)
+  {
+    if (s_slots[i].state == RPC_SLOT_RECEIVING && s_slots[i].id == id)
+      slot = &s_slots[i];
+  }
+  for (size_t i = 0; i < RPC_MAX_CALLS && slot == NULL; i++)
+  {
+    if (s_slots[i].state == RPC_SLOT_FREE)
+      slot = &s_slots[i];
+  }
+  if (slot != NULL)
+  {
+    slot->state = RPC_SLOT_RECEIVING;
+    for (size_t i = 0; i < RPC_MAX_CALLS; i++)
+      in_flight += (s_slots[i].state != RPC_SLOT_FREE) ? 1 : 0;
+    if (in_flight > s_stats.max_in_flight)
+      s_stats.max_in_flight = in_flight;
+  }
+  taskEXIT_CRITICAL(&s_rpc_lock);
+
+  return slot;
+}
+
+static ble_rpc_slot_t *rpc_slot_find(uint8_t id)
+{
+  for (size_t i = 0; i < RPC_MAX_CALLS; i++)
+  {
+    if (s_slots[i].state == RPC_SLOT_RECEIVING && s_slots[i].id == id)
+      return &s_slots[i];
+  }
+  return NULL;
+}
+
+static void rpc_slot_drop(ble_rpc_slot_t *slot)
+{
+  taskENTER_CRITICAL(&s_rpc_lock);
+  slot->state = RPC_SLOT_FREE;
+  taskEXIT_CRITICAL(&s_rpc_lock);
+}
+
+static ble_char_error_t rpc_request_write(const uint8_t *data, size_t len)
+{
+  if (len < RPC_CONT_HEADER)
+    return BLE_CHAR_ERR_SIZE;
+
+  uint8_t id = data[0];
+  uint8_t seq = data[1];
+  ble_rpc_slot_t *slot;
+  size_t header;
+
+  taskENTER_CRITICAL(&s_rpc_lock);
+  s_stats.segments_received++;
+  taskEXIT_CRITICAL(&s_rpc_lock);
+
+  if (seq == 0)
+  {
+    if (len < RPC_REQ_HEADER)
+      return BLE_CHAR_ERR_SIZE;
+    if (get_u16(&data[3]) > BLE_RPC_MAX_MESSAGE)
+    {
+      rpc_reject(id, BLE_CHAR_ERR_SIZE);
+      return BLE_CHAR_OK;
+    }
+
+    slot = rpc_slot_open(id);
+    if (slot == NULL)
+    {
+      rpc_reject(id, BLE_CHAR_ERR_BUSY);  // Pipeline full, the client retries after a response
+      return BLE_CHAR_OK;
+    }
+
+    slot->id = id;
+    slot->method = data[2];
+    slot->len = get_u16(&data[3]);
+    slot->received = 0;
+    slot->next_seq = 0;
+    header = RPC_REQ_HEADER;
+  }
+  else
+  {
+    slot = rpc_slot_find(id);
+    if (slot == NULL)
+      return BLE_CHAR_OK;  // Rest of a request already rejected
+    header = RPC_CONT_HEADER;
+  }
+
+  size_t chunk = len - header;
+  if (seq != slot->next_seq || slot->received + chunk > slot->len)
+  {
+    // A lost segment or a length mismatch: the whole call fails
+    ble_char_error_t status = (seq != slot->next_seq) ? BLE_CHAR_ERR_VALUE : BLE_CHAR_ERR_SIZE;
+    rpc_slot_drop(slot);
+    rpc_reject(id, status);
+    return BLE_CHAR_OK;
+  }
+
+  memcpy(&slot->args[slot->received], &data[header], chunk);
+  slot->received += chunk;
+  slot->next_seq++;
+
+  if (slot->received == slot->len)
+  {
+    taskENTER_CRITICAL(&s_rpc_lock);
+    slot->state = RPC_SLOT_QUEUED;
+    taskEXIT_CRITICAL(&s_rpc_lock);
+
+    uint8_t index = slot - s_slots;
+    xQueueSend(s_calls, &index, 0);  // Cannot fail, the queue holds every slot
+  }
+
+  return BLE_CHAR_OK;
+}
+
+esp_err_t ble_rpc_init(const ble_rpc_config_t *config, ble_characteristic_t *out, size_t index)
+{
+  if (config->methods == NULL || config->method_count == 0)
+  {
+    ESP_LOGE(RPC_TAG, "No RPC methods");
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (size_t i = 0; i < config->method_count; i++)
+  {
+    for (size_t j = 0; j < i; j++)
+    {
+      if (config->methods[j].id == config->methods[i].id)
+      {
+        ESP_LOGE(RPC_TAG, "Duplicate RPC method 0x%02X", config->methods[i].id);
+        return ESP_ERR_INVALID_ARG;
+      }
+    }
+    if (config->methods[i].handler == NULL)
+    {
+      ESP_LOGE(RPC_TAG, "RPC method 0x%02X has no handler", config->methods[i].id);
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+
+  s_config = config;
+  s_response_index = index + 1;
+  memset(&s_stats, 0, sizeof(s_stats));
+
+  s_slots = (ble_rpc_slot_t *)calloc(RPC_MAX_CALLS, sizeof(ble_rpc_slot_t));
+  s_calls = xQueueCreate(RPC_MAX_CALLS, sizeof(uint8_t));
+  if (s_slots == NULL || s_calls == NULL ||
+      xTaskCreate(rpc_task, "ble_rpc", RPC_TASK_STACK, NULL, RPC_TASK_PRIORITY, &s_task) != pdPASS)
+  {
+    ESP_LOGE(RPC_TAG, "Failed to start the RPC dispatcher");
+    ble_rpc_deinit();
+    return ESP_ERR_NO_MEM;
+  }
+
+  out[0] = (ble_characteristic_t){
+    .uuid = config->request_uuid,
+    .name = "RPC request",
+    .description = "RPC request",
+    .size = UINT8_MAX,
+    .write = rpc_request_write,
+    .flags = BLE_CHAR_FLAG_WRITE_NO_RSP,
+  };
+  out[1] = (ble_characteristic_t){
+    .uuid = config->response_uuid,
+    .name = "RPC response",
+    .description = "RPC response",
+    .size = UINT8_MAX,
+    .flags = BLE_CHAR_FLAG_NOTIFY_DIRECT,
+  };
+
+  ESP_LOGI(RPC_TAG, "RPC with %d methods, %d calls in flight", config->method_count, RPC_MAX_CALLS);
+  return ESP_OK;
+}
+
+void ble_rpc_deinit(void)
+{
+  if (s_task != NULL)
+  {
+    vTaskDelete(s_task);
+    s_task = NULL;
+  }
+  if (s_calls != NULL)
+  {
+    vQueueDelete(s_calls);
+    s_calls = NULL;
+  }
+
+  free(s_slots);
+  s_slots = NULL;
+  s_config = NULL;
+}
+
+void ble_rpc_reset(void)
+{
+  if (s_slots == NULL)
+    return;
+
+  // Queued calls still run; their responses are dropped with the link
+  taskENTER_CRITICAL(&s_rpc_lock);
+  for (size_t i = 0; i < RPC_MAX_CALLS; i++)
+  {
+    if (s_slots[i].state == RPC_SLOT_RECEIVING)
+      s_slots[i].state = RPC_SLOT_FREE;
+  }
+  taskEXIT_CRITICAL(&s_rpc_lock);
+}
+
+ble_return_code_t ble_rpc_stream(const ble_rpc_call_t *call, const void *data, size_t len)
+{
+  if (call == NULL || (data == NULL && len > 0) || len > BLE_RPC_MAX_MESSAGE)
+    return BLE_INVALID_CONFIG;
+  if (s_task == NULL || xTaskGetCurrentTaskHandle() != s_task)
+    return BLE_NOT_INITIALIZED;  // Only valid inside a method handler
+
+  return rpc_send(call->id, BLE_CHAR_OK, RPC_FLAG_MORE, data, len);
+}
+
+void ble_rpc_get_stats(ble_rpc_stats_t *out)
+{
+  taskENTER_CRITICAL(&s_rpc_lock);
+  *out = s_stats;
+  taskEXIT_CRITICAL(&s_rpc_lock);
+}
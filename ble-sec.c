@@ -0,0 +1,457 @@
+/**
+ * @file ble-sec.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Security Manager - LE Secure Connections bonding with LRU bond table
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * Keys (LTK, IRK, identity) are persisted by Bluedroid itself in NVS. This module
+ * keeps the usage order of the bonds in BLE storage so that the least recently
+ * used bond is evicted instead of the oldest one.
+ */
+
+#include "ble-sec.h"
+
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <mbedtls/aes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ble-bond.h"
+#include "ble-gatts.h"
+#include "ble-store.h"
+
+#define SEC_TAG "BLE_SEC"
+
+#ifdef CONFIG_BT_SMP_MAX_BONDS
+#define SEC_STACK_MAX_BONDS CONFIG_BT_SMP_MAX_BONDS
+#else
+#define SEC_STACK_MAX_BONDS 15
+#endif
+
+#define SEC_LRU_KEY     "sec_lru"
+#define SEC_KEY_SIZE    16
+#define SEC_PASSKEY_MAX 999999
+
+static ble_security_mode_t s_mode = BLE_SECURITY_NONE;
+static uint8_t s_max_bonds = SEC_STACK_MAX_BONDS - 1;
+
+static bool s_service_changed = false;
+
+static ble_bond_entry_t s_lru[SEC_STACK_MAX_BONDS];
+static uint32_t s_lru_clock = 0;
+static uint32_t s_db_hash = 0;
+
+// Current link
+static bool s_link_bonded = false;
+static bool s_link_authenticated = false;  // Encrypted with keys from a MITM-protected pairing
+static uint8_t s_link_identity[ESP_BD_ADDR_LEN];
+
+// Statistics
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static ble_security_stats_t s_stats = {0};
+
+/**
+ * @brief Check if an address is a resolvable private address
+ */
+static bool sec_is_rpa(const uint8_t *bda, uint8_t addr_type)
+{
+  return addr_type == BLE_ADDR_TYPE_RANDOM && (bda[0] & 0xC0) == 0x40;
+}
+
+bool ble_sec_rpa_matches(const uint8_t *irk, const uint8_t *rpa)
+{
+  // ah(k, r) = e(k, padding || prand) mod 2^24, with e() working on MSB-first blocks
+  uint8_t key[SEC_KEY_SIZE];
+  uint8_t plaintext[SEC_KEY_SIZE] = {0};
+  uint8_t out[SEC_KEY_SIZE];
+
+  for (int i = 0; i < SEC_KEY_SIZE; i++)
+    key[i] = irk[SEC_KEY_SIZE - 1 - i];
+
+  plaintext[13] = rpa[0];
+  plaintext[14] = rpa[1];
+  plaintext[15] = rpa[2];
+
+  mbedtls_aes_context ctx;
+  mbedtls_aes_init(&ctx);
+  int ret = mbedtls_aes_setkey_enc(&ctx, key, SEC_KEY_SIZE * 8);
+  if (ret == 0)
+    ret = mbedtls_aes_crypt_ecb(&ctx, MBEDTLS_AES_ENCRYPT, plaintext, out);
+  mbedtls_aes_free(&ctx);
+
+  if (ret != 0)
+    return false;
+
+  return out[13] == rpa[3] && out[14] == rpa[4] && out[15] == rpa[5];
+}
+
+/**
+ * @brief Get the bond list from the stack. The caller frees the returned list.
+ */
+static esp_ble_bond_dev_t *sec_get_bond_list(int *count)
+{
+  *count = esp_ble_get_bond_device_num();
+  if (*count <= 0)
+  {
+    *count = 0;
+    return NULL;
+  }
+
+  esp_ble_bond_dev_t *list = (esp_ble_bond_dev_t *)calloc(*count, sizeof(esp_ble_bond_dev_t));
+  if (list == NULL)
+  {
+    *count = 0;
+    return NULL;
+  }
+
+  if (esp_ble_get_bond_device_list(count, list) != ESP_OK)
+  {
+    free(list);
+    *count = 0;
+    return NULL;
+  }
+
+  return list;
+}
+
+/**
+ * @brief Identity address of a bonded device
+ */
+static const uint8_t *sec_identity_of(const esp_ble_bond_dev_t *dev)
+{
+  if (dev->bond_key.key_mask & ESP_LE_KEY_PID)
+    return dev->bond_key.pid_key.static_addr;
+
+  return dev->bd_addr;
+}
+
+/**
+ * @brief Find the bond of a connection address, resolving private addresses with the stored IRKs
+ */
+static int sec_find_bond(const esp_ble_bond_dev_t *list, int count, const uint8_t *bda, uint8_t addr_type)
+{
+  for (int i = 0; i < count; i++)
+  {
+    if (memcmp(list[i].bd_addr, bda, ESP_BD_ADDR_LEN) == 0 ||
+        memcmp(sec_identity_of(&list[i]), bda, ESP_BD_ADDR_LEN) == 0)
+      return i;
+  }
+
+  if (!sec_is_rpa(bda, addr_type))
+    return -1;
+
+  for (int i = 0; i < count; i++)
+  {
+    if ((list[i].bond_key.key_mask & ESP_LE_KEY_PID) && ble_sec_rpa_matches(list[i].bond_key.pid_key.irk, bda))
+      return i;
+  }
+
+  return -1;
+}
+
+static void sec_lru_save(void)
+{
+  if (ble_store_set(SEC_LRU_KEY, s_lru, sizeof(s_lru)) == ESP_OK)
+    ble_store_commit();
+}
+
+/**
+ * @brief Evict least recently used bonds until the table fits, never the current client
+ */
+static void sec_evict_if_needed(const uint8_t *current)
+{
+  int count;
+  esp_ble_bond_dev_t *list = sec_get_bond_list(&count);
+
+  while (count > s_max_bonds)
+  {
+    int victim = -1;
+    uint32_t victim_used = UINT32_MAX;
+
+    for (int i = 0; i < count; i++)
+    {
+      const uint8_t *identity = sec_identity_of(&list[i]);
+      if (memcmp(identity, current, ESP_BD_ADDR_LEN) == 0)
+        continue;
+
+      // Bonds without usage information are older than anything tracked
+      ble_bond_entry_t *entry = ble_bond_find(s_lru, SEC_STACK_MAX_BONDS, identity);
+      uint32_t used = (entry != NULL) ? entry->last_used : 0;
+      if (used < victim_used)
+      {
+        victim = i;
+        victim_used = used;
+      }
+    }
+
+    if (victim < 0)
+      break;
+
+    ESP_LOGI(SEC_TAG, "Bond table full, evicting " ESP_BD_ADDR_STR, ESP_BD_ADDR_HEX(list[victim].bd_addr));
+    esp_ble_remove_bond_device(list[victim].bd_addr);
+
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.evictions++;
+    taskEXIT_CRITICAL(&s_stats_lock);
+
+    list[victim] = list[count - 1];
+    count--;
+  }
+
+  free(list);
+}
+
+esp_err_t ble_sec_init(const ble_security_config_t *config)
+{
+  s_mode = config->mode;
+  s_service_changed = config->service_changed;
+
+#ifndef CONFIG_BT_GATTS_ROBUST_CACHING_ENABLED
+  // Bluedroid owns the GATT service: Database Hash and Client Supported Features only exist with this option
+  if (s_service_changed)
+  {
+    ESP_LOGE(SEC_TAG, "Service Changed needs CONFIG_BT_GATTS_ROBUST_CACHING_ENABLED");
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+#endif
+
+  if (s_mode == BLE_SECURITY_NONE)
+    return ESP_OK;
+
+  bool mitm = (s_mode == BLE_SECURITY_BOND_SC_MITM);
+  if (mitm && (config->passkey == 0 || config->passkey > SEC_PASSKEY_MAX))
+  {
+    ESP_LOGE(SEC_TAG, "Passkey pairing needs a passkey from 1 to %d", SEC_PASSKEY_MAX);
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  s_max_bonds = config->max_bonds;
+  if (s_max_bonds == 0 || s_max_bonds >= SEC_STACK_MAX_BONDS)
+    s_max_bonds = SEC_STACK_MAX_BONDS - 1;  // Keep a free slot so the stack never evicts on its own
+
+  size_t len = sizeof(s_lru);
+  if (ble_store_get(SEC_LRU_KEY, s_lru, &len) != ESP_OK || len != sizeof(s_lru))
+    memset(s_lru, 0, sizeof(s_lru));
+
+  s_lru_clock = ble_bond_clock(s_lru, SEC_STACK_MAX_BONDS);
+
+  // Just Works cannot protect against MITM; with a passkey the device displays it and the user types it
+  esp_ble_auth_req_t auth_req = mitm ? ESP_LE_AUTH_REQ_SC_MITM_BOND : ESP_LE_AUTH_REQ_SC_BOND;
+  esp_ble_io_cap_t iocap = mitm ? ESP_IO_CAP_OUT : ESP_IO_CAP_NONE;
+  uint32_t passkey = config->passkey;
+  uint8_t key_size = SEC_KEY_SIZE;
+  uint8_t init_key = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
+  uint8_t rsp_key = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
+  uint8_t auth_option = ESP_BLE_ONLY_ACCEPT_SPECIFIED_AUTH_ENABLE;  // Reject legacy pairing
+
+  esp_err_t ret = esp_ble_gap_set_security_param(ESP_BLE_SM_AUTHEN_REQ_MODE, &auth_req, sizeof(auth_req));
+  if (ret == ESP_OK)
+    ret = esp_ble_gap_set_security_param(ESP_BLE_SM_IOCAP_MODE, &iocap, sizeof(iocap));
+  if (ret == ESP_OK)
+    ret = esp_ble_gap_set_security_param(ESP_BLE_SM_MAX_KEY_SIZE, &key_size, sizeof(key_size));
+  if (ret == ESP_OK)
+    ret = esp_ble_gap_set_security_param(ESP_BLE_SM_SET_INIT_KEY, &init_key, sizeof(init_key));
+  if (ret == ESP_OK)
+    ret = esp_ble_gap_set_security_param(ESP_BLE_SM_SET_RSP_KEY, &rsp_key, sizeof(rsp_key));
+  if (ret == ESP_OK)
+    ret = esp_ble_gap_set_security_param(ESP_BLE_SM_ONLY_ACCEPT_SPECIFIED_SEC_AUTH, &auth_option, sizeof(auth_option));
+  if (ret == ESP_OK && mitm)
+    ret = esp_ble_gap_set_security_param(ESP_BLE_SM_SET_STATIC_PASSKEY, &passkey, sizeof(passkey));
+
+  if (ret != ESP_OK)
+  {
+    ESP_LOGE(SEC_TAG, "Setting security parameters failed: %s", esp_err_to_name(ret));
+    return ret;
+  }
+
+  taskENTER_CRITICAL(&s_stats_lock);
+  s_stats.bond_count = esp_ble_get_bond_device_num();
+  taskEXIT_CRITICAL(&s_stats_lock);
+
+  ESP_LOGI(SEC_TAG,
+           "Secure Connections bonding enabled (%s), %d bonds stored (max %d)",
+           mitm ? "passkey" : "Just Works",
+           s_stats.bond_count,
+           s_max_bonds);
+  return ESP_OK;
+}
+
+bool ble_sec_is_enabled(void)
+{
+  return s_mode != BLE_SECURITY_NONE;
+}
+
+bool ble_sec_requires_mitm(void)
+{
+  return s_mode == BLE_SECURITY_BOND_SC_MITM;
+}
+
+bool ble_sec_link_authenticated(void)
+{
+  return s_link_authenticated;
+}
+
+bool ble_sec_on_connect(const uint8_t *bda, uint8_t addr_type, uint8_t *identity, uint8_t *identity_type)
+{
+  memcpy(identity, bda, ESP_BD_ADDR_LEN);
+  *identity_type = addr_type;
+  s_link_bonded = false;
+  s_link_authenticated = false;
+
+  if (s_mode == BLE_SECURITY_NONE)
+    return false;
+
+  int count;
+  esp_ble_bond_dev_t *list = sec_get_bond_list(&count);
+  int idx = sec_find_bond(list, count, bda, addr_type);
+  if (idx >= 0)
+  {
+    s_link_bonded = true;
+    memcpy(identity, sec_identity_of(&list[idx]), ESP_BD_ADDR_LEN);
+    if (list[idx].bond_key.key_mask & ESP_LE_KEY_PID)
+      *identity_type = list[idx].bond_key.pid_key.addr_type;
+  }
+  free(list);
+
+  memcpy(s_link_identity, identity, ESP_BD_ADDR_LEN);
+
+  // Ask the client to encrypt right away: a bonded client re-encrypts with its stored
+  // LTK, a new one pairs before its first request instead of after an ATT error
+  esp_ble_sec_act_t level = ble_sec_requires_mitm() ? ESP_BLE_SEC_ENCRYPT_MITM : ESP_BLE_SEC_ENCRYPT_NO_MITM;
+  esp_err_t ret = esp_ble_set_encryption((uint8_t *)bda, level);
+  if (ret != ESP_OK)
+    ESP_LOGW(SEC_TAG, "Security request failed: %s", esp_err_to_name(ret));
+
+  ESP_LOGI(SEC_TAG,
+           "Client " ESP_BD_ADDR_STR " is %s",
+           ESP_BD_ADDR_HEX(identity),
+           s_link_bonded ? "bonded, re-encrypting" : "not bonded, pairing");
+  return s_link_bonded;
+}
+
+static void sec_latency_add(ble_latency_stats_t *stat, int64_t latency_us)
+{
+  if (stat->count == 0 || latency_us < stat->min_us)
+    stat->min_us = latency_us;
+  if (latency_us > stat->max_us)
+    stat->max_us = latency_us;
+  stat->last_us = latency_us;
+  stat->total_us += latency_us;
+  stat->count++;
+}
+
+void ble_sec_record_first_request(int64_t latency_us)
+{
+  taskENTER_CRITICAL(&s_stats_lock);
+  sec_latency_add(s_link_bonded ? &s_stats.bonded_first_req : &s_stats.unbonded_first_req, latency_us);
+  taskEXIT_CRITICAL(&s_stats_lock);
+
+  ESP_LOGI(SEC_TAG, "First request %lld us after connect (%s)", latency_us, s_link_bonded ? "bonded" : "unbonded");
+}
+
+void ble_sec_handle_gap_event(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
+{
+  switch (event)
+  {
+    case ESP_GAP_BLE_SEC_REQ_EVT:
+    {
+      esp_ble_gap_security_rsp(param->ble_security.ble_req.bd_addr, s_mode != BLE_SECURITY_NONE);
+      break;
+    }
+    case ESP_GAP_BLE_KEY_EVT:
+    {
+      ESP_LOGD(SEC_TAG, "Key exchanged, type 0x%02x", param->ble_security.ble_key.key_type);
+      break;
+    }
+    case ESP_GAP_BLE_AUTH_CMPL_EVT:
+    {
+      esp_ble_auth_cmpl_t *auth = &param->ble_security.auth_cmpl;
+      if (!auth->success)
+      {
+        ESP_LOGW(SEC_TAG,
+                 "Authentication with " ESP_BD_ADDR_STR " failed, reason 0x%x",
+                 ESP_BD_ADDR_HEX(auth->bd_addr),
+                 auth->fail_reason);
+        break;
+      }
+
+      ESP_LOGI(SEC_TAG,
+               "Link with " ESP_BD_ADDR_STR " encrypted, auth mode %d",
+               ESP_BD_ADDR_HEX(auth->bd_addr),
+               auth->auth_mode);
+      s_link_authenticated = (auth->auth_mode & ESP_LE_AUTH_REQ_MITM) != 0;
+
+      // Identity is known now even for a first pairing
+      int count;
+      esp_ble_bond_dev_t *list = sec_get_bond_list(&count);
+      int idx = sec_find_bond(list, count, auth->bd_addr, auth->addr_type);
+      if (idx >= 0)
+        memcpy(s_link_identity, sec_identity_of(&list[idx]), ESP_BD_ADDR_LEN);
+      free(list);
+
+      // A bonded client trusts its attribute cache; tell it when the layout changed since
+      bool db_changed = ble_bond_touch(s_lru, SEC_STACK_MAX_BONDS, &s_lru_clock, s_link_identity, s_db_hash);
+      sec_lru_save();
+      if (db_changed && s_service_changed)
+      {
+        ESP_LOGI(SEC_TAG,
+                 "Attribute layout changed since " ESP_BD_ADDR_STR " last connected",
+                 ESP_BD_ADDR_HEX(s_link_identity));
+        ble_gatts_send_service_changed(auth->bd_addr);
+
+        taskENTER_CRITICAL(&s_stats_lock);
+        s_stats.service_changed_sent++;
+        taskEXIT_CRITICAL(&s_stats_lock);
+      }
+      sec_evict_if_needed(s_link_identity);
+
+      taskENTER_CRITICAL(&s_stats_lock);
+      s_stats.bond_count = esp_ble_get_bond_device_num();
+      taskEXIT_CRITICAL(&s_stats_lock);
+      break;
+    }
+    case ESP_GAP_BLE_REMOVE_BOND_DEV_COMPLETE_EVT:
+    {
+      if (ble_bond_remove(s_lru, SEC_STACK_MAX_BONDS, param->remove_bond_dev_cmpl.bd_addr))
+        sec_lru_save();
+
+      taskENTER_CRITICAL(&s_stats_lock);
+      s_stats.bond_count = esp_ble_get_bond_device_num();
+      taskEXIT_CRITICAL(&s_stats_lock);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void ble_sec_set_db_hash(uint32_t hash)
+{
+  s_db_hash = hash;
+}
+
+void ble_sec_clear_bonds(void)
+{
+  int count;
+  esp_ble_bond_dev_t *list = sec_get_bond_list(&count);
+
+  // Each removal completes with ESP_GAP_BLE_REMOVE_BOND_DEV_COMPLETE_EVT
+  for (int i = 0; i < count; i++)
+    esp_ble_remove_bond_device(list[i].bd_addr);
+
+  free(list);
+
+  memset(s_lru, 0, sizeof(s_lru));
+  sec_lru_save();
+}
+
+void ble_sec_get_stats(ble_security_stats_t *out)
+{
+  taskENTER_CRITICAL(&s_stats_lock);
+  *out = s_stats;
+  taskEXIT_CRITICAL(&s_stats_lock);
+}
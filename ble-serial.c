@@ -0,0 +1,290 @@
+/**
+ * @file ble-serial.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Serial bridge - a byte stream over an RX/TX characteristic pair (UART over GATT)
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * Laid out like the Nordic UART Service: the client writes to RX (with or
+ * without response) and subscribes to TX. Both directions go through a
+ * single-producer single-consumer byte ring (ble-ring.c):
+ *
+ *   RX: Bluetooth task -> ring -> ble_serial_read()
+ *   TX: ble_serial_write() -> ring -> flush timer -> notifications
+ *
+ * The rings themselves need no lock. Callers of read and write from several
+ * tasks are serialized by a mutex per direction, so each ring keeps exactly
+ * one producer and one consumer. Outgoing bytes are packed into MTU-sized
+ * notifications; a partial packet leaves at most SERIAL_FLUSH_US after its
+ * first byte was written.
+ */
+
+#include "ble-serial.h"
+
+#include <esp_gatt_defs.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <string.h>
+
+#include "ble-gatts.h"
+#include "ble-notify.h"
+#include "ble-ring.h"
+
+#define SERIAL_TAG          "BLE_SERIAL"
+#define SERIAL_DEFAULT_SIZE 1024  // Ring size when the configuration gives none
+#define SERIAL_FLUSH_US     5000  // Longest a partial TX packet waits for more bytes
+
+static ble_ring_t s_rx;
+static ble_ring_t s_tx;
+static size_t s_tx_index = 0;
+static SemaphoreHandle_t s_rx_lock = NULL;   // One reader at a time
+static SemaphoreHandle_t s_tx_lock = NULL;   // One writer at a time
+static SemaphoreHandle_t s_rx_data = NULL;   // Given when bytes arrive
+static SemaphoreHandle_t s_tx_space = NULL;  // Given when the flush frees room
+static esp_timer_handle_t s_flush_timer = NULL;
+static volatile bool s_rx_discard = false;       // Reader drops everything before its next read
+static uint8_t s_packet[ESP_GATT_MAX_ATTR_LEN];  // Flush timer only
+
+static portMUX_TYPE s_serial_lock = portMUX_INITIALIZER_UNLOCKED;
+static ble_serial_stats_t s_stats = {0};
+
+static void flush_arm(uint64_t delay_us)
+{
+  // Already armed: the pending flush picks the new bytes up
+  if (s_flush_timer != NULL && !esp_timer_is_active(s_flush_timer))
+    esp_timer_start_once(s_flush_timer, delay_us);
+}
+
+/**
+ * @brief Send the TX ring as MTU-sized notifications until it is empty or the link is busy
+ */
+static void serial_flush(void *arg)
+{
+  size_t room = ble_gatts_get_mtu() - BLE_ATT_NOTIFY_HEADER;
+  size_t freed = 0;
+
+  // Nobody to deliver to: what was written for the last client goes away
+  if (!ble_gatts_is_connected())
+  {
+    ble_ring_consume(&s_tx, ble_ring_used(&s_tx));
+    xSemaphoreGive(s_tx_space);
+    return;
+  }
+
+  while (ble_ring_used(&s_tx) > 0 && ble_notify_is_subscribed(s_tx_index))
+  {
+    size_t len = ble_ring_peek(&s_tx, s_packet, room);
+    if (ble_gatts_notify(s_tx_index, s_packet, len) != ESP_OK)
+    {
+      flush_arm(SERIAL_FLUSH_US);  // Congested, try again shortly
+      break;
+    }
+    ble_ring_consume(&s_tx, len);
+    freed += len;
+
+    taskENTER_CRITICAL(&s_serial_lock);
+    s_stats.bytes_sent += len;
+    s_stats.packets_sent++;
+    if (len < room)
+      s_stats.partial_packets++;
+    taskEXIT_CRITICAL(&s_serial_lock);
+  }
+
+  if (freed > 0)
+    xSemaphoreGive(s_tx_space);
+}
+
+static ble_char_error_t serial_rx_write(const uint8_t *data, size_t len)
+{
+  // All or nothing: a write the client resends after BUSY must not duplicate its first part
+  if (ble_ring_space(&s_rx) < len)
+  {
+    taskENTER_CRITICAL(&s_serial_lock);
+    s_stats.rx_overflows += len;
+    taskEXIT_CRITICAL(&s_serial_lock);
+
+    // The reader is too slow; with a response the client learns it, without one the bytes are lost
+    return BLE_CHAR_ERR_BUSY;
+  }
+
+  ble_ring_put(&s_rx, data, len);
+
+  taskENTER_CRITICAL(&s_serial_lock);
+  s_stats.bytes_received += len;
+  taskEXIT_CRITICAL(&s_serial_lock);
+
+  if (len > 0)
+    xSemaphoreGive(s_rx_data);
+  return BLE_CHAR_OK;
+}
+
+esp_err_t ble_serial_init(const ble_serial_config_t *config, ble_characteristic_t *out, size_t index)
+{
+  s_tx_index = index + 1;
+  s_rx_discard = false;
+
+  const esp_timer_create_args_t timer_args = {
+    .callback = serial_flush,
+    .name = "ble_serial",
+  };
+
+  if (!ble_ring_alloc(&s_rx, config->rx_buffer_size ? config->rx_buffer_size : SERIAL_DEFAULT_SIZE) ||
+      !ble_ring_alloc(&s_tx, config->tx_buffer_size ? config->tx_buffer_size : SERIAL_DEFAULT_SIZE) ||
+      (s_rx_lock = xSemaphoreCreateMutex()) == NULL || (s_tx_lock = xSemaphoreCreateMutex()) == NULL ||
+      (s_rx_data = xSemaphoreCreateBinary()) == NULL || (s_tx_space = xSemaphoreCreateBinary()) == NULL ||
+      esp_timer_create(&timer_args, &s_flush_timer) != ESP_OK)
+  {
+    ESP_LOGE(SERIAL_TAG, "Failed to allocate the serial bridge");
+    ble_serial_deinit();
+    return ESP_ERR_NO_MEM;
+  }
+
+  out[0] = (ble_characteristic_t){
+    .uuid = config->rx_uuid,
+    .name = "Serial RX",
+    .description = "Serial RX",
+    .size = UINT8_MAX,
+    .write = serial_rx_write,
+    .flags = BLE_CHAR_FLAG_WRITE_NO_RSP,
+  };
+  out[1] = (ble_characteristic_t){
+    .uuid = config->tx_uuid,
+    .name = "Serial TX",
+    .description = "Serial TX",
+    .size = UINT8_MAX,
+    .flags = BLE_CHAR_FLAG_NOTIFY_DIRECT,
+  };
+
+  ESP_LOGI(SERIAL_TAG, "Serial bridge, %lu byte RX and %lu byte TX buffers", (unsigned long)(s_rx.mask + 1),
+           (unsigned long)(s_tx.mask + 1));
+  return ESP_OK;
+}
+
+void ble_serial_deinit(void)
+{
+  if (s_flush_timer != NULL)
+  {
+    esp_timer_stop(s_flush_timer);
+    esp_timer_delete(s_flush_timer);
+    s_flush_timer = NULL;
+  }
+
+  SemaphoreHandle_t *sems[] = {&s_rx_lock, &s_tx_lock, &s_rx_data, &s_tx_space};
+  for (size_t i = 0; i < sizeof(sems) / sizeof(sems[0]); i++)
+  {
+    if (*sems[i] != NULL)
+    {
+      vSemaphoreDelete(*sems[i]);
+      *sems[i] = NULL;
+    }
+  }
+
+  ble_ring_release(&s_rx);
+  ble_ring_release(&s_tx);
+}
+
+void ble_serial_reset(void)
+{
+  if (s_flush_timer == NULL)
+    return;
+
+  // Each ring is emptied by its own consumer, so no index has two writers
+  s_rx_discard = true;
+  esp_timer_stop(s_flush_timer);
+  flush_arm(0);
+}
+
+ble_return_code_t ble_serial_write(const void *data, size_t len, size_t *written, uint32_t timeout_ms)
+{
+  if (data == NULL || written == NULL)
+    return BLE_INVALID_CONFIG;
+  *written = 0;
+  if (s_tx.buf == NULL || !ble_gatts_is_connected())
+    return BLE_NOT_INITIALIZED;
+
+  TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(timeout_ms);
+  if (xSemaphoreTake(s_tx_lock, pdMS_TO_TICKS(timeout_ms)) != pdTRUE)
+    return BLE_TIMEOUT;
+
+  const uint8_t *bytes = data;
+  size_t room = ble_gatts_get_mtu() - BLE_ATT_NOTIFY_HEADER;
+
+  for (;;)
+  {
+    *written += ble_ring_put(&s_tx, &bytes[*written], len - *written);
+
+    // A full packet goes now, a partial one waits briefly for more bytes
+    flush_arm((ble_ring_used(&s_tx) >= room) ? 0 : SERIAL_FLUSH_US);
+    if (*written == len)
+      break;
+
+    taskENTER_CRITICAL(&s_serial_lock);
+    s_stats.tx_waits++;
+    taskEXIT_CRITICAL(&s_serial_lock);
+
+    TickType_t now = xTaskGetTickCount();
+    if (now >= deadline || xSemaphoreTake(s_tx_space, deadline - now) != pdTRUE)
+      break;
+  }
+
+  xSemaphoreGive(s_tx_lock);
+  return (*written == len) ? BLE_SUCCESS : BLE_TIMEOUT;
+}
+
+ble_return_code_t ble_serial_read(void *out, size_t max_len, size_t *out_len, uint32_t timeout_ms)
+{
+  if (out == NULL || out_len == NULL)
+    return BLE_INVALID_CONFIG;
+  *out_len = 0;
+  if (s_rx.buf == NULL)
+    return BLE_NOT_INITIALIZED;
+
+  TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(timeout_ms);
+  if (xSemaphoreTake(s_rx_lock, pdMS_TO_TICKS(timeout_ms)) != pdTRUE)
+    return BLE_TIMEOUT;
+
+  for (;;)
+  {
+    if (s_rx_discard)
+    {
+      s_rx_discard = false;
+      ble_ring_consume(&s_rx, ble_ring_used(&s_rx));
+    }
+
+    *out_len = ble_ring_peek(&s_rx, out, max_len);
+    ble_ring_consume(&s_rx, *out_len);
+    if (*out_len > 0)
+      break;
+
+    TickType_t now = xTaskGetTickCount();
+    if (now >= deadline || xSemaphoreTake(s_rx_data, deadline - now) != pdTRUE)
+      break;
+  }
+
+  xSemaphoreGive(s_rx_lock);
+  return (*out_len > 0) ? BLE_SUCCESS : BLE_TIMEOUT;
+}
+
+ble_return_code_t ble_serial_poll(size_t *readable, size_t *writable)
+{
+  if (readable == NULL || writable == NULL)
+    return BLE_INVALID_CONFIG;
+  if (s_rx.buf == NULL)
+    return BLE_NOT_INITIALIZED;
+
+  *readable = s_rx_discard ? 0 : ble_ring_used(&s_rx);
+  *writable = ble_gatts_is_connected() ? ble_ring_space(&s_tx) : 0;
+  return BLE_SUCCESS;
+}
+
+void ble_serial_get_stats(ble_serial_stats_t *out)
+{
+  taskENTER_CRITICAL(&s_serial_lock);
+  *out = s_stats;
+  taskEXIT_CRITICAL(&s_serial_lock);
+}
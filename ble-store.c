@@ -0,0 +1,102 @@
+/**
+ * @file ble-store.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Persistent key/blob storage for BLE state
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * Uses the NVS partition brought up by nvm_init(). All BLE keys live in their
+ * own namespace so they cannot collide with application data.
+ */
+
+#include "ble-store.h"
+
+#include <esp_log.h>
+#include <nvs.h>
+
+#define STORE_TAG       "BLE_STORE"
+#define STORE_NAMESPACE "ble"
+
+static nvs_handle_t s_nvs_handle = 0;
+static bool s_is_open = false;
+
+esp_err_t ble_store_init(void)
+{
+  if (s_is_open)
+    return ESP_OK;
+
+  esp_err_t ret = nvs_open(STORE_NAMESPACE, NVS_READWRITE, &s_nvs_handle);
+  if (ret != ESP_OK)
+  {
+    ESP_LOGE(STORE_TAG, "Open namespace '%s' failed: %s", STORE_NAMESPACE, esp_err_to_name(ret));
+    return ret;
+  }
+
+  s_is_open = true;
+  return ESP_OK;
+}
+
+void ble_store_deinit(void)
+{
+  if (!s_is_open)
+    return;
+
+  nvs_close(s_nvs_handle);
+  s_is_open = false;
+}
+
+esp_err_t ble_store_get(const char *key, void *out, size_t *len)
+{
+  if (!s_is_open)
+    return ESP_ERR_INVALID_STATE;
+
+  esp_err_t ret = nvs_get_blob(s_nvs_handle, key, out, len);
+  if (ret == ESP_ERR_NVS_NOT_FOUND)
+    return ESP_ERR_NOT_FOUND;
+
+  if (ret != ESP_OK)
+    ESP_LOGW(STORE_TAG, "Read '%s' failed: %s", key, esp_err_to_name(ret));
+
+  return ret;
+}
+
+esp_err_t ble_store_set(const char *key, const void *data, size_t len)
+{
+  if (!s_is_open)
+    return ESP_ERR_INVALID_STATE;
+
+  esp_err_t ret = nvs_set_blob(s_nvs_handle, key, data, len);
+  if (ret != ESP_OK)
+    ESP_LOGE(STORE_TAG, "Write '%s' failed: %s", key, esp_err_to_name(ret));
+
+  return ret;
+}
+
+esp_err_t ble_store_erase(const char *key)
+{
+  if (!s_is_open)
+    return ESP_ERR_INVALID_STATE;
+
+  esp_err_t ret = nvs_erase_key(s_nvs_handle, key);
+  if (ret == ESP_ERR_NVS_NOT_FOUND)
+    return ESP_OK;
+
+  if (ret != ESP_OK)
+    ESP_LOGE(STORE_TAG, "Erase '%s' failed: %s", key, esp_err_to_name(ret));
+
+  return ret;
+}
+
+esp_err_t ble_store_commit(void)
+{
+  if (!s_is_open)
+    return ESP_ERR_INVALID_STATE;
+
+  esp_err_t ret = nvs_commit(s_nvs_handle);
+  if (ret != ESP_OK)
+    ESP_LOGE(STORE_TAG, "Commit failed: %s", esp_err_to_name(ret));
+
+  return ret;
+}
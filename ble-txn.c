@@ -0,0 +1,226 @@
+/**
+ * @file ble-txn.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Atomic multi-characteristic transactions over ATT reliable writes
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * Prepare Write requests only stage their fragment. On Execute Write the staged
+ * values are checked one by one, then as a set by the application's transaction
+ * validator, and only if all of them pass is each characteristic applied once,
+ * in the order the client first prepared it. A cancel or a disconnect discards
+ * everything, so interdependent settings never reach the application half done.
+ * All calls come from the Bluetooth task.
+ *
+ * A characteristic served by a plain write handler has no check that can run
+ * ahead of the apply, so it only joins a transaction when the application has
+ * a transaction validator to approve it.
+ */
+
+#include "ble-txn.h"
+
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ble-char.h"
+
+#define TXN_TAG "BLE_TXN"
+
+// Staged value of one writable characteristic
+typedef struct
+{
+  uint8_t *value;  // NULL = characteristic not writable
+  uint8_t len;     // Highest byte written so far
+} ble_txn_slot_t;
+
+static const ble_characteristic_t *s_chars = NULL;
+static size_t s_count = 0;
+static ble_txn_validate_t s_validate = NULL;
+static ble_txn_slot_t s_slots[BLE_MAX_CHARACTERISTICS];
+static uint8_t s_order[BLE_MAX_CHARACTERISTICS];  // Staged characteristics, first prepared first
+static size_t s_staged = 0;
+static uint32_t s_fragments = 0;  // Prepare Write requests in the current transaction
+
+static portMUX_TYPE s_txn_lock = portMUX_INITIALIZER_UNLOCKED;
+static ble_txn_stats_t s_stats = {0};
+
+esp_err_t ble_txn_init(const ble_characteristic_t *chars, size_t count, ble_txn_validate_t validate)
+{
+  s_chars = chars;
+  s_count = (count > BLE_MAX_CHARACTERISTICS) ? BLE_MAX_CHARACTERISTICS : count;
+  s_validate = validate;
+  s_staged = 0;
+  s_fragments = 0;
+  memset(s_slots, 0, sizeof(s_slots));
+
+  for (size_t i = 0; i < s_count; i++)
+  {
+    if (!ble_char_is_writable(&chars[i]) || chars[i].size == 0)
+      continue;
+
+    s_slots[i].value = (uint8_t *)calloc(chars[i].size, sizeof(uint8_t));
+    if (s_slots[i].value == NULL)
+    {
+      ESP_LOGE(TXN_TAG, "Failed to allocate staging buffer for '%s'", chars[i].name);
+      ble_txn_deinit();
+      return ESP_ERR_NO_MEM;
+    }
+  }
+
+  return ESP_OK;
+}
+
+void ble_txn_deinit(void)
+{
+  for (size_t i = 0; i < BLE_MAX_CHARACTERISTICS; i++)
+  {
+    free(s_slots[i].value);
+    s_slots[i].value = NULL;
+  }
+
+  s_chars = NULL;
+  s_count = 0;
+  s_validate = NULL;
+  s_staged = 0;
+  s_fragments = 0;
+}
+
+/**
+ * @brief Check if only the write handler itself can refuse a value, when it is applied
+ */
+static bool txn_handler_backed(const ble_characteristic_t *ch)
+{
+  return ch->binding == NULL && ch->coalesce == NULL;
+}
+
+ble_char_error_t ble_txn_prepare(size_t index, size_t offset, const uint8_t *data, size_t len)
+{
+  if (index >= s_count || s_slots[index].value == NULL)
+    return BLE_CHAR_ERR_READONLY;
+
+  if (s_validate == NULL && txn_handler_backed(&s_chars[index]))
+  {
+    ESP_LOGW(TXN_TAG, "'%s' needs a transaction validator for reliable writes", s_chars[index].name);
+    return BLE_CHAR_ERR_READONLY;
+  }
+
+  ble_txn_slot_t *slot = &s_slots[index];
+  if (offset + len > s_chars[index].size)
+    return BLE_CHAR_ERR_SIZE;
+
+  bool staged = false;
+  for (size_t i = 0; i < s_staged && !staged; i++)
+    staged = (s_order[i] == index);
+
+  // Bytes the client skips must not leak from an earlier transaction
+  if (!staged)
+  {
+    s_order[s_staged++] = index;
+    memset(slot->value, 0, s_chars[index].size);
+    slot->len = 0;
+  }
+
+  memcpy(&slot->value[offset], data, len);
+  if (offset + len > slot->len)
+    slot->len = offset + len;
+  s_fragments++;
+  return BLE_CHAR_OK;
+}
+
+/**
+ * @brief Check the staged set without applying anything
+ */
+static ble_char_error_t txn_validate(size_t *failed_index)
+{
+  ble_txn_value_t values[BLE_MAX_CHARACTERISTICS];
+
+  for (size_t i = 0; i < s_staged; i++)
+  {
+    size_t index = s_order[i];
+    const ble_txn_slot_t *slot = &s_slots[index];
+
+    ble_char_error_t result = ble_char_validate_value(&s_chars[index], slot->value, slot->len);
+    if (result != BLE_CHAR_OK)
+    {
+      *failed_index = index;
+      return result;
+    }
+
+    values[i] = (ble_txn_value_t){
+      .uuid = s_chars[index].uuid,
+      .value = slot->value,
+      .len = slot->len,
+    };
+  }
+
+  *failed_index = SIZE_MAX;
+  return (s_validate != NULL) ? s_validate(values, s_staged) : BLE_CHAR_OK;
+}
+
+ble_char_error_t ble_txn_execute(ble_txn_apply_t apply, size_t *failed_index)
+{
+  size_t fragments = s_fragments;
+  size_t staged = s_staged;
+
+  ble_char_error_t result = txn_validate(failed_index);
+  size_t applied = 0;
+
+  for (size_t i = 0; i < s_staged && result == BLE_CHAR_OK; i++)
+  {
+    size_t index = s_order[i];
+
+    // Validators passed, so a refusal here comes from a handler with checks of its own
+    result = apply(index, s_slots[index].value, s_slots[index].len);
+    if (result != BLE_CHAR_OK)
+    {
+      ESP_LOGE(TXN_TAG, "'%s' refused its committed value (%d) after %d applied", s_chars[index].name, result,
+               applied);
+      *failed_index = index;
+      break;
+    }
+    applied++;
+  }
+
+  s_staged = 0;
+  s_fragments = 0;
+
+  taskENTER_CRITICAL(&s_txn_lock);
+  s_stats.fragments += fragments;
+  s_stats.applied += applied;
+  if (result == BLE_CHAR_OK)
+    s_stats.committed++;
+  else
+    s_stats.rejected++;
+  taskEXIT_CRITICAL(&s_txn_lock);
+
+  if (result == BLE_CHAR_OK)
+    ESP_LOGI(TXN_TAG, "Committed %d characteristics from %d prepared writes", staged, fragments);
+  else
+    ESP_LOGW(TXN_TAG, "Transaction of %d characteristics rejected (%d)", staged, result);
+
+  return result;
+}
+
+void ble_txn_cancel(void)
+{
+  if (s_staged == 0)
+    return;
+
+  s_staged = 0;
+  s_fragments = 0;
+
+  taskENTER_CRITICAL(&s_txn_lock);
+  s_stats.cancelled++;
+  taskEXIT_CRITICAL(&s_txn_lock);
+}
+
+void ble_txn_get_stats(ble_txn_stats_t *out)
+{
+  taskENTER_CRITICAL(&s_txn_lock);
+  *out = s_stats;
+  taskEXIT_CRITICAL(&s_txn_lock);
+}
@@ -0,0 +1,140 @@
+/**
+ * @file ble-xfer-proto.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Bulk transfer protocol - block framing, credit window, rewind and resume
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * The callers hold their own lock around every call; nothing here blocks.
+ */
+
+#include "ble-xfer-proto.h"
+
+#ifdef ESP_PLATFORM
+#include <esp_rom_crc.h>
+#endif
+
+static uint32_t proto_crc32(const uint8_t *data, size_t len)
+{
+#ifdef ESP_PLATFORM
+  return esp_rom_crc32_le(0, data, len);
+#else
+  // Same CRC-32 as the ROM routine, bit by bit
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < len; i++)
+  {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++)
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+  }
+  return ~crc;
+#endif
+}
+
+void ble_xfer_put_u32(uint8_t *out, uint32_t value)
+{
+  for (size_t i = 0; i < 4; i++)
+    out[i] = (uint8_t)(value >> (8 * i));
+}
+
+uint32_t ble_xfer_get_u32(const uint8_t *in)
+{
+  return in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+uint32_t ble_xfer_proto_resolve(const ble_xfer_resume_t *resume, uint8_t object, ble_xfer_proto_state_t state,
+                                uint32_t offset)
+{
+  if (offset != BLE_XFER_RESUME)
+    return offset;
+  return (resume->valid && resume->object == object && resume->state == state) ? resume->offset : 0;
+}
+
+void ble_xfer_proto_open(ble_xfer_proto_t *p, ble_xfer_proto_state_t state, uint32_t size, uint32_t offset,
+                         uint16_t block, uint32_t window)
+{
+  p->state = state;
+  p->size = size;
+  p->start = offset;
+  p->block = block;
+  p->window = window;
+  p->next = offset;
+  p->acked = offset;
+  p->unacked = 0;
+  p->seek_sent = false;
+}
+
+bool ble_xfer_proto_next(const ble_xfer_proto_t *p, uint32_t *offset, uint32_t *len)
+{
+  if (p->state != BLE_XFER_PROTO_DOWNLOAD || p->next >= p->size || p->next - p->acked >= p->window * p->block)
+    return false;
+
+  *offset = p->next;
+  *len = (p->size - p->next < p->block) ? p->size - p->next : p->block;
+  return true;
+}
+
+void ble_xfer_proto_sent(ble_xfer_proto_t *p, uint32_t offset, uint32_t covered)
+{
+  if (p->state == BLE_XFER_PROTO_DOWNLOAD && p->next == offset)
+    p->next = offset + covered;
+}
+
+bool ble_xfer_proto_ack(ble_xfer_proto_t *p, uint32_t offset, bool seek, bool *done)
+{
+  if (p->state != BLE_XFER_PROTO_DOWNLOAD || offset < p->acked || offset > p->next)
+    return false;
+
+  if (seek)
+    p->next = offset;
+  p->acked = offset;
+  *done = (p->acked == p->size);
+  return true;
+}
+
+size_t ble_xfer_proto_seal(uint8_t *block, uint32_t offset, size_t payload)
+{
+  ble_xfer_put_u32(block, offset);
+  ble_xfer_put_u32(&block[4 + payload], proto_crc32(block, 4 + payload));
+  return payload + BLE_XFER_BLOCK_OVERHEAD;
+}
+
+ble_xfer_block_t ble_xfer_proto_check(const ble_xfer_proto_t *p, const uint8_t *data, size_t len,
+                                      uint32_t *offset, size_t *payload)
+{
+  if (len <= BLE_XFER_BLOCK_OVERHEAD)
+    return BLE_XFER_BLOCK_SHORT;
+
+  *payload = len - BLE_XFER_BLOCK_OVERHEAD;
+  *offset = ble_xfer_get_u32(data);
+
+  if (proto_crc32(data, len - 4) != ble_xfer_get_u32(&data[len - 4]))
+    return BLE_XFER_BLOCK_CORRUPT;
+  // Everything after a lost or damaged block is dropped until the sender rewinds
+  if (*offset != p->next || *offset + *payload > p->size)
+    return BLE_XFER_BLOCK_GAP;
+  return BLE_XFER_BLOCK_OK;
+}
+
+bool ble_xfer_proto_rewind(ble_xfer_proto_t *p)
+{
+  if (p->seek_sent)
+    return false;
+
+  p->seek_sent = true;
+  return true;
+}
+
+bool ble_xfer_proto_accept(ble_xfer_proto_t *p, size_t payload, bool *done)
+{
+  p->next += payload;
+  p->seek_sent = false;
+  *done = (p->next == p->size);
+
+  bool ack = *done || ++p->unacked >= (p->window + 1) / 2;
+  if (ack)
+    p->unacked = 0;
+  return ack;
+}
@@ -0,0 +1,562 @@
+/**
+ * @file ble-xfer.c
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Bulk transfer service - credit window, per-block CRC32 and resume
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * Two characteristics move an application object (log, file, blob) in either
+ * direction. All integers are little endian.
+ *
+ * Control point (write, notify):
+ *
+ *   0x01 OPEN   object u8, direction u8 (0 = download, 1 = upload, 0x80 = compressed
+ *               download), offset u32 (0xFFFFFFFF = resume), size u32 (upload only)
+ *          ->   0x81, status u8, size u32, block payload size u16, offset u32,
+ *               compressed u8
+ *   0x02 ACK    offset u32   download: every byte below offset arrived intact
+ *   0x03 SEEK   offset u32   download: resend from offset (loss or CRC error)
+ *   0x04 CLOSE             ->  0x84, status u8
+ *        Server, upload:      0x82 ACK offset u32, 0x83 SEEK offset u32
+ *
+ * Data (notify downstream, write without response upstream), one block per PDU:
+ *
+ *   offset u32, payload, CRC32 of offset and payload u32
+ *
+ * A compressed download, granted once the client accepted compression, carries
+ * in each payload one LZ stream (see ble-compress.c) of the object bytes from
+ * offset on. The stream fills the block, so a block holds as many object bytes
+ * as compress into it; offsets, ACK and SEEK keep counting object bytes.
+ *
+ * Status bytes are ble_char_error_t values. The sender keeps at most window
+ * blocks unacknowledged. The last acknowledged offset survives a disconnect, so
+ * an OPEN of the same object with offset 0xFFFFFFFF continues from there.
+ *
+ * The window, framing, rewind and resume rules live in ble-xfer-proto.c; this file
+ * binds them to the characteristics, the pump timer and the application callbacks.
+ * The pump reads download blocks on the esp_timer task while CLOSE and disconnects
+ * end the transfer on the Bluetooth task. A mutex around each block read and the
+ * close callback keeps the application from seeing close() during a read().
+ */
+
+#include "ble-xfer.h"
+
+#include <esp_gatt_defs.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <string.h>
+
+#include "ble-compress.h"
+#include "ble-gatts.h"
+#include "ble-notify.h"
+#include "ble-xfer-proto.h"
+
+#define XFER_TAG            "BLE_XFER"
+#define XFER_PUMP_US        5000  // Send retry period while a transfer is open
+#define XFER_DEFAULT_WINDOW 8     // Unacknowledged blocks when the configuration gives none
+#define XFER_CONTROL_SIZE   16
+#define XFER_DIR_COMPRESS   0x80  // OPEN direction bit asking for a compressed download
+#define XFER_COMPRESS_CHUNK 128   // Source bytes read per call while a compressed block fills
+
+#define XFER_OP_OPEN  0x01
+#define XFER_OP_ACK   0x02
+#define XFER_OP_SEEK  0x03
+#define XFER_OP_CLOSE 0x04
+#define XFER_RSP      0x80  // Response opcode = request opcode | XFER_RSP
+
+static const ble_xfer_config_t *s_config = NULL;
+static const ble_xfer_config_t *s_ops = NULL;      // Callbacks of the open transfer
+static const ble_xfer_config_t *s_builtin = NULL;  // Callbacks of the object served by the component
+static uint8_t s_builtin_object = 0;
+static size_t s_control_index = 0;
+static size_t s_data_index = 0;
+static esp_timer_handle_t s_pump_timer = NULL;
+static portMUX_TYPE s_xfer_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t s_ops_lock = NULL;  // Held while the application's read or close callback runs
+
+// Open transfer, under s_xfer_lock
+static ble_xfer_proto_t s_proto = {0};
+static uint8_t s_object = 0;
+static int64_t s_start_us = 0;
+static bool s_compressed = false;  // Download: payloads are LZ streams
+
+static ble_xfer_resume_t s_resume;
+
+// Control notification the link refused, retried by the pump
+static uint8_t s_control_pending[XFER_CONTROL_SIZE];
+static size_t s_control_pending_len = 0;
+
+// Download block being built, only touched by the pump
+static uint8_t s_block_buf[ESP_GATT_MAX_ATTR_LEN];
+
+static ble_xfer_stats_t s_stats = {0};
+
+static void pump_start(void)
+{
+  if (s_pump_timer != NULL && !esp_timer_is_active(s_pump_timer))
+    esp_timer_start_periodic(s_pump_timer, XFER_PUMP_US);
+}
+
+/**
+ * @brief Notify on the control point, or keep the message for the pump if the link is busy
+ */
+static void send_control(const uint8_t *msg, size_t len)
+{
+  if (ble_gatts_notify(s_control_index, msg, len) == ESP_OK)
+    return;
+
+  memcpy(s_control_pending, msg, len);
+  s_control_pending_len = len;
+  pump_start();
+}
+
+static void send_offset(uint8_t opcode, uint32_t offset)
+{
+  uint8_t msg[5] = {opcode};
+  ble_xfer_put_u32(&msg[1], offset);
+  send_control(msg, sizeof(msg));
+}
+
+static void send_status(uint8_t opcode, ble_char_error_t status)
+{
+  uint8_t msg[2] = {opcode | XFER_RSP, status};
+  send_control(msg, sizeof(msg));
+}
+
+/**
+ * @brief Ask the uploading client to resend from the next expected offset, once per gap
+ */
+static void upload_rewind(void)
+{
+  if (!ble_xfer_proto_rewind(&s_proto))
+    return;
+
+  s_stats.retransmissions++;
+  send_offset(XFER_OP_SEEK | XFER_RSP, s_proto.next);
+}
+
+/**
+ * @brief End the open transfer and tell the application
+ */
+static void xfer_finish(bool complete)
+{
+  ble_xfer_proto_state_t state;
+  uint32_t bytes = 0;
+  int64_t elapsed_us = esp_timer_get_time() - s_start_us;
+
+  // Waits for a block read in progress; the pump starts no read once the state is idle
+  xSemaphoreTake(s_ops_lock, portMAX_DELAY);
+
+  taskENTER_CRITICAL(&s_xfer_lock);
+  state = s_proto.state;
+  s_proto.state = BLE_XFER_PROTO_IDLE;
+  if (state != BLE_XFER_PROTO_IDLE)
+  {
+    bytes = s_proto.size - s_proto.start;
+    if (complete)
+    {
+      s_stats.completed++;
+      if (elapsed_us > 0)
+        s_stats.goodput_bytes_per_s = (uint32_t)((int64_t)bytes * 1000000 / elapsed_us);
+    }
+    else
+    {
+      s_stats.aborted++;
+    }
+  }
+  taskEXIT_CRITICAL(&s_xfer_lock);
+
+  if (state == BLE_XFER_PROTO_IDLE)
+  {
+    xSemaphoreGive(s_ops_lock);
+    return;
+  }
+
+  if (complete)
+  {
+    s_resume.valid = false;
+    ESP_LOGI(XFER_TAG,
+             "Object %d %s: %lu bytes in %lld ms",
+             s_object,
+             (state == BLE_XFER_PROTO_DOWNLOAD) ? "downloaded" : "uploaded",
+             (unsigned long)bytes,
+             elapsed_us / 1000);
+  }
+
+  if (s_ops->close != NULL)
+    s_ops->close(complete);
+  xSemaphoreGive(s_ops_lock);
+}
+
+/**
+ * @brief Encode the object from offset into the block payload until the payload is full or the object ends
+ *
+ * @param offset Object offset the block starts at
+ * @param covered Set to the object bytes the payload holds
+ * @return Payload length, or -1 if the source read failed
+ */
+static int compress_block(uint32_t offset, uint32_t *covered)
+{
+  ble_compress_begin(BLE_COMPRESS_CTX_TIMER, &s_block_buf[4], s_proto.block);
+
+  uint32_t at = offset;
+  while (at < s_proto.size)
+  {
+    size_t room;
+    uint8_t *in = ble_compress_input(BLE_COMPRESS_CTX_TIMER, &room);
+    if (room == 0)
+      break;
+
+    // Small reads: what is read after the payload fills up is read again for the next block
+    size_t want = (s_proto.size - at < XFER_COMPRESS_CHUNK) ? s_proto.size - at : XFER_COMPRESS_CHUNK;
+    if (want > room)
+      want = room;
+    int read = s_ops->read(at, in, want);
+    if (read <= 0)
+      return -1;
+
+    ble_compress_commit(BLE_COMPRESS_CTX_TIMER, read);
+    at += read;
+  }
+
+  size_t consumed;
+  size_t len = ble_compress_finish(BLE_COMPRESS_CTX_TIMER, &consumed);
+  *covered = consumed;
+  return (int)len;
+}
+
+/**
+ * @brief Send pending control messages and download blocks while the window allows. Runs in the esp_timer task.
+ */
+static void xfer_pump(void *arg)
+{
+  if (s_control_pending_len > 0)
+  {
+    if (ble_gatts_notify(s_control_index, s_control_pending, s_control_pending_len) != ESP_OK)
+      return;
+    s_control_pending_len = 0;
+  }
+
+  for (;;)
+  {
+    uint32_t offset, len;
+
+    xSemaphoreTake(s_ops_lock, portMAX_DELAY);
+
+    taskENTER_CRITICAL(&s_xfer_lock);
+    bool can_send = ble_xfer_proto_next(&s_proto, &offset, &len);
+    taskEXIT_CRITICAL(&s_xfer_lock);
+
+    if (!can_send || !ble_notify_is_subscribed(s_data_index))
+    {
+      xSemaphoreGive(s_ops_lock);
+      if (!can_send)
+        break;
+      return;
+    }
+
+    uint32_t covered;  // Object bytes in the block
+    int read = s_compressed ? compress_block(offset, &covered) : s_ops->read(offset, &s_block_buf[4], len);
+    xSemaphoreGive(s_ops_lock);
+
+    if (read <= 0)
+    {
+      ESP_LOGE(XFER_TAG, "Source read failed at offset %lu", (unsigned long)offset);
+      send_status(XFER_OP_CLOSE, BLE_CHAR_ERR_VALUE);
+      xfer_finish(false);
+      return;
+    }
+    if (!s_compressed)
+      covered = read;
+
+    size_t framed = ble_xfer_proto_seal(s_block_buf, offset, read);
+
+    // Congested: the window stays where it is and the next run retries
+    if (ble_gatts_notify(s_data_index, s_block_buf, framed) != ESP_OK)
+      return;
+
+    taskENTER_CRITICAL(&s_xfer_lock);
+    ble_xfer_proto_sent(&s_proto, offset, covered);
+    s_stats.blocks_sent++;
+    s_stats.bytes_sent += covered;
+    taskEXIT_CRITICAL(&s_xfer_lock);
+  }
+
+  if (s_proto.state == BLE_XFER_PROTO_IDLE && s_control_pending_len == 0)
+    esp_timer_stop(s_pump_timer);
+}
+
+/**
+ * @brief Handle OPEN: resolve the resume point and ask the application for the object
+ */
+static void xfer_open(const uint8_t *data, size_t len)
+{
+  uint8_t rsp[13] = {XFER_OP_OPEN | XFER_RSP, BLE_CHAR_OK};
+  ble_xfer_proto_state_t state = (len >= 3 && data[2] == 1) ? BLE_XFER_PROTO_UPLOAD : BLE_XFER_PROTO_DOWNLOAD;
+  bool compressed =
+    state == BLE_XFER_PROTO_DOWNLOAD && len >= 3 && (data[2] & XFER_DIR_COMPRESS) && ble_compress_is_enabled();
+  uint32_t size = (state == BLE_XFER_PROTO_UPLOAD && len >= 11) ? ble_xfer_get_u32(&data[7]) : 0;
+  uint32_t offset = (len >= 7) ? ble_xfer_get_u32(&data[3]) : 0;
+
+  const ble_xfer_config_t *ops = (s_builtin != NULL && data[1] == s_builtin_object) ? s_builtin : s_config;
+
+  if (len < 7 || (state == BLE_XFER_PROTO_UPLOAD && len < 11))
+    rsp[1] = BLE_CHAR_ERR_SIZE;
+  else if (s_proto.state != BLE_XFER_PROTO_IDLE)
+    rsp[1] = BLE_CHAR_ERR_BUSY;
+  else if ((state == BLE_XFER_PROTO_UPLOAD && ops->write == NULL) ||
+           (state == BLE_XFER_PROTO_DOWNLOAD && ops->read == NULL))
+    rsp[1] = BLE_CHAR_ERR_READONLY;
+
+  offset = ble_xfer_proto_resolve(&s_resume, data[1], state, offset);
+
+  if (rsp[1] == BLE_CHAR_OK)
+    rsp[1] = ops->open(data[1], (state == BLE_XFER_PROTO_UPLOAD) ? BLE_XFER_UPLOAD : BLE_XFER_DOWNLOAD, &size);
+  if (rsp[1] == BLE_CHAR_OK && offset > size)
+  {
+    rsp[1] = BLE_CHAR_ERR_VALUE;
+    if (ops->close != NULL)
+      ops->close(false);
+  }
+
+  uint16_t block = ble_gatts_get_mtu() - BLE_ATT_NOTIFY_HEADER - BLE_XFER_BLOCK_OVERHEAD;
+  uint32_t window = (s_config->window > 0) ? s_config->window : XFER_DEFAULT_WINDOW;
+
+  if (rsp[1] == BLE_CHAR_OK)
+  {
+    taskENTER_CRITICAL(&s_xfer_lock);
+    s_ops = ops;
+    ble_xfer_proto_open(&s_proto, state, size, offset, block, window);
+    s_object = data[1];
+    s_compressed = compressed;
+    s_start_us = esp_timer_get_time();
+    taskEXIT_CRITICAL(&s_xfer_lock);
+
+    s_resume.valid = true;
+    s_resume.object = data[1];
+    s_resume.state = state;
+    s_resume.offset = offset;
+
+    ESP_LOGI(XFER_TAG,
+             "%s object %d, %lu bytes from offset %lu, %d byte blocks",
+             (state == BLE_XFER_PROTO_UPLOAD) ? "Upload of" : "Download of",
+             data[1],
+             (unsigned long)size,
+             (unsigned long)offset,
+             block);
+  }
+
+  ble_xfer_put_u32(&rsp[2], size);
+  rsp[6] = (uint8_t)(block & 0xFF);
+  rsp[7] = (uint8_t)(block >> 8);
+  ble_xfer_put_u32(&rsp[8], offset);
+  rsp[12] = (rsp[1] == BLE_CHAR_OK && compressed) ? 1 : 0;
+  send_control(rsp, sizeof(rsp));
+
+  if (rsp[1] == BLE_CHAR_OK)
+    pump_start();
+}
+
+static ble_char_error_t xfer_control_write(const uint8_t *data, size_t len)
+{
+  if (len < 1)
+    return BLE_CHAR_ERR_SIZE;
+
+  switch (data[0])
+  {
+    case XFER_OP_OPEN:
+      xfer_open(data, len);
+      return BLE_CHAR_OK;
+
+    case XFER_OP_ACK:
+    case XFER_OP_SEEK:
+    {
+      if (len < 5)
+        return BLE_CHAR_ERR_SIZE;
+
+      uint32_t offset = ble_xfer_get_u32(&data[1]);
+      bool seek = data[0] == XFER_OP_SEEK;
+      bool done = false;
+
+      taskENTER_CRITICAL(&s_xfer_lock);
+      bool valid = ble_xfer_proto_ack(&s_proto, offset, seek, &done);
+      if (valid && seek)
+        s_stats.retransmissions++;
+      taskEXIT_CRITICAL(&s_xfer_lock);
+
+      if (!valid)
+        return BLE_CHAR_ERR_VALUE;
+
+      s_resume.offset = offset;
+      if (done)
+        xfer_finish(true);
+      else
+        pump_start();
+      return BLE_CHAR_OK;
+    }
+
+    case XFER_OP_CLOSE:
+    {
+      // An explicit close abandons the object, there is nothing to resume
+      s_resume.valid = false;
+      xfer_finish(false);
+      send_status(XFER_OP_CLOSE, BLE_CHAR_OK);
+      return BLE_CHAR_OK;
+    }
+
+    default:
+      return BLE_CHAR_ERR_VALUE;
+  }
+}
+
+/**
+ * @brief Receive an upload block (write without response)
+ */
+static ble_char_error_t xfer_data_write(const uint8_t *data, size_t len)
+{
+  if (s_proto.state != BLE_XFER_PROTO_UPLOAD)
+    return BLE_CHAR_ERR_BUSY;
+
+  uint32_t offset;
+  size_t payload;
+  ble_xfer_block_t check = ble_xfer_proto_check(&s_proto, data, len, &offset, &payload);
+  if (check == BLE_XFER_BLOCK_SHORT)
+    return BLE_CHAR_ERR_SIZE;
+  if (check == BLE_XFER_BLOCK_CORRUPT)
+    s_stats.crc_errors++;
+  if (check != BLE_XFER_BLOCK_OK)
+  {
+    upload_rewind();
+    return BLE_CHAR_ERR_VALUE;
+  }
+
+  ble_char_error_t result = s_ops->write(offset, &data[4], payload);
+  if (result == BLE_CHAR_ERR_BUSY)
+  {
+    // The sink cannot take more yet: the client resends from here, which paces it
+    upload_rewind();
+    return result;
+  }
+  if (result != BLE_CHAR_OK)
+  {
+    send_status(XFER_OP_CLOSE, result);
+    xfer_finish(false);
+    return result;
+  }
+
+  bool done;
+
+  taskENTER_CRITICAL(&s_xfer_lock);
+  bool ack = ble_xfer_proto_accept(&s_proto, payload, &done);
+  s_stats.bytes_received += payload;
+  taskEXIT_CRITICAL(&s_xfer_lock);
+
+  if (ack)
+  {
+    s_resume.offset = s_proto.next;
+    send_offset(XFER_OP_ACK | XFER_RSP, s_proto.next);
+  }
+  if (done)
+    xfer_finish(true);
+  return BLE_CHAR_OK;
+}
+
+esp_err_t ble_xfer_init(const ble_xfer_config_t *config, ble_characteristic_t *out, size_t index)
+{
+  if (config->open == NULL || (config->read == NULL && config->write == NULL))
+  {
+    ESP_LOGE(XFER_TAG, "Transfer needs an open callback and a source or a sink");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (s_ops_lock == NULL && (s_ops_lock = xSemaphoreCreateMutex()) == NULL)
+    return ESP_ERR_NO_MEM;
+
+  s_config = config;
+  s_ops = config;
+  s_control_index = index;
+  s_data_index = index + 1;
+  s_proto.state = BLE_XFER_PROTO_IDLE;
+  s_control_pending_len = 0;
+  memset(&s_resume, 0, sizeof(s_resume));
+
+  if (s_pump_timer == NULL)
+  {
+    const esp_timer_create_args_t timer_args = {
+      .callback = xfer_pump,
+      .name = "ble_xfer",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &s_pump_timer);
+    if (ret != ESP_OK)
+    {
+      ESP_LOGE(XFER_TAG, "Pump timer creation failed: %s", esp_err_to_name(ret));
+      return ret;
+    }
+  }
+
+  out[0] = (ble_characteristic_t){
+    .uuid = config->control_uuid,
+    .name = "Transfer control",
+    .description = "Transfer control point",
+    .size = XFER_CONTROL_SIZE,
+    .write = xfer_control_write,
+    .flags = BLE_CHAR_FLAG_NOTIFY_DIRECT,
+  };
+  out[1] = (ble_characteristic_t){
+    .uuid = config->data_uuid,
+    .name = "Transfer data",
+    .description = "Transfer data",
+    .size = UINT8_MAX,
+    .write = xfer_data_write,
+    .flags = BLE_CHAR_FLAG_NOTIFY_DIRECT | BLE_CHAR_FLAG_WRITE_NO_RSP,
+  };
+
+  return ESP_OK;
+}
+
+void ble_xfer_deinit(void)
+{
+  if (s_pump_timer != NULL)
+  {
+    esp_timer_stop(s_pump_timer);
+    esp_timer_delete(s_pump_timer);
+    s_pump_timer = NULL;
+  }
+
+  if (s_config != NULL)
+    xfer_finish(false);
+  s_config = NULL;
+  s_builtin = NULL;
+
+  if (s_ops_lock != NULL)
+  {
+    vSemaphoreDelete(s_ops_lock);
+    s_ops_lock = NULL;
+  }
+}
+
+void ble_xfer_set_object_handler(uint8_t object, const ble_xfer_config_t *handler)
+{
+  s_builtin_object = object;
+  s_builtin = handler;
+}
+
+void ble_xfer_reset(void)
+{
+  if (s_config == NULL)
+    return;
+
+  s_control_pending_len = 0;
+  xfer_finish(false);
+}
+
+void ble_xfer_get_stats(ble_xfer_stats_t *out)
+{
+  taskENTER_CRITICAL(&s_xfer_lock);
+  *out = s_stats;
+  taskEXIT_CRITICAL(&s_xfer_lock);
+}
@@ -20,18 +20,137 @@
 #include <esp_log.h>
 #include <string.h>
 
+#include "ble-boot.h"
+#include "ble-central.h"
+#include "ble-channel.h"
+#include "ble-coalesce.h"
+#include "ble-compress.h"
+#include "ble-frame.h"
 #include "ble-gap.h"
 #include "ble-gatt.h"
 #include "ble-gatts.h"
+#include "ble-history.h"
+#include "ble-notify.h"
+#include "ble-ota.h"
+#include "ble-persist.h"
+#include "ble-prop.h"
+#include "ble-rpc.h"
 #include "ble-return-code.h"
+#include "ble-sec.h"
+#include "ble-serial.h"
+#include "ble-store.h"
+#include "ble-txn.h"
+#include "ble-xfer.h"
 #include "nvm_driver.h"
 
 static const char *TAG = "BLE";
 
 // Server state
 static bool s_initialized = false;
+static bool s_suspended = false;
 static const ble_server_config_t *s_config = NULL;
 
+// User characteristics followed by the built-in ones
+static ble_characteristic_t s_chars[BLE_MAX_CHARACTERISTICS];
+static size_t s_char_count = 0;
+
+/**
+ * @brief Build the characteristic table: the user's characteristics, then the built-in ones
+ */
+static ble_return_code_t build_characteristics(const ble_server_config_t *config)
+{
+  size_t builtin = (config->frame != NULL) ? 1 : 0;
+  builtin += (config->transfer != NULL) ? BLE_XFER_CHAR_COUNT : 0;
+  builtin += (config->ota != NULL) ? 1 : 0;
+  builtin += (config->channel != NULL) ? 1 : 0;
+  builtin += (config->rpc != NULL) ? BLE_RPC_CHAR_COUNT : 0;
+  builtin += (config->serial != NULL) ? BLE_SERIAL_CHAR_COUNT : 0;
+  builtin += (config->properties != NULL) ? 1 : 0;
+  builtin += (config->history != NULL) ? 1 : 0;
+  builtin += (config->compression != NULL) ? 1 : 0;
+  if (config->characteristic_count + builtin > BLE_MAX_CHARACTERISTICS)
+  {
+    ESP_LOGE(TAG, "Too many characteristics (max %d)", BLE_MAX_CHARACTERISTICS);
+    return BLE_INVALID_CHARS;
+  }
+
+  memcpy(s_chars, config->characteristics, config->characteristic_count * sizeof(ble_characteristic_t));
+  s_char_count = config->characteristic_count;
+
+  if (config->frame != NULL)
+  {
+    if (ble_frame_init(config->frame, s_chars, s_char_count, &s_chars[s_char_count]) != ESP_OK)
+      return BLE_INVALID_CHARS;
+    s_char_count++;
+  }
+
+  if (config->transfer != NULL)
+  {
+    if (ble_xfer_init(config->transfer, &s_chars[s_char_count], s_char_count) != ESP_OK)
+      return BLE_INVALID_CHARS;
+    s_char_count += BLE_XFER_CHAR_COUNT;
+  }
+
+  if (config->ota != NULL)
+  {
+    // The image travels as a transfer object
+    if (config->transfer == NULL)
+    {
+      ESP_LOGE(TAG, "OTA needs the transfer service");
+      return BLE_INVALID_CONFIG;
+    }
+    if (ble_ota_init(config->ota, config->security.mode, &s_chars[s_char_count], s_char_count) != ESP_OK)
+      return BLE_INVALID_CHARS;
+    s_char_count++;
+  }
+
+  if (config->channel != NULL)
+  {
+    if (ble_channel_init(config->channel, &s_chars[s_char_count], s_char_count) != ESP_OK)
+      return BLE_INVALID_CHARS;
+    s_char_count++;
+  }
+
+  if (config->rpc != NULL)
+  {
+    if (ble_rpc_init(config->rpc, &s_chars[s_char_count], s_char_count) != ESP_OK)
+      return BLE_INVALID_CHARS;
+    s_char_count += BLE_RPC_CHAR_COUNT;
+  }
+
+  if (config->serial != NULL)
+  {
+    if (ble_serial_init(config->serial, &s_chars[s_char_count], s_char_count) != ESP_OK)
+      return BLE_INVALID_CHARS;
+    s_char_count += BLE_SERIAL_CHAR_COUNT;
+  }
+
+  if (config->properties != NULL)
+  {
+    if (ble_prop_init(config->properties, &s_chars[s_char_count], s_char_count) != ESP_OK)
+      return BLE_INVALID_CHARS;
+    s_char_count++;
+  }
+
+  if (config->history != NULL)
+  {
+    if (ble_history_init(config->history, s_chars, config->characteristic_count, &s_chars[s_char_count],
+                         s_char_count) != ESP_OK)
+      return BLE_INVALID_CHARS;
+    s_char_count++;
+  }
+
+  if (config->compression != NULL)
+  {
+    if (ble_compress_init(config->compression, s_chars, config->characteristic_count, &s_chars[s_char_count]) !=
+        ESP_OK)
+      return BLE_INVALID_CHARS;
+    s_char_count++;
+  }
+
+  return BLE_SUCCESS;
+}
+
 /**
  * @brief Initialize and start the BLE GATT server
  */
@@ -55,11 +174,24 @@ ble_return_code_t ble_server_init(const ble_server_config_t *config)
     return BLE_INVALID_CHARS;
   }
 
+  ble_return_code_t rc = build_characteristics(config);
+  if (rc != BLE_SUCCESS)
+    return rc;
+
   s_config = config;
   esp_err_t ret;
 
+  ble_boot_start(config->on_ready);
+
   nvm_init();
 
+  ret = ble_store_init();
+  if (ret != ESP_OK)
+  {
+    // Not fatal: the server still works, it just cannot remember anything across reboots
+    ESP_LOGW(TAG, "BLE storage unavailable: %s", esp_err_to_name(ret));
+  }
+
   ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT));
 
   esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
@@ -76,6 +208,7 @@ ble_return_code_t ble_server_init(const ble_server_config_t *config)
     ESP_LOGE(TAG, "BT controller enable failed: %s", esp_err_to_name(ret));
     return BLE_GENERIC_ERROR;
   }
+  ble_boot_mark(BLE_BOOT_STAGE_CONTROLLER_ENABLED);
 
   ret = esp_bluedroid_init();
   if (ret != ESP_OK)
@@ -90,23 +223,71 @@ ble_return_code_t ble_server_init(const ble_server_config_t *config)
     ESP_LOGE(TAG, "Bluedroid enable failed: %s", esp_err_to_name(ret));
     return BLE_GENERIC_ERROR;
   }
+  ble_boot_mark(BLE_BOOT_STAGE_BLUEDROID_ENABLED);
+
+  // Characteristic permissions depend on the security mode, so configure it first
+  ret = ble_sec_init(&config->security);
+  if (ret != ESP_OK)
+  {
+    ESP_LOGE(TAG, "Security init failed: %s", esp_err_to_name(ret));
+    return BLE_GENERIC_ERROR;
+  }
+
+  // Stored values reach the application before the service exists, so the first read sees them
+  ret = ble_persist_init(s_chars, s_char_count);
+  if (ret != ESP_OK)
+  {
+    ESP_LOGE(TAG, "Persistence init failed: %s", esp_err_to_name(ret));
+    return BLE_GENERIC_ERROR;
+  }
+
+  ret = ble_coalesce_init(s_chars, s_char_count);
+  if (ret != ESP_OK)
+  {
+    ESP_LOGE(TAG, "Write coalescing init failed: %s", esp_err_to_name(ret));
+    return BLE_GENERIC_ERROR;
+  }
+
+  ret = ble_txn_init(s_chars, s_char_count, config->validate_transaction);
+  if (ret != ESP_OK)
+  {
+    ESP_LOGE(TAG, "Transaction init failed: %s", esp_err_to_name(ret));
+    return BLE_GENERIC_ERROR;
+  }
 
-  ret = ble_gatts_init(config->characteristics, config->characteristic_count, config->service_uuid);
+  ret = ble_notify_init(s_chars, s_char_count);
+  if (ret != ESP_OK)
+  {
+    ESP_LOGE(TAG, "Notification init failed: %s", esp_err_to_name(ret));
+    return BLE_GENERIC_ERROR;
+  }
+
+  ret = ble_gatts_init(s_chars, s_char_count, config->service_uuid);
   if (ret != ESP_OK)
   {
     ESP_LOGE(TAG, "GATTS init failed: %s", esp_err_to_name(ret));
     return BLE_GENERIC_ERROR;
   }
 
-  ret = ble_gap_init(config->device_name);
+  ret = ble_gap_init(config->device_name, &config->reconnect, config->observer);
   if (ret != ESP_OK)
   {
     ESP_LOGE(TAG, "GAP init failed: %s", esp_err_to_name(ret));
     return BLE_GENERIC_ERROR;
   }
 
+  if (config->central != NULL)
+  {
+    ret = ble_central_init(config->central);
+    if (ret != ESP_OK)
+    {
+      ESP_LOGE(TAG, "Central init failed: %s", esp_err_to_name(ret));
+      return BLE_GENERIC_ERROR;
+    }
+  }
+
   s_initialized = true;
-  ESP_LOGI(TAG, "BLE server initialized with %d characteristics", config->characteristic_count);
+  ESP_LOGI(TAG, "BLE server initialized with %d characteristics", s_char_count);
 
   return BLE_SUCCESS;
 }
@@ -130,6 +311,15 @@ ble_return_code_t ble_server_stop()
     ESP_LOGW(TAG, "Failed to stop advertising: %s", esp_err_to_name(ret));
   }
 
+  // No scan result may reach the observer once its queue and table are released
+  ret = ble_gap_stop_scan();
+  if (ret != ESP_OK)
+  {
+    ESP_LOGW(TAG, "Failed to stop scanning: %s", esp_err_to_name(ret));
+  }
+
+  // Bluedroid goes down first: it drops the links and no GAP/GATT callback runs afterwards,
+  // so the module state below is never freed under the Bluetooth task
   ret = esp_bluedroid_disable();
   if (ret != ESP_OK)
   {
@@ -137,6 +327,24 @@ ble_return_code_t ble_server_stop()
     return BLE_GENERIC_ERROR;
   }
 
+  // Module timers are stopped before their buffers are released
+  ble_central_deinit();
+  ble_gap_deinit();
+
+  // Pending values are applied, then written before storage is closed
+  ble_coalesce_deinit();
+  ble_persist_deinit();
+  ble_notify_deinit();
+  ble_txn_deinit();
+  ble_xfer_deinit();
+  ble_ota_deinit();
+  ble_channel_deinit();
+  ble_rpc_deinit();
+  ble_serial_deinit();
+  ble_prop_deinit();
+  ble_history_deinit();
+  ble_compress_deinit();
+
   ret = esp_bluedroid_deinit();
   if (ret != ESP_OK)
   {
@@ -158,13 +366,86 @@ ble_return_code_t ble_server_stop()
     return BLE_GENERIC_ERROR;
   }
 
+  ble_store_deinit();
+  ble_boot_reset();
+
+  ble_gatts_resume();
+
   s_initialized = false;
+  s_suspended = false;
   s_config = NULL;
 
   ESP_LOGI(TAG, "BLE server stopped");
   return BLE_SUCCESS;
 }
 
+/**
+ * @brief Suspend the BLE server without tearing down the stack
+ */
+ble_return_code_t ble_server_suspend()
+{
+  if (!s_initialized)
+  {
+    ESP_LOGW(TAG, "BLE server not initialized");
+    return BLE_NOT_INITIALIZED;
+  }
+
+  if (s_suspended)
+    return BLE_SUCCESS;
+
+  // Stop advertising first so the disconnect below does not restart it
+  esp_err_t ret = ble_gap_stop_adv();
+  if (ret != ESP_OK)
+  {
+    ESP_LOGW(TAG, "Failed to stop advertising: %s", esp_err_to_name(ret));
+  }
+  ble_gatts_suspend();
+  ble_gap_suspend_scan(true);
+  ble_central_suspend();
+  ble_persist_flush();
+
+  s_suspended = true;
+  ESP_LOGI(TAG, "BLE server suspended");
+  return BLE_SUCCESS;
+}
+
+/**
+ * @brief Resume a suspended BLE server
+ */
+ble_return_code_t ble_server_resume()
+{
+  if (!s_initialized)
+  {
+    ESP_LOGW(TAG, "BLE server not initialized");
+    return BLE_NOT_INITIALIZED;
+  }
+
+  if (!s_suspended)
+    return BLE_SUCCESS;
+
+  ble_gatts_resume();
+  ble_central_resume();
+  ble_gap_suspend_scan(false);
+  esp_err_t ret = ble_gap_resume_adv();
+  if (ret != ESP_OK)
+  {
+    ESP_LOGE(TAG, "Failed to resume advertising: %s", esp_err_to_name(ret));
+    return BLE_GENERIC_ERROR;
+  }
+
+  s_suspended = false;
+  ESP_LOGI(TAG, "BLE server resumed");
+  return BLE_SUCCESS;
+}
+
+/**
+ * @brief Check if the BLE server is suspended
+ */
+bool ble_server_is_suspended()
+{
+  return s_suspended;
+}
+
 /**
  * @brief Check if a BLE client is currently connected
  */
@@ -172,3 +453,240 @@ bool ble_server_is_connected()
 {
   return ble_gatts_is_connected();
 }
+
+/**
+ * @brief Forget the remembered client used for fast reconnection
+ */
+ble_return_code_t ble_server_forget_peer()
+{
+  if (!s_initialized)
+  {
+    ESP_LOGW(TAG, "BLE server not initialized");
+    return BLE_NOT_INITIALIZED;
+  }
+
+  ble_gap_forget_peer();
+  return BLE_SUCCESS;
+}
+
+/**
+ * @brief Get bonding statistics
+ */
+ble_return_code_t ble_server_get_security_stats(ble_security_stats_t *out)
+{
+  if (out == NULL)
+    return BLE_INVALID_CONFIG;
+
+  ble_sec_get_stats(out);
+  return BLE_SUCCESS;
+}
+
+/**
+ * @brief Remove all stored bonds
+ */
+ble_return_code_t ble_server_clear_bonds()
+{
+  if (!s_initialized)
+  {
+    ESP_LOGW(TAG, "BLE server not initialized");
+    return BLE_NOT_INITIALIZED;
+  }
+
+  ble_sec_clear_bonds();
+  return BLE_SUCCESS;
+}
+
+/**
+ * @brief Wait until the server is connectable
+ */
+ble_return_code_t ble_server_wait_ready(uint32_t timeout_ms)
+{
+  if (!s_initialized)
+  {
+    ESP_LOGW(TAG, "BLE server not initialized");
+    return BLE_NOT_INITIALIZED;
+  }
+
+  return ble_boot_wait_ready(timeout_ms) ? BLE_SUCCESS : BLE_TIMEOUT;
+}
+
+/**
+ * @brief Get the bring-up timing profile
+ */
+ble_return_code_t ble_server_get_boot_profile(ble_boot_profile_t *out)
+{
+  if (out == NULL)
+    return BLE_INVALID_CONFIG;
+
+  ble_boot_get_profile(out);
+  return BLE_SUCCESS;
+}
+
+/**
+ * @brief Get notification statistics
+ */
+ble_return_code_t ble_server_get_notify_stats(ble_notify_stats_t *out)
+{
+  if (out == NULL)
+    return BLE_INVALID_CONFIG;
+
+  ble_notify_get_stats(out);
+  return BLE_SUCCESS;
+}
+
+/**
+ * @brief Get the write counters of a coalescing characteristic
+ */
+ble_return_code_t ble_server_get_write_stats(uint16_t uuid, ble_write_stats_t *out)
+{
+  if (out == NULL)
+    return BLE_INVALID_CONFIG;
+
+  if (!s_initialized)
+    return BLE_NOT_INITIALIZED;
+
+  return (ble_coalesce_get_stats(uuid, out) == ESP_OK) ? BLE_SUCCESS : BLE_INVALID_CHARS;
+}
+
+/**
+ * @brief Get reliable write transaction statistics
+ */
+ble_return_code_t ble_server_get_txn_stats(ble_txn_stats_t *out)
+{
+  if (out == NULL)
+    return BLE_INVALID_CONFIG;
+
+  ble_txn_get_stats(out);
+  return BLE_SUCCESS;
+}
+
+/**
+ * @brief Get bulk transfer statistics
+ */
+ble_return_code_t ble_server_get_xfer_stats(ble_xfer_stats_t *out)
+{
+  if (out == NULL)
+    return BLE_INVALID_CONFIG;
+
+  ble_xfer_get_stats(out);
+  return BLE_SUCCESS;
+}
+
+/**
+ * @brief Get the firmware update status
+ */
+ble_return_code_t ble_server_get_ota_status(ble_ota_status_t *out)
+{
+  if (out == NULL)
+    return BLE_INVALID_CONFIG;
+
+  ble_ota_get_status(out);
+  return BLE_SUCCESS;
+}
+
+/**
+ * @brief Get data channel statistics
+ */
+ble_return_code_t ble_server_get_channel_stats(ble_channel_stats_t *out)
+{
+  if (out == NULL)
+    return BLE_INVALID_CONFIG;
+
+  ble_channel_get_stats(out);
+  return BLE_SUCCESS;
+}
+
+/**
+ * @brief Get RPC statistics
+ */
+ble_return_code_t ble_server_get_rpc_stats(ble_rpc_stats_t *out)
+{
+  if (out == NULL)
+    return BLE_INVALID_CONFIG;
+
+  ble_rpc_get_stats(out);
+  return BLE_SUCCESS;
+}
+
+/**
+ * @brief Get serial bridge statistics
+ */
+ble_return_code_t ble_server_get_serial_stats(ble_serial_stats_t *out)
+{
+  if (out == NULL)
+    return BLE_INVALID_CONFIG;
+
+  ble_serial_get_stats(out);
+  return BLE_SUCCESS;
+}
+
+/**
+ * @brief Get property store statistics
+ */
+ble_return_code_t ble_server_get_prop_stats(ble_prop_stats_t *out)
+{
+  if (out == NULL)
+    return BLE_INVALID_CONFIG;
+
+  ble_prop_get_stats(out);
+  return BLE_SUCCESS;
+}
+
+/**
+ * @brief Get sample history statistics
+ */
+ble_return_code_t ble_server_get_history_stats(ble_history_stats_t *out)
+{
+  if (out == NULL)
+    return BLE_INVALID_CONFIG;
+
+  ble_history_get_stats(out);
+  return BLE_SUCCESS;
+}
+
+/**
+ * @brief Get payload compression statistics
+ */
+ble_return_code_t ble_server_get_compress_stats(ble_compress_stats_t *out)
+{
+  if (out == NULL)
+    return BLE_INVALID_CONFIG;
+
+  ble_compress_get_stats(out);
+  return BLE_SUCCESS;
+}
+
+/**
+ * @brief Get the link and polling statistics of one central peer
+ */
+ble_return_code_t ble_server_get_central_stats(size_t peer, ble_central_peer_stats_t *out)
+{
+  if (out == NULL)
+    return BLE_INVALID_CONFIG;
+
+  return ble_central_get_stats(peer, out);
+}
+
+/**
+ * @brief Get observer ingest, deduplication and drop counts
+ */
+ble_return_code_t ble_server_get_observer_stats(ble_observer_stats_t *out)
+{
+  if (out == NULL)
+    return BLE_INVALID_CONFIG;
+
+  ble_gap_get_observer_stats(out);
+  return BLE_SUCCESS;
+}
+
+/**
+ * @brief Get advertising state and restart timing
+ */
+ble_return_code_t ble_server_get_adv_stats(ble_adv_stats_t *out)
+{
+  if (out == NULL)
+    return BLE_INVALID_CONFIG;
+
+  ble_gap_get_adv_stats(out);
+  return BLE_SUCCESS;
+}
@@ -0,0 +1,67 @@
+/**
+ * @file ble-bond.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Bond usage table internal API - LRU order and the attribute database each client last saw
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ *
+ * Plain C with no stack dependency, so the Service Changed decision can be tested on the host.
+ */
+
+#ifndef BLE_BOND_H
+#define BLE_BOND_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BLE_BOND_ADDR_LEN 6  ///< Identity address length
+
+/**
+ * @brief Usage of one bond, keyed by identity address (persisted as is)
+ */
+typedef struct
+{
+  uint8_t bda[BLE_BOND_ADDR_LEN];  ///< Identity address
+  uint32_t last_used;              ///< Usage clock at the last encrypted connection (0 = free slot)
+  uint32_t db_hash;                ///< Attribute database hash the client last saw (its cached discovery)
+} ble_bond_entry_t;
+
+/**
+ * @brief Find the entry of an identity address
+ *
+ * @return The entry, or NULL if the address is not tracked
+ */
+ble_bond_entry_t *ble_bond_find(ble_bond_entry_t *table, size_t count, const uint8_t *bda);
+
+/**
+ * @brief Highest usage clock in the table, to continue counting after a reload
+ */
+uint32_t ble_bond_clock(const ble_bond_entry_t *table, size_t count);
+
+/**
+ * @brief Record an encrypted connection of a client that now sees the database db_hash
+ *
+ * An untracked client takes a free slot, or the least recently used one.
+ *
+ * @param table Bond table
+ * @param count Number of entries in table
+ * @param clock Usage clock, advanced by one
+ * @param bda Identity address of the client
+ * @param db_hash Current attribute database hash
+ * @return true if the client was tracked and last saw a different database (its cache is stale)
+ */
+bool ble_bond_touch(ble_bond_entry_t *table, size_t count, uint32_t *clock, const uint8_t *bda, uint32_t db_hash);
+
+/**
+ * @brief Forget a client
+ *
+ * @return true if the address was tracked
+ */
+bool ble_bond_remove(ble_bond_entry_t *table, size_t count, const uint8_t *bda);
+
+#endif  // BLE_BOND_H
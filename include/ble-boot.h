@@ -0,0 +1,62 @@
+/**
+ * @file ble-boot.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Bring-up profiling internal API - stage timestamps and ready signalling
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ */
+
+#ifndef BLE_BOOT_H
+#define BLE_BOOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ble.h"
+
+/**
+ * @brief Start a new bring-up profile
+ *
+ * @param on_ready Callback for when the server becomes connectable (may be NULL)
+ */
+void ble_boot_start(ble_ready_cb_t on_ready);
+
+/**
+ * @brief Record that a stage was reached (only the first time per bring-up)
+ *
+ * @param stage Stage reached
+ */
+void ble_boot_mark(ble_boot_stage_t stage);
+
+/**
+ * @brief Record that a characteristic was added
+ *
+ * @param index Characteristic index in the configuration
+ */
+void ble_boot_mark_char(size_t index);
+
+/**
+ * @brief Forget the profile and the ready state
+ */
+void ble_boot_reset(void);
+
+/**
+ * @brief Wait until the server is connectable
+ *
+ * @param timeout_ms Maximum time to wait
+ * @return true if ready
+ */
+bool ble_boot_wait_ready(uint32_t timeout_ms);
+
+/**
+ * @brief Get a snapshot of the bring-up profile
+ *
+ * @param out Destination for the profile
+ */
+void ble_boot_get_profile(ble_boot_profile_t *out);
+
+#endif  // BLE_BOOT_H
@@ -0,0 +1,74 @@
+/**
+ * @file ble-central.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Central role internal API - peripheral connections, handle cache and poll scheduler
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ */
+
+#ifndef BLE_CENTRAL_H
+#define BLE_CENTRAL_H
+
+#include <esp_err.h>
+#include <esp_gap_ble_api.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ble.h"
+
+/**
+ * @brief Check the peer table and register the GATT client; scanning starts once it is registered
+ *
+ * @param config Central role configuration
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the peer table is invalid, error code otherwise
+ */
+esp_err_t ble_central_init(const ble_central_config_t *config);
+
+/**
+ * @brief Stop scanning and polling, close the peer connections and unregister the GATT client
+ */
+void ble_central_deinit(void);
+
+/**
+ * @brief Handle scan results, scan stops and security events of links that are not the client's
+ *
+ * Pairing requests are refused: peers are read without pairing and never enter the bond table.
+ *
+ * @param event GAP event
+ * @param param GAP event parameters
+ */
+void ble_central_handle_gap_event(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
+
+/**
+ * @brief Stop polling and scanning and close the peer links (server suspended)
+ */
+void ble_central_suspend(void);
+
+/**
+ * @brief Search for the peers again after ble_central_suspend()
+ */
+void ble_central_resume(void);
+
+/**
+ * @brief Check if an address belongs to a configured peer
+ *
+ * @param bda Device address
+ * @return true for a peer link, false for the client link
+ */
+bool ble_central_is_peer(const uint8_t *bda);
+
+/**
+ * @brief Get a snapshot of the statistics of one peer
+ *
+ * @param peer Peer index
+ * @param out Destination for the statistics
+ * @return BLE_SUCCESS, BLE_INVALID_CONFIG if peer is out of range, BLE_NOT_INITIALIZED if not configured
+ */
+ble_return_code_t ble_central_get_stats(size_t peer, ble_central_peer_stats_t *out);
+
+#endif  // BLE_CENTRAL_H
@@ -0,0 +1,48 @@
+/**
+ * @file ble-channel.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Credit-based data channel internal API - SDUs over one characteristic
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ */
+
+#ifndef BLE_CHANNEL_H
+#define BLE_CHANNEL_H
+
+#include <esp_err.h>
+#include <stddef.h>
+
+#include "ble.h"
+
+/**
+ * @brief Allocate the buffer pool and build the channel characteristic
+ *
+ * @param config Channel configuration
+ * @param out Filled with the channel characteristic definition
+ * @param index Index of out in the characteristic table
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t ble_channel_init(const ble_channel_config_t *config, ble_characteristic_t *out, size_t index);
+
+/**
+ * @brief Release the pool and the queues
+ */
+void ble_channel_deinit(void);
+
+/**
+ * @brief Drop queued data and credits (client disconnected)
+ */
+void ble_channel_reset(void);
+
+/**
+ * @brief Get a snapshot of the channel statistics
+ *
+ * @param out Destination for the statistics
+ */
+void ble_channel_get_stats(ble_channel_stats_t *out);
+
+#endif  // BLE_CHANNEL_H
@@ -0,0 +1,71 @@
+/**
+ * @file ble-char.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Characteristic value access internal API - handlers or bound memory
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ */
+
+#ifndef BLE_CHAR_H
+#define BLE_CHAR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ble.h"
+
+/**
+ * @brief Check if clients may read the characteristic
+ */
+bool ble_char_is_readable(const ble_characteristic_t *ch);
+
+/**
+ * @brief Check if clients may write the characteristic
+ */
+bool ble_char_is_writable(const ble_characteristic_t *ch);
+
+/**
+ * @brief Check if the characteristic has the Notify property (a policy or direct notifications)
+ */
+bool ble_char_is_notifiable(const ble_characteristic_t *ch);
+
+/**
+ * @brief Read the current value, from the bound memory or through the read handler
+ *
+ * @param ch Characteristic
+ * @param out Destination buffer
+ * @param max_len Size of out
+ * @return Number of bytes read, or negative on error
+ */
+int ble_char_read_value(const ble_characteristic_t *ch, uint8_t *out, size_t max_len);
+
+/**
+ * @brief Check a client value without applying it
+ *
+ * Bound characteristics run their validator. Handler characteristics only get
+ * the size check and the coalescing validator, if any; the write handler may
+ * still refuse the value when it is applied.
+ *
+ * @param ch Characteristic
+ * @param data Value written by the client
+ * @param len Length of data
+ * @return BLE_CHAR_OK if acceptable, error code otherwise
+ */
+ble_char_error_t ble_char_validate_value(const ble_characteristic_t *ch, const uint8_t *data, size_t len);
+
+/**
+ * @brief Apply a client value, to the bound memory after validation or through the write handler
+ *
+ * @param ch Characteristic
+ * @param data Value written by the client
+ * @param len Length of data
+ * @return BLE_CHAR_OK if accepted, error code otherwise
+ */
+ble_char_error_t ble_char_write_value(const ble_characteristic_t *ch, const uint8_t *data, size_t len);
+
+#endif  // BLE_CHAR_H
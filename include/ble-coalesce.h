@@ -0,0 +1,55 @@
+/**
+ * @file ble-coalesce.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Write coalescing internal API - last writer wins, bounded apply rate
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ */
+
+#ifndef BLE_COALESCE_H
+#define BLE_COALESCE_H
+
+#include <esp_err.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ble.h"
+
+/**
+ * @brief Allocate the pending value slots and apply timers of coalescing characteristics
+ *
+ * @param chars Array of characteristic definitions
+ * @param count Number of characteristics
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t ble_coalesce_init(const ble_characteristic_t *chars, size_t count);
+
+/**
+ * @brief Apply pending values and release the slots
+ */
+void ble_coalesce_deinit(void);
+
+/**
+ * @brief Validate a client write and queue it, replacing any value not applied yet
+ *
+ * @param index Characteristic index in the configuration
+ * @param data Value written by the client
+ * @param len Length of data
+ * @return BLE_CHAR_OK if the value was accepted, validation error otherwise
+ */
+ble_char_error_t ble_coalesce_write(size_t index, const uint8_t *data, size_t len);
+
+/**
+ * @brief Get the write counters of a coalescing characteristic
+ *
+ * @param uuid Characteristic UUID
+ * @param out Destination for the counters
+ * @return ESP_OK, ESP_ERR_NOT_FOUND if the characteristic does not coalesce writes
+ */
+esp_err_t ble_coalesce_get_stats(uint16_t uuid, ble_write_stats_t *out);
+
+#endif  // BLE_COALESCE_H
@@ -0,0 +1,128 @@
+/**
+ * @file ble-compress.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Payload compression internal API - value framing and capability negotiation
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ */
+
+#ifndef BLE_COMPRESS_H
+#define BLE_COMPRESS_H
+
+#include <esp_err.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ble.h"
+
+#define BLE_COMPRESS_FORMAT_RAW 0x00  ///< Value prefix: the rest is the value as is
+#define BLE_COMPRESS_FORMAT_LZ  0x01  ///< Value prefix: the rest is an LZ stream
+
+/**
+ * @brief Encoder contexts, one per task that compresses
+ */
+typedef enum
+{
+  BLE_COMPRESS_CTX_BT = 0,  ///< Bluetooth task (long reads)
+  BLE_COMPRESS_CTX_TIMER,   ///< esp_timer task (notifications and transfers)
+  BLE_COMPRESS_CTX_COUNT,
+} ble_compress_ctx_t;
+
+/**
+ * @brief Allocate the encoder contexts, prime the dictionary and build the capability characteristic
+ *
+ * @param config Compression configuration
+ * @param chars User characteristics, those with BLE_CHAR_FLAG_COMPRESS set the MTU compression needs
+ * @param count Number of user characteristics
+ * @param out Filled with the capability characteristic definition
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG, ESP_ERR_NO_MEM
+ */
+esp_err_t ble_compress_init(const ble_compress_config_t *config, const ble_characteristic_t *chars, size_t count,
+                            ble_characteristic_t *out);
+
+/**
+ * @brief Release the encoder contexts
+ */
+void ble_compress_deinit(void);
+
+/**
+ * @brief Turn compression off until the next client enables it (client disconnected)
+ */
+void ble_compress_reset(void);
+
+/**
+ * @brief Check if the connected client accepts compressed values
+ */
+bool ble_compress_is_enabled(void);
+
+/**
+ * @brief Start a stream: the encoded output goes to out, never more than cap bytes
+ *
+ * @param ctx Encoder context of the calling task
+ * @param out Destination of the LZ stream
+ * @param cap Size of out
+ */
+void ble_compress_begin(ble_compress_ctx_t ctx, uint8_t *out, size_t cap);
+
+/**
+ * @brief Get the window space the next input bytes go to, so sources fill it without a copy
+ *
+ * @param ctx Encoder context of the calling task
+ * @param room Set to the bytes that may be written (0 once the output is full)
+ * @return Where to write the input
+ */
+uint8_t *ble_compress_input(ble_compress_ctx_t ctx, size_t *room);
+
+/**
+ * @brief Encode len bytes written at the pointer ble_compress_input() returned
+ *
+ * @param ctx Encoder context of the calling task
+ * @param len Bytes written
+ */
+void ble_compress_commit(ble_compress_ctx_t ctx, size_t len);
+
+/**
+ * @brief Encode the remaining input and end the stream
+ *
+ * @param ctx Encoder context of the calling task
+ * @param consumed Set to the input bytes the output holds (less than committed if the output filled up)
+ * @return Length of the LZ stream
+ */
+size_t ble_compress_finish(ble_compress_ctx_t ctx, size_t *consumed);
+
+/**
+ * @brief Encode a value behind a format byte, or copy it raw if compression does not make it smaller
+ *
+ * @param ctx Encoder context of the calling task
+ * @param in Value
+ * @param len Length of the value
+ * @param out Destination, format byte first
+ * @param max Size of out
+ * @return Bytes written to out, 0 if the value does not fit behind the format byte
+ */
+size_t ble_compress_value(ble_compress_ctx_t ctx, const uint8_t *in, size_t len, uint8_t *out, size_t max);
+
+/**
+ * @brief Read a characteristic straight into the encoder window and encode it like ble_compress_value()
+ *
+ * @param ctx Encoder context of the calling task
+ * @param ch Characteristic
+ * @param out Destination, format byte first
+ * @param max Size of out
+ * @return Bytes written to out, or negative if the read failed or the value does not fit behind the format byte
+ */
+int ble_compress_read(ble_compress_ctx_t ctx, const ble_characteristic_t *ch, uint8_t *out, size_t max);
+
+/**
+ * @brief Get a snapshot of the compression statistics
+ *
+ * @param out Destination for the statistics
+ */
+void ble_compress_get_stats(ble_compress_stats_t *out);
+
+#endif  // BLE_COMPRESS_H
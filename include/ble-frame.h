@@ -0,0 +1,33 @@
+/**
+ * @file ble-frame.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Telemetry frame internal API - many characteristic values in one PDU
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ */
+
+#ifndef BLE_FRAME_H
+#define BLE_FRAME_H
+
+#include <esp_err.h>
+#include <stddef.h>
+
+#include "ble.h"
+
+/**
+ * @brief Resolve the frame fields and build the frame characteristic
+ *
+ * @param config Frame configuration
+ * @param chars Characteristics the fields refer to (must stay valid)
+ * @param count Number of characteristics
+ * @param out Filled with the frame characteristic definition
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if a field is unknown or the frame does not fit
+ */
+esp_err_t ble_frame_init(const ble_frame_config_t *config, const ble_characteristic_t *chars, size_t count,
+                         ble_characteristic_t *out);
+
+#endif  // BLE_FRAME_H
@@ -1,7 +1,7 @@
 /**
  * @file ble-gap.h
  * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
- * @brief GAP (Generic Access Profile) internal API - manages advertising
+ * @brief GAP (Generic Access Profile) internal API - manages advertising and scanning
  * @version 0.2
  * @date 2025-07-20
  *
@@ -14,30 +14,122 @@
 #define BLE_GAP_H
 
 #include <esp_err.h>
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "ble.h"
+
 /**
- * @brief Initialize GAP and configure advertising
+ * @brief Initialize GAP, configure advertising and start the observer if configured
  *
  * @param device_name BLE device name for advertising
+ * @param reconnect Fast reconnection settings
+ * @param observer Observer configuration (NULL = no observer)
  * @return ESP_OK on success, error code otherwise
  */
-esp_err_t ble_gap_init(const char *device_name);
+esp_err_t ble_gap_init(const char *device_name, const ble_reconnect_config_t *reconnect,
+                       const ble_observer_config_t *observer);
+
+/**
+ * @brief Release advertising payloads, stop scanning and reset the state machines
+ */
+void ble_gap_deinit(void);
 
 /**
- * @brief Start BLE advertising
+ * @brief Request BLE advertising
+ *
+ * Requests are coalesced: calling this while a start is already in flight,
+ * while advertising or while connected is a no-op.
  *
  * @return ESP_OK on success, error code otherwise
  */
 esp_err_t ble_gap_start_adv(void);
 
 /**
- * @brief Stop BLE advertising
+ * @brief Request BLE advertising to stop
+ *
+ * Advertising payloads stay resident so advertising can be restarted later.
  *
  * @return ESP_OK on success, error code otherwise
  */
 esp_err_t ble_gap_stop_adv(void);
 
+/**
+ * @brief Stop scanning for good and wait for the controller to confirm it
+ *
+ * Neither the observer nor the central role scans again until ble_gap_deinit().
+ * Call it while Bluedroid is still enabled, before the observer state is released.
+ *
+ * @return ESP_OK once the scan is stopped, ESP_ERR_TIMEOUT if the stop was not confirmed
+ */
+esp_err_t ble_gap_stop_scan(void);
+
+/**
+ * @brief Hold or release scanning while the server is suspended
+ *
+ * A suspended scan is stopped like ble_gap_stop_scan() does, without waiting,
+ * and starts again on release if the observer or the central role still wants it.
+ *
+ * @param suspended true to stop scanning, false to let it run again
+ */
+void ble_gap_suspend_scan(bool suspended);
+
+/**
+ * @brief Request advertising again after a suspend, timing the resume
+ *
+ * Starts a new advertising cycle (directed first when a client is remembered).
+ * The time until advertising is live is reported in the advertising statistics.
+ *
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t ble_gap_resume_adv(void);
+
+/**
+ * @brief Notify GAP that a client connected (controller stopped advertising)
+ *
+ * @param bda Address of the connected client
+ * @param addr_type Address type of the connected client (esp_ble_addr_type_t)
+ */
+void ble_gap_on_connect(const uint8_t *bda, uint8_t addr_type);
+
+/**
+ * @brief Notify GAP that the client disconnected, restarting advertising if requested
+ */
+void ble_gap_on_disconnect(void);
+
+/**
+ * @brief Forget the remembered client and return to undirected advertising
+ */
+void ble_gap_forget_peer(void);
+
+/**
+ * @brief Get a snapshot of the advertising state and timing
+ *
+ * @param out Destination for the statistics
+ */
+void ble_gap_get_adv_stats(ble_adv_stats_t *out);
+
+/**
+ * @brief Tell the scanner what the central role needs
+ *
+ * Called from the Bluetooth task, and once by the central resume.
+ * The scanner runs while the observer is configured or the central role is
+ * searching, and is stopped while the central role opens a connection.
+ * SCAN_STOP_COMPLETE is forwarded to the central role once the scan stopped.
+ *
+ * @param searching A peer is missing and must be scanned for
+ * @param connecting A connection is about to be opened, scanning must stop
+ * @return true if no scan is running or being started or stopped
+ */
+bool ble_gap_set_central_scan(bool searching, bool connecting);
+
+/**
+ * @brief Get a snapshot of the observer statistics
+ *
+ * @param out Destination for the statistics
+ */
+void ble_gap_get_observer_stats(ble_observer_stats_t *out);
+
 /**
  * @brief Update connection parameters for a connected device
  *
@@ -19,6 +19,8 @@
 
 #include "ble.h"
 
+#define BLE_ATT_NOTIFY_HEADER 3  ///< Opcode + attribute handle in front of a notified value
+
 /**
  * @brief Initialize GATTS with user-defined characteristics
  *
@@ -36,6 +38,42 @@ esp_err_t ble_gatts_init(ble_characteristic_t *chars, size_t count, uint16_t ser
  */
 esp_err_t ble_gatts_deinit();
 
+/**
+ * @brief Refuse new connections and drop the connected client, if any
+ *
+ * The GATT database stays registered.
+ */
+void ble_gatts_suspend(void);
+
+/**
+ * @brief Accept connections again
+ */
+void ble_gatts_resume(void);
+
+/**
+ * @brief Current ATT MTU of the connection (23 when not connected or not negotiated)
+ */
+uint16_t ble_gatts_get_mtu(void);
+
+/**
+ * @brief Send a notification for a characteristic to the connected client
+ *
+ * The value is truncated to the ATT MTU.
+ *
+ * @param index Characteristic index in the configuration
+ * @param value Value to send
+ * @param len Length of value
+ * @return ESP_OK if queued, ESP_ERR_INVALID_STATE if not connected or congested, error code otherwise
+ */
+esp_err_t ble_gatts_notify(size_t index, const uint8_t *value, size_t len);
+
+/**
+ * @brief Indicate Service Changed (whole database) to a client
+ *
+ * @param bda Connection address of the client
+ */
+void ble_gatts_send_service_changed(const uint8_t *bda);
+
 /**
  * @brief Check if a BLE client is currently connected
  *
@@ -43,4 +81,12 @@ esp_err_t ble_gatts_deinit();
  */
 bool ble_gatts_is_connected(void);
 
+/**
+ * @brief Check if an address belongs to the connected client, as opposed to a link opened as central
+ *
+ * @param bda Device address, as connected or as resolved to the identity
+ * @return true while that client is connected
+ */
+bool ble_gatts_is_client(const uint8_t *bda);
+
 #endif  // BLE_GATTS_H
@@ -0,0 +1,51 @@
+/**
+ * @file ble-history.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Sample history internal API - a sampled value kept in RAM and downloaded by time range
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ */
+
+#ifndef BLE_HISTORY_H
+#define BLE_HISTORY_H
+
+#include <esp_err.h>
+#include <stddef.h>
+
+#include "ble.h"
+
+/**
+ * @brief Resolve the source, allocate the ring, start sampling and build the history characteristic
+ *
+ * @param config History configuration
+ * @param chars Characteristics the source refers to (must stay valid)
+ * @param count Number of characteristics
+ * @param out Filled with the history characteristic definition
+ * @param index Index of out in the characteristic table
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the source or type is invalid, ESP_ERR_NO_MEM
+ */
+esp_err_t ble_history_init(const ble_history_config_t *config, const ble_characteristic_t *chars, size_t count,
+                           ble_characteristic_t *out, size_t index);
+
+/**
+ * @brief Stop sampling and release the ring
+ */
+void ble_history_deinit(void);
+
+/**
+ * @brief Stop a download in progress (client disconnected)
+ */
+void ble_history_reset(void);
+
+/**
+ * @brief Get a snapshot of the history statistics
+ *
+ * @param out Destination for the statistics
+ */
+void ble_history_get_stats(ble_history_stats_t *out);
+
+#endif  // BLE_HISTORY_H
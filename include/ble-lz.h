@@ -0,0 +1,105 @@
+/**
+ * @file ble-lz.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief LZ codec internal API - streaming encoder and the matching decoder
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ *
+ * Plain C with no stack dependency, so the stream format can be tested on the host.
+ */
+
+#ifndef BLE_LZ_H
+#define BLE_LZ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BLE_LZ_WINDOW     1024  ///< Farthest match distance
+#define BLE_LZ_BUF_SIZE   (2 * BLE_LZ_WINDOW)
+#define BLE_LZ_MIN_MATCH  3
+#define BLE_LZ_MAX_MATCH  66
+#define BLE_LZ_HASH_BITS  9
+#define BLE_LZ_HASH_SIZE  (1 << BLE_LZ_HASH_BITS)
+#define BLE_LZ_NONE       0xFFFF  ///< Empty hash table slot
+
+/**
+ * @brief Encoder state: one window of history plus the input being encoded and a single-probe hash table
+ */
+typedef struct
+{
+  uint8_t window[BLE_LZ_BUF_SIZE];  ///< Dictionary or history, then input not yet encoded
+  uint16_t head[BLE_LZ_HASH_SIZE];  ///< Last window position of each 3-byte hash
+  size_t pos;                       ///< Next window byte to encode
+  size_t end;                       ///< Window bytes in use
+  uint8_t *out;                     ///< Destination of the stream
+  size_t cap;                       ///< Size of out
+  size_t len;                       ///< Stream bytes written
+  size_t flags_at;                  ///< Output index of the current flag byte
+  uint8_t bit;                      ///< Items in the current group (8 = a new group starts)
+  bool full;                        ///< The output cannot take another item
+  size_t encoded;                   ///< Input bytes encoded since begin
+} ble_lz_t;
+
+/**
+ * @brief Fill a hash table with the positions of a dictionary, to be shared by every stream
+ *
+ * @param head Hash table of BLE_LZ_HASH_SIZE entries
+ * @param dict Dictionary, at most BLE_LZ_WINDOW bytes
+ * @param dict_len Length of the dictionary
+ */
+void ble_lz_prime(uint16_t *head, const uint8_t *dict, size_t dict_len);
+
+/**
+ * @brief Start a stream: the encoded output goes to out, never more than cap bytes
+ *
+ * @param lz Encoder
+ * @param dict Dictionary placed before the stream (NULL if dict_len is 0)
+ * @param dict_len Length of the dictionary, at most BLE_LZ_WINDOW
+ * @param dict_head Hash table primed with the dictionary by ble_lz_prime()
+ * @param out Destination of the stream
+ * @param cap Size of out
+ */
+void ble_lz_begin(ble_lz_t *lz, const uint8_t *dict, size_t dict_len, const uint16_t *dict_head, uint8_t *out,
+                  size_t cap);
+
+/**
+ * @brief Get the window space the next input bytes go to, sliding the history when the window is full
+ *
+ * @param room Set to the bytes that may be written (0 once the output is full)
+ * @return Where to write the input
+ */
+uint8_t *ble_lz_input(ble_lz_t *lz, size_t *room);
+
+/**
+ * @brief Encode len bytes written at the pointer ble_lz_input() returned
+ *
+ * The last BLE_LZ_MAX_MATCH bytes wait for more input or ble_lz_finish().
+ */
+void ble_lz_commit(ble_lz_t *lz, size_t len);
+
+/**
+ * @brief Encode the remaining input and end the stream
+ *
+ * @return Length of the stream (lz->encoded holds the input bytes it carries)
+ */
+size_t ble_lz_finish(ble_lz_t *lz);
+
+/**
+ * @brief Decode a whole stream
+ *
+ * @param dict Dictionary the stream was encoded against (NULL if dict_len is 0)
+ * @param dict_len Length of the dictionary
+ * @param in Stream
+ * @param len Length of the stream
+ * @param out Destination
+ * @param max Size of out
+ * @return Decoded length, or -1 if the stream is malformed or does not fit out
+ */
+int ble_lz_decode(const uint8_t *dict, size_t dict_len, const uint8_t *in, size_t len, uint8_t *out, size_t max);
+
+#endif  // BLE_LZ_H
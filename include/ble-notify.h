@@ -0,0 +1,66 @@
+/**
+ * @file ble-notify.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Change-driven notification internal API - deadband, rate limit and heartbeat
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ */
+
+#ifndef BLE_NOTIFY_H
+#define BLE_NOTIFY_H
+
+#include <esp_err.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ble.h"
+
+/**
+ * @brief Allocate the last-sent value buffers of notifying characteristics
+ *
+ * @param chars Array of characteristic definitions
+ * @param count Number of characteristics
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t ble_notify_init(const ble_characteristic_t *chars, size_t count);
+
+/**
+ * @brief Stop sampling and release the buffers
+ */
+void ble_notify_deinit(void);
+
+/**
+ * @brief Update the subscription of a characteristic (CCCD written)
+ *
+ * A new subscription sends the current value on the next sample.
+ *
+ * @param index Characteristic index in the configuration
+ * @param subscribed Client enabled notifications
+ */
+void ble_notify_set_subscribed(size_t index, bool subscribed);
+
+/**
+ * @brief Check if the client enabled notifications for a characteristic
+ *
+ * @param index Characteristic index in the configuration
+ * @return true if subscribed
+ */
+bool ble_notify_is_subscribed(size_t index);
+
+/**
+ * @brief Drop all subscriptions (client disconnected)
+ */
+void ble_notify_reset(void);
+
+/**
+ * @brief Get a snapshot of the notification statistics
+ *
+ * @param out Destination for the statistics
+ */
+void ble_notify_get_stats(ble_notify_stats_t *out);
+
+#endif  // BLE_NOTIFY_H
@@ -0,0 +1,104 @@
+/**
+ * @file ble-observe.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Observer report path internal API - filters, dedup table and report queue
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ *
+ * No locking: the Bluetooth task alone filters and deduplicates, and the caller
+ * serializes the queue between it and the receivers. Plain C with no stack
+ * dependency, so the ingest path can be benchmarked on the host.
+ */
+
+#ifndef BLE_OBSERVE_H
+#define BLE_OBSERVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ble.h"
+
+#define BLE_OBSERVE_DEDUP_SLOTS 512  ///< Power of two, about twice the advertisers expected in range
+#define BLE_OBSERVE_DEDUP_PROBE 4    ///< Slots looked at per report
+
+/**
+ * @brief What became of one report
+ */
+typedef enum
+{
+  BLE_OBSERVE_NEW = 0,    ///< Passed the filters and not seen within dedup_ms: queue it
+  BLE_OBSERVE_FILTERED,   ///< Rejected by the address, service UUID or company ID lists
+  BLE_OBSERVE_DUPLICATE,  ///< Same address and payload passed on less than dedup_ms ago
+} ble_observe_verdict_t;
+
+/**
+ * @brief Dedup entry: an address and payload passed on at seen_ms (0 = free)
+ */
+typedef struct
+{
+  uint8_t bda[6];
+  uint32_t payload_hash;
+  uint32_t seen_ms;
+} ble_observe_entry_t;
+
+/**
+ * @brief Filters, dedup table and bounded report queue of one observer
+ */
+typedef struct
+{
+  const ble_observer_config_t *cfg;  ///< Filter lists
+  uint32_t dedup_ms;                 ///< Suppression period of an identical report
+  ble_observe_entry_t *dedup;        ///< BLE_OBSERVE_DEDUP_SLOTS entries
+  ble_observer_report_t *queue;      ///< Ring of queue_length reports
+  size_t queue_length;               ///< Reports the ring holds
+  size_t head;                       ///< Next report to pop
+  size_t count;                      ///< Reports waiting
+} ble_observe_t;
+
+/**
+ * @brief Allocate the dedup table and the queue
+ *
+ * @param cfg Observer configuration, kept for the filters
+ * @param dedup_ms Suppression period, non-zero
+ * @param queue_length Reports the queue holds, non-zero
+ * @return false if out of memory (nothing stays allocated)
+ */
+bool ble_observe_alloc(ble_observe_t *o, const ble_observer_config_t *cfg, uint32_t dedup_ms, size_t queue_length);
+
+/**
+ * @brief Release the dedup table and the queue
+ */
+void ble_observe_release(ble_observe_t *o);
+
+/**
+ * @brief Filter one report and check it against the dedup table, recording it when it is new
+ *
+ * @param bda Advertiser address
+ * @param data Advertising data followed by the scan response data
+ * @param len Length of data
+ * @param now_ms Reception time in ms, never 0 (0 marks a free dedup slot)
+ * @param evicted Set when a new report overwrote a live entry
+ */
+ble_observe_verdict_t ble_observe_check(ble_observe_t *o, const uint8_t *bda, const uint8_t *data, size_t len,
+                                        uint32_t now_ms, bool *evicted);
+
+/**
+ * @brief Append a report to the queue without waiting
+ *
+ * @return false if the queue is full and the report was dropped
+ */
+bool ble_observe_push(ble_observe_t *o, const ble_observer_report_t *report);
+
+/**
+ * @brief Take the oldest report from the queue
+ *
+ * @return false if the queue is empty
+ */
+bool ble_observe_pop(ble_observe_t *o, ble_observer_report_t *out);
+
+#endif  // BLE_OBSERVE_H
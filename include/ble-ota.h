@@ -0,0 +1,49 @@
+/**
+ * @file ble-ota.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Firmware update internal API - image streamed through the transfer service
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ */
+
+#ifndef BLE_OTA_H
+#define BLE_OTA_H
+
+#include <esp_err.h>
+#include <stddef.h>
+
+#include "ble.h"
+
+/**
+ * @brief Build the OTA control characteristic, start the flash writer and claim the image object
+ *
+ * Firmware is only accepted over an authenticated link, so the security mode must be
+ * BLE_SECURITY_BOND_SC_MITM.
+ *
+ * @param config OTA configuration
+ * @param security Security mode of the server
+ * @param out Filled with the control characteristic definition
+ * @param index Index of out in the characteristic table
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if the security mode cannot authenticate links,
+ *         error code otherwise
+ */
+esp_err_t ble_ota_init(const ble_ota_config_t *config, ble_security_mode_t security, ble_characteristic_t *out,
+                       size_t index);
+
+/**
+ * @brief Stop the flash writer and release the buffers
+ */
+void ble_ota_deinit(void);
+
+/**
+ * @brief Get a snapshot of the update status
+ *
+ * @param out Destination for the status
+ */
+void ble_ota_get_status(ble_ota_status_t *out);
+
+#endif  // BLE_OTA_H
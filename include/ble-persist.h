@@ -0,0 +1,56 @@
+/**
+ * @file ble-persist.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Write-behind persistence internal API - characteristic values kept across reboots
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ */
+
+#ifndef BLE_PERSIST_H
+#define BLE_PERSIST_H
+
+#include <esp_err.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ble.h"
+
+/**
+ * @brief Allocate the value cache and restore stored values through the write handlers
+ *
+ * Only characteristics with BLE_CHAR_FLAG_PERSISTENT are handled. Values are stored under their UUID.
+ *
+ * @param chars Array of characteristic definitions
+ * @param count Number of characteristics
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if two persistent characteristics share a UUID
+ */
+esp_err_t ble_persist_init(const ble_characteristic_t *chars, size_t count);
+
+/**
+ * @brief Flush pending values and release the cache
+ */
+void ble_persist_deinit(void);
+
+/**
+ * @brief Cache an accepted value and schedule a flush
+ *
+ * Does not touch flash; safe to call from the Bluetooth task.
+ *
+ * @param index Characteristic index in the configuration
+ * @param value Value accepted by the write handler
+ * @param len Length of value
+ */
+void ble_persist_store(size_t index, const uint8_t *value, size_t len);
+
+/**
+ * @brief Write all pending values to flash now
+ *
+ * A value that fails to store stays pending and is retried by the next flush.
+ */
+void ble_persist_flush(void);
+
+#endif  // BLE_PERSIST_H
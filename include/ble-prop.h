@@ -0,0 +1,43 @@
+/**
+ * @file ble-prop.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Property store internal API - typed keys behind one batched characteristic
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ */
+
+#ifndef BLE_PROP_H
+#define BLE_PROP_H
+
+#include <esp_err.h>
+#include <stddef.h>
+
+#include "ble.h"
+
+/**
+ * @brief Check the key table, load the defaults and build the store characteristic
+ *
+ * @param config Property store configuration
+ * @param out Filled with the store characteristic definition
+ * @param index Index of out in the characteristic table
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the table is unsorted or a key is invalid
+ */
+esp_err_t ble_prop_init(const ble_prop_config_t *config, ble_characteristic_t *out, size_t index);
+
+/**
+ * @brief Release the value table
+ */
+void ble_prop_deinit(void);
+
+/**
+ * @brief Get a snapshot of the property store statistics
+ *
+ * @param out Destination for the statistics
+ */
+void ble_prop_get_stats(ble_prop_stats_t *out);
+
+#endif  // BLE_PROP_H
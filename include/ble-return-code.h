@@ -23,6 +23,8 @@ typedef enum
   BLE_NOT_INITIALIZED,      ///< BLE subsystem not initialized
   BLE_INVALID_CONFIG,       ///< Invalid configuration provided
   BLE_INVALID_CHARS,        ///< Invalid characteristics definition
+  BLE_TIMEOUT,              ///< Operation did not complete in time
+  BLE_TRUNCATED,            ///< Data did not fit in the buffer, only part of it was returned
 } ble_return_code_t;
 
 /**
@@ -0,0 +1,75 @@
+/**
+ * @file ble-ring.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Single-producer single-consumer byte ring internal API
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ *
+ * Lock-free as long as one task only produces and one only consumes. Plain C with
+ * no stack dependency, so the serial bridge data path can be benchmarked on the host.
+ */
+
+#ifndef BLE_RING_H
+#define BLE_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Byte ring. Indexes run freely and wrap with the mask.
+ */
+typedef struct
+{
+  uint8_t *buf;            ///< Storage
+  uint32_t mask;           ///< Size - 1, size is a power of two
+  volatile uint32_t head;  ///< Written by the producer only
+  volatile uint32_t tail;  ///< Written by the consumer only
+} ble_ring_t;
+
+/**
+ * @brief Allocate the storage, rounding size up to a power of two
+ *
+ * @return false if out of memory
+ */
+bool ble_ring_alloc(ble_ring_t *r, size_t size);
+
+/**
+ * @brief Release the storage
+ */
+void ble_ring_release(ble_ring_t *r);
+
+/**
+ * @brief Bytes waiting to be consumed
+ */
+size_t ble_ring_used(const ble_ring_t *r);
+
+/**
+ * @brief Bytes that can be put without overwriting
+ */
+size_t ble_ring_space(const ble_ring_t *r);
+
+/**
+ * @brief Append up to len bytes. Producer side.
+ *
+ * @return Bytes appended (less than len if the ring filled up)
+ */
+size_t ble_ring_put(ble_ring_t *r, const uint8_t *data, size_t len);
+
+/**
+ * @brief Copy up to len bytes without removing them. Consumer side.
+ *
+ * @return Bytes copied
+ */
+size_t ble_ring_peek(const ble_ring_t *r, uint8_t *out, size_t len);
+
+/**
+ * @brief Remove len bytes that were peeked. Consumer side.
+ */
+void ble_ring_consume(ble_ring_t *r, size_t len);
+
+#endif  // BLE_RING_H
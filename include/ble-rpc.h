@@ -0,0 +1,50 @@
+/**
+ * @file ble-rpc.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief RPC transport internal API - method calls over a request/response characteristic pair
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ */
+
+#ifndef BLE_RPC_H
+#define BLE_RPC_H
+
+#include <esp_err.h>
+#include <stddef.h>
+
+#include "ble.h"
+
+#define BLE_RPC_CHAR_COUNT 2  ///< Request + response
+
+/**
+ * @brief Allocate the call slots, start the dispatch task and build the characteristics
+ *
+ * @param config RPC configuration
+ * @param out Filled with BLE_RPC_CHAR_COUNT characteristic definitions
+ * @param index Index of out[0] in the characteristic table
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the method table is invalid, ESP_ERR_NO_MEM
+ */
+esp_err_t ble_rpc_init(const ble_rpc_config_t *config, ble_characteristic_t *out, size_t index);
+
+/**
+ * @brief Stop the dispatch task and release the slots
+ */
+void ble_rpc_deinit(void);
+
+/**
+ * @brief Drop partially received requests (client disconnected)
+ */
+void ble_rpc_reset(void);
+
+/**
+ * @brief Get a snapshot of the RPC statistics
+ *
+ * @param out Destination for the statistics
+ */
+void ble_rpc_get_stats(ble_rpc_stats_t *out);
+
+#endif  // BLE_RPC_H
@@ -0,0 +1,107 @@
+/**
+ * @file ble-sec.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Security Manager internal API - pairing, bonding and address resolution
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ */
+
+#ifndef BLE_SEC_H
+#define BLE_SEC_H
+
+#include <esp_err.h>
+#include <esp_gap_ble_api.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ble.h"
+
+/**
+ * @brief Configure the security manager
+ *
+ * @param config Security settings
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t ble_sec_init(const ble_security_config_t *config);
+
+/**
+ * @brief Check if links must be encrypted
+ *
+ * @return true if a security mode other than BLE_SECURITY_NONE is configured
+ */
+bool ble_sec_is_enabled(void);
+
+/**
+ * @brief Check if links must be authenticated (encrypted after a pairing with MITM protection)
+ *
+ * @return true in BLE_SECURITY_BOND_SC_MITM
+ */
+bool ble_sec_requires_mitm(void);
+
+/**
+ * @brief Check if the current link is encrypted with keys from a MITM-protected pairing
+ */
+bool ble_sec_link_authenticated(void);
+
+/**
+ * @brief Handle a security related GAP event
+ *
+ * @param event GAP event
+ * @param param GAP event parameters
+ */
+void ble_sec_handle_gap_event(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
+
+/**
+ * @brief A client connected: look up its bond and start encryption
+ *
+ * @param bda Connection address (may be a resolvable private address)
+ * @param addr_type Connection address type (esp_ble_addr_type_t)
+ * @param identity Out: identity address of the client (connection address if unknown)
+ * @param identity_type Out: identity address type
+ * @return true if the client has a stored bond
+ */
+bool ble_sec_on_connect(const uint8_t *bda, uint8_t addr_type, uint8_t *identity, uint8_t *identity_type);
+
+/**
+ * @brief Record the connect -> first ATT request latency of the current link
+ *
+ * @param latency_us Latency in microseconds
+ */
+void ble_sec_record_first_request(int64_t latency_us);
+
+/**
+ * @brief Resolve a resolvable private address against an IRK
+ *
+ * @param irk Identity Resolving Key, as distributed over the air (LSB first)
+ * @param rpa Address to check, in esp_bd_addr_t order (MSB first)
+ * @return true if rpa was generated from irk
+ */
+bool ble_sec_rpa_matches(const uint8_t *irk, const uint8_t *rpa);
+
+/**
+ * @brief Set the attribute layout hash bonded clients are checked against
+ *
+ * A bonded client that last saw a different layout gets a Service Changed
+ * indication once its link is encrypted.
+ *
+ * @param hash Hash of the registered attribute layout
+ */
+void ble_sec_set_db_hash(uint32_t hash);
+
+/**
+ * @brief Remove all bonds
+ */
+void ble_sec_clear_bonds(void);
+
+/**
+ * @brief Get a snapshot of the bonding statistics
+ *
+ * @param out Destination for the statistics
+ */
+void ble_sec_get_stats(ble_security_stats_t *out);
+
+#endif  // BLE_SEC_H
@@ -0,0 +1,50 @@
+/**
+ * @file ble-serial.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Serial bridge internal API - byte stream over an RX/TX characteristic pair
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ */
+
+#ifndef BLE_SERIAL_H
+#define BLE_SERIAL_H
+
+#include <esp_err.h>
+#include <stddef.h>
+
+#include "ble.h"
+
+#define BLE_SERIAL_CHAR_COUNT 2  ///< RX + TX
+
+/**
+ * @brief Allocate the ring buffers and build the RX and TX characteristics
+ *
+ * @param config Serial bridge configuration
+ * @param out Filled with BLE_SERIAL_CHAR_COUNT characteristic definitions
+ * @param index Index of out[0] in the characteristic table
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t ble_serial_init(const ble_serial_config_t *config, ble_characteristic_t *out, size_t index);
+
+/**
+ * @brief Stop the flush timer and release the buffers
+ */
+void ble_serial_deinit(void);
+
+/**
+ * @brief Drop buffered data in both directions (client disconnected)
+ */
+void ble_serial_reset(void);
+
+/**
+ * @brief Get a snapshot of the serial bridge statistics
+ *
+ * @param out Destination for the statistics
+ */
+void ble_serial_get_stats(ble_serial_stats_t *out);
+
+#endif  // BLE_SERIAL_H
@@ -0,0 +1,68 @@
+/**
+ * @file ble-store.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Persistent key/blob storage internal API - keeps BLE state across reboots
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ */
+
+#ifndef BLE_STORE_H
+#define BLE_STORE_H
+
+#include <esp_err.h>
+#include <stddef.h>
+
+/**
+ * @brief Open the BLE storage namespace
+ *
+ * The underlying flash partition must already be initialized by nvm_init().
+ *
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t ble_store_init(void);
+
+/**
+ * @brief Close the BLE storage namespace
+ */
+void ble_store_deinit(void);
+
+/**
+ * @brief Read a blob
+ *
+ * @param key Storage key (max 15 characters)
+ * @param out Destination buffer
+ * @param len In: size of out, out: size of the stored blob
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if the key does not exist, error code otherwise
+ */
+esp_err_t ble_store_get(const char *key, void *out, size_t *len);
+
+/**
+ * @brief Write a blob (not committed until ble_store_commit())
+ *
+ * @param key Storage key (max 15 characters)
+ * @param data Data to store
+ * @param len Size of data
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t ble_store_set(const char *key, const void *data, size_t len);
+
+/**
+ * @brief Erase a key (not committed until ble_store_commit())
+ *
+ * @param key Storage key
+ * @return ESP_OK on success or if the key did not exist, error code otherwise
+ */
+esp_err_t ble_store_erase(const char *key);
+
+/**
+ * @brief Commit pending writes to flash
+ *
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t ble_store_commit(void);
+
+#endif  // BLE_STORE_H
@@ -0,0 +1,84 @@
+/**
+ * @file ble-txn.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Reliable write transaction internal API - staged multi-characteristic writes
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ */
+
+#ifndef BLE_TXN_H
+#define BLE_TXN_H
+
+#include <esp_err.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ble.h"
+
+/**
+ * @brief Apply one committed value (the same path as a regular client write)
+ *
+ * @param index Characteristic index in the configuration
+ * @param value Staged value
+ * @param len Length of value
+ * @return BLE_CHAR_OK if applied, error code otherwise
+ */
+typedef ble_char_error_t (*ble_txn_apply_t)(size_t index, const uint8_t *value, size_t len);
+
+/**
+ * @brief Allocate staging buffers for the writable characteristics
+ *
+ * @param chars Array of characteristic definitions
+ * @param count Number of characteristics
+ * @param validate Transaction validator (NULL = per-characteristic checks only)
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t ble_txn_init(const ble_characteristic_t *chars, size_t count, ble_txn_validate_t validate);
+
+/**
+ * @brief Release the staging buffers
+ */
+void ble_txn_deinit(void);
+
+/**
+ * @brief Stage one Prepare Write fragment
+ *
+ * @param index Characteristic index in the configuration
+ * @param offset Offset of the fragment in the value
+ * @param data Fragment
+ * @param len Length of data
+ * @return BLE_CHAR_OK if staged, BLE_CHAR_ERR_SIZE if it does not fit, BLE_CHAR_ERR_READONLY if not
+ *         writable or only checked by its write handler while there is no transaction validator
+ */
+ble_char_error_t ble_txn_prepare(size_t index, size_t offset, const uint8_t *data, size_t len);
+
+/**
+ * @brief Validate the staged values and apply them in the order they were first prepared
+ *
+ * Nothing is applied unless every value and the transaction validator accept the set.
+ * Applying stops at the first value refused by its write handler; the values before
+ * it stay applied. The transaction is cleared in any case.
+ *
+ * @param apply Applies one value
+ * @param failed_index Out: characteristic that refused the set (SIZE_MAX = the transaction validator)
+ * @return BLE_CHAR_OK if committed, error code of the first refusal otherwise
+ */
+ble_char_error_t ble_txn_execute(ble_txn_apply_t apply, size_t *failed_index);
+
+/**
+ * @brief Discard the staged values (Execute Write cancel or disconnect)
+ */
+void ble_txn_cancel(void);
+
+/**
+ * @brief Get a snapshot of the transaction statistics
+ *
+ * @param out Destination for the statistics
+ */
+void ble_txn_get_stats(ble_txn_stats_t *out);
+
+#endif  // BLE_TXN_H
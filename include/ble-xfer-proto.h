@@ -0,0 +1,156 @@
+/**
+ * @file ble-xfer-proto.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Bulk transfer protocol internal API - block framing, credit window, rewind and resume
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ *
+ * The sending side (download) and the receiving side (upload) of one transfer,
+ * without the characteristics, timers and locks around them. Plain C with no stack
+ * dependency, so loss and corruption recovery can be tested on the host.
+ */
+
+#ifndef BLE_XFER_PROTO_H
+#define BLE_XFER_PROTO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BLE_XFER_BLOCK_OVERHEAD 8            ///< Offset u32 + CRC32 u32 around each payload
+#define BLE_XFER_RESUME         0xFFFFFFFFu  ///< OPEN offset continuing the last interrupted transfer
+
+/**
+ * @brief Direction of the open transfer
+ */
+typedef enum
+{
+  BLE_XFER_PROTO_IDLE = 0,
+  BLE_XFER_PROTO_DOWNLOAD,  ///< This side sends the blocks
+  BLE_XFER_PROTO_UPLOAD,    ///< This side receives the blocks
+} ble_xfer_proto_state_t;
+
+/**
+ * @brief Outcome of checking a received block
+ */
+typedef enum
+{
+  BLE_XFER_BLOCK_OK = 0,   ///< Intact and at the expected offset
+  BLE_XFER_BLOCK_SHORT,    ///< No payload
+  BLE_XFER_BLOCK_CORRUPT,  ///< CRC mismatch
+  BLE_XFER_BLOCK_GAP,      ///< Not the expected offset or past the end, an earlier block was lost
+} ble_xfer_block_t;
+
+/**
+ * @brief One transfer. Offsets count object bytes.
+ */
+typedef struct
+{
+  ble_xfer_proto_state_t state;  ///< Idle, download or upload
+  uint32_t size;                 ///< Object size
+  uint32_t start;                ///< Offset the transfer was opened at
+  uint16_t block;                ///< Payload bytes per block
+  uint32_t window;               ///< Blocks sent ahead of the last ACK, and twice the blocks per ACK
+  uint32_t next;                 ///< Download: next offset to send. Upload: next offset expected
+  uint32_t acked;                ///< Download: offset acknowledged by the receiver
+  uint32_t unacked;              ///< Upload: blocks received since the last ACK
+  bool seek_sent;                ///< Upload: a SEEK for next is outstanding
+} ble_xfer_proto_t;
+
+/**
+ * @brief Resume point of the last interrupted transfer
+ */
+typedef struct
+{
+  bool valid;                    ///< A transfer was opened and not completed or closed
+  uint8_t object;                ///< Its object id
+  ble_xfer_proto_state_t state;  ///< Its direction
+  uint32_t offset;               ///< Last acknowledged offset
+} ble_xfer_resume_t;
+
+/**
+ * @brief Write a little endian u32
+ */
+void ble_xfer_put_u32(uint8_t *out, uint32_t value);
+
+/**
+ * @brief Read a little endian u32
+ */
+uint32_t ble_xfer_get_u32(const uint8_t *in);
+
+/**
+ * @brief Resolve the OPEN offset: BLE_XFER_RESUME continues the same object and direction, or starts at 0
+ */
+uint32_t ble_xfer_proto_resolve(const ble_xfer_resume_t *resume, uint8_t object, ble_xfer_proto_state_t state,
+                                uint32_t offset);
+
+/**
+ * @brief Start a transfer at offset
+ *
+ * @param window Unacknowledged blocks, at least 1
+ */
+void ble_xfer_proto_open(ble_xfer_proto_t *p, ble_xfer_proto_state_t state, uint32_t size, uint32_t offset,
+                         uint16_t block, uint32_t window);
+
+/**
+ * @brief Download: get the next block to send if the window allows it
+ *
+ * @param offset Set to the offset of the block
+ * @param len Set to its payload length, uncompressed
+ * @return false when everything up to the end is sent or the window is full
+ */
+bool ble_xfer_proto_next(const ble_xfer_proto_t *p, uint32_t *offset, uint32_t *len);
+
+/**
+ * @brief Download: a block covering covered object bytes from offset was sent
+ *
+ * A SEEK that moved the window meanwhile wins; the block then just arrives twice.
+ */
+void ble_xfer_proto_sent(ble_xfer_proto_t *p, uint32_t offset, uint32_t covered);
+
+/**
+ * @brief Download: apply an ACK, or a SEEK that also resends from offset
+ *
+ * @param done Set when the whole object is acknowledged
+ * @return false if offset is outside the sent and not yet acknowledged range
+ */
+bool ble_xfer_proto_ack(ble_xfer_proto_t *p, uint32_t offset, bool seek, bool *done);
+
+/**
+ * @brief Frame a block: offset before the payload at block[4], CRC32 after it
+ *
+ * @return Length of the framed block
+ */
+size_t ble_xfer_proto_seal(uint8_t *block, uint32_t offset, size_t payload);
+
+/**
+ * @brief Upload: check a received block against its CRC and the expected offset
+ *
+ * @param offset Set to the block offset
+ * @param payload Set to the payload length (the payload starts at data[4])
+ */
+ble_xfer_block_t ble_xfer_proto_check(const ble_xfer_proto_t *p, const uint8_t *data, size_t len,
+                                      uint32_t *offset, size_t *payload);
+
+/**
+ * @brief Upload: a block was refused, ask for everything from next again
+ *
+ * @return true if a SEEK to next must be sent, false if one is already outstanding for this gap
+ */
+bool ble_xfer_proto_rewind(ble_xfer_proto_t *p);
+
+/**
+ * @brief Upload: the sink took a checked block
+ *
+ * Acknowledging every half window keeps the sender going while the ACK travels.
+ *
+ * @param done Set when the object is complete
+ * @return true if an ACK of next must be sent
+ */
+bool ble_xfer_proto_accept(ble_xfer_proto_t *p, size_t payload, bool *done);
+
+#endif  // BLE_XFER_PROTO_H
@@ -0,0 +1,60 @@
+/**
+ * @file ble-xfer.h
+ * @author Pedro Luis Dionísio Fraga (pedrodfraga@hotmail.com)
+ * @brief Bulk transfer internal API - windowed block transfer with CRC and resume
+ * @version 0.2
+ * @date 2025-07-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ * This is an internal header. Users should use ble.h instead.
+ */
+
+#ifndef BLE_XFER_H
+#define BLE_XFER_H
+
+#include <esp_err.h>
+#include <stddef.h>
+
+#include "ble.h"
+
+#define BLE_XFER_CHAR_COUNT 2  ///< Control point + data
+
+/**
+ * @brief Build the control point and data characteristics
+ *
+ * @param config Transfer configuration
+ * @param out Filled with BLE_XFER_CHAR_COUNT characteristic definitions
+ * @param index Index of out[0] in the characteristic table
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the configuration is incomplete
+ */
+esp_err_t ble_xfer_init(const ble_xfer_config_t *config, ble_characteristic_t *out, size_t index);
+
+/**
+ * @brief Serve one object id with component callbacks instead of the application's
+ *
+ * Only the open, read, write and close callbacks of handler are used.
+ *
+ * @param object Object id reserved by the component
+ * @param handler Callbacks for that object
+ */
+void ble_xfer_set_object_handler(uint8_t object, const ble_xfer_config_t *handler);
+
+/**
+ * @brief Stop any transfer and release the pump timer
+ */
+void ble_xfer_deinit(void);
+
+/**
+ * @brief Abort the open transfer (client disconnected), keeping its resume point
+ */
+void ble_xfer_reset(void);
+
+/**
+ * @brief Get a snapshot of the transfer statistics
+ *
+ * @param out Destination for the statistics
+ */
+void ble_xfer_get_stats(ble_xfer_stats_t *out);
+
+#endif  // BLE_XFER_H
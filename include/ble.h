@@ -20,6 +20,20 @@
 
 #include "ble-return-code.h"
 
+#define BLE_MAX_CHARACTERISTICS 16  ///< Maximum number of characteristics per service
+#define BLE_CENTRAL_MAX_PEERS   3   ///< Peripherals the central role connects to (one more link is kept for the client)
+#define BLE_CENTRAL_MAX_POINTS  8   ///< Characteristics collected per peripheral
+#define BLE_CENTRAL_MAX_VALUE   64  ///< Bytes of the latest value kept per point
+#define BLE_OBSERVER_MAX_DATA   62  ///< Bytes of one observer report (advertising plus scan response data)
+
+/**
+ * @brief Characteristic option flags (ble_characteristic_t::flags)
+ */
+#define BLE_CHAR_FLAG_PERSISTENT    (1 << 0)  ///< Accepted writes are stored in flash and restored at init
+#define BLE_CHAR_FLAG_WRITE_NO_RSP  (1 << 1)  ///< Also accept Write Without Response
+#define BLE_CHAR_FLAG_NOTIFY_DIRECT (1 << 2)  ///< Notify property and CCCD, values pushed by the component itself
+#define BLE_CHAR_FLAG_COMPRESS      (1 << 3)  ///< Reads and notifications are compressed once the client accepts it
+
 /**
  * @brief Read handler function type for characteristics
  *
@@ -58,22 +72,517 @@ typedef int (*ble_char_read_t)(uint8_t *out_buffer, size_t max_len);
  */
 typedef ble_char_error_t (*ble_char_write_t)(const uint8_t *in_data, size_t len);
 
+/**
+ * @brief Validator function type for bound characteristics
+ *
+ * Called before a client write is copied into the bound memory.
+ *
+ * @param in_data Pointer to received data
+ * @param len Length of received data in bytes
+ * @return BLE_CHAR_OK to accept the value, or error code from ble_char_error_t
+ */
+typedef ble_char_error_t (*ble_char_validate_t)(const uint8_t *in_data, size_t len);
+
+/**
+ * @brief Application memory a characteristic is bound to
+ *
+ * Reads are served straight from the memory and client writes land in it after
+ * validation, without calling handlers. The memory is guarded by a sequence lock:
+ * update it between ble_binding_write_begin() and ble_binding_write_end() (or with
+ * ble_binding_write()), and read it with ble_binding_read() from other tasks.
+ *
+ * @example
+ * static sensor_regs_t s_regs;
+ * static ble_char_binding_t s_regs_binding = { .data = &s_regs, .len = sizeof(s_regs) };
+ */
+typedef struct
+{
+  void *data;                    ///< Bound memory
+  size_t len;                    ///< Size of the bound memory in bytes
+  bool writable;                 ///< Clients may write the whole region
+  ble_char_validate_t validate;  ///< Checks client writes before they are applied (NULL = accept all)
+  volatile uint32_t seq;         ///< Sequence lock, odd while an update is in progress (initialize to 0)
+} ble_char_binding_t;
+
+/**
+ * @brief How a characteristic value is interpreted when checking for changes
+ */
+typedef enum
+{
+  BLE_VALUE_RAW = 0,  ///< Opaque bytes, any difference is a change
+  BLE_VALUE_U8,       ///< uint8_t
+  BLE_VALUE_I8,       ///< int8_t
+  BLE_VALUE_U16,      ///< uint16_t, little endian
+  BLE_VALUE_I16,      ///< int16_t, little endian
+  BLE_VALUE_U32,      ///< uint32_t, little endian
+  BLE_VALUE_I32,      ///< int32_t, little endian
+  BLE_VALUE_FLOAT,    ///< IEEE 754 float, little endian
+} ble_value_type_t;
+
+/**
+ * @brief Change-driven notification policy
+ *
+ * While a client is subscribed the value is sampled and compared with the last
+ * value sent. A notification goes out when it moved by more than the deadband,
+ * never more often than min_interval_ms, and at least every heartbeat_ms.
+ * Read handlers of notifying characteristics are also called from the esp_timer task.
+ */
+typedef struct
+{
+  ble_value_type_t type;     ///< Value interpretation for the deadband
+  float deadband;            ///< Changes up to this magnitude are not sent (0 = any change)
+  uint32_t min_interval_ms;  ///< Minimum time between notifications (0 = sample period)
+  uint32_t heartbeat_ms;     ///< Notify at least this often even without change (0 = never)
+} ble_notify_policy_t;
+
+/**
+ * @brief Write coalescing policy for high-rate control characteristics
+ *
+ * Client writes are validated and acknowledged at once, but only the newest
+ * value is applied, at most once per apply_interval_ms. Values a newer write
+ * replaced before they were applied are never seen by the application. The
+ * write handler (or binding update) runs in the esp_timer task.
+ */
+typedef struct
+{
+  ble_char_validate_t validate;  ///< Checks writes before they are acknowledged (NULL = size check only)
+  uint32_t apply_interval_ms;    ///< Minimum time between two applies (0 = as fast as the timer task runs)
+} ble_coalesce_policy_t;
+
 /**
  * @brief Characteristic definition structure
  *
  * Each characteristic acts as a "data register" that can be read and/or written
- * by BLE clients. Define handlers for read/write operations.
+ * by BLE clients. Define handlers for read/write operations, or bind it to
+ * application memory.
  */
 typedef struct
 {
-  uint16_t uuid;            ///< 16-bit UUID for the characteristic (e.g., 0xFF01)
-  const char *name;         ///< Human-readable name for debugging (e.g., "Temperature")
-  const char *description;  ///< User description for the characteristic (shown to BLE clients)
-  uint8_t size;             ///< Maximum data size in bytes (1, 2, 4, etc.)
-  ble_char_read_t read;     ///< Read handler (NULL = write-only characteristic)
-  ble_char_write_t write;   ///< Write handler (NULL = read-only characteristic)
+  uint16_t uuid;                          ///< 16-bit UUID for the characteristic (e.g., 0xFF01)
+  const char *name;                       ///< Human-readable name for debugging (e.g., "Temperature")
+  const char *description;                ///< User description for the characteristic (shown to BLE clients)
+  uint8_t size;                           ///< Maximum data size in bytes (1, 2, 4, etc.)
+  ble_char_read_t read;                   ///< Read handler (NULL = write-only characteristic)
+  ble_char_write_t write;                 ///< Write handler (NULL = read-only characteristic)
+  uint32_t flags;                         ///< BLE_CHAR_FLAG_* options (0 = none)
+  ble_char_binding_t *binding;            ///< Bound memory, used instead of the handlers (NULL = use handlers)
+  const ble_notify_policy_t *notify;      ///< Notification policy (NULL = not notifiable)
+  const ble_coalesce_policy_t *coalesce;  ///< Write coalescing (NULL = every write is applied at once)
 } ble_characteristic_t;
 
+/**
+ * @brief Fast reconnection settings
+ *
+ * When enabled, the address of the last connected client is persisted. After a
+ * disconnect (or at boot) the server first sends high duty cycle directed
+ * advertising to that client, then advertises with an allowlist so only that
+ * client can connect, and finally falls back to normal advertising.
+ */
+typedef struct
+{
+  bool enabled;                  ///< Remember the last client and reconnect to it first
+  uint32_t allowlist_window_ms;  ///< Allowlist-only advertising after the directed burst (0 = until connected)
+} ble_reconnect_config_t;
+
+/**
+ * @brief Link security modes
+ */
+typedef enum
+{
+  BLE_SECURITY_NONE = 0,      ///< Open links, no pairing (default)
+  BLE_SECURITY_BOND_SC,       ///< LE Secure Connections with bonding, characteristics require encryption
+  BLE_SECURITY_BOND_SC_MITM,  ///< As BOND_SC, paired by passkey entry: characteristics require an authenticated link
+} ble_security_mode_t;
+
+/**
+ * @brief Security settings
+ *
+ * Bonded clients re-encrypt with their stored keys on reconnection instead of
+ * pairing again. When the bond table is full the least recently used bond is
+ * evicted.
+ */
+typedef struct
+{
+  ble_security_mode_t mode;  ///< Security mode
+  uint8_t max_bonds;         ///< Bond table size (0 = stack maximum minus one)
+  bool service_changed;      ///< Indicate Service Changed to bonded clients with a stale cache (needs robust caching)
+  uint32_t passkey;          ///< Passkey the device displays (label) for BLE_SECURITY_BOND_SC_MITM, 1 to 999999
+} ble_security_config_t;
+
+#define BLE_FRAME_VERSION  1    ///< Telemetry frame layout version (first byte of the frame)
+#define BLE_FRAME_MAX_SIZE 244  ///< Largest telemetry frame: one notification in a single LE data PDU
+
+/**
+ * @brief Telemetry frame characteristic
+ *
+ * Packs the listed characteristics into one value: an 8 byte header (version,
+ * field count, sequence number, timestamp in ms) followed by each field at a
+ * fixed offset, padded to its characteristic size. Fields that do not fit in the
+ * connection MTU are left out from the end. The frame is readable and notifies
+ * subscribers every period_ms.
+ */
+typedef struct
+{
+  uint16_t uuid;                ///< UUID of the frame characteristic
+  const char *description;      ///< User description (optional)
+  const uint16_t *field_uuids;  ///< UUIDs of the packed characteristics, in frame order
+  size_t field_count;           ///< Number of entries in field_uuids
+  uint32_t period_ms;           ///< Notification period while subscribed (0 = every 20 ms sample)
+} ble_frame_config_t;
+
+/**
+ * @brief Server ready callback type
+ *
+ * Called from the Bluetooth task once the service, all characteristics and
+ * advertising are live. Keep it short.
+ */
+typedef void (*ble_ready_cb_t)(void);
+
+/**
+ * @brief Direction of a bulk transfer
+ */
+typedef enum
+{
+  BLE_XFER_DOWNLOAD = 0,  ///< Device to client, served by the read callback
+  BLE_XFER_UPLOAD,        ///< Client to device, stored by the write callback
+} ble_xfer_dir_t;
+
+/**
+ * @brief Open an object for a transfer
+ *
+ * @param object Object identifier chosen by the client (log, file, ...)
+ * @param dir Transfer direction
+ * @param size Download: set to the object size. Upload: size announced by the client
+ * @return BLE_CHAR_OK to start, or error code from ble_char_error_t to refuse
+ */
+typedef ble_char_error_t (*ble_xfer_open_t)(uint8_t object, ble_xfer_dir_t dir, uint32_t *size);
+
+/**
+ * @brief Read part of the open object (download). Called from the esp_timer task.
+ *
+ * Offsets may go backwards when the client asks for a retransmission.
+ *
+ * @return Number of bytes read (at most len), or negative on error
+ */
+typedef int (*ble_xfer_read_t)(uint32_t offset, uint8_t *out, size_t len);
+
+/**
+ * @brief Store part of the open object (upload). Data arrives in order, verified.
+ *
+ * Called from the Bluetooth task, so it must not block. BLE_CHAR_ERR_BUSY drops
+ * the block and makes the client resend from its offset, which paces the upload.
+ *
+ * @return BLE_CHAR_OK, BLE_CHAR_ERR_BUSY, or another error code to abort the transfer
+ */
+typedef ble_char_error_t (*ble_xfer_write_t)(uint32_t offset, const uint8_t *data, size_t len);
+
+/**
+ * @brief The transfer ended
+ *
+ * @param complete Every byte was transferred and acknowledged; false after an abort or disconnect
+ */
+typedef void (*ble_xfer_close_t)(bool complete);
+
+/**
+ * @brief Bulk transfer service configuration
+ *
+ * Adds a control point and a data characteristic that move an application
+ * object in MTU-sized blocks with a credit window, a CRC32 per block and resume
+ * after reconnect. See the README for the protocol.
+ */
+typedef struct
+{
+  uint16_t control_uuid;   ///< UUID of the control point characteristic
+  uint16_t data_uuid;      ///< UUID of the data characteristic
+  ble_xfer_open_t open;    ///< Opens an object (required)
+  ble_xfer_read_t read;    ///< Source for downloads (NULL = no downloads)
+  ble_xfer_write_t write;  ///< Sink for uploads (NULL = no uploads)
+  ble_xfer_close_t close;  ///< Called when a transfer ends (optional)
+  uint8_t window;          ///< Unacknowledged blocks in flight (0 = 8)
+} ble_xfer_config_t;
+
+/**
+ * @brief Firmware update service configuration
+ *
+ * Adds an OTA control characteristic. The image itself is uploaded through the
+ * bulk transfer service as a reserved object, so the transfer must be configured too.
+ */
+typedef struct
+{
+  uint16_t control_uuid;  ///< UUID of the OTA control characteristic
+  uint8_t object;         ///< Transfer object id of the image (0 = 0xF0)
+} ble_ota_config_t;
+
+/**
+ * @brief Data channel configuration
+ *
+ * Adds a credit-based channel carrying application messages (SDUs) of up to
+ * 65535 bytes over one characteristic, segmented to the connection MTU. Use
+ * ble_channel_write() and ble_channel_read(). See the README for the protocol.
+ */
+typedef struct
+{
+  uint16_t uuid;  ///< UUID of the channel characteristic
+} ble_channel_config_t;
+
+#define BLE_RPC_MAX_MESSAGE 512  ///< Largest RPC request arguments and response result, in bytes
+
+/**
+ * @brief One RPC call as seen by a method handler
+ */
+typedef struct
+{
+  uint8_t id;           ///< Call id chosen by the client, echoed in the response
+  uint8_t method;       ///< Method id
+  const uint8_t *args;  ///< Request arguments
+  size_t len;           ///< Length of args in bytes
+} ble_rpc_call_t;
+
+/**
+ * @brief RPC method handler function type
+ *
+ * Called in the RPC task, one call at a time, so it may block briefly. Parts of
+ * a long result can be streamed first with ble_rpc_stream(); the final part is
+ * written to result.
+ *
+ * @param call The call
+ * @param result Buffer for the final result
+ * @param result_len In: size of result (BLE_RPC_MAX_MESSAGE). Out: bytes written
+ * @return BLE_CHAR_OK, or error code from ble_char_error_t sent to the client instead of a result
+ */
+typedef ble_char_error_t (*ble_rpc_handler_t)(const ble_rpc_call_t *call, uint8_t *result, size_t *result_len);
+
+/**
+ * @brief One entry of the RPC method table
+ */
+typedef struct
+{
+  uint8_t id;                 ///< Method id used by clients
+  ble_rpc_handler_t handler;  ///< Handler of the method
+} ble_rpc_method_t;
+
+/**
+ * @brief RPC transport configuration
+ *
+ * Adds a request characteristic (write without response) and a response
+ * characteristic (notify) carrying framed, segmented method calls, so new
+ * operations need a table entry instead of a characteristic. See the README for the framing.
+ */
+typedef struct
+{
+  uint16_t request_uuid;            ///< UUID of the request characteristic
+  uint16_t response_uuid;           ///< UUID of the response characteristic
+  const ble_rpc_method_t *methods;  ///< Method table (must stay valid)
+  size_t method_count;              ///< Number of methods
+} ble_rpc_config_t;
+
+/**
+ * @brief Serial bridge configuration
+ *
+ * Adds an RX characteristic (client writes) and a TX characteristic (notify)
+ * carrying a plain byte stream, like the Nordic UART Service. Use
+ * ble_serial_read(), ble_serial_write() and ble_serial_poll().
+ */
+typedef struct
+{
+  uint16_t rx_uuid;       ///< UUID of the RX characteristic (client to device)
+  uint16_t tx_uuid;       ///< UUID of the TX characteristic (device to client)
+  size_t rx_buffer_size;  ///< RX ring size, rounded up to a power of two (0 = 1024)
+  size_t tx_buffer_size;  ///< TX ring size, rounded up to a power of two (0 = 1024)
+} ble_serial_config_t;
+
+/**
+ * @brief One key of the property store
+ */
+typedef struct
+{
+  uint16_t id;            ///< Key, unique; the table is sorted by ascending id
+  ble_value_type_t type;  ///< BLE_VALUE_U8 to BLE_VALUE_I32 (RAW and FLOAT are not property types)
+  int64_t min;            ///< Smallest value clients may set
+  int64_t max;            ///< Largest value clients may set (min = max = 0: the whole range of the type)
+  int64_t def;            ///< Value at init
+  bool readonly;          ///< Clients may only GET it
+} ble_prop_def_t;
+
+/**
+ * @brief Property validator function type
+ *
+ * Called for client SETs that passed the bounds of the key, before the value is stored.
+ *
+ * @param id Key
+ * @param value New value
+ * @return BLE_CHAR_OK to accept, or error code from ble_char_error_t returned to the client
+ */
+typedef ble_char_error_t (*ble_prop_validate_t)(uint16_t id, int64_t value);
+
+/**
+ * @brief Property change callback function type
+ *
+ * Called from the Bluetooth task after a client SET changed a value.
+ *
+ * @param id Key
+ * @param value New value
+ */
+typedef void (*ble_prop_changed_t)(uint16_t id, int64_t value);
+
+/**
+ * @brief Property store configuration
+ *
+ * Adds one characteristic serving any number of typed keys. Clients GET, SET
+ * and LIST many keys in one write and receive the results in one notification.
+ * See the README for the protocol.
+ */
+typedef struct
+{
+  uint16_t uuid;                 ///< UUID of the property store characteristic
+  const ble_prop_def_t *props;   ///< Keys sorted by ascending id (must stay valid)
+  size_t prop_count;             ///< Number of keys
+  ble_prop_validate_t validate;  ///< Extra check of client SETs (optional)
+  ble_prop_changed_t on_change;  ///< Called after a client changed a value (optional)
+} ble_prop_config_t;
+
+/**
+ * @brief Sample history configuration
+ *
+ * Samples a readable characteristic at a fixed period into a RAM ring, and adds
+ * a characteristic from which clients download any time range of it as
+ * delta-encoded notifications. See the README for the protocol.
+ */
+typedef struct
+{
+  uint16_t uuid;            ///< UUID of the history characteristic
+  const char *description;  ///< User description of the history characteristic
+  uint16_t source_uuid;     ///< Characteristic sampled (must be readable)
+  ble_value_type_t type;    ///< Sample type, BLE_VALUE_U8 to BLE_VALUE_I32
+  uint32_t period_ms;       ///< Sampling period
+  uint32_t capacity;        ///< Samples kept; the oldest are overwritten (RAM = capacity x type width)
+} ble_history_config_t;
+
+/**
+ * @brief Payload compression configuration
+ *
+ * Adds a capability characteristic through which the client accepts LZ
+ * compression for the connection. From then on, reads and notifications of
+ * characteristics with BLE_CHAR_FLAG_COMPRESS start with a format byte and
+ * bulk downloads may be opened compressed. See the README for the format.
+ */
+typedef struct
+{
+  uint16_t uuid;              ///< UUID of the capability characteristic
+  const uint8_t *dictionary;  ///< Text that typically occurs in values, shared with the client (optional)
+  size_t dictionary_len;      ///< Length of dictionary; only the last 1024 bytes are used
+  uint8_t dictionary_id;      ///< Non-zero id the client must name to prove it has the same dictionary
+} ble_compress_config_t;
+
+/**
+ * @brief How the central role collects a peripheral characteristic
+ */
+typedef enum
+{
+  BLE_CENTRAL_POLL = 0,   ///< Read every period_ms
+  BLE_CENTRAL_SUBSCRIBE,  ///< Enable notifications; every notification is a sample
+} ble_central_mode_t;
+
+/**
+ * @brief One characteristic collected from a peripheral
+ */
+typedef struct
+{
+  uint16_t service_uuid;    ///< Service holding the characteristic on the peripheral
+  uint16_t uuid;            ///< Characteristic UUID
+  ble_central_mode_t mode;  ///< Poll or subscribe
+  uint32_t period_ms;       ///< BLE_CENTRAL_POLL: read period
+} ble_central_point_t;
+
+/**
+ * @brief One peripheral the central role keeps connected
+ */
+typedef struct
+{
+  const char *name;                   ///< Name used in logs
+  uint8_t address[6];                 ///< Device address, most significant byte first (as printed)
+  const ble_central_point_t *points;  ///< Characteristics to collect
+  size_t point_count;                 ///< Number of points (max BLE_CENTRAL_MAX_POINTS)
+} ble_central_peer_t;
+
+/**
+ * @brief Sample callback function type
+ *
+ * Called in the Bluetooth task with every value read or notified. Keep it short.
+ *
+ * @param peer Index of the peer in ble_central_config_t::peers
+ * @param point Index of the point in ble_central_peer_t::points
+ * @param value Value received
+ * @param len Length of value
+ */
+typedef void (*ble_central_data_cb_t)(size_t peer, size_t point, const uint8_t *value, size_t len);
+
+/**
+ * @brief Central (gateway) role configuration
+ *
+ * Besides serving its own client, the device scans for the configured
+ * peripherals, connects to each one it sees, discovers the points once (the
+ * handles are cached in flash) and then polls or subscribes to them. Polls of
+ * all peers are scheduled side by side so every link has a read in flight.
+ * The latest value of each point is kept for ble_central_get_value().
+ */
+typedef struct
+{
+  const ble_central_peer_t *peers;  ///< Peripherals to connect to
+  size_t peer_count;                ///< Number of peers (max BLE_CENTRAL_MAX_PEERS)
+  ble_central_data_cb_t on_data;    ///< Called with every sample (optional)
+} ble_central_config_t;
+
+/**
+ * @brief Observer (passive scanner) configuration
+ *
+ * Reports are filtered, then deduplicated on address and payload: a report
+ * identical to one passed on less than dedup_ms ago is dropped, so a beacon
+ * repeating the same payload reaches the application once per dedup_ms while
+ * a changed payload comes through at once. Each filter list left NULL
+ * accepts everything; a report must pass every list that is set.
+ */
+typedef struct
+{
+  uint16_t scan_interval;         ///< Scan interval in 0.625 ms units (0 = 0x50, 50 ms)
+  uint16_t scan_window;           ///< Scan window in 0.625 ms units, at most the interval (0 = 0x30, 30 ms)
+  bool active;                    ///< Request scan responses (each one costs the advertiser a transmission)
+  const uint8_t (*addresses)[6];  ///< Accepted advertisers, most significant byte first (NULL = any)
+  size_t address_count;           ///< Number of addresses
+  const uint16_t *service_uuids;  ///< Accepted 16-bit service UUIDs, listed or with service data (NULL = any)
+  size_t service_uuid_count;      ///< Number of service UUIDs
+  const uint16_t *company_ids;    ///< Accepted manufacturer data company IDs (NULL = any)
+  size_t company_id_count;        ///< Number of company IDs
+  uint32_t dedup_ms;              ///< Period an identical report is suppressed for (0 = 1000)
+  size_t queue_length;            ///< Reports buffered for ble_observer_receive() (0 = 32)
+} ble_observer_config_t;
+
+/**
+ * @brief One staged value of a reliable write transaction
+ */
+typedef struct
+{
+  uint16_t uuid;         ///< Characteristic UUID
+  const uint8_t *value;  ///< Staged value
+  size_t len;            ///< Length of value in bytes
+} ble_txn_value_t;
+
+/**
+ * @brief Transaction validator function type
+ *
+ * Called on Execute Write with every characteristic the client staged through
+ * Prepare Write, after each value passed its own validation. Nothing is applied
+ * unless it returns BLE_CHAR_OK; the values are then applied once each, in the
+ * order the client first prepared them. Characteristics with a plain write handler
+ * (no binding or coalescing validator) only accept reliable writes when a
+ * transaction validator is configured, since it is their only check before the apply.
+ *
+ * @param values Staged values
+ * @param count Number of values
+ * @return BLE_CHAR_OK to commit, or error code from ble_char_error_t to discard the whole set
+ */
+typedef ble_char_error_t (*ble_txn_validate_t)(const ble_txn_value_t *values, size_t count);
+
 /**
  * @brief BLE server configuration structure
  *
@@ -81,12 +590,347 @@ typedef struct
  */
 typedef struct
 {
-  const char *device_name;                ///< BLE device name shown during discovery
-  uint16_t service_uuid;                  ///< Primary service UUID (e.g., 0x00FF)
-  ble_characteristic_t *characteristics;  ///< Array of characteristic definitions
-  size_t characteristic_count;            ///< Number of characteristics in the array
+  const char *device_name;                   ///< BLE device name shown during discovery
+  uint16_t service_uuid;                     ///< Primary service UUID (e.g., 0x00FF)
+  ble_characteristic_t *characteristics;     ///< Array of characteristic definitions
+  size_t characteristic_count;               ///< Number of characteristics in the array
+  ble_reconnect_config_t reconnect;          ///< Fast reconnection to the last client (disabled by default)
+  ble_security_config_t security;            ///< Pairing and bonding (disabled by default)
+  ble_ready_cb_t on_ready;                   ///< Called once the server is connectable (optional)
+  const ble_frame_config_t *frame;           ///< Telemetry frame characteristic (NULL = none)
+  ble_txn_validate_t validate_transaction;   ///< Checks reliable write transactions as a whole (optional)
+  const ble_xfer_config_t *transfer;         ///< Bulk transfer service (NULL = none)
+  const ble_ota_config_t *ota;               ///< Firmware update service, needs transfer (NULL = none)
+  const ble_channel_config_t *channel;       ///< Credit-based data channel (NULL = none)
+  const ble_rpc_config_t *rpc;               ///< RPC transport (NULL = none)
+  const ble_serial_config_t *serial;         ///< Serial bridge (NULL = none)
+  const ble_prop_config_t *properties;       ///< Property store (NULL = none)
+  const ble_history_config_t *history;       ///< Sample history (NULL = none)
+  const ble_compress_config_t *compression;  ///< Payload compression (NULL = none)
+  const ble_central_config_t *central;       ///< Central role polling peripherals (NULL = none)
+  const ble_observer_config_t *observer;     ///< Advertisement observer (NULL = none)
 } ble_server_config_t;
 
+/**
+ * @brief Advertising lifecycle states
+ *
+ * IDLE -> CONFIGURING -> ADVERTISING -> CONNECTED -> RESTARTING -> ADVERTISING
+ */
+typedef enum
+{
+  BLE_ADV_STATE_IDLE = 0,     ///< Not advertising, payloads may still be resident
+  BLE_ADV_STATE_CONFIGURING,  ///< Advertising/scan response data being pushed to the controller
+  BLE_ADV_STATE_ADVERTISING,  ///< Advertising is live
+  BLE_ADV_STATE_CONNECTED,    ///< A client is connected, advertising stopped by the controller
+  BLE_ADV_STATE_RESTARTING,   ///< Start requested, waiting for the controller to confirm
+  BLE_ADV_STATE_COUNT,
+} ble_adv_state_t;
+
+/**
+ * @brief Advertising modes used while reconnecting
+ */
+typedef enum
+{
+  BLE_ADV_MODE_UNDIRECTED = 0,  ///< Connectable undirected advertising, anyone may connect
+  BLE_ADV_MODE_DIRECTED,        ///< High duty cycle directed advertising to the last client
+  BLE_ADV_MODE_ALLOWLIST,       ///< Undirected advertising, only the last client may connect
+  BLE_ADV_MODE_COUNT,
+} ble_adv_mode_t;
+
+/**
+ * @brief Advertising timing statistics
+ *
+ * All timestamps come from esp_timer_get_time() (microseconds since boot).
+ */
+typedef struct
+{
+  ble_adv_state_t state;                          ///< Current advertising state
+  int64_t state_entered_us[BLE_ADV_STATE_COUNT];  ///< Last time each state was entered (0 = never)
+  uint32_t restart_count;                         ///< Restarts completed after a disconnect
+  int64_t last_restart_latency_us;                ///< Disconnect -> advertising live, last restart
+  int64_t max_restart_latency_us;                 ///< Disconnect -> advertising live, worst case
+  ble_adv_mode_t mode;                            ///< Advertising mode currently requested
+  uint32_t reconnect_count[BLE_ADV_MODE_COUNT];   ///< Reconnections completed through each mode
+  ble_adv_mode_t last_reconnect_mode;             ///< Mode the last reconnection came through
+  int64_t last_reconnect_latency_us;              ///< Disconnect -> next connection, last reconnection
+  uint32_t resume_count;                          ///< Resumes completed with advertising live
+  int64_t last_resume_latency_us;                 ///< ble_server_resume() -> advertising live, last resume
+  int64_t max_resume_latency_us;                  ///< ble_server_resume() -> advertising live, worst case
+  int64_t cold_start_latency_us;                  ///< ble_server_init() -> advertising live, current boot (0 = not yet)
+} ble_adv_stats_t;
+
+/**
+ * @brief Latency accumulator
+ */
+typedef struct
+{
+  uint32_t count;    ///< Number of samples
+  int64_t last_us;   ///< Last sample
+  int64_t min_us;    ///< Smallest sample
+  int64_t max_us;    ///< Largest sample
+  int64_t total_us;  ///< Sum of all samples (average = total_us / count)
+} ble_latency_stats_t;
+
+/**
+ * @brief Bonding statistics
+ */
+typedef struct
+{
+  uint32_t bond_count;                     ///< Bonds currently stored
+  uint32_t evictions;                      ///< Bonds evicted (least recently used) to make room
+  uint32_t service_changed_sent;           ///< Service Changed indications sent to bonded clients with a stale cache
+  ble_latency_stats_t bonded_first_req;    ///< Connect -> first ATT request, client with a cached bond
+  ble_latency_stats_t unbonded_first_req;  ///< Connect -> first ATT request, client without a bond
+} ble_security_stats_t;
+
+/**
+ * @brief Notification statistics
+ */
+typedef struct
+{
+  uint32_t sent;        ///< Notifications sent
+  uint32_t heartbeats;  ///< Notifications sent because the heartbeat expired, without a change
+  uint32_t suppressed;  ///< Samples that changed by no more than the deadband
+  uint32_t dropped;     ///< Notifications not sent because the link was congested
+} ble_notify_stats_t;
+
+/**
+ * @brief Write counters of a coalescing characteristic
+ *
+ * received - applied - rejected writes were replaced by a newer one before being applied.
+ */
+typedef struct
+{
+  uint32_t received;  ///< Writes validated and acknowledged
+  uint32_t applied;   ///< Values handed to the write handler or binding
+  uint32_t rejected;  ///< Values the write handler refused when applied
+} ble_write_stats_t;
+
+/**
+ * @brief Reliable write transaction statistics
+ *
+ * fragments - applied is the number of handler calls saved compared with plain writes.
+ */
+typedef struct
+{
+  uint32_t committed;  ///< Transactions applied
+  uint32_t rejected;   ///< Transactions refused by a validator or a write handler
+  uint32_t cancelled;  ///< Transactions cancelled by the client or by a disconnect
+  uint32_t fragments;  ///< Prepare Write requests in executed transactions
+  uint32_t applied;    ///< Values applied by transactions (one per characteristic)
+} ble_txn_stats_t;
+
+/**
+ * @brief Bulk transfer statistics
+ */
+typedef struct
+{
+  uint32_t completed;            ///< Transfers finished and acknowledged
+  uint32_t aborted;              ///< Transfers closed early, refused or interrupted by a disconnect
+  uint32_t bytes_sent;           ///< Download payload bytes sent, retransmissions included
+  uint32_t bytes_received;       ///< Upload payload bytes accepted
+  uint32_t blocks_sent;          ///< Download blocks sent
+  uint32_t retransmissions;      ///< Rewinds: SEEKs from the client (download) or to the client (upload)
+  uint32_t crc_errors;           ///< Upload blocks dropped because of a CRC mismatch
+  uint32_t goodput_bytes_per_s;  ///< Payload rate of the last completed transfer
+} ble_xfer_stats_t;
+
+/**
+ * @brief Firmware update states
+ */
+typedef enum
+{
+  BLE_OTA_IDLE = 0,   ///< No update in progress
+  BLE_OTA_RECEIVING,  ///< BEGIN accepted, image being uploaded
+  BLE_OTA_VERIFYING,  ///< Image complete, hash being checked
+  BLE_OTA_READY,      ///< Image verified and selected for the next boot
+  BLE_OTA_FAILED,     ///< Flash write, hash or image check failed
+} ble_ota_state_t;
+
+/**
+ * @brief Firmware update status
+ */
+typedef struct
+{
+  ble_ota_state_t state;         ///< Current state
+  uint32_t size;                 ///< Image size announced by BEGIN
+  uint32_t written;              ///< Bytes written to flash
+  uint32_t resumed_from;         ///< Offset the current upload resumed at (0 = from the start)
+  uint32_t flash_waits;          ///< Blocks refused because both buffers were still being written
+  uint32_t max_sector_write_us;  ///< Longest erase + write + hash of one sector
+} ble_ota_status_t;
+
+/**
+ * @brief Data channel statistics
+ */
+typedef struct
+{
+  uint32_t sdus_sent;          ///< Messages fully sent
+  uint32_t sdus_received;      ///< Messages fully received
+  uint32_t segments_sent;      ///< Segments notified
+  uint32_t segments_received;  ///< Segments stored in the receive pool
+  uint32_t credit_waits;       ///< Segments that had to wait for a credit from the client
+  uint32_t overruns;           ///< Segments dropped because the client sent without a credit
+} ble_channel_stats_t;
+
+/**
+ * @brief RPC statistics
+ */
+typedef struct
+{
+  uint32_t calls;              ///< Calls dispatched to a handler or unknown method
+  uint32_t failed;             ///< Dispatched calls answered with an error status
+  uint32_t rejected;           ///< Requests refused before dispatch (pipeline full, bad segment, too long)
+  uint32_t responses_dropped;  ///< Responses the link did not take in time
+  uint32_t segments_received;  ///< Request segments written by the client
+  uint32_t segments_sent;      ///< Response segments notified
+  uint32_t max_in_flight;      ///< Most calls received and not yet answered at once
+} ble_rpc_stats_t;
+
+/**
+ * @brief Serial bridge statistics
+ */
+typedef struct
+{
+  uint32_t bytes_received;   ///< Bytes written by the client and buffered
+  uint32_t bytes_sent;       ///< Bytes notified to the client
+  uint32_t packets_sent;     ///< Notifications sent
+  uint32_t partial_packets;  ///< Notifications sent below the MTU payload by the flush timer
+  uint32_t rx_overflows;     ///< Bytes dropped because the RX buffer was full
+  uint32_t tx_waits;         ///< Writes that had to wait for TX buffer room
+} ble_serial_stats_t;
+
+/**
+ * @brief Property store statistics
+ */
+typedef struct
+{
+  uint32_t batches;    ///< Batches executed
+  uint32_t gets;       ///< GET operations answered
+  uint32_t sets;       ///< SET operations answered
+  uint32_t rejected;   ///< GETs of unknown keys and SETs refused by bounds, read-only or the validator
+  uint32_t truncated;  ///< Batches cut short because the results did not fit the MTU
+  uint32_t malformed;  ///< Batches refused whole because of bad framing or an unknown SET key
+} ble_prop_stats_t;
+
+/**
+ * @brief Sample history statistics
+ */
+typedef struct
+{
+  uint32_t samples;                 ///< Samples taken
+  uint32_t read_errors;             ///< Sample periods left empty because the source read failed
+  uint32_t max_sample_us;           ///< Longest time spent taking one sample
+  uint32_t downloads;               ///< Downloads completed
+  uint32_t samples_sent;            ///< Samples notified
+  uint32_t bytes_sent;              ///< Notification bytes sent, headers included
+  uint32_t skipped;                 ///< Requested samples overwritten before they could be sent
+  uint32_t throughput_bytes_per_s;  ///< Notification rate of the last completed download
+} ble_history_stats_t;
+
+/**
+ * @brief Payload compression statistics
+ *
+ * The compression ratio is bytes_out / bytes_in and the CPU cost per KB is
+ * encode_us * 1024 / bytes_in.
+ */
+typedef struct
+{
+  uint32_t values_compressed;  ///< Values and transfer blocks sent compressed
+  uint32_t values_raw;         ///< Values sent raw because compression did not make them smaller
+  uint32_t bytes_in;           ///< Bytes given to the encoder
+  uint32_t bytes_out;          ///< Bytes sent for them, format bytes excluded
+  uint32_t encode_us;          ///< Time spent encoding
+} ble_compress_stats_t;
+
+/**
+ * @brief Connection state of a central peer
+ */
+typedef enum
+{
+  BLE_CENTRAL_PEER_SEARCHING = 0,  ///< Scanning for its advertisements
+  BLE_CENTRAL_PEER_CONNECTING,     ///< Connection requested
+  BLE_CENTRAL_PEER_DISCOVERING,    ///< Looking up the handles of its points
+  BLE_CENTRAL_PEER_READY,          ///< Polled and subscribed
+} ble_central_peer_state_t;
+
+/**
+ * @brief Scheduling statistics of one central peer
+ */
+typedef struct
+{
+  ble_central_peer_state_t state;  ///< Current connection state
+  uint32_t connects;               ///< Connections established
+  uint32_t disconnects;            ///< Connections lost
+  uint32_t discoveries;            ///< Full service discoveries (other connections reused the cached handles)
+  uint32_t polls;                  ///< Reads completed
+  uint32_t missed_polls;           ///< Poll periods that passed without a read being issued
+  uint32_t notifications;          ///< Notifications received
+  uint32_t errors;                 ///< Reads that failed or timed out
+  uint32_t last_latency_us;        ///< Request to response time of the last read
+  uint32_t avg_latency_us;         ///< Average request to response time
+  uint32_t max_latency_us;         ///< Longest request to response time
+  uint32_t max_lag_us;             ///< Longest time a due poll waited before its read was issued
+} ble_central_peer_stats_t;
+
+/**
+ * @brief One unique advertising report passed on by the observer
+ */
+typedef struct
+{
+  uint8_t address[6];                   ///< Advertiser address, most significant byte first
+  uint8_t address_type;                 ///< esp_ble_addr_type_t
+  uint8_t event_type;                   ///< esp_ble_evt_type_t (connectable, non-connectable, scan response...)
+  int8_t rssi;                          ///< Received signal strength in dBm
+  uint8_t len;                          ///< Bytes in data
+  uint8_t data[BLE_OBSERVER_MAX_DATA];  ///< Advertising data, followed by the scan response data if any
+  int64_t time_us;                      ///< Reception time (esp_timer_get_time())
+} ble_observer_report_t;
+
+/**
+ * @brief Observer ingest statistics
+ */
+typedef struct
+{
+  uint32_t received;         ///< Reports delivered by the controller
+  uint32_t filtered;         ///< Reports rejected by the address, UUID or company filters
+  uint32_t duplicates;       ///< Reports identical to one passed on within dedup_ms
+  uint32_t queued;           ///< Unique reports handed to the application queue
+  uint32_t dropped;          ///< Unique reports lost because the queue was full
+  uint32_t evictions;        ///< Live dedup entries overwritten because the table was crowded
+  uint32_t rate_per_s;       ///< Reports received in the last full second
+  uint32_t peak_rate_per_s;  ///< Highest rate_per_s seen
+} ble_observer_stats_t;
+
+/**
+ * @brief Server bring-up stages, in order
+ */
+typedef enum
+{
+  BLE_BOOT_STAGE_INIT_CALLED = 0,     ///< ble_server_init() entered
+  BLE_BOOT_STAGE_CONTROLLER_ENABLED,  ///< BT controller initialized and enabled
+  BLE_BOOT_STAGE_BLUEDROID_ENABLED,   ///< Bluedroid initialized and enabled
+  BLE_BOOT_STAGE_APP_REGISTERED,      ///< GATTS application registered
+  BLE_BOOT_STAGE_SERVICE_CREATED,     ///< Primary service created
+  BLE_BOOT_STAGE_SERVICE_STARTED,     ///< Primary service started
+  BLE_BOOT_STAGE_CHARS_ADDED,         ///< All characteristics (and descriptors) added
+  BLE_BOOT_STAGE_ADV_STARTED,         ///< Advertising live for the first time
+  BLE_BOOT_STAGE_COUNT,
+} ble_boot_stage_t;
+
+/**
+ * @brief Bring-up timing profile
+ *
+ * All timestamps come from esp_timer_get_time() (microseconds since boot), 0 = not reached.
+ */
+typedef struct
+{
+  int64_t stage_us[BLE_BOOT_STAGE_COUNT];          ///< Time each stage was reached
+  int64_t char_added_us[BLE_MAX_CHARACTERISTICS];  ///< Time each characteristic was added
+  size_t char_count;                               ///< Number of valid entries in char_added_us
+  bool ready;                                      ///< Server is connectable
+} ble_boot_profile_t;
+
 /**
  * @brief Initialize and start the BLE GATT server
  *
@@ -107,6 +951,34 @@ ble_return_code_t ble_server_init(const ble_server_config_t *config);
  */
 ble_return_code_t ble_server_stop();
 
+/**
+ * @brief Suspend the BLE server without tearing down the stack
+ *
+ * Stops advertising and disconnects the client. The controller, Bluedroid,
+ * the GATT database and the advertising payloads stay resident, so
+ * ble_server_resume() only has to restart advertising.
+ *
+ * @return BLE_SUCCESS, BLE_NOT_INITIALIZED if the server is not running
+ */
+ble_return_code_t ble_server_suspend();
+
+/**
+ * @brief Resume a suspended BLE server
+ *
+ * The time until advertising is live is reported by ble_server_get_adv_stats()
+ * next to the cold ble_server_init() time.
+ *
+ * @return BLE_SUCCESS, BLE_NOT_INITIALIZED if the server is not running
+ */
+ble_return_code_t ble_server_resume();
+
+/**
+ * @brief Check if the BLE server is suspended
+ *
+ * @return true if suspended, false otherwise
+ */
+bool ble_server_is_suspended();
+
 /**
  * @brief Check if a BLE client is currently connected
  *
@@ -114,4 +986,325 @@ ble_return_code_t ble_server_stop();
  */
 bool ble_server_is_connected();
 
+/**
+ * @brief Forget the remembered client used for fast reconnection
+ *
+ * Clears the persisted address and returns to normal undirected advertising.
+ *
+ * @return BLE_SUCCESS, BLE_NOT_INITIALIZED if the server is not running
+ */
+ble_return_code_t ble_server_forget_peer();
+
+/**
+ * @brief Get bonding statistics
+ *
+ * @param out Filled with a snapshot of the bonding statistics
+ * @return BLE_SUCCESS, BLE_INVALID_CONFIG if out is NULL
+ */
+ble_return_code_t ble_server_get_security_stats(ble_security_stats_t *out);
+
+/**
+ * @brief Remove all stored bonds
+ *
+ * @return BLE_SUCCESS, BLE_NOT_INITIALIZED if the server is not running
+ */
+ble_return_code_t ble_server_clear_bonds();
+
+/**
+ * @brief Wait until the server is connectable
+ *
+ * ble_server_init() returns once registration is queued; the service, the
+ * characteristics and advertising come up asynchronously afterwards.
+ *
+ * @param timeout_ms Maximum time to wait
+ * @return BLE_SUCCESS when ready, BLE_TIMEOUT otherwise, BLE_NOT_INITIALIZED if the server is not running
+ */
+ble_return_code_t ble_server_wait_ready(uint32_t timeout_ms);
+
+/**
+ * @brief Get the bring-up timing profile
+ *
+ * @param out Filled with a snapshot of the profile
+ * @return BLE_SUCCESS, BLE_INVALID_CONFIG if out is NULL
+ */
+ble_return_code_t ble_server_get_boot_profile(ble_boot_profile_t *out);
+
+/**
+ * @brief Get notification statistics
+ *
+ * @param out Filled with a snapshot of the notification statistics
+ * @return BLE_SUCCESS, BLE_INVALID_CONFIG if out is NULL
+ */
+ble_return_code_t ble_server_get_notify_stats(ble_notify_stats_t *out);
+
+/**
+ * @brief Get the write counters of a coalescing characteristic
+ *
+ * @param uuid Characteristic UUID
+ * @param out Filled with a snapshot of the counters
+ * @return BLE_SUCCESS, BLE_INVALID_CONFIG if out is NULL, BLE_INVALID_CHARS if the
+ *         characteristic does not coalesce writes, BLE_NOT_INITIALIZED if the server is not running
+ */
+ble_return_code_t ble_server_get_write_stats(uint16_t uuid, ble_write_stats_t *out);
+
+/**
+ * @brief Get reliable write transaction statistics
+ *
+ * @param out Filled with a snapshot of the transaction statistics
+ * @return BLE_SUCCESS, BLE_INVALID_CONFIG if out is NULL
+ */
+ble_return_code_t ble_server_get_txn_stats(ble_txn_stats_t *out);
+
+/**
+ * @brief Get bulk transfer statistics
+ *
+ * @param out Filled with a snapshot of the transfer statistics
+ * @return BLE_SUCCESS, BLE_INVALID_CONFIG if out is NULL
+ */
+ble_return_code_t ble_server_get_xfer_stats(ble_xfer_stats_t *out);
+
+/**
+ * @brief Get the firmware update status
+ *
+ * @param out Filled with a snapshot of the update status
+ * @return BLE_SUCCESS, BLE_INVALID_CONFIG if out is NULL
+ */
+ble_return_code_t ble_server_get_ota_status(ble_ota_status_t *out);
+
+/**
+ * @brief Send one message over the data channel
+ *
+ * Blocks while the client has no credit left. Must not be called from the
+ * Bluetooth task (characteristic handlers).
+ *
+ * @param data Message
+ * @param len Length of data (1 to 65535 bytes)
+ * @param timeout_ms Maximum time to wait for credits and link
+ * @return BLE_SUCCESS, BLE_TIMEOUT, BLE_INVALID_CONFIG on a bad argument,
+ *         BLE_NOT_INITIALIZED if the channel is not configured or the client left
+ */
+ble_return_code_t ble_channel_write(const void *data, size_t len, uint32_t timeout_ms);
+
+/**
+ * @brief Receive one message from the data channel
+ *
+ * A message longer than max_len is consumed whole, and only its first max_len bytes are returned.
+ *
+ * @param out Destination buffer
+ * @param max_len Size of out
+ * @param out_len Set to the number of bytes copied into out
+ * @param timeout_ms Maximum time to wait for a complete message
+ * @return BLE_SUCCESS, BLE_TRUNCATED if the message was longer than max_len, BLE_TIMEOUT,
+ *         BLE_INVALID_CONFIG on a bad argument, BLE_NOT_INITIALIZED if the channel is not configured
+ */
+ble_return_code_t ble_channel_read(void *out, size_t max_len, size_t *out_len, uint32_t timeout_ms);
+
+/**
+ * @brief Get data channel statistics
+ *
+ * @param out Filled with a snapshot of the channel statistics
+ * @return BLE_SUCCESS, BLE_INVALID_CONFIG if out is NULL
+ */
+ble_return_code_t ble_server_get_channel_stats(ble_channel_stats_t *out);
+
+/**
+ * @brief Stream part of a result from inside an RPC method handler
+ *
+ * The client receives it as a response flagged as more to come; the call ends
+ * with the result the handler returns.
+ *
+ * @param call Call being handled
+ * @param data Part of the result
+ * @param len Length of data (at most BLE_RPC_MAX_MESSAGE)
+ * @return BLE_SUCCESS, BLE_TIMEOUT if the link stayed congested, BLE_INVALID_CONFIG on a bad argument,
+ *         BLE_NOT_INITIALIZED outside a method handler or if the client left
+ */
+ble_return_code_t ble_rpc_stream(const ble_rpc_call_t *call, const void *data, size_t len);
+
+/**
+ * @brief Get RPC statistics
+ *
+ * @param out Filled with a snapshot of the RPC statistics
+ * @return BLE_SUCCESS, BLE_INVALID_CONFIG if out is NULL
+ */
+ble_return_code_t ble_server_get_rpc_stats(ble_rpc_stats_t *out);
+
+/**
+ * @brief Write bytes to the serial bridge
+ *
+ * Bytes are buffered and sent in MTU-sized notifications; a partial packet
+ * leaves within a few milliseconds. Blocks while the TX buffer is full.
+ *
+ * @param data Bytes to send
+ * @param len Length of data
+ * @param written Set to the number of bytes accepted
+ * @param timeout_ms Maximum time to wait for buffer room
+ * @return BLE_SUCCESS if all bytes were accepted, BLE_TIMEOUT if only *written were,
+ *         BLE_INVALID_CONFIG on a bad argument, BLE_NOT_INITIALIZED if not configured or no client
+ */
+ble_return_code_t ble_serial_write(const void *data, size_t len, size_t *written, uint32_t timeout_ms);
+
+/**
+ * @brief Read bytes received by the serial bridge
+ *
+ * Returns as soon as at least one byte is available.
+ *
+ * @param out Destination buffer
+ * @param max_len Size of out
+ * @param out_len Set to the number of bytes read
+ * @param timeout_ms Maximum time to wait for the first byte
+ * @return BLE_SUCCESS, BLE_TIMEOUT if nothing arrived, BLE_INVALID_CONFIG on a bad argument,
+ *         BLE_NOT_INITIALIZED if not configured
+ */
+ble_return_code_t ble_serial_read(void *out, size_t max_len, size_t *out_len, uint32_t timeout_ms);
+
+/**
+ * @brief Check the serial bridge without blocking
+ *
+ * @param readable Set to the bytes ble_serial_read() can return now
+ * @param writable Set to the bytes ble_serial_write() can take now (0 without a client)
+ * @return BLE_SUCCESS, BLE_INVALID_CONFIG on a bad argument, BLE_NOT_INITIALIZED if not configured
+ */
+ble_return_code_t ble_serial_poll(size_t *readable, size_t *writable);
+
+/**
+ * @brief Get serial bridge statistics
+ *
+ * @param out Filled with a snapshot of the serial bridge statistics
+ * @return BLE_SUCCESS, BLE_INVALID_CONFIG if out is NULL
+ */
+ble_return_code_t ble_server_get_serial_stats(ble_serial_stats_t *out);
+
+/**
+ * @brief Get the value of a property
+ *
+ * @param id Key
+ * @param value Set to the current value
+ * @return BLE_SUCCESS, BLE_INVALID_CHARS if the key is unknown, BLE_INVALID_CONFIG if value is NULL,
+ *         BLE_NOT_INITIALIZED if the property store is not configured
+ */
+ble_return_code_t ble_prop_get(uint16_t id, int64_t *value);
+
+/**
+ * @brief Set the value of a property from the application
+ *
+ * Bounds apply, read-only does not; the validator and the change callback are not called.
+ *
+ * @param id Key
+ * @param value New value
+ * @return BLE_SUCCESS, BLE_INVALID_CHARS if the key is unknown, BLE_INVALID_CONFIG if out of bounds,
+ *         BLE_NOT_INITIALIZED if the property store is not configured
+ */
+ble_return_code_t ble_prop_set(uint16_t id, int64_t value);
+
+/**
+ * @brief Get property store statistics
+ *
+ * @param out Filled with a snapshot of the property store statistics
+ * @return BLE_SUCCESS, BLE_INVALID_CONFIG if out is NULL
+ */
+ble_return_code_t ble_server_get_prop_stats(ble_prop_stats_t *out);
+
+/**
+ * @brief Get sample history statistics
+ *
+ * @param out Filled with a snapshot of the history statistics
+ * @return BLE_SUCCESS, BLE_INVALID_CONFIG if out is NULL
+ */
+ble_return_code_t ble_server_get_history_stats(ble_history_stats_t *out);
+
+/**
+ * @brief Get payload compression statistics
+ *
+ * @param out Filled with a snapshot of the compression statistics
+ * @return BLE_SUCCESS, BLE_INVALID_CONFIG if out is NULL
+ */
+ble_return_code_t ble_server_get_compress_stats(ble_compress_stats_t *out);
+
+/**
+ * @brief Get the latest value the central role received for a point
+ *
+ * @param peer Index of the peer in ble_central_config_t::peers
+ * @param point Index of the point in ble_central_peer_t::points
+ * @param out Destination buffer (a longer value is truncated)
+ * @param max_len Size of out
+ * @param out_len Set to the number of bytes copied
+ * @param age_ms Set to the time since the value arrived (optional)
+ * @return BLE_SUCCESS, BLE_INVALID_CONFIG on a bad argument,
+ *         BLE_NOT_INITIALIZED if the central role is not configured or no value arrived yet
+ */
+ble_return_code_t ble_central_get_value(size_t peer, size_t point, void *out, size_t max_len, size_t *out_len,
+                                        uint32_t *age_ms);
+
+/**
+ * @brief Get the scheduling statistics of one central peer
+ *
+ * @param peer Index of the peer in ble_central_config_t::peers
+ * @param out Filled with a snapshot of the peer statistics
+ * @return BLE_SUCCESS, BLE_INVALID_CONFIG if out is NULL or peer is out of range,
+ *         BLE_NOT_INITIALIZED if the central role is not configured
+ */
+ble_return_code_t ble_server_get_central_stats(size_t peer, ble_central_peer_stats_t *out);
+
+/**
+ * @brief Take the next unique advertising report from the observer queue
+ *
+ * @param out Filled with the report
+ * @param timeout_ms Time to wait for a report (0 = do not wait)
+ * @return BLE_SUCCESS, BLE_TIMEOUT if no report arrived, BLE_INVALID_CONFIG if out is NULL,
+ *         BLE_NOT_INITIALIZED if the observer is not configured or the server stopped while waiting
+ */
+ble_return_code_t ble_observer_receive(ble_observer_report_t *out, uint32_t timeout_ms);
+
+/**
+ * @brief Get the observer ingest, deduplication and drop counts
+ *
+ * @param out Filled with a snapshot of the statistics
+ * @return BLE_SUCCESS, BLE_INVALID_CONFIG if out is NULL
+ */
+ble_return_code_t ble_server_get_observer_stats(ble_observer_stats_t *out);
+
+/**
+ * @brief Start updating bound memory
+ *
+ * Concurrent readers retry until ble_binding_write_end(). Keep the update short.
+ *
+ * @param binding Binding to update
+ */
+void ble_binding_write_begin(ble_char_binding_t *binding);
+
+/**
+ * @brief Finish updating bound memory
+ *
+ * @param binding Binding being updated
+ */
+void ble_binding_write_end(ble_char_binding_t *binding);
+
+/**
+ * @brief Copy a value into bound memory
+ *
+ * @param binding Binding to update
+ * @param data New value
+ * @param len Length of data (at most binding->len)
+ */
+void ble_binding_write(ble_char_binding_t *binding, const void *data, size_t len);
+
+/**
+ * @brief Take a consistent snapshot of bound memory
+ *
+ * @param binding Binding to read
+ * @param out Destination buffer
+ * @param max_len Size of out
+ * @return Number of bytes copied
+ */
+size_t ble_binding_read(const ble_char_binding_t *binding, void *out, size_t max_len);
+
+/**
+ * @brief Get advertising state and restart timing
+ *
+ * @param out Filled with a snapshot of the advertising statistics
+ * @return BLE_SUCCESS, BLE_INVALID_CONFIG if out is NULL
+ */
+ble_return_code_t ble_server_get_adv_stats(ble_adv_stats_t *out);
+
 #endif  // BLE_H
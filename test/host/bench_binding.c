@@ -0,0 +1,165 @@
+/**
+ * @file bench_binding.c
+ * @brief Host benchmark of bound memory against a read/write handler round trip
+ *
+ * The same register block is served twice through ble_char_read_value() and
+ * ble_char_write_value(), the calls the GATT server makes for a client access:
+ * once bound to the memory (sequence lock, no handler) and once through
+ * handlers that copy under a mutex, the usual way an application shares a
+ * value with its own tasks.
+ *
+ * Each size is measured alone, then with an application thread updating the
+ * value as fast as it can while the reader runs. Every value is written with all
+ * its bytes equal, so a torn read fails the benchmark. The numbers are host CPU
+ * costs, without the stack and radio time common to both paths.
+ */
+
+#include "ble-char.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_MAX_SIZE 244  // Largest value at a 247 byte MTU
+#define BENCH_ROUNDS   1000000
+#define BENCH_BUSY_MS  300  // Duration of the contended runs
+
+static uint8_t s_memory[BENCH_MAX_SIZE];
+static size_t s_size;
+static ble_char_binding_t s_binding = {.data = s_memory, .writable = true};
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile bool s_stop;
+
+static int64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int handler_read(uint8_t *out, size_t max_len)
+{
+  size_t len = (s_size < max_len) ? s_size : max_len;
+  pthread_mutex_lock(&s_mutex);
+  memcpy(out, s_memory, len);
+  pthread_mutex_unlock(&s_mutex);
+  return (int)len;
+}
+
+static ble_char_error_t handler_write(const uint8_t *data, size_t len)
+{
+  if (len != s_size)
+    return BLE_CHAR_ERR_SIZE;
+  pthread_mutex_lock(&s_mutex);
+  memcpy(s_memory, data, len);
+  pthread_mutex_unlock(&s_mutex);
+  return BLE_CHAR_OK;
+}
+
+static const ble_characteristic_t s_bound = {.uuid = 0xFF01, .size = BENCH_MAX_SIZE, .binding = &s_binding};
+static const ble_characteristic_t s_handled = {
+  .uuid = 0xFF02,
+  .size = BENCH_MAX_SIZE,
+  .read = handler_read,
+  .write = handler_write,
+};
+
+/**
+ * @brief Application thread: update the value through the path under test until told to stop
+ */
+static void *writer_thread(void *arg)
+{
+  const ble_characteristic_t *ch = (const ble_characteristic_t *)arg;
+  uint8_t value[BENCH_MAX_SIZE];
+  uint8_t fill = 0;
+
+  while (!s_stop)
+  {
+    memset(value, ++fill, s_size);
+    if (ch->binding != NULL)
+      ble_binding_write(ch->binding, value, s_size);
+    else
+      ch->write(value, s_size);
+  }
+  return NULL;
+}
+
+static bool torn(const uint8_t *value, size_t len)
+{
+  for (size_t i = 1; i < len; i++)
+  {
+    if (value[i] != value[0])
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Alone, then against the writer thread
+ * @return 0, or 1 if a read returned a torn value
+ */
+static int run(const char *name, const ble_characteristic_t *ch)
+{
+  uint8_t value[BENCH_MAX_SIZE];
+  memset(value, 0, sizeof(value));
+  memset(s_memory, 0, sizeof(s_memory));  // Uniform again after the last run's writer
+
+  int64_t start = now_ns();
+  for (int i = 0; i < BENCH_ROUNDS; i++)
+    ble_char_read_value(ch, value, s_size);
+  double read_ns = (double)(now_ns() - start) / BENCH_ROUNDS;
+
+  start = now_ns();
+  for (int i = 0; i < BENCH_ROUNDS; i++)
+    ble_char_write_value(ch, value, s_size);
+  double write_ns = (double)(now_ns() - start) / BENCH_ROUNDS;
+
+  pthread_t writer;
+  uint32_t reads = 0;
+  s_stop = false;
+  pthread_create(&writer, NULL, writer_thread, (void *)ch);
+  start = now_ns();
+  int64_t end = start + (int64_t)BENCH_BUSY_MS * 1000000;
+  int64_t now = start;
+  while (now < end)
+  {
+    for (int i = 0; i < 256; i++, reads++)
+    {
+      ble_char_read_value(ch, value, s_size);
+      if (torn(value, s_size))
+      {
+        s_stop = true;
+        pthread_join(writer, NULL);
+        fprintf(stderr, "%s: torn %zu byte read\n", name, s_size);
+        return 1;
+      }
+    }
+    now = now_ns();
+  }
+  s_stop = true;
+  pthread_join(writer, NULL);
+
+  printf("%-8s %3zu bytes: read %6.1f ns, write %6.1f ns, %6.2f M reads/s against a writer\n",
+         name,
+         s_size,
+         read_ns,
+         write_ns,
+         (double)reads * 1000.0 / (double)(now - start));
+  return 0;
+}
+
+int main(void)
+{
+  static const size_t sizes[] = {4, 16, 64, BENCH_MAX_SIZE};
+  int failed = 0;
+
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+  {
+    s_size = sizes[i];
+    s_binding.len = s_size;
+    failed |= run("binding", &s_bound);
+    failed |= run("handler", &s_handled);
+  }
+  return failed;
+}
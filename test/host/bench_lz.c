@@ -0,0 +1,219 @@
+/**
+ * @file bench_lz.c
+ * @brief Host benchmark of the LZ codec on status records and log text
+ *
+ * Values are encoded one at a time, the way reads and notifications are, and
+ * the whole text is downloaded as blocks, each one stream filled from the
+ * source in small reads until the payload is full, the way ble-xfer does it.
+ * Each case runs with and without a static dictionary and prints the
+ * compression ratio (bytes out per byte in) and the encoder CPU cost per KB of
+ * input. Every stream is decoded and compared, so the benchmark also fails on
+ * a codec error.
+ */
+
+#include "ble-lz.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_RECORDS 2000
+#define BENCH_TEXT    (512 * 1024)
+#define BENCH_VALUE   244  // Notification payload at a 247 byte MTU, format byte excluded
+#define BENCH_BLOCK   236  // Download block payload at the same MTU
+#define BENCH_CHUNK   128  // Source bytes read per call while a block fills
+#define BENCH_ROUNDS  20
+
+static const char s_dict[] = "{\"state\":\"temperature\":\"humidity\":\"error\":\"uptime\":\"rssi\":\"fan\":"
+                             "\"door\":\"idle\",\"heating\",\"cooling\",\"ok\",\"timeout\"}"
+                             " I (ble) W (ble) E (ble) connected disconnected notify read write ";
+
+static const char *const s_states[] = {"idle", "heating", "cooling", "ok"};
+static const char *const s_errors[] = {"ok", "ok", "ok", "timeout"};
+static const char *const s_logs[] = {
+  "I (%lu) ble: connected, mtu %u\n",
+  "W (%lu) ble: notify queue full, %u dropped\n",
+  "I (%lu) sensor: temperature %u.%u C\n",
+  "E (%lu) sensor: read timeout after %u ms\n",
+  "I (%lu) ble: disconnected, reason 0x%02x\n",
+};
+
+static char s_text[BENCH_TEXT];
+static size_t s_text_len = 0;
+static size_t s_value_at[BENCH_RECORDS + 1];  // Record boundaries inside s_text
+
+static ble_lz_t s_lz;
+static uint16_t s_head[BLE_LZ_HASH_SIZE];
+static uint8_t s_stream[BENCH_TEXT + BENCH_TEXT / 8 + 16];
+static uint8_t s_decoded[BENCH_TEXT];
+
+static int64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint32_t next(uint32_t *seed)
+{
+  *seed = *seed * 1103515245u + 12345u;
+  return *seed >> 16;
+}
+
+/**
+ * @brief Status records, each followed by one log line, as one value per record
+ */
+static void make_text(void)
+{
+  uint32_t seed = 1;
+  unsigned long uptime = 1000;
+
+  for (size_t r = 0; r < BENCH_RECORDS; r++)
+  {
+    s_value_at[r] = s_text_len;
+    uptime += 1000 + next(&seed) % 50;
+    s_text_len += (size_t)snprintf(&s_text[s_text_len], BENCH_TEXT - s_text_len,
+                                   "{\"state\":\"%s\",\"temperature\":%u,\"humidity\":%u,\"error\":\"%s\","
+                                   "\"uptime\":%lu,\"rssi\":-%u}",
+                                   s_states[next(&seed) % 4], 180 + next(&seed) % 60, 30 + next(&seed) % 40,
+                                   s_errors[next(&seed) % 4], uptime, 40 + next(&seed) % 50);
+
+    const char *log = s_logs[next(&seed) % (sizeof(s_logs) / sizeof(s_logs[0]))];
+    unsigned a = next(&seed) % 300, b = next(&seed) % 10;
+    s_text_len += (size_t)snprintf(&s_text[s_text_len], BENCH_TEXT - s_text_len, log, uptime, a, b);
+  }
+  s_value_at[BENCH_RECORDS] = s_text_len;
+}
+
+/**
+ * @brief Encode in to at most cap bytes, committing chunk bytes at a time until the output is full
+ */
+static size_t encode(const uint8_t *dict, size_t dict_len, const uint8_t *in, size_t len, size_t chunk, size_t cap)
+{
+  ble_lz_begin(&s_lz, dict, dict_len, s_head, s_stream, cap);
+
+  size_t done = 0;
+  while (done < len)
+  {
+    size_t room;
+    uint8_t *window = ble_lz_input(&s_lz, &room);
+    if (room == 0)
+      break;
+    size_t n = (len - done < chunk) ? len - done : chunk;
+    if (n > room)
+      n = room;
+    memcpy(window, &in[done], n);
+    ble_lz_commit(&s_lz, n);
+    done += n;
+  }
+  return ble_lz_finish(&s_lz);
+}
+
+/**
+ * @brief Check that the last stream decodes to the input it covers
+ */
+static bool decodes(const uint8_t *dict, size_t dict_len, size_t n, const uint8_t *in)
+{
+  return ble_lz_decode(dict, dict_len, s_stream, n, s_decoded, sizeof(s_decoded)) == (int)s_lz.encoded &&
+         memcmp(s_decoded, in, s_lz.encoded) == 0;
+}
+
+static void report(const char *name, size_t in, size_t out, int64_t encode_ns)
+{
+  printf("%-28s ratio %.3f (%5.1f%% saved), %.2f us/KB\n",
+         name,
+         (double)out / (double)in,
+         100.0 * (1.0 - (double)out / (double)in),
+         (double)encode_ns / 1000.0 / ((double)in / 1024.0));
+}
+
+/**
+ * @brief One value per record; a value that does not shrink is counted raw, as ble-compress sends it
+ * @return 0, or 1 if a stream did not decode to its input
+ */
+static int run_values(const char *name, const uint8_t *dict, size_t dict_len)
+{
+  size_t in = 0, out = 0;
+  int64_t encode_ns = 0;
+
+  ble_lz_prime(s_head, dict, dict_len);
+  for (int round = 0; round < BENCH_ROUNDS; round++)
+  {
+    for (size_t v = 0; v < BENCH_RECORDS; v++)
+    {
+      const uint8_t *value = (const uint8_t *)&s_text[s_value_at[v]];
+      size_t len = s_value_at[v + 1] - s_value_at[v];
+      if (len > BENCH_VALUE)
+        len = BENCH_VALUE;
+
+      int64_t start = now_ns();
+      size_t n = encode(dict, dict_len, value, len, len, len - 1);
+      encode_ns += now_ns() - start;
+
+      bool packed = s_lz.encoded == len && !s_lz.full;
+      if (packed && !decodes(dict, dict_len, n, value))
+      {
+        fprintf(stderr, "%s: value %zu did not decode\n", name, v);
+        return 1;
+      }
+      in += len;
+      out += 1 + (packed ? n : len);  // Format byte
+    }
+  }
+
+  report(name, in, out, encode_ns);
+  return 0;
+}
+
+/**
+ * @brief The whole text as download blocks, each covering as much of it as compresses into the payload
+ * @return 0, or 1 if a block did not decode to its input
+ */
+static int run_blocks(const char *name, const uint8_t *dict, size_t dict_len)
+{
+  size_t in = 0, out = 0, blocks = 0;
+  int64_t encode_ns = 0;
+
+  ble_lz_prime(s_head, dict, dict_len);
+  for (int round = 0; round < BENCH_ROUNDS; round++)
+  {
+    size_t at = 0;
+    while (at < s_text_len)
+    {
+      const uint8_t *block = (const uint8_t *)&s_text[at];
+
+      int64_t start = now_ns();
+      size_t n = encode(dict, dict_len, block, s_text_len - at, BENCH_CHUNK, BENCH_BLOCK);
+      encode_ns += now_ns() - start;
+
+      if (s_lz.encoded == 0 || !decodes(dict, dict_len, n, block))
+      {
+        fprintf(stderr, "%s: block at %zu did not decode\n", name, at);
+        return 1;
+      }
+      at += s_lz.encoded;
+      out += n;
+      blocks++;
+    }
+    in += s_text_len;
+  }
+
+  report(name, in, out, encode_ns);
+  printf("%-28s %.1f object bytes per %d byte block\n", "", (double)in / (double)blocks, BENCH_BLOCK);
+  return 0;
+}
+
+int main(void)
+{
+  make_text();
+  printf("lz bench: %zu bytes of status records and log lines, %d values\n", s_text_len, BENCH_RECORDS);
+
+  const uint8_t *dict = (const uint8_t *)s_dict;
+  size_t dict_len = sizeof(s_dict) - 1;
+  int failed = 0;
+  failed |= run_values("values, no dictionary", NULL, 0);
+  failed |= run_values("values, dictionary", dict, dict_len);
+  failed |= run_blocks("download, no dictionary", NULL, 0);
+  failed |= run_blocks("download, dictionary", dict, dict_len);
+  return failed;
+}
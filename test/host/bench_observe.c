@@ -0,0 +1,146 @@
+/**
+ * @file bench_observe.c
+ * @brief Host benchmark of the observer report path: filters, dedup table and queue
+ *
+ * N beacons advertise every 100 ms for a simulated 20 s. A fifth of them carry
+ * another service and are filtered out. At each advertisement a beacon keeps its
+ * last payload with the given duplicate rate, or changes its counter. Reports
+ * go through ble_observe_check() and the new ones are pushed to a 64-report
+ * queue, which an application task drains at 200 reports per second.
+ *
+ * For every N x duplicate rate the benchmark prints the ingest rate the host
+ * sustains (check plus push, CPU time only) and what became of the reports:
+ * queued, duplicates suppressed, live dedup entries evicted and reports dropped
+ * because the queue was full.
+ */
+
+#include "ble-observe.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_SECONDS    20
+#define BENCH_PERIOD_MS  100  // Advertising interval of every beacon
+#define BENCH_DEDUP_MS   2000
+#define BENCH_QUEUE      64
+#define BENCH_DRAIN_MS   5  // One report taken by the application every 5 ms
+#define BENCH_MAX_BEACON 1000
+
+static const uint16_t s_environment[] = {0x181A};
+
+static const ble_observer_config_t s_config = {
+  .service_uuids = s_environment,
+  .service_uuid_count = 1,
+  .dedup_ms = BENCH_DEDUP_MS,
+  .queue_length = BENCH_QUEUE,
+};
+
+static ble_observe_t s_observe;
+static uint16_t s_counter[BENCH_MAX_BEACON];
+static uint32_t s_seed;
+
+static int64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint32_t next(void)
+{
+  s_seed = s_seed * 1103515245u + 12345u;
+  return s_seed >> 16;
+}
+
+/**
+ * @brief Advertising data of one beacon: flags, 16-bit service list, service data with counter and reading
+ */
+static size_t make_report(ble_observer_report_t *report, size_t beacon)
+{
+  uint16_t uuid = (beacon % 5 == 0) ? 0x180F : 0x181A;
+  uint16_t counter = s_counter[beacon];
+  const uint8_t data[] = {
+    0x02, 0x01, 0x06,                                     // Flags
+    0x03, 0x03, uuid & 0xFF, uuid >> 8,                   // Complete 16-bit service list
+    0x09, 0x16, uuid & 0xFF, uuid >> 8, counter & 0xFF,   // Service data: UUID, counter,
+    counter >> 8, 0xD7, 0x00, 0x2A, 0x01,                 // temperature and humidity
+  };
+
+  memset(report, 0, sizeof(*report));
+  report->address[0] = 0xC0;
+  report->address[4] = (uint8_t)(beacon >> 8);
+  report->address[5] = (uint8_t)beacon;
+  report->len = sizeof(data);
+  memcpy(report->data, data, sizeof(data));
+  return sizeof(data);
+}
+
+static void run(size_t beacons, unsigned duplicate_pct)
+{
+  uint32_t received = 0, filtered = 0, duplicates = 0, evictions = 0, queued = 0, dropped = 0;
+  int64_t ingest_ns = 0;
+  ble_observer_report_t report;
+
+  ble_observe_alloc(&s_observe, &s_config, BENCH_DEDUP_MS, BENCH_QUEUE);
+  memset(s_counter, 0, sizeof(s_counter));
+  s_seed = 1;
+
+  for (uint32_t ms = 1; ms <= BENCH_SECONDS * 1000; ms++)
+  {
+    // Beacons are spread evenly over the advertising interval
+    for (size_t b = ms % BENCH_PERIOD_MS; b < beacons; b += BENCH_PERIOD_MS)
+    {
+      if (next() % 100 >= duplicate_pct)
+        s_counter[b]++;
+      size_t len = make_report(&report, b);
+
+      bool evicted;
+      int64_t start = now_ns();
+      ble_observe_verdict_t verdict = ble_observe_check(&s_observe, report.address, report.data, len, ms, &evicted);
+      bool pushed = verdict == BLE_OBSERVE_NEW && ble_observe_push(&s_observe, &report);
+      ingest_ns += now_ns() - start;
+
+      received++;
+      filtered += verdict == BLE_OBSERVE_FILTERED;
+      duplicates += verdict == BLE_OBSERVE_DUPLICATE;
+      evictions += evicted;
+      queued += pushed;
+      dropped += verdict == BLE_OBSERVE_NEW && !pushed;
+    }
+
+    if (ms % BENCH_DRAIN_MS == 0)
+      ble_observe_pop(&s_observe, &report);
+  }
+
+  printf("%4zu beacons, %2u%% duplicate: %5.2f M reports/s, %6u received, %5u filtered, %6u duplicates, "
+         "%5u queued, %4u evicted, %5u dropped\n",
+         beacons,
+         duplicate_pct,
+         (double)received * 1000.0 / (double)ingest_ns,
+         received,
+         filtered,
+         duplicates,
+         queued,
+         evictions,
+         dropped);
+  ble_observe_release(&s_observe);
+}
+
+int main(void)
+{
+  static const size_t beacons[] = {50, 200, BENCH_MAX_BEACON};
+  static const unsigned duplicate_pct[] = {50, 90, 99};
+
+  printf("observer bench: %d ms advertising, %d ms dedup, %d report queue drained every %d ms\n",
+         BENCH_PERIOD_MS,
+         BENCH_DEDUP_MS,
+         BENCH_QUEUE,
+         BENCH_DRAIN_MS);
+  for (size_t i = 0; i < sizeof(beacons) / sizeof(beacons[0]); i++)
+  {
+    for (size_t j = 0; j < sizeof(duplicate_pct) / sizeof(duplicate_pct[0]); j++)
+      run(beacons[i], duplicate_pct[j]);
+  }
+  return 0;
+}
@@ -0,0 +1,182 @@
+/**
+ * @file bench_read_multiple.c
+ * @brief Host benchmark of fetching a 16-characteristic config: Read Multiple against sequential reads
+ *
+ * Bluedroid answers ATT Read Multiple (Variable Length) by raising one read
+ * event per handle and assembling the response itself, so the server side of
+ * both procedures is the same: handle_char_read() takes one value snapshot per
+ * handle through ble_char_read_value(). That path sits on the Bluedroid event
+ * and response calls and does not run on the host; the values do, so they are
+ * produced here by the same calls, half from bound memory and half from read
+ * handlers, and packed into ATT PDUs the way the client and the stack exchange
+ * them.
+ *
+ * A round trip is one request and its response, which costs a connection
+ * interval when the server answers in the next connection event. For each MTU
+ * and interval the benchmark prints the round trips and the latency of fetching
+ * every value: one Read per value (plus Read Blob for values longer than
+ * MTU - 1) against as few Read Multiple Variable Length requests as the request
+ * and response PDUs allow. The server CPU time per fetch is measured and added;
+ * it is the same for both.
+ */
+
+#include "ble-char.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_CHARS  16
+#define BENCH_ROUNDS 100000
+#define BENCH_VALUE  512  // ESP_GATT_MAX_ATTR_LEN, the size of the read snapshot
+
+static uint8_t s_regs[8][4];  // Bound settings
+static char s_labels[4][20];  // Read through handlers
+static uint32_t s_counters[4];
+static ble_char_binding_t s_bindings[8];
+
+static int64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int read_label(size_t i, uint8_t *out, size_t max_len)
+{
+  size_t len = strlen(s_labels[i]);
+  if (len > max_len)
+    len = max_len;
+  memcpy(out, s_labels[i], len);
+  return (int)len;
+}
+
+static int read_label0(uint8_t *out, size_t max_len)
+{
+  return read_label(0, out, max_len);
+}
+
+static int read_label1(uint8_t *out, size_t max_len)
+{
+  return read_label(1, out, max_len);
+}
+
+static int read_label2(uint8_t *out, size_t max_len)
+{
+  return read_label(2, out, max_len);
+}
+
+static int read_label3(uint8_t *out, size_t max_len)
+{
+  return read_label(3, out, max_len);
+}
+
+static int read_counters(uint8_t *out, size_t max_len)
+{
+  size_t len = (sizeof(s_counters) < max_len) ? sizeof(s_counters) : max_len;
+  memcpy(out, s_counters, len);
+  return (int)len;
+}
+
+static ble_characteristic_t s_chars[BENCH_CHARS];
+
+static void make_config(void)
+{
+  static const ble_char_read_t labels[] = {read_label0, read_label1, read_label2, read_label3};
+
+  for (size_t i = 0; i < 8; i++)
+  {
+    memset(s_regs[i], (int)i, sizeof(s_regs[i]));
+    s_bindings[i] = (ble_char_binding_t){.data = s_regs[i], .len = (i < 4) ? 1 : 4, .writable = true};
+    s_chars[i] = (ble_characteristic_t){.uuid = (uint16_t)(0xFF01 + i), .size = 4, .binding = &s_bindings[i]};
+  }
+  for (size_t i = 0; i < 4; i++)
+  {
+    snprintf(s_labels[i], sizeof(s_labels[i]), "zone-%zu-living-room", i);
+    s_chars[8 + i] = (ble_characteristic_t){.uuid = (uint16_t)(0xFF09 + i), .size = 20, .read = labels[i]};
+  }
+  for (size_t i = 0; i < 4; i++)
+    s_chars[12 + i] = (ble_characteristic_t){.uuid = (uint16_t)(0xFF0D + i), .size = 16, .read = read_counters};
+}
+
+/**
+ * @brief Round trips of one Read per value, plus Read Blob for what does not fit MTU - 1
+ */
+static unsigned sequential(const size_t *len, size_t mtu)
+{
+  unsigned trips = 0;
+  for (size_t i = 0; i < BENCH_CHARS; i++)
+    trips += 1 + ((len[i] > mtu - 1) ? (unsigned)((len[i] - 1) / (mtu - 1)) : 0);
+  return trips;
+}
+
+/**
+ * @brief Round trips of Read Multiple Variable Length: the request lists handles, the response length + value pairs
+ *
+ * A value cut by the end of the response is finished with Read Blob.
+ */
+static unsigned read_multiple(const size_t *len, size_t mtu)
+{
+  unsigned trips = 0;
+  size_t i = 0;
+  while (i < BENCH_CHARS)
+  {
+    size_t rsp = 1, handles = 0;  // Opcode
+    while (i < BENCH_CHARS && 1 + 2 * (handles + 1) <= mtu && rsp + 2 <= mtu)
+    {
+      size_t room = mtu - rsp - 2;
+      rsp += 2 + ((len[i] < room) ? len[i] : room);
+      if (len[i] > room)
+        trips += (unsigned)((len[i] - room + mtu - 2) / (mtu - 1));
+      handles++;
+      i++;
+    }
+    trips++;
+  }
+  return trips;
+}
+
+int main(void)
+{
+  static const size_t mtus[] = {23, 185, 247};
+  static const double intervals_ms[] = {7.5, 30.0};
+  uint8_t value[BENCH_CHARS][BENCH_VALUE];
+  size_t len[BENCH_CHARS];
+  size_t total = 0;
+
+  make_config();
+
+  // Server side of one fetch: one snapshot per handle, whichever procedure asked
+  int64_t start = now_ns();
+  for (int round = 0; round < BENCH_ROUNDS; round++)
+  {
+    for (size_t i = 0; i < BENCH_CHARS; i++)
+      len[i] = (size_t)ble_char_read_value(&s_chars[i], value[i], sizeof(value[i]));
+  }
+  double server_ms = (double)(now_ns() - start) / BENCH_ROUNDS / 1e6;
+
+  for (size_t i = 0; i < BENCH_CHARS; i++)
+    total += len[i];
+  printf("read multiple bench: %d characteristics, %zu value bytes, %.2f us server time per fetch\n",
+         BENCH_CHARS,
+         total,
+         server_ms * 1000.0);
+
+  for (size_t m = 0; m < sizeof(mtus) / sizeof(mtus[0]); m++)
+  {
+    unsigned seq = sequential(len, mtus[m]);
+    unsigned multi = read_multiple(len, mtus[m]);
+    for (size_t k = 0; k < sizeof(intervals_ms) / sizeof(intervals_ms[0]); k++)
+    {
+      printf("MTU %3zu, %4.1f ms interval: sequential %2u round trips %6.1f ms, "
+             "Read Multiple %2u round trips %6.1f ms\n",
+             mtus[m],
+             intervals_ms[k],
+             seq,
+             seq * intervals_ms[k] + server_ms,
+             multi,
+             multi * intervals_ms[k] + server_ms);
+    }
+  }
+  return 0;
+}
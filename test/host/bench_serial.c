@@ -0,0 +1,157 @@
+/**
+ * @file bench_serial.c
+ * @brief Host loopback benchmark of the serial bridge data path
+ *
+ * Three threads stand in for the tasks of the bridge:
+ *
+ *   client -> RX ring -> echo (application) -> TX ring -> flush (notifications)
+ *
+ * The client writes MTU-sized packets all or nothing, as serial_rx_write() does,
+ * retrying while the RX ring is full. The flush thread drains the TX ring in
+ * packets of the same size, checks every byte and measures how long each packet
+ * took from the client write to the flush. Radio time is not modelled, so the
+ * numbers are the ceiling the rings and copies allow.
+ */
+
+#include "ble-ring.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_RING_SIZE 1024                // Default ring size of the bridge
+#define BENCH_PACKET    244                 // Notification payload at a 247 byte MTU
+#define BENCH_PACKETS   200000
+#define BENCH_BYTES     ((size_t)BENCH_PACKETS * BENCH_PACKET)
+#define BENCH_STAMPS    (BENCH_PACKETS + 1)
+
+static ble_ring_t s_rx;
+static ble_ring_t s_tx;
+static int64_t s_sent_ns[BENCH_STAMPS];  // Client write time of each packet
+static int64_t s_latency_ns[BENCH_STAMPS];
+
+static int64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint8_t pattern(size_t at)
+{
+  return (uint8_t)(at * 31 + (at >> 8));
+}
+
+static void *client_thread(void *arg)
+{
+  uint8_t packet[BENCH_PACKET];
+  (void)arg;
+
+  for (size_t n = 0; n < BENCH_PACKETS; n++)
+  {
+    for (size_t i = 0; i < BENCH_PACKET; i++)
+      packet[i] = pattern(n * BENCH_PACKET + i);
+
+    // Refused whole while the reader lags, like a write request answered with BUSY
+    while (ble_ring_space(&s_rx) < BENCH_PACKET)
+      sched_yield();
+    s_sent_ns[n] = now_ns();
+    ble_ring_put(&s_rx, packet, BENCH_PACKET);
+  }
+  return NULL;
+}
+
+static void *echo_thread(void *arg)
+{
+  uint8_t buf[128];  // Smaller than a packet, like a line-oriented application
+  size_t echoed = 0;
+  (void)arg;
+
+  while (echoed < BENCH_BYTES)
+  {
+    size_t len = ble_ring_peek(&s_rx, buf, sizeof(buf));
+    if (len == 0)
+    {
+      sched_yield();
+      continue;
+    }
+    ble_ring_consume(&s_rx, len);
+
+    size_t done = 0;
+    while (done < len)
+    {
+      done += ble_ring_put(&s_tx, &buf[done], len - done);
+      if (done < len)
+        sched_yield();
+    }
+    echoed += len;
+  }
+  return NULL;
+}
+
+static int compare_i64(const void *a, const void *b)
+{
+  int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+  return (x > y) - (x < y);
+}
+
+int main(void)
+{
+  if (!ble_ring_alloc(&s_rx, BENCH_RING_SIZE) || !ble_ring_alloc(&s_tx, BENCH_RING_SIZE))
+    return 1;
+
+  pthread_t client, echo;
+  int64_t start = now_ns();
+  pthread_create(&client, NULL, client_thread, NULL);
+  pthread_create(&echo, NULL, echo_thread, NULL);
+
+  // Flush: full packets only, the tail of the stream is the last partial one
+  uint8_t packet[BENCH_PACKET];
+  size_t received = 0, packets = 0;
+  while (received < BENCH_BYTES)
+  {
+    size_t want = (BENCH_BYTES - received < BENCH_PACKET) ? BENCH_BYTES - received : BENCH_PACKET;
+    if (ble_ring_used(&s_tx) < want)
+    {
+      sched_yield();
+      continue;
+    }
+
+    size_t len = ble_ring_peek(&s_tx, packet, want);
+    ble_ring_consume(&s_tx, len);
+    for (size_t i = 0; i < len; i++)
+    {
+      if (packet[i] != pattern(received + i))
+      {
+        fprintf(stderr, "Byte %zu corrupted\n", received + i);
+        return 1;
+      }
+    }
+
+    // Packets stay aligned because the flush takes exactly one client packet at a time
+    s_latency_ns[packets] = now_ns() - s_sent_ns[packets];
+    received += len;
+    packets++;
+  }
+  int64_t elapsed = now_ns() - start;
+
+  pthread_join(client, NULL);
+  pthread_join(echo, NULL);
+
+  qsort(s_latency_ns, packets, sizeof(s_latency_ns[0]), compare_i64);
+  printf("serial loopback: %zu bytes in %zu packets, %.1f MB/s\n",
+         received,
+         packets,
+         (double)received * 1000.0 / (double)elapsed);
+  printf("packet latency: p50 %.1f us, p99 %.1f us, max %.1f us\n",
+         s_latency_ns[packets / 2] / 1000.0,
+         s_latency_ns[packets * 99 / 100] / 1000.0,
+         s_latency_ns[packets - 1] / 1000.0);
+
+  ble_ring_release(&s_rx);
+  ble_ring_release(&s_tx);
+  return 0;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file test_bond.c
+ * @brief Host test of the bond usage table and its Service Changed decision
+ */
+
+#include "ble-bond.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHECK(cond)                                                            \
+  do                                                                           \
+  {                                                                            \
+    if (!(cond))                                                               \
+    {                                                                          \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+      exit(1);                                                                 \
+    }                                                                          \
+  } while (0)
+
+static const uint8_t A[BLE_BOND_ADDR_LEN] = {1, 1, 1, 1, 1, 1};
+static const uint8_t B[BLE_BOND_ADDR_LEN] = {2, 2, 2, 2, 2, 2};
+static const uint8_t C[BLE_BOND_ADDR_LEN] = {3, 3, 3, 3, 3, 3};
+
+static void test_stale_cache(void)
+{
+  ble_bond_entry_t table[2] = {0};
+  uint32_t clock = 0;
+
+  CHECK(!ble_bond_touch(table, 2, &clock, A, 0x1111));  // New client discovers the current database
+  CHECK(!ble_bond_touch(table, 2, &clock, A, 0x1111));  // Same database, cache still valid
+  CHECK(ble_bond_touch(table, 2, &clock, A, 0x2222));   // Database changed since the last connection
+  CHECK(!ble_bond_touch(table, 2, &clock, A, 0x2222));  // Indicated once, then up to date
+  CHECK(ble_bond_find(table, 2, A)->db_hash == 0x2222);
+}
+
+static void test_lru(void)
+{
+  ble_bond_entry_t table[2] = {0};
+  uint32_t clock = 0;
+
+  ble_bond_touch(table, 2, &clock, A, 1);
+  ble_bond_touch(table, 2, &clock, B, 1);
+  ble_bond_touch(table, 2, &clock, A, 1);  // B is now the least recently used
+  CHECK(!ble_bond_touch(table, 2, &clock, C, 2));
+  CHECK(ble_bond_find(table, 2, B) == NULL);
+  CHECK(ble_bond_find(table, 2, A) != NULL);
+  CHECK(ble_bond_find(table, 2, C)->db_hash == 2);
+  CHECK(ble_bond_clock(table, 2) == clock);
+  CHECK(clock == 4);
+}
+
+static void test_remove(void)
+{
+  ble_bond_entry_t table[2] = {0};
+  uint32_t clock = 0;
+
+  ble_bond_touch(table, 2, &clock, A, 1);
+  CHECK(ble_bond_remove(table, 2, A));
+  CHECK(!ble_bond_remove(table, 2, A));
+  CHECK(ble_bond_find(table, 2, A) == NULL);
+  CHECK(!ble_bond_touch(table, 2, &clock, A, 2));  // Re-bonded client discovers from scratch
+  CHECK(ble_bond_clock(table, 2) == 2);
+}
+
+int main(void)
+{
+  test_stale_cache();
+  test_lru();
+  test_remove();
+  printf("bond: ok\n");
+  return 0;
+}
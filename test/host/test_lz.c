@@ -0,0 +1,162 @@
+/**
+ * @file test_lz.c
+ * @brief Host test of the LZ codec: encode in pieces, decode, compare
+ */
+
+#include "ble-lz.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHECK(cond)                                                            \
+  do                                                                           \
+  {                                                                            \
+    if (!(cond))                                                               \
+    {                                                                          \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+      exit(1);                                                                 \
+    }                                                                          \
+  } while (0)
+
+#define BIG 8192
+
+static ble_lz_t lz;
+static uint16_t dict_head[BLE_LZ_HASH_SIZE];
+static uint8_t stream[2 * BIG];
+static uint8_t decoded[BIG];
+
+/**
+ * @brief Encode input committed in chunk-sized pieces into at most cap bytes
+ * @return Stream length; lz.encoded holds the input bytes it carries
+ */
+static size_t encode(const uint8_t *dict, size_t dict_len, const uint8_t *in, size_t len, size_t chunk, size_t cap)
+{
+  ble_lz_prime(dict_head, dict, dict_len);
+  ble_lz_begin(&lz, dict, dict_len, dict_head, stream, cap);
+
+  size_t done = 0;
+  while (done < len)
+  {
+    size_t room;
+    uint8_t *window = ble_lz_input(&lz, &room);
+    if (room == 0)
+      break;
+    size_t n = len - done;
+    if (n > chunk)
+      n = chunk;
+    if (n > room)
+      n = room;
+    memcpy(window, &in[done], n);
+    ble_lz_commit(&lz, n);
+    done += n;
+  }
+  return ble_lz_finish(&lz);
+}
+
+static void round_trip(const uint8_t *dict, size_t dict_len, const uint8_t *in, size_t len, size_t chunk)
+{
+  size_t n = encode(dict, dict_len, in, len, chunk, sizeof(stream));
+  CHECK(lz.encoded == len);
+  CHECK(ble_lz_decode(dict, dict_len, stream, n, decoded, sizeof(decoded)) == (int)len);
+  CHECK(memcmp(decoded, in, len) == 0);
+}
+
+static void test_dictionary(void)
+{
+  static const uint8_t dict[] = "\"state\":\"temperature\":\"error\":\"uptime\":";
+  static const uint8_t value[] = "{\"state\":1,\"temperature\":215,\"uptime\":3600}";
+  size_t dict_len = sizeof(dict) - 1, len = sizeof(value) - 1;
+
+  size_t with = encode(dict, dict_len, value, len, len, sizeof(stream));
+  CHECK(ble_lz_decode(dict, dict_len, stream, with, decoded, sizeof(decoded)) == (int)len);
+  CHECK(memcmp(decoded, value, len) == 0);
+
+  // The keys come from the dictionary, so the stream is shorter than without it
+  size_t without = encode(NULL, 0, value, len, len, sizeof(stream));
+  CHECK(with < without);
+
+  // Matches into the dictionary cannot be decoded without it
+  with = encode(dict, dict_len, value, len, len, sizeof(stream));
+  CHECK(ble_lz_decode(NULL, 0, stream, with, decoded, sizeof(decoded)) < 0);
+}
+
+static void test_overlap(void)
+{
+  static uint8_t run[600];
+  memset(run, 'a', sizeof(run));
+
+  // One literal, then matches one byte back copying the bytes they produce
+  size_t n = encode(NULL, 0, run, sizeof(run), sizeof(run), sizeof(stream));
+  CHECK(n < 40);
+  CHECK(ble_lz_decode(NULL, 0, stream, n, decoded, sizeof(decoded)) == (int)sizeof(run));
+  CHECK(memcmp(decoded, run, sizeof(run)) == 0);
+
+  static const uint8_t abc[] = "abcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabc";
+  round_trip(NULL, 0, abc, sizeof(abc) - 1, 5);
+}
+
+static void test_window_slide(void)
+{
+  static uint8_t text[BIG];
+  static const char *words[] = {"sensor", "value", "error", "ok", "temperature", "fan", "door", "42", "\n"};
+  uint32_t seed = 1;
+
+  // Repetitive but irregular text, far longer than the window
+  size_t len = 0;
+  while (len < sizeof(text))
+  {
+    seed = seed * 1103515245u + 12345u;
+    const char *w = words[(seed >> 16) % (sizeof(words) / sizeof(words[0]))];
+    for (size_t i = 0; w[i] != '\0' && len < sizeof(text); i++)
+      text[len++] = (uint8_t)w[i];
+  }
+
+  round_trip(NULL, 0, text, len, 1);
+  round_trip(NULL, 0, text, len, 100);
+  round_trip(NULL, 0, text, len, BLE_LZ_BUF_SIZE);
+
+  static const uint8_t dict[] = "temperature sensor value";
+  round_trip(dict, sizeof(dict) - 1, text, len, 333);
+}
+
+static void test_full_output(void)
+{
+  static uint8_t noise[1000];
+  uint32_t seed = 7;
+  for (size_t i = 0; i < sizeof(noise); i++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    noise[i] = (uint8_t)(seed >> 16);
+  }
+
+  // The stream stops at the cap and holds a prefix of the input
+  size_t n = encode(NULL, 0, noise, sizeof(noise), 64, 100);
+  CHECK(n <= 100);
+  CHECK(lz.encoded > 0 && lz.encoded < sizeof(noise));
+  CHECK(ble_lz_decode(NULL, 0, stream, n, decoded, sizeof(decoded)) == (int)lz.encoded);
+  CHECK(memcmp(decoded, noise, lz.encoded) == 0);
+}
+
+static void test_malformed(void)
+{
+  static const uint8_t match_before_start[] = {0x01, 0x00, 0x00};
+  static const uint8_t cut_match[] = {0x02, 'a', 0x00};
+  static const uint8_t literals[] = {0x00, 'a', 'b', 'c'};
+
+  CHECK(ble_lz_decode(NULL, 0, match_before_start, sizeof(match_before_start), decoded, sizeof(decoded)) < 0);
+  CHECK(ble_lz_decode(NULL, 0, cut_match, sizeof(cut_match), decoded, sizeof(decoded)) < 0);
+  CHECK(ble_lz_decode(NULL, 0, literals, sizeof(literals), decoded, 2) < 0);
+  CHECK(ble_lz_decode(NULL, 0, literals, sizeof(literals), decoded, 3) == 3);
+}
+
+int main(void)
+{
+  test_dictionary();
+  test_overlap();
+  test_window_slide();
+  test_full_output();
+  test_malformed();
+  printf("lz: ok\n");
+  return 0;
+}
@@ -0,0 +1,279 @@
+/**
+ * @file test_xfer.c
+ * @brief Host test of the transfer protocol over a lossy, corrupting link
+ *
+ * A sender and a receiver run the ble-xfer-proto rules: the server sends
+ * downloads and receives uploads the same way, so one pair covers both
+ * directions. Each connection event the sender puts up to BURST blocks on the
+ * link, which drops or damages each one at the configured rates; ACK and SEEK
+ * travel as writes with response or control notifications, which the link
+ * layer delivers. When the window is full and nothing answers, the receiver
+ * times out and sends SEEK, the way a client recovers from a lost last block.
+ *
+ * Every run checks the object arrives intact and prints the goodput (share of
+ * the link carrying new object bytes, and KB/s at a 7.5 ms interval), the
+ * blocks sent again, the SEEKs and the timeouts. One run disconnects part way
+ * and continues with an OPEN at offset 0xFFFFFFFF.
+ */
+
+#include "ble-xfer-proto.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHECK(cond)                                                            \
+  do                                                                           \
+  {                                                                            \
+    if (!(cond))                                                               \
+    {                                                                          \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+      exit(1);                                                                 \
+    }                                                                          \
+  } while (0)
+
+#define OBJECT_SIZE    (64 * 1024)
+#define OBJECT_ID      3
+#define BLOCK          236  // Payload at a 247 byte MTU
+#define WINDOW         8
+#define BURST          4    // Blocks per connection event
+#define INTERVAL_US    7500
+#define TIMEOUT_EVENTS 14   // About 100 ms without progress before the receiver rewinds
+#define MAX_EVENTS     1000000
+
+typedef struct
+{
+  unsigned loss_pct;
+  unsigned corrupt_pct;
+  uint32_t disconnect_at;  ///< Event of the disconnect, 0 for none
+} link_t;
+
+typedef struct
+{
+  uint32_t events;
+  uint32_t blocks;
+  uint32_t resent;  ///< Blocks below the highest offset already sent
+  uint32_t seeks;
+  uint32_t crc_errors;
+  uint32_t timeouts;
+  uint32_t resumed_at;
+} result_t;
+
+static uint8_t s_object[OBJECT_SIZE];
+static uint8_t s_received[OBJECT_SIZE];
+static uint32_t s_seed;
+
+static uint32_t next(void)
+{
+  s_seed = s_seed * 1103515245u + 12345u;
+  return s_seed >> 16;
+}
+
+/**
+ * @brief Pass one block to the receiver
+ * @return true if it sends a control message, with seek and offset set
+ */
+static bool receive(ble_xfer_proto_t *rx, const uint8_t *data, size_t len, result_t *res, bool *seek, uint32_t *at)
+{
+  uint32_t offset;
+  size_t payload;
+  ble_xfer_block_t check = ble_xfer_proto_check(rx, data, len, &offset, &payload);
+  CHECK(check != BLE_XFER_BLOCK_SHORT);
+
+  if (check == BLE_XFER_BLOCK_OK)
+  {
+    memcpy(&s_received[offset], &data[4], payload);
+    bool done;
+    bool ack = ble_xfer_proto_accept(rx, payload, &done);
+    *seek = false;
+    *at = rx->next;
+    return ack;
+  }
+
+  if (check == BLE_XFER_BLOCK_CORRUPT)
+    res->crc_errors++;
+  *seek = true;
+  *at = rx->next;
+  return ble_xfer_proto_rewind(rx);
+}
+
+static result_t run(const link_t *link)
+{
+  static uint8_t block[BLOCK + BLE_XFER_BLOCK_OVERHEAD];
+  ble_xfer_proto_t tx, rx;
+  ble_xfer_resume_t resume = {.valid = true, .object = OBJECT_ID, .state = BLE_XFER_PROTO_DOWNLOAD, .offset = 0};
+  result_t res = {0};
+  uint32_t high = 0;
+  bool done = false;
+
+  memset(s_received, 0, sizeof(s_received));
+  ble_xfer_proto_open(&tx, BLE_XFER_PROTO_DOWNLOAD, OBJECT_SIZE, 0, BLOCK, WINDOW);
+  ble_xfer_proto_open(&rx, BLE_XFER_PROTO_UPLOAD, OBJECT_SIZE, 0, BLOCK, WINDOW);
+
+  while (!done)
+  {
+    CHECK(++res.events < MAX_EVENTS);
+
+    if (res.events == link->disconnect_at)
+    {
+      // Both sides start over; the OPEN asks to resume and the response tells the receiver where
+      uint32_t offset = ble_xfer_proto_resolve(&resume, OBJECT_ID, BLE_XFER_PROTO_DOWNLOAD, BLE_XFER_RESUME);
+      ble_xfer_proto_open(&tx, BLE_XFER_PROTO_DOWNLOAD, OBJECT_SIZE, offset, BLOCK, WINDOW);
+      ble_xfer_proto_open(&rx, BLE_XFER_PROTO_UPLOAD, OBJECT_SIZE, offset, BLOCK, WINDOW);
+      res.resumed_at = offset;
+    }
+
+    // Control messages of this event, applied by the sender at its end, in order
+    struct
+    {
+      bool seek;
+      uint32_t offset;
+    } control[BURST + 1];
+    size_t controls = 0;
+
+    size_t sent = 0;
+    uint32_t offset, len;
+    while (sent < BURST && ble_xfer_proto_next(&tx, &offset, &len))
+    {
+      memcpy(&block[4], &s_object[offset], len);
+      size_t framed = ble_xfer_proto_seal(block, offset, len);
+      ble_xfer_proto_sent(&tx, offset, len);
+      sent++;
+      res.blocks++;
+      if (offset < high)
+        res.resent++;
+      if (offset + len > high)
+        high = offset + len;
+
+      if (next() % 100 < link->loss_pct)
+        continue;
+      if (next() % 100 < link->corrupt_pct)
+        block[next() % framed] ^= (uint8_t)(1 << (next() % 8));
+
+      if (receive(&rx, block, framed, &res, &control[controls].seek, &control[controls].offset))
+        controls++;
+    }
+
+    if (sent == 0 && controls == 0)
+    {
+      // Stalled: the receiver gives up waiting and asks for everything from its next offset
+      res.events += TIMEOUT_EVENTS;
+      res.timeouts++;
+      rx.seek_sent = false;
+      CHECK(ble_xfer_proto_rewind(&rx));
+      control[controls].seek = true;
+      control[controls++].offset = rx.next;
+    }
+
+    for (size_t i = 0; i < controls; i++)
+    {
+      res.seeks += control[i].seek;
+      CHECK(ble_xfer_proto_ack(&tx, control[i].offset, control[i].seek, &done));
+      resume.offset = control[i].offset;
+    }
+  }
+
+  CHECK(rx.next == OBJECT_SIZE);
+  CHECK(memcmp(s_received + res.resumed_at, s_object + res.resumed_at, OBJECT_SIZE - res.resumed_at) == 0);
+  return res;
+}
+
+static void report(const char *name, const result_t *res)
+{
+  double seconds = (double)res->events * INTERVAL_US / 1e6;
+  printf("%-24s goodput %5.1f%% of link, %6.1f KB/s, %4u blocks resent, %3u SEEKs (%u timeouts), %u CRC errors\n",
+         name,
+         100.0 * OBJECT_SIZE / ((double)res->events * BURST * BLOCK),
+         OBJECT_SIZE / 1024.0 / seconds,
+         res->resent,
+         res->seeks,
+         res->timeouts,
+         res->crc_errors);
+}
+
+static void test_clean_link(void)
+{
+  link_t link = {0};
+  result_t res = run(&link);
+  CHECK(res.resent == 0 && res.seeks == 0 && res.timeouts == 0);
+  CHECK(res.blocks == (OBJECT_SIZE + BLOCK - 1) / BLOCK);
+  report("clean", &res);
+}
+
+static void test_loss_and_corruption(void)
+{
+  static const link_t links[] = {
+    {1, 0, 0}, {5, 0, 0}, {20, 0, 0}, {0, 1, 0}, {0, 5, 0}, {5, 5, 0},
+  };
+
+  for (size_t i = 0; i < sizeof(links) / sizeof(links[0]); i++)
+  {
+    char name[32];
+    snprintf(name, sizeof(name), "loss %u%%, corrupt %u%%", links[i].loss_pct, links[i].corrupt_pct);
+    result_t res = run(&links[i]);
+    CHECK(res.resent > 0 && res.seeks > 0);
+    CHECK(links[i].corrupt_pct == 0 || res.crc_errors > 0);
+    report(name, &res);
+  }
+}
+
+static void test_resume(void)
+{
+  link_t link = {5, 1, 40};
+  result_t res = run(&link);
+  // Continues from the last ACK instead of offset 0
+  CHECK(res.resumed_at > 0 && res.resumed_at % BLOCK == 0);
+  report("resume after disconnect", &res);
+}
+
+static void test_protocol_rules(void)
+{
+  ble_xfer_proto_t p;
+  ble_xfer_resume_t resume = {.valid = true, .object = 1, .state = BLE_XFER_PROTO_UPLOAD, .offset = 500};
+  uint8_t block[16] = {0};
+  uint32_t offset, len;
+  size_t payload;
+  bool done;
+
+  // Resume only for the same object and direction
+  CHECK(ble_xfer_proto_resolve(&resume, 1, BLE_XFER_PROTO_UPLOAD, BLE_XFER_RESUME) == 500);
+  CHECK(ble_xfer_proto_resolve(&resume, 2, BLE_XFER_PROTO_UPLOAD, BLE_XFER_RESUME) == 0);
+  CHECK(ble_xfer_proto_resolve(&resume, 1, BLE_XFER_PROTO_DOWNLOAD, BLE_XFER_RESUME) == 0);
+  CHECK(ble_xfer_proto_resolve(&resume, 2, BLE_XFER_PROTO_DOWNLOAD, 7) == 7);
+
+  // The window stops the sender, an ACK outside the sent range is refused
+  ble_xfer_proto_open(&p, BLE_XFER_PROTO_DOWNLOAD, 100, 0, 10, 2);
+  CHECK(ble_xfer_proto_next(&p, &offset, &len) && offset == 0 && len == 10);
+  ble_xfer_proto_sent(&p, 0, 10);
+  ble_xfer_proto_sent(&p, 10, 10);
+  CHECK(!ble_xfer_proto_next(&p, &offset, &len));
+  CHECK(!ble_xfer_proto_ack(&p, 30, false, &done));
+  CHECK(ble_xfer_proto_ack(&p, 10, true, &done) && !done && p.next == 10);
+  CHECK(!ble_xfer_proto_ack(&p, 0, false, &done));
+
+  // A short, damaged or out of order block is refused, one SEEK per gap
+  ble_xfer_proto_open(&p, BLE_XFER_PROTO_UPLOAD, 100, 0, 4, 8);
+  CHECK(ble_xfer_proto_check(&p, block, BLE_XFER_BLOCK_OVERHEAD, &offset, &payload) == BLE_XFER_BLOCK_SHORT);
+  size_t framed = ble_xfer_proto_seal(block, 4, 4);
+  CHECK(ble_xfer_proto_check(&p, block, framed, &offset, &payload) == BLE_XFER_BLOCK_GAP);
+  CHECK(ble_xfer_proto_rewind(&p) && !ble_xfer_proto_rewind(&p));
+  block[5] ^= 1;
+  CHECK(ble_xfer_proto_check(&p, block, framed, &offset, &payload) == BLE_XFER_BLOCK_CORRUPT);
+  framed = ble_xfer_proto_seal(block, 0, 4);
+  CHECK(ble_xfer_proto_check(&p, block, framed, &offset, &payload) == BLE_XFER_BLOCK_OK && payload == 4);
+  CHECK(!ble_xfer_proto_accept(&p, payload, &done) && !p.seek_sent);
+}
+
+int main(void)
+{
+  for (size_t i = 0; i < OBJECT_SIZE; i++)
+    s_object[i] = (uint8_t)(i * 31 + (i >> 8));
+  s_seed = 1;
+
+  test_protocol_rules();
+  test_clean_link();
+  test_loss_and_corruption();
+  test_resume();
+  printf("xfer: ok\n");
+  return 0;
+}